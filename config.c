@@ -574,6 +574,14 @@ int main()
     printf("Do you want stripped-down version (smaller - no error messages) (Y/N)?");
     stripped=answer();
     if (stripped) fprintf(fp,"#define MR_STRIPPED_DOWN\n");
+
+    if (!static_build)
+    {
+        printf("Do you want each instance to recycle its memory through an allocation pool\n");
+        printf("with optional arena scopes, rather than calling the heap every time (Y/N)?");
+        choice=answer();
+        if (choice) fprintf(fp,"#define MR_ALLOC_POOL\n");
+    }
     
      printf("Do you want multi-threaded version of MIRACL\n");
      printf("Not recommended for program development - read the manual (Y/N)?");
@@ -917,7 +925,15 @@ int main()
     {
         fprintf(fp,"#define MR_SMALL_AES\n");
     }
-    
+
+    printf("\nDo you want to speed up AES-GCM by using a larger 4k byte GHASH table\n");
+    printf("instead of the default 256 bytes. Default to No. (Y/N)?");
+    r=answer();
+    if (r)
+    {
+        fprintf(fp,"#define MR_GCM_TABLE8\n");
+    }
+
     edwards=0;
     printf("\nDo you want to use Edwards paramaterization of elliptic curves over Fp\n");
     printf("This is faster for basic Elliptic Curve cryptography (but does not support\n");
@@ -135,6 +135,19 @@ mr->RPOINT=TRUE;
     ~Miracl()                    {mirexit();}
 };
 
+#ifdef MR_ALLOC_POOL
+
+class Arena
+{ /* scoped arena - all Bigs etc. created in its lifetime are bump allocated,
+   * and must be destroyed before it is. */
+    BOOL ok;
+public:
+    Arena()                      {ok=mr_arena_mark();}
+    ~Arena()                     {if (ok) mr_arena_release();}
+};
+
+#endif
+
 #endif
 
 /*
@@ -440,6 +453,25 @@ public:
 
 extern BOOL modulo(int,int,int,int,BOOL);
 extern Big get_modulus(void);
+
+#ifndef MR_STATIC
+
+class ModContext
+{ /* a prepared modulus. Switching to it with modulo() is cheap, and *
+   * ZZn values created under it remain valid across switches.      */
+    mr_monty m;
+    ModContext(const ModContext&);
+    ModContext& operator=(const ModContext&);
+public:
+    ModContext(const Big& n)     {monty_init(&m,n.getbig());}
+    mr_monty *getmonty()         {return &m;}
+    ~ModContext()                {monty_end(&m);}
+};
+
+inline void modulo(ModContext& c) {monty_use(c.getmonty());}
+
+#endif
+
 extern Big rand(int,int); 
 extern Big strong_rand(csprng *,int,int);
 extern Big from_binary(int,char *);
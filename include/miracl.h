@@ -57,6 +57,32 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 #define MR_KARATSUBA 2
 #endif
 
+/* multiply() and divide() crossovers in words, see mrarth2.c. Run multune to choose */
+
+#ifndef MR_KARATSUBA_THRESHOLD
+#define MR_KARATSUBA_THRESHOLD 24
+#endif
+
+#ifndef MR_TOOM3_THRESHOLD
+#define MR_TOOM3_THRESHOLD 192
+#endif
+
+#ifndef MR_BURNIKEL_THRESHOLD
+#define MR_BURNIKEL_THRESHOLD 64
+#endif
+
+#ifndef MR_BARRETT_THRESHOLD
+#define MR_BARRETT_THRESHOLD 1024
+#endif
+
+/* Define MR_FFT_THREADS to let fft_mult() and the polynomial FFT routines in *
+ * mrfast.c use mr_mip->FFT_THREADS POSIX threads, for transforms of at least *
+ * this many points in all                                                  */
+
+#ifndef MR_FFT_THREAD_POINTS
+#define MR_FFT_THREAD_POINTS 16384
+#endif
+
 #ifndef MR_DOUBLE_BIG
 
 #ifdef MR_KCM
@@ -369,6 +395,18 @@ mr_utype *M;
 int NP;
 } small_chinese;
 
+/* squaring modulo 2^q+1 or 2^q-1 by weighted transform, see mrfast.c */
+
+typedef struct {
+int q,sign,logn,n;
+int *shift;
+mr_utype prime[2],c;
+mr_utype *roots[2];
+mr_utype *wt[2],*iwt[2];
+mr_utype *t[2];
+mr_utype *d;
+} fft_mod;
+
 /* Cryptographically strong pseudo-random number generator */
 
 typedef struct {
@@ -426,6 +464,7 @@ int rate,len;
 typedef struct {
 int Nk,Nr;
 int mode;
+int ni;     /* TRUE if AES-NI instructions are to be used */
 mr_unsign32 fkey[60];
 mr_unsign32 rkey[60];
 char f[16];
@@ -440,8 +479,17 @@ char f[16];
 #define GCM_ENCRYPTING 0
 #define GCM_DECRYPTING 1
 
+#ifdef MR_GCM_TABLE8
+#define GCM_TABLE_SIZE 256    /* 4k bytes */
+#else
+#define GCM_TABLE_SIZE 16     /* 256 bytes */
+#endif
+#define GCM_HPOWERS 4
+
 typedef struct {
-mr_unsign32 table[128][4]; /* 2k bytes */
+mr_unsign32 table[GCM_TABLE_SIZE][4]; 
+MR_BYTE Hpow[GCM_HPOWERS][16]; /* H^1..H^4 for carry-less multiply */
+int clmul;
 MR_BYTE stateX[16];
 MR_BYTE Y_0[16];
 mr_unsign32 counter;
@@ -591,6 +639,79 @@ typedef struct
 	zzn2 c;
 } zzn6_3x2;
 
+#ifdef MR_ALLOC_POOL
+
+#include <stddef.h>
+
+/* allocation pool - see mralloc.c */
+
+#define MR_POOL_CLASSES 8      /* distinct block sizes kept on free lists */
+#define MR_POOL_DEPTH   256    /* maximum blocks cached per size */
+#define MR_ARENA_DEPTH  16     /* maximum nesting of arena scopes */
+#define MR_ARENA_CHUNK  65536  /* arena grows in chunks of this many bytes */
+
+typedef struct {
+unsigned long allocs;    /* calls to mr_alloc()           */
+unsigned long frees;     /* calls to mr_free()            */
+unsigned long heap;      /* passed to backing allocator   */
+unsigned long recycled;  /* served from a free list       */
+unsigned long arena;     /* served from the arena         */
+} mr_alloc_stats;
+
+typedef struct mr_chunk_t {
+struct mr_chunk_t *next;
+size_t size,top;
+} mr_chunk;
+
+typedef struct {
+void *(*alloc)(size_t);          /* backing allocator */
+void  (*dealloc)(void *);
+int   size[MR_POOL_CLASSES];     /* size classes ...  */
+void *list[MR_POOL_CLASSES];     /* ... and their free lists */
+int   count[MR_POOL_CLASSES];
+mr_chunk *first,*chunk;          /* arena */
+int   scope;
+mr_chunk *mchunk[MR_ARENA_DEPTH];
+size_t mtop[MR_ARENA_DEPTH];
+long  live;                      /* heap blocks not yet returned */
+BOOL  closed;
+mr_alloc_stats stats;
+#ifdef MR_UNIX_MT
+void *lock;                      /* mutex, as blocks may be freed by any thread */
+#endif
+} mr_pool;
+
+#endif
+
+/* fixed size Montgomery kernels, w=x*y mod n given ndash, for moduli */
+/* of up to MR_KERNEL_MAX words - see mr_set_kernel() and montfield.h */
+
+#define MR_KERNEL_MAX 16
+
+typedef void (*mr_kernel)(big,big,big,mr_small,big);
+
+/* a Montgomery modulus with its precomputed constants - see monty_init() */
+
+#ifdef MR_KCM
+#define MR_MONTY_SPACES 5
+#else
+#define MR_MONTY_SPACES 4
+#endif
+
+typedef struct {
+char *mem;
+big modulus;
+big pR;
+big one;
+#ifdef MR_KCM
+big big_ndash;
+#endif
+mr_small ndash;
+int qnr,pmod8,pmod9;
+BOOL NO_CARRY,ACTIVE,MONTY;
+mr_kernel kmult,ksqr;
+} mr_monty;
+
 /* main MIRACL instance structure */
 
 /* ------------------------------------------------------------------------*/
@@ -633,6 +754,9 @@ big modulus;
 big pR;
 BOOL ACTIVE;
 BOOL MONTY;
+mr_kernel kmult,ksqr;  /* fixed size kernels for this modulus, or NULL */
+mr_monty *cmonty;      /* modulus context in use, or NULL...           */
+mr_monty monty;        /* ...in which case our own modulus is kept here */
 
                        /* Elliptic Curve details   */
 #ifndef MR_NO_SS
@@ -668,6 +792,14 @@ mr_utype *wa;
 mr_utype *wb;
 mr_utype *wc;
 
+mr_small *rdiv;       /* last divisor, reciprocal and workspace for divide() */
+int rlen;
+BOOL rready;
+
+#ifdef MR_ALLOC_POOL
+mr_pool *pool;        /* allocator for this instance */
+#endif
+
 #endif
 
 BOOL same;
@@ -697,6 +829,13 @@ int  IOBSIZ;       /* size of i/o buffer */
 BOOL ERCON;        /* error control   */
 int  ERNUM;        /* last error code */
 int  NTRY;         /* no. of tries for probablistic primality testing   */
+#ifndef MR_STATIC
+int  KARATSUBA;    /* multiply() uses Karatsuba from this many words.. */
+int  TOOM3;        /* ..and Toom-3 from this many. 0 for never         */
+int  BURNIKEL;     /* divide() recurses from this many words           */
+int  BARRETT;      /* divide() keeps the last divisor's reciprocal     */
+int  FFT_THREADS;  /* workers for mrfast.c, with MR_FFT_THREADS        */
+#endif
 #ifndef MR_SIMPLE_IO
 int  INPLEN;       /* input length               */
 #ifndef MR_SIMPLE_BASE
@@ -845,7 +984,15 @@ extern void mr_xor(big,big,big);
 extern void  mr_shift(_MIPT_ big,int,big); 
 extern miracl *mr_first_alloc(void);
 extern void  *mr_alloc(_MIPT_ int,int);
-extern void  mr_free(void *);  
+extern void  mr_free(void *);
+#ifdef MR_ALLOC_POOL
+extern mr_pool *mr_pool_create(void *(*)(size_t),void (*)(void *));
+extern void  mr_pool_close(mr_pool *);
+extern void  mr_set_allocator(_MIPT_ void *(*)(size_t),void (*)(void *));
+extern BOOL  mr_arena_mark(_MIPTO_ );
+extern void  mr_arena_release(_MIPTO_ );
+extern void  mr_alloc_counters(_MIPT_ mr_alloc_stats *,BOOL);
+#endif  
 extern void  set_user_function(_MIPT_ BOOL (*)(void));
 extern void  set_io_buffer_size(_MIPT_ int);
 extern int   mr_testbit(_MIPT_ big,int);
@@ -868,6 +1015,12 @@ extern int   mr_poly_rem(_MIPT_ int,big *,big *);
 extern int   mr_ps_big_mul(_MIPT_ int,big *,big *,big *);
 extern int   mr_ps_zzn_mul(_MIPT_ int,big *,big *,big *);
 
+extern BOOL  fft_mod_init(_MIPT_ fft_mod *,int,int);
+extern void  fft_mod_set(_MIPT_ fft_mod *,big);
+extern void  fft_mod_sqr(_MIPT_ fft_mod *,int);
+extern void  fft_mod_get(_MIPT_ fft_mod *,big);
+extern void  fft_mod_end(fft_mod *);
+
 extern mr_small muldiv(mr_small,mr_small,mr_small,mr_small,mr_small *);
 extern mr_small muldvm(mr_small,mr_small,mr_small,mr_small *); 
 extern mr_small muldvd(mr_small,mr_small,mr_small,mr_small *); 
@@ -993,6 +1146,7 @@ extern void  bigdig(_MIPT_ int,int,big);
 extern int   trial_division(_MIPT_ big,big);
 extern BOOL  isprime(_MIPT_ big);
 extern BOOL  nxprime(_MIPT_ big,big);
+extern BOOL  nxprime_step(_MIPT_ int,int,big,big);
 extern BOOL  nxsafeprime(_MIPT_ int,int,big,big);
 extern BOOL  crt_init(_MIPT_ big_chinese *,int,big *);
 extern void  crt(_MIPT_ big_chinese *,big *,big);
@@ -1026,6 +1180,17 @@ extern int   mul2_brick(_MIPT_ ebrick2*,big,big,big);
 
 extern mr_small prepare_monty(_MIPT_ big);
 extern void  kill_monty(_MIPTO_ );
+extern void  mr_set_kernel(int,mr_kernel,mr_kernel);
+#ifndef MR_STATIC
+extern BOOL  monty_init(_MIPT_ mr_monty *,big);
+extern void  monty_end(_MIPT_ mr_monty *);
+#endif
+extern void  monty_use(_MIPT_ mr_monty *);
+extern void  monty_nres(_MIPT_ mr_monty *,big,big);
+extern void  monty_redc(_MIPT_ mr_monty *,big,big);
+extern void  monty_modmult(_MIPT_ mr_monty *,big,big,big);
+extern void  monty_modadd(_MIPT_ mr_monty *,big,big,big);
+extern void  monty_modsub(_MIPT_ mr_monty *,big,big,big);
 extern void  nres(_MIPT_ big,big);        
 extern void  redc(_MIPT_ big,big);        
 
@@ -1036,6 +1201,8 @@ extern void  nres_lazy(_MIPT_ big,big,big,big,big,big);
 extern void  nres_complex(_MIPT_ big,big,big,big);
 extern void  nres_double_modadd(_MIPT_ big,big,big);    
 extern void  nres_double_modsub(_MIPT_ big,big,big); 
+extern void  nres_double_lazy(_MIPT_ big,big,big,big,big,big);
+extern void  nres_double_redc(_MIPT_ big,big);
 extern void  nres_premult(_MIPT_ big,int,big);
 extern void  nres_modmult(_MIPT_ big,big,big);    
 extern int   nres_moddiv(_MIPT_ big,big,big);     
@@ -1054,24 +1221,30 @@ extern void  nres_div5(_MIPT_ big,big);
 
 extern void  shs_init(sha *);
 extern void  shs_process(sha *,int);
+extern void  shs_update(sha *,char *,int);
 extern void  shs_hash(sha *,char *);
 
 extern void  shs256_init(sha256 *);
 extern void  shs256_process(sha256 *,int);
+extern void  shs256_update(sha256 *,char *,int);
 extern void  shs256_hash(sha256 *,char *);
+extern void  shs256_hash_batch(int,sha256 **,char **,int *,char **);
 
 #ifdef mr_unsign64
 
 extern void  shs512_init(sha512 *);
 extern void  shs512_process(sha512 *,int);
+extern void  shs512_update(sha512 *,char *,int);
 extern void  shs512_hash(sha512 *,char *);
 
 extern void  shs384_init(sha384 *);
 extern void  shs384_process(sha384 *,int);
+extern void  shs384_update(sha384 *,char *,int);
 extern void  shs384_hash(sha384 *,char *);
 
 extern void  sha3_init(sha3 *,int);
 extern void  sha3_process(sha3 *,int);
+extern void  sha3_update(sha3 *,char *,int);
 extern void  sha3_hash(sha3 *,char *);
 
 #endif
@@ -1082,6 +1255,7 @@ extern void  aes_ecb_encrypt(aes *,MR_BYTE *);
 extern void  aes_ecb_decrypt(aes *,MR_BYTE *);
 extern mr_unsign32 aes_encrypt(aes *,char *);
 extern mr_unsign32 aes_decrypt(aes *,char *);
+extern void  aes_ctr_encrypt_blocks(aes *,char *,char *,int);
 extern void  aes_reset(aes *,int,char *);
 extern void  aes_end(aes *);
 
@@ -1231,6 +1405,12 @@ extern void zzn2_txd(_MIPT_ zzn2 *);
 extern BOOL zzn2_sqrt(_MIPT_ zzn2 *,zzn2 *);
 extern BOOL zzn2_qr(_MIPT_ zzn2 *);
 extern BOOL zzn2_multi_inverse(_MIPT_ int,zzn2 *,zzn2 *);
+extern void zzn2_double_mul(_MIPT_ zzn2 *,zzn2 *,zzn2 *);
+extern void zzn2_double_add(_MIPT_ zzn2 *,zzn2 *,zzn2 *);
+extern void zzn2_double_sub(_MIPT_ zzn2 *,zzn2 *,zzn2 *);
+extern void zzn2_double_txx(_MIPT_ zzn2 *);
+extern void zzn2_redc(_MIPT_ zzn2 *,zzn2 *);
+extern char *zzn2_double_memalloc(_MIPT_ int,zzn2 *);
 
 
 /* zzn3 stuff */
@@ -1289,6 +1469,13 @@ extern void zzn4_from_big(_MIPT_ big , zzn4 *);
 extern void zzn4_sadd(_MIPT_ zzn4 *,zzn2 *,zzn4 *);
 extern void zzn4_ssub(_MIPT_ zzn4 *,zzn2 *,zzn4 *);
 extern void zzn4_div2(_MIPT_ zzn4 *);
+extern void zzn4_double_mul(_MIPT_ zzn4 *,zzn4 *,zzn4 *);
+extern void zzn4_double_sqr(_MIPT_ zzn4 *,zzn4 *);
+extern void zzn4_double_add(_MIPT_ zzn4 *,zzn4 *,zzn4 *);
+extern void zzn4_double_sub(_MIPT_ zzn4 *,zzn4 *,zzn4 *);
+extern void zzn4_double_tx(_MIPT_ zzn4 *);
+extern void zzn4_redc(_MIPT_ zzn4 *,zzn4 *);
+extern char *zzn4_double_memalloc(_MIPT_ int,zzn4 *);
 extern void zzn4_conj(_MIPT_ zzn4 *,zzn4 *);
 extern void zzn4_imul(_MIPT_ zzn4 *,int,zzn4 *);
 extern void zzn4_lmul(_MIPT_ zzn4 *,big,zzn4 *);
@@ -0,0 +1,311 @@
+
+/***************************************************************************
+                                                                           *
+Copyright 2013 CertiVox UK Ltd.                                           *
+                                                                           *
+This file is part of CertiVox MIRACL Crypto SDK.                           *
+                                                                           *
+The CertiVox MIRACL Crypto SDK provides developers with an                 *
+extensive and efficient set of cryptographic functions.                    *
+For further information about its features and functionalities please      *
+refer to http://www.certivox.com                                           *
+                                                                           *
+* The CertiVox MIRACL Crypto SDK is free software: you can                 *
+  redistribute it and/or modify it under the terms of the                  *
+  GNU Affero General Public License as published by the                    *
+  Free Software Foundation, either version 3 of the License,               *
+  or (at your option) any later version.                                   *
+                                                                           *
+* The CertiVox MIRACL Crypto SDK is distributed in the hope                *
+  that it will be useful, but WITHOUT ANY WARRANTY; without even the       *
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. *
+  See the GNU Affero General Public License for more details.              *
+                                                                           *
+* You should have received a copy of the GNU Affero General Public         *
+  License along with CertiVox MIRACL Crypto SDK.                           *
+  If not, see <http://www.gnu.org/licenses/>.                              *
+                                                                           *
+You can be released from the requirements of the license by purchasing     *
+a commercial license. Buying such a license is mandatory as soon as you    *
+develop commercial activities involving the CertiVox MIRACL Crypto SDK     *
+without disclosing the source code of your own applications, or shipping   *
+the CertiVox MIRACL Crypto SDK with a closed source product.               *
+                                                                           *
+***************************************************************************/
+/*
+ *
+ *    MIRACL  C++ Header file montfield.h
+ *
+ *    PURPOSE :    Fixed size Montgomery multiplication, squaring and 
+ *                 reduction, fully unrolled at compile time, for moduli 
+ *                 of N=4 to 16 words.
+ *
+ *   This is an alternative to building the library with MR_COMBA, which 
+ *   supports just one modulus size. Including this header in any module 
+ *   of a program registers a kernel for each size with mr_set_kernel(), 
+ *   and prepare_monty() (and so modulo() in C++) then selects the right 
+ *   one automatically from the length of the modulus. So for example 
+ *   P-256, P-384 and BN-254 moduli can all use their own fast path in 
+ *   the same program. 
+ *
+ *   The kernels are only used with a full-width base, that is with 
+ *   Miracl precision(n,0) or mirsys(n,0), and are ignored for a modulus 
+ *   for which MR_COMBA or MR_KCM code is active. 
+ *
+ *   Define MR_MONTFIELD_MANUAL before including this header to suppress 
+ *   automatic registration, and instead call montfield_init() 
+ *
+ *   The templates can also be used directly on arrays of N words - 
+ *
+ *   MontField<4>::mul(a,b,t);         // t[0..7]=a*b
+ *   MontField<4>::redc(t,n,ndash,z);  // z=t/R mod n, where R=2^(4.MIRACL)
+ */
+
+#ifndef MONTFIELD_H
+#define MONTFIELD_H
+
+#include "mirdef.h"
+
+#ifdef MR_CPP
+#include "miracl.h"
+#else
+extern "C"
+{
+    #include "miracl.h"
+}
+#endif
+
+#if !defined(MR_FP) && !defined(MR_NOFULLWIDTH)
+
+#define MR_MONTFIELD_MIN 4
+
+/* (c2,c1,c0) += a*b */
+
+static inline void mf_mac(mr_small a,mr_small b,mr_small &c0,mr_small &c1,mr_small &c2)
+{
+    mr_small lo,hi;
+#if defined(mr_dltype)
+    mr_large p=(mr_large)a*b;
+    lo=(mr_small)p; hi=(mr_small)(p>>MIRACL);
+#elif MIRACL==64 && defined(__GNUC__)
+    unsigned __int128 p=(unsigned __int128)a*b;
+    lo=(mr_small)p; hi=(mr_small)(p>>64);
+#elif defined(MR_WIN64)
+    lo=_umul128(a,b,&hi);
+#else
+    lo=0; hi=0;
+    muldvd2(a,b,&hi,&lo);
+#endif
+    c0+=lo; hi+=(c0<lo);     /* cannot overflow */
+    c1+=hi; c2+=(c1<hi);
+}
+
+/* (c2,c1,c0) += 2*a*b */
+
+static inline void mf_mac2(mr_small a,mr_small b,mr_small &c0,mr_small &c1,mr_small &c2)
+{
+    mr_small lo,hi;
+#if defined(mr_dltype)
+    mr_large p=(mr_large)a*b;
+    lo=(mr_small)p; hi=(mr_small)(p>>MIRACL);
+#elif MIRACL==64 && defined(__GNUC__)
+    unsigned __int128 p=(unsigned __int128)a*b;
+    lo=(mr_small)p; hi=(mr_small)(p>>64);
+#elif defined(MR_WIN64)
+    lo=_umul128(a,b,&hi);
+#else
+    lo=0; hi=0;
+    muldvd2(a,b,&hi,&lo);
+#endif
+    c2+=(hi>>(MIRACL-1));
+    hi=(hi<<1)|(lo>>(MIRACL-1));
+    lo<<=1;
+    c0+=lo; lo=(c0<lo);      /* hi may be all ones - carry separately */
+    c1+=lo; c2+=(c1<lo);
+    c1+=hi; c2+=(c1<hi);
+}
+
+/* (c2,c1,c0) += a */
+
+static inline void mf_add(mr_small a,mr_small &c0,mr_small &c1,mr_small &c2)
+{
+    c0+=a; a=(c0<a);
+    c1+=a; c2+=(c1<a);
+}
+
+/* R products a[I]*b[K-I], a[I+1]*b[K-I-1] ... of column K */
+
+template <int K,int I,int R> struct MFcol
+{
+    static inline void mul(const mr_small *a,const mr_small *b,mr_small &c0,mr_small &c1,mr_small &c2)
+    {
+        mf_mac(a[I],b[K-I],c0,c1,c2);
+        MFcol<K,I+1,R-1>::mul(a,b,c0,c1,c2);
+    }
+    static inline void sqr(const mr_small *a,mr_small &c0,mr_small &c1,mr_small &c2)
+    {
+        mf_mac2(a[I],a[K-I],c0,c1,c2);
+        MFcol<K,I+1,R-1>::sqr(a,c0,c1,c2);
+    }
+};
+
+template <int K,int I> struct MFcol<K,I,0>
+{
+    static inline void mul(const mr_small *,const mr_small *,mr_small &,mr_small &,mr_small &) {}
+    static inline void sqr(const mr_small *,mr_small &,mr_small &,mr_small &) {}
+};
+
+/* Comba multiplication and squaring, column K of 2N-1, R columns left */
+
+template <int N,int K,int R> struct MFprod
+{
+    enum {LO=(K<N)?0:K-N+1, HI=(K<N)?K:N-1, SQ=((K+1)/2>LO)?(K+1)/2-LO:0};
+
+    static inline void mul(const mr_small *a,const mr_small *b,mr_small *c,mr_small &c0,mr_small &c1,mr_small &c2)
+    {
+        MFcol<K,LO,HI-LO+1>::mul(a,b,c0,c1,c2);
+        c[K]=c0; c0=c1; c1=c2; c2=0;
+        MFprod<N,K+1,R-1>::mul(a,b,c,c0,c1,c2);
+    }
+    static inline void sqr(const mr_small *a,mr_small *c,mr_small &c0,mr_small &c1,mr_small &c2)
+    {
+        MFcol<K,LO,SQ>::sqr(a,c0,c1,c2);
+        if (K%2==0) mf_mac(a[K/2],a[K/2],c0,c1,c2);
+        c[K]=c0; c0=c1; c1=c2; c2=0;
+        MFprod<N,K+1,R-1>::sqr(a,c,c0,c1,c2);
+    }
+};
+
+template <int N,int K> struct MFprod<N,K,0>
+{
+    static inline void mul(const mr_small *,const mr_small *,mr_small *c,mr_small &c0,mr_small &,mr_small &) {c[K]=c0;}
+    static inline void sqr(const mr_small *,mr_small *c,mr_small &c0,mr_small &,mr_small &) {c[K]=c0;}
+};
+
+/* Product scanning Montgomery reduction. First the N columns which  *
+ * determine the multipliers m[K], then the N columns of the result  */
+
+template <int N,int K,int R> struct MFredc
+{
+    static inline void low(const mr_small *t,const mr_small *n,mr_small ndash,mr_small *m,mr_small &c0,mr_small &c1,mr_small &c2)
+    {
+        MFcol<K,0,K>::mul(m,n,c0,c1,c2);
+        mf_add(t[K],c0,c1,c2);
+        m[K]=c0*ndash;
+        mf_mac(m[K],n[0],c0,c1,c2);       /* c0 is now zero */
+        c0=c1; c1=c2; c2=0;
+        MFredc<N,K+1,R-1>::low(t,n,ndash,m,c0,c1,c2);
+    }
+    static inline void high(const mr_small *t,const mr_small *n,const mr_small *m,mr_small *z,mr_small &c0,mr_small &c1,mr_small &c2)
+    {
+        MFcol<K,K-N+1,R-1>::mul(m,n,c0,c1,c2);
+        mf_add(t[K],c0,c1,c2);
+        z[K-N]=c0; c0=c1; c1=c2; c2=0;
+        MFredc<N,K+1,R-1>::high(t,n,m,z,c0,c1,c2);
+    }
+};
+
+template <int N,int K> struct MFredc<N,K,0>
+{
+    static inline void low(const mr_small *,const mr_small *,mr_small,mr_small *,mr_small &,mr_small &,mr_small &) {}
+    static inline void high(const mr_small *,const mr_small *,const mr_small *,mr_small *,mr_small &,mr_small &,mr_small &) {}
+};
+
+template <int N> class MontField
+{
+    static void operand(big x,mr_small *a)
+    { /* a[0..N-1]=x, reading no further than x->len */
+        int i,len=(int)(x->len&MR_OBITS);
+        for (i=0;i<len;i++) a[i]=x->w[i];
+        for (;i<N;i++) a[i]=0;
+    }
+
+    static void result(const mr_small *z,big w)
+    {
+        int i,len=(int)(w->len&MR_OBITS);
+        for (i=N;i<len;i++) w->w[i]=0;
+        for (i=0;i<N;i++) w->w[i]=z[i];
+        w->len=N;
+        mr_lzero(w);
+    }
+public:
+    static void mul(const mr_small *a,const mr_small *b,mr_small *c)
+    { /* c[0..2N-1]=a*b */
+        mr_small c0=0,c1=0,c2=0;
+        MFprod<N,0,2*N-1>::mul(a,b,c,c0,c1,c2);
+    }
+
+    static void sqr(const mr_small *a,mr_small *c)
+    { /* c[0..2N-1]=a*a */
+        mr_small c0=0,c1=0,c2=0;
+        MFprod<N,0,2*N-1>::sqr(a,c,c0,c1,c2);
+    }
+
+    static void redc(const mr_small *t,const mr_small *n,mr_small ndash,mr_small *z)
+    { /* z=t/R mod n, for t < nR */
+        mr_small m[N],d[N],c0=0,c1=0,c2=0,b,s;
+        int i;
+        MFredc<N,0,N>::low(t,n,ndash,m,c0,c1,c2);
+        MFredc<N,N,N>::high(t,n,m,z,c0,c1,c2);
+
+        for (b=0,i=0;i<N;i++)
+        { /* d=z-n */
+            s=z[i]-n[i];
+            d[i]=s-b;
+            b=(z[i]<n[i]) | (s<b);
+        }
+        if (c0>=b)
+            for (i=0;i<N;i++) z[i]=d[i];
+    }
+
+/* kernels for mr_set_kernel() */
+
+    static void modmult(big x,big y,big n,mr_small ndash,big w)
+    {
+        mr_small a[N],b[N],t[2*N],z[N];
+        operand(x,a);
+        operand(y,b);
+        mul(a,b,t);
+        redc(t,n->w,ndash,z);
+        result(z,w);
+    }
+
+    static void modsqr(big x,big,big n,mr_small ndash,big w)
+    {
+        mr_small a[N],t[2*N],z[N];
+        operand(x,a);
+        sqr(a,t);
+        redc(t,n->w,ndash,z);
+        result(z,w);
+    }
+};
+
+template <int N> struct MFinit
+{
+    static void attach()
+    {
+        mr_set_kernel(N,MontField<N>::modmult,MontField<N>::modsqr);
+        MFinit<N-1>::attach();
+    }
+};
+
+template <> struct MFinit<MR_MONTFIELD_MIN-1>
+{
+    static void attach() {}
+};
+
+static inline void montfield_init()
+{
+    MFinit<MR_KERNEL_MAX>::attach();
+}
+
+#ifndef MR_MONTFIELD_MANUAL
+static struct mf_register
+{
+    mf_register() {montfield_init();}
+} mf_registered;
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ *   Program to check radix conversion of large numbers
+ *
+ *   Numbers of well over 64 words, which take the fast paths of cbase(),
+ *   are written with cotstr() and read back with cinstr(), in a decimal
+ *   base instance and in a full-width one. After each conversion the
+ *   workspace is used again through expb2(), as called by bigbits(),
+ *   which fails if the conversion left stale words behind.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "miracl.h"
+
+static char buff[20000];
+
+static int check(miracl *mip,int bits,int iobase)
+{
+    big x,y;
+    int k,bad=0;
+
+    x=mirvar(0);
+    y=mirvar(0);
+    for (k=0;k<4;k++)
+    {
+        bigbits(bits,x);
+        mip->IOBASE=iobase;
+        cotstr(x,buff);
+        cinstr(y,buff);
+        mip->IOBASE=10;
+        if (mr_compare(x,y)!=0)
+        {
+            printf("%d bit number, IOBASE=%d, did not convert back\n",bits,iobase);
+            bad++;
+        }
+        bigbits(bits,y);
+        if (mip->ERNUM!=0 || logb2(y)>bits)
+        {
+            printf("%d bit number, IOBASE=%d, spoiled bigbits()\n",bits,iobase);
+            bad++;
+        }
+        expb2(bits/2,y);
+        if (logb2(y)!=bits/2+1)
+        {
+            printf("%d bit number, IOBASE=%d, spoiled expb2()\n",bits,iobase);
+            bad++;
+        }
+        if (bad) break;
+    }
+    mirkill(y);
+    mirkill(x);
+    return bad;
+}
+
+int main()
+{
+    miracl *mip;
+    int bad=0;
+
+    mip=mirsys(6000,10);
+    mip->ERCON=TRUE;
+    irand(1L);
+    bad+=check(mip,4000,16);
+    bad+=check(mip,4000,10);
+    bad+=check(mip,12000,16);
+    mirexit();
+
+    mip=mirsys(600,0);
+    mip->ERCON=TRUE;
+    irand(2L);
+    bad+=check(mip,12000,10);
+    bad+=check(mip,12000,7);
+    bad+=check(mip,12000,16);
+    mirexit();
+
+    if (bad) printf("FAILED\n");
+    else     printf("All OK\n");
+    return bad;
+}
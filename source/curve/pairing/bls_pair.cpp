@@ -55,6 +55,7 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 
 #define MR_PAIRING_BLS
 #include "pairing_3.h"
+#include "pairing_mt.h"
 
 // BLS curve
 //static char param[]= "E000000000058400";
@@ -104,11 +105,8 @@ Big H1(char *string)
 
     shs256_init(&sh);
 
-    for (i=0;;i++)
-    {
-        if (string[i]==0) break;
-        shs256_process(&sh,string[i]);
-    }
+    for (i=0;string[i]!=0;i++) ;
+    shs256_update(&sh,string,i);
     shs256_hash(&sh,s);
     p=get_modulus();
     h=1; j=0; i=1;
@@ -143,10 +141,9 @@ void PFC::add_to_hash(const GT& x)
 	ZZn24 v=x.g;
 	ZZn4 h,l;
 	ZZn2 t,b;
-	Big a;
 	ZZn xx[8];
 
-	int i,j,m;
+	int i;
 	v.get(u);
 	u.get(l,h);
 	l.get(t,b);
@@ -156,26 +153,17 @@ void PFC::add_to_hash(const GT& x)
 	t.get(xx[4],xx[5]);
 	b.get(xx[6],xx[7]);
     for (i=0;i<8;i++)
-    {
-        a=(Big)xx[i];
-        while (a>0)
-        {
-            m=a%256;
-            shs256_process(&SH,m);
-            a/=256;
-        }
-    }
+        hash_big(&SH,(Big)xx[i]);
 }
 
 void PFC::add_to_hash(const G2& x)
 {
 	ZZn4 X,Y;
 	ECn4 v=x.g;
-	Big a;
 	ZZn2 t,b;
 	ZZn xx[8];
 
-	int i,m;
+	int i;
 
 	v.get(X,Y);
 	X.get(t,b);
@@ -186,59 +174,28 @@ void PFC::add_to_hash(const G2& x)
 	b.get(xx[6],xx[7]);
 
 	for (i=0;i<8;i++)
-    {
-        a=(Big)xx[i];
-        while (a>0)
-        {
-            m=a%256;
-            shs256_process(&SH,m);
-            a/=256;
-        }
-    }
+		hash_big(&SH,(Big)xx[i]);
 }
 
 void PFC::add_to_hash(const G1& x)
 {
-	Big a,X,Y;
-	int i,m;
+	Big X,Y;
 	x.g.get(X,Y);
-	a=X;
-    while (a>0)
-    {
-        m=a%256;
-        shs256_process(&SH,m);
-        a/=256;
-    }
-	a=Y;
-    while (a>0)
-    {
-        m=a%256;
-        shs256_process(&SH,m);
-        a/=256;
-    }
+	hash_big(&SH,X);
+	hash_big(&SH,Y);
 }
 
 void PFC::add_to_hash(const Big& x)
 {
-	int m;
-	Big a=x;
-    while (a>0)
-    {
-        m=a%256;
-        shs256_process(&SH,m);
-        a/=256;
-    }
+	hash_big(&SH,x);
 }
 
 
 void PFC::add_to_hash(char *x)
 {
-	int i=0;
-	while (x[i]!=0)
-	{
-		shs256_process(&SH,x[i]);
-		i++;
-	}
+	int i;
+	for (i=0;x[i]!=0;i++) ;
+	shs256_update(&SH,x,i);
 }
 
 Big H2(ZZn24 x)
@@ -250,7 +207,7 @@ Big H2(ZZn24 x)
     Big a,hash,p;
 	ZZn xx[8];
     char s[HASH_LEN];
-    int i,j,m;
+    int i;
 
     shs256_init(&sh);
     x.get(u);  // compress to single ZZn4
@@ -269,12 +226,7 @@ Big H2(ZZn24 x)
     for (i=0;i<8;i++)
     {
         a=(Big)xx[i];
-        while (a>0)
-        {
-            m=a%256;
-            shs256_process(&sh,m);
-            a/=256;
-        }
+        hash_big(&sh,a);
     }
     shs256_hash(&sh,s);
     hash=from_binary(HASH_LEN,s);
@@ -522,7 +474,7 @@ int PFC::precomp_for_pairing(G2& w)
 	return len;
 }
 
-GT PFC::multi_miller(int n,G2** QQ,G1** PP)
+GT PFC::multi_miller(int n,G2** QQ,G1** PP,int threads)
 {
 	GT z;
     ZZn *Px,*Py;
@@ -532,6 +484,14 @@ GT PFC::multi_miller(int n,G2** QQ,G1** PP)
     ZZn24 res;
 	Big X=*x;
 
+#ifdef MR_UNIX_MT
+	if (threads<=0) threads=MR_PAIRING_THREADS;
+	if (threads>n/2) threads=n/2;  // at least two pairs each
+	if (threads>1) return shared_miller(this,threads,n,QQ,PP);
+#else
+	(void)threads;
+#endif
+
 	Px=new ZZn[n];
 	Py=new ZZn[n];
 	Q=new ECn4[n];
@@ -1578,10 +1538,10 @@ GT PFC::pairing(const G2& x,const G1& y)
 	return z;
 }
 
-GT PFC::multi_pairing(int n,G2 **y,G1 **x)
+GT PFC::multi_pairing(int n,G2 **y,G1 **x,int threads)
 {
 	GT z;
-	z=multi_miller(n,y,x);
+	z=multi_miller(n,y,x,threads);
 	z=final_exp(z);
 	return z;
 
@@ -0,0 +1,145 @@
+/*
+   Test program for batch verification of BLS short signatures
+
+   Compile with modules as specified in the selected header file, and
+   pfc_bls.cpp. For example for the MR_PAIRING_BN curve
+
+   cl /O2 /GX blsbatch.cpp pfc_bls.cpp bn_pair.cpp zzn12a.cpp ecn2.cpp zzn4.cpp zzn2.cpp big.cpp zzn.cpp ecn.cpp miracl.lib
+
+   A batch of good signatures under a few keys is accepted, two bad ones
+   are found, with multipliers from a hash of the batch and from a random
+   number generator. Where G1 has a cofactor, a signature with a component
+   of small order added, so not in G1, must be found bad.
+*/
+
+#include <iostream>
+#include <stdio.h>
+
+//********* choose just one of these pairs **********
+//#define MR_PAIRING_CP      // AES-80 security
+//#define AES_SECURITY 80
+
+//#define MR_PAIRING_MNT	// AES-80 security
+//#define AES_SECURITY 80
+
+#define MR_PAIRING_BN    // AES-128 or AES-192 security
+#define AES_SECURITY 128
+//#define AES_SECURITY 192
+
+//#define MR_PAIRING_KSS    // AES-192 security
+//#define AES_SECURITY 192
+
+//#define MR_PAIRING_BLS    // AES-256 security
+//#define AES_SECURITY 256
+//*********************************************
+
+#include "pairing_3.h"
+
+#define N 12
+
+static int check(PFC& pfc,char **m,G1 **SP,G2 **V,G2& Q,int bad1,int bad2)
+{ // batch with signatures bad1 and bad2 (if not -1) bad
+	int i,bad=0,expect=0;
+	BOOL good[N];
+
+	if (bad1>=0) expect++;
+	if (bad2>=0) expect++;
+	if (pfc.batch_verify(N,m,SP,V,Q,good)!=expect) bad++;
+	for (i=0;i<N;i++)
+		if (good[i]!=(i!=bad1 && i!=bad2)) bad++;
+	if (pfc.batch_verify(N,m,SP,V,Q)!=expect) bad++;
+	return bad;
+}
+
+int main()
+{
+	PFC pfc(AES_SECURITY);  // initialise pairing-friendly curve
+
+	G2 Q,K[3],*V[N];
+	G1 S[N],*SP[N],H,keep;
+	ECn T,U;
+	Big s[3],h,x;
+	char msg[N][20],*m[N],raw[32];
+	csprng rng;
+	int i,j,ell,bad=0;
+
+	irand(1L);
+	pfc.random(Q);
+	for (i=0;i<3;i++)
+	{
+		pfc.random(s[i]);
+		K[i]=pfc.mult(Q,s[i]);
+	}
+	for (i=0;i<N;i++)
+	{
+		sprintf(msg[i],"Message %d",i);
+		m[i]=msg[i];
+		V[i]=&K[i%3];
+		pfc.hash_and_map(H,m[i]);
+		S[i]=pfc.mult(H,s[i%3]);
+		SP[i]=&S[i];
+	}
+
+// multipliers from a hash of the batch
+
+	bad+=check(pfc,m,SP,V,Q,-1,-1);
+	keep=S[3];
+	S[3]=S[3]+S[3];
+	S[8]=S[9];
+	bad+=check(pfc,m,SP,V,Q,3,8);
+	S[3]=keep;
+	pfc.hash_and_map(H,m[8]);
+	S[8]=pfc.mult(H,s[8%3]);
+	if (bad) cout << "Batch with hashed multipliers failed" << endl;
+
+// random multipliers
+
+	for (i=0;i<32;i++) raw[i]=(char)i;
+	strong_init(&rng,32,raw,0L);
+	pfc.RNG=&rng;
+	j=bad;
+	bad+=check(pfc,m,SP,V,Q,-1,-1);
+	V[5]=&K[0];
+	bad+=check(pfc,m,SP,V,Q,5,-1);
+	V[5]=&K[5%3];
+	if (bad>j) cout << "Batch with random multipliers failed" << endl;
+
+// a point of small order ell in E(Fp), for ell the least prime factor of
+// the cofactor of G1, added to a good signature
+
+	h=*pfc.npoints/(*pfc.ord);
+	for (ell=2;ell<1000;ell++) if (h%ell==0) break;
+	if (ell<1000)
+	{
+		h=*pfc.npoints;
+		while (h%ell==0) h/=ell;
+		do
+		{ // a point in the ell-part of E(Fp), of order ell^k
+			x=rand(*pfc.mod);
+			while (!T.set(x,x)) x+=1;
+			T*=h;
+		} while (T.iszero());
+		for (;;)
+		{
+			U=T;
+			U*=ell;
+			if (U.iszero()) break;
+			T=U;
+		}
+		keep=S[0];
+		S[0].g+=T;
+		j=check(pfc,m,SP,V,Q,0,-1);
+		S[0]=keep;
+		if (j!=0)
+		{
+			cout << "Signature with a component of order " << ell << " accepted" << endl;
+			bad++;
+		}
+	}
+	pfc.RNG=NULL;
+	strong_kill(&rng);
+
+	if (bad) cout << "FAILED" << endl;
+	else     cout << "All OK" << endl;
+	return bad;
+}
@@ -56,6 +56,7 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 
 #define MR_PAIRING_BN
 #include "pairing_3.h"
+#include "pairing_mt.h"
 
 // BN curve parameters x,A,B
 static char param_128[]="-4080000000000001";
@@ -103,11 +104,8 @@ Big H1(char *string)
 
     shs256_init(&sh);
 
-    for (i=0;;i++)
-    {
-        if (string[i]==0) break;
-        shs256_process(&sh,string[i]);
-    }
+    for (i=0;string[i]!=0;i++) ;
+    shs256_update(&sh,string,i);
     shs256_hash(&sh,(char *)s);
     p=get_modulus();
     h=1; j=0; i=1;
@@ -151,93 +149,52 @@ void PFC::add_to_hash(const GT& x)
 	ZZn4 u;
 	ZZn12 v=x.g;
 	ZZn2 h,l;
-	Big a;
 	ZZn xx[6];
 
-	int i,j,m;
+	int i;
 	v.get(u);
 	u.get(l,h);
 	l.get(xx[0],xx[1]);
 	h.get(xx[2],xx[3]);
 
     for (i=0;i<4;i++)
-    {
-        a=(Big)xx[i];
-        while (a>0)
-        {
-            m=a%256;
-            shs256_process(&SH,m);
-            a/=256;
-        }
-    }
+        hash_big(&SH,(Big)xx[i]);
 }
 
 void PFC::add_to_hash(const G2& x)
 {
 	ZZn2 X,Y;
 	ECn2 v=x.g;
-	Big a;
 	ZZn xx[4];
 
-	int i,m;
+	int i;
 
 	v.get(X,Y);
 	X.get(xx[0],xx[1]);
 	Y.get(xx[2],xx[3]);
 	for (i=0;i<4;i++)
-    {
-        a=(Big)xx[i];
-        while (a>0)
-        {
-            m=a%256;
-            shs256_process(&SH,m);
-            a/=256;
-        }
-    }
+	    hash_big(&SH,(Big)xx[i]);
 }
 
 void PFC::add_to_hash(const G1& x)
 {
-	Big a,X,Y;
-	int i,m;
+	Big X,Y;
 	x.g.get(X,Y);
-	a=X;
-    while (a>0)
-    {
-        m=a%256;
-        shs256_process(&SH,m);
-        a/=256;
-    }
-	a=Y;
-    while (a>0)
-    {
-        m=a%256;
-        shs256_process(&SH,m);
-        a/=256;
-    }
+	hash_big(&SH,X);
+	hash_big(&SH,Y);
 }
 
 void PFC::add_to_hash(const Big& x)
 {
-	int m;
-	Big a=x;
-    while (a>0)
-    {
-        m=a%256;
-        shs256_process(&SH,m);
-        a/=256;
-    }
+	hash_big(&SH,x);
 }
 
 
 void PFC::add_to_hash(char *x)
 {
-	int i=0;
-	while (x[i]!=0)
-	{
-		shs256_process(&SH,x[i]);
-		i++;
-	}
+	int i;
+	for (i=0;x[i]!=0;i++) ;
+	shs256_update(&SH,x,i);
 }
 
 Big H2(ZZn12 x)
@@ -245,9 +202,9 @@ Big H2(ZZn12 x)
     sha256 sh;
     ZZn4 u;
     ZZn2 h,l;
-    Big a,hash,p,xx[4];
+    Big hash,xx[4];
     char s[HASH_LEN];
-    int i,j,m;
+    int i;
 
     shs256_init(&sh);
     x.get(u);  // compress to single ZZn4
@@ -255,15 +212,7 @@ Big H2(ZZn12 x)
     xx[0]=real(l); xx[1]=imaginary(l); xx[2]=real(h); xx[3]=imaginary(h);
  
     for (i=0;i<4;i++)
-    {
-        a=xx[i];
-        while (a>0)
-        {
-            m=a%256;
-            shs256_process(&sh,m);
-            a/=256;
-        }
-    }
+        hash_big(&sh,xx[i]);
     shs256_hash(&sh,s);
     hash=from_binary(HASH_LEN,s);
     return hash;
@@ -522,7 +471,7 @@ int PFC::precomp_for_pairing(G2& w)
 	return len;
 }
 
-GT PFC::multi_miller(int n,G2** QQ,G1** PP)
+GT PFC::multi_miller(int n,G2** QQ,G1** PP,int threads)
 {
 	GT z;
     ZZn *Px,*Py;
@@ -533,6 +482,14 @@ GT PFC::multi_miller(int n,G2** QQ,G1** PP)
 	Big m;
 	Big X=*x;
 
+#ifdef MR_UNIX_MT
+	if (threads<=0) threads=MR_PAIRING_THREADS;
+	if (threads>n/2) threads=n/2;  // at least two pairs each
+	if (threads>1) return shared_miller(this,threads,n,QQ,PP);
+#else
+	(void)threads;
+#endif
+
 	Px=new ZZn[n];
 	Py=new ZZn[n];
 	Q=new ECn2[n];
@@ -1157,10 +1114,7 @@ Big PFC::hash_to_group(char *buffer, int len)
     sha256 sh;
 
     shs256_init(&sh);
-    for (i=0; i < len; i++)
-    {
-        shs256_process(&sh,buffer[i]);
-    }
+    shs256_update(&sh,buffer,len);
     shs256_hash(&sh,s);
 
     p=get_modulus();
@@ -1480,10 +1434,10 @@ GT PFC::pairing(const G2& x,const G1& y)
 	return z;
 }
 
-GT PFC::multi_pairing(int n,G2 **y,G1 **x)
+GT PFC::multi_pairing(int n,G2 **y,G1 **x,int threads)
 {
 	GT z;
-	z=multi_miller(n,y,x);
+	z=multi_miller(n,y,x,threads);
 	z=final_exp(z);
 	return z;
 
@@ -52,6 +52,7 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 
 #define MR_PAIRING_KSS
 #include "pairing_3.h"
+#include "pairing_mt.h"
 
 // KSS curve parameters x,A,B
 // irreducible poly is x^18+2
@@ -101,11 +102,8 @@ Big H1(char *string)
 
     shs256_init(&sh);
 
-    for (i=0;;i++)
-    {
-        if (string[i]==0) break;
-        shs256_process(&sh,string[i]);
-    }
+    for (i=0;string[i]!=0;i++) ;
+    shs256_update(&sh,string,i);
     shs256_hash(&sh,s);
     p=get_modulus();
     h=1; j=0; i=1;
@@ -139,93 +137,52 @@ void PFC::add_to_hash(const GT& x)
 	ZZn6 u;
 	ZZn18 v=x.g;
 	ZZn3 h,l;
-	Big a;
 	ZZn xx[6];
 
-	int i,j,m;
+	int i;
 	v.get(u);
 	u.get(l,h);
 	l.get(xx[0],xx[1],xx[2]);
 	h.get(xx[3],xx[4],xx[5]);
 
     for (i=0;i<6;i++)
-    {
-        a=(Big)xx[i];
-        while (a>0)
-        {
-            m=a%256;
-            shs256_process(&SH,m);
-            a/=256;
-        }
-    }
+        hash_big(&SH,(Big)xx[i]);
 }
 
 void PFC::add_to_hash(const G2& x)
 {
 	ZZn3 X,Y;
 	ECn3 v=x.g;
-	Big a;
 	ZZn xx[6];
 
-	int i,m;
+	int i;
 
 	v.get(X,Y);
 	X.get(xx[0],xx[1],xx[2]);
 	Y.get(xx[3],xx[4],xx[5]);
 	for (i=0;i<6;i++)
-    {
-        a=(Big)xx[i];
-        while (a>0)
-        {
-            m=a%256;
-            shs256_process(&SH,m);
-            a/=256;
-        }
-    }
+		hash_big(&SH,(Big)xx[i]);
 }
 
 void PFC::add_to_hash(const G1& x)
 {
-	Big a,X,Y;
-	int i,m;
+	Big X,Y;
 	x.g.get(X,Y);
-	a=X;
-    while (a>0)
-    {
-        m=a%256;
-        shs256_process(&SH,m);
-        a/=256;
-    }
-	a=Y;
-    while (a>0)
-    {
-        m=a%256;
-        shs256_process(&SH,m);
-        a/=256;
-    }
+	hash_big(&SH,X);
+	hash_big(&SH,Y);
 }
 
 void PFC::add_to_hash(const Big& x)
 {
-	int m;
-	Big a=x;
-    while (a>0)
-    {
-        m=a%256;
-        shs256_process(&SH,m);
-        a/=256;
-    }
+	hash_big(&SH,x);
 }
 
 
 void PFC::add_to_hash(char *x)
 {
-	int i=0;
-	while (x[i]!=0)
-	{
-		shs256_process(&SH,x[i]);
-		i++;
-	}
+	int i;
+	for (i=0;x[i]!=0;i++) ;
+	shs256_update(&SH,x,i);
 }
 
 Big H2(ZZn18 x)
@@ -236,7 +193,7 @@ Big H2(ZZn18 x)
     Big a,hash;
 	ZZn xx[6];
     char s[HASH_LEN];
-    int i,j,m;
+    int i;
 
     shs256_init(&sh);
     x.get(u);  // compress to single ZZn6
@@ -247,12 +204,7 @@ Big H2(ZZn18 x)
     for (i=0;i<6;i++)
     {
         a=(Big)xx[i];
-        while (a>0)
-        {
-            m=a%256;
-            shs256_process(&sh,m);
-            a/=256;
-        }
+        hash_big(&sh,a);
     }
     shs256_hash(&sh,s);
     hash=from_binary(HASH_LEN,s);
@@ -517,7 +469,7 @@ int PFC::precomp_for_pairing(G2& w)
 	return len;
 }
 	
-GT PFC::multi_miller(int n,G2** QQ,G1** PP)
+GT PFC::multi_miller(int n,G2** QQ,G1** PP,int threads)
 {
 	GT z;
     ZZn *Px,*Py;
@@ -528,6 +480,14 @@ GT PFC::multi_miller(int n,G2** QQ,G1** PP)
 	Big m;
 	Big X=*x;
 
+#ifdef MR_UNIX_MT
+	if (threads<=0) threads=MR_PAIRING_THREADS;
+	if (threads>n/2) threads=n/2;  // at least two pairs each
+	if (threads>1) return shared_miller(this,threads,n,QQ,PP);
+#else
+	(void)threads;
+#endif
+
 	Px=new ZZn[n];
 	Py=new ZZn[n];
 	Q=new ECn3[n];
@@ -1664,10 +1624,10 @@ GT PFC::pairing(const G2& x,const G1& y)
 	return z;
 }
 
-GT PFC::multi_pairing(int n,G2 **y,G1 **x)
+GT PFC::multi_pairing(int n,G2 **y,G1 **x,int threads)
 {
 	GT z;
-	z=multi_miller(n,y,x);
+	z=multi_miller(n,y,x,threads);
 	z=final_exp(z);
 	return z;
 
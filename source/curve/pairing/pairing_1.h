@@ -67,6 +67,17 @@ extern void read_only_error(void);
 #define GT_TYPE GF2m4x
 #endif
 
+// With MR_UNIX_MT, multi_miller() shares the pairs between this many threads
+
+#ifdef MR_UNIX_MT
+#ifndef MR_PAIRING_THREADS
+#define MR_PAIRING_THREADS 4
+#endif
+#else
+#undef MR_PAIRING_THREADS
+#define MR_PAIRING_THREADS 1
+#endif
+
 class PFC;
 
 class G1
@@ -208,8 +219,9 @@ public:
 	GT final_exp(const GT&);
 	GT pairing(const G1&,const G1&);
 // parameters: number of pairings n, pointers to pair of G1 elements
-	GT multi_pairing(int n,G1 **,G1 **); //product of pairings
-	GT multi_miller(int n,G1 **,G1 **);
+// threads to share the pairs between, 0 for MR_PAIRING_THREADS
+	GT multi_pairing(int n,G1 **,G1 **,int threads=0); //product of pairings
+	GT multi_miller(int n,G1 **,G1 **,int threads=0);
 	void start_hash(void);
 	void add_to_hash(const G1&);
 	void add_to_hash(const GT&);
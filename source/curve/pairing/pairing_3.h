@@ -105,6 +105,17 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 #define FROB_TYPE ZZn2
 #endif
 
+// With MR_UNIX_MT, multi_miller() shares the pairs between this many threads
+
+#ifdef MR_UNIX_MT
+#ifndef MR_PAIRING_THREADS
+#define MR_PAIRING_THREADS 4
+#endif
+#else
+#undef MR_PAIRING_THREADS
+#define MR_PAIRING_THREADS 1
+#endif
+
 class PFC;
 extern void read_only_error(void);
 
@@ -267,15 +278,25 @@ public:
 	int spill(G2&,char *&);
 	void restore(char *,G2&);
 
+// save instances of G1, G2 and GT with their precomputed tables to a file, and
+// load them again - see pfc_tables.cpp
+	BOOL save_tables(char *,int,G1 **,int,G2 **,int,GT **);
+	BOOL load_tables(char *,int,G1 **,int,G2 **,int,GT **);
+
+// verify n BLS signatures in G1 on messages, with public keys in G2 that are
+// multiples of Q - see pfc_bls.cpp. Returns the number of bad signatures
+	int batch_verify(int n,char **,G1 **,G2 **,G2& Q,BOOL *good=NULL);
+
 	Big hash_to_aes_key(const GT&);
 	Big hash_to_group(char *);
 	Big hash_to_group(char *, int);
 	GT miller_loop(const G2&,const G1&);
 	GT final_exp(const GT&);
 	GT pairing(const G2&,const G1&);
-// parameters: number of pairings n, pointers to G1 and G2 elements
-	GT multi_miller(int n,G2 **,G1 **);
-	GT multi_pairing(int n,G2 **,G1 **); //product of pairings
+// parameters: number of pairings n, pointers to G1 and G2 elements, and the
+// number of threads to share them between (0 for MR_PAIRING_THREADS)
+	GT multi_miller(int n,G2 **,G1 **,int threads=0);
+	GT multi_pairing(int n,G2 **,G1 **,int threads=0); //product of pairings
 	void start_hash(void);
 	void add_to_hash(const G1&);
 	void add_to_hash(const G2&);
@@ -298,4 +319,23 @@ extern void extract(ECn&,ZZn&,ZZn&,ZZn&);
 extern void force(ZZn&,ZZn&,ECn&);
 extern void extract(ECn&,ZZn&,ZZn&);
 
+// add the bytes of x to a SHA256 hash, least significant first, as the
+// add_to_hash() members do
+
+inline void hash_big(sha256 *sh,const Big& x)
+{
+	int i,len,n;
+	char t,*b;
+	if (x<=0) return;
+	n=bits(x)/8+1;
+	b=new char[n];
+	len=to_binary(x,n,b,FALSE);
+	for (i=0;i<len/2;i++)
+	{
+		t=b[i]; b[i]=b[len-1-i]; b[len-1-i]=t;
+	}
+	shs256_update(sh,b,len);
+	delete [] b;
+}
+
 #endif
@@ -0,0 +1,131 @@
+
+/***************************************************************************
+                                                                           *
+Copyright 2013 CertiVox UK Ltd.                                           *
+                                                                           *
+This file is part of CertiVox MIRACL Crypto SDK.                           *
+                                                                           *
+The CertiVox MIRACL Crypto SDK provides developers with an                 *
+extensive and efficient set of cryptographic functions.                    *
+For further information about its features and functionalities please      *
+refer to http://www.certivox.com                                           *
+                                                                           *
+* The CertiVox MIRACL Crypto SDK is free software: you can                 *
+  redistribute it and/or modify it under the terms of the                  *
+  GNU Affero General Public License as published by the                    *
+  Free Software Foundation, either version 3 of the License,               *
+  or (at your option) any later version.                                   *
+                                                                           *
+* The CertiVox MIRACL Crypto SDK is distributed in the hope                *
+  that it will be useful, but WITHOUT ANY WARRANTY; without even the       *
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. *
+  See the GNU Affero General Public License for more details.              *
+                                                                           *
+* You should have received a copy of the GNU Affero General Public         *
+  License along with CertiVox MIRACL Crypto SDK.                           *
+  If not, see <http://www.gnu.org/licenses/>.                              *
+                                                                           *
+You can be released from the requirements of the license by purchasing     *
+a commercial license. Buying such a license is mandatory as soon as you    *
+develop commercial activities involving the CertiVox MIRACL Crypto SDK     *
+without disclosing the source code of your own applications, or shipping   *
+the CertiVox MIRACL Crypto SDK with a closed source product.               *
+                                                                           *
+***************************************************************************/
+/*
+ * pairing_mt.h
+ *
+ * Sharing the pairs of PFC::multi_miller() between threads, with MR_UNIX_MT.
+ * Included by each of the GF(p) pairing back ends, after pairing_1.h or 
+ * pairing_3.h
+ *
+ * Each worker has its own MIRACL instance, set up with the caller's modulus 
+ * and curve, so that residues are the same in both and can be copied between 
+ * them directly. These parameters are copied into the job by the caller before
+ * the workers start, as the caller's own instance changes while it works.
+ */
+
+#ifndef PAIRING_MT_H
+#define PAIRING_MT_H
+
+#ifdef MR_UNIX_MT
+
+#include <pthread.h>
+
+template <class G> struct miller_job
+{
+	PFC *pfc;
+	int nib,Asize,Bsize,coord,TWIST,cnr;
+	Big modulus,A,B,sru;	// caller's parameters
+	int n;
+	G **QQ;
+	G1 **PP;
+	GT *res;
+};
+
+template <class G> static void *miller_thread(void *arg)
+{
+	miller_job<G> *job=(miller_job<G> *)arg;
+#ifdef MR_SIMPLE_BASE
+	miracl *mip=mirsys((MIRACL/4)*(job->nib-1),16);
+#else
+	miracl *mip=mirsys(job->nib-1,0);
+#endif
+	prepare_monty(job->modulus.getbig());
+	mip->Asize=job->Asize; copy(job->A.getbig(),mip->A);
+	mip->Bsize=job->Bsize; copy(job->B.getbig(),mip->B);
+	mip->coord=job->coord;
+	mip->TWIST=job->TWIST;
+	mip->cnr=job->cnr; copy(job->sru.getbig(),mip->sru);
+
+	*job->res=job->pfc->multi_miller(job->n,job->QQ,job->PP,1);
+
+	mirexit();
+	return NULL;
+}
+
+template <class G> static GT shared_miller(PFC *pfc,int t,int n,G** QQ,G1** PP)
+{ // product of the Miller loops of t groups of pairs, one group per thread
+	int i,m;
+	GT z;
+	miracl *mip=get_mip();
+	GT *part=new GT[t];
+	miller_job<G> *job=new miller_job<G>[t];
+	pthread_t *tid=new pthread_t[t];
+	BOOL *started=new BOOL[t];
+
+	for (i=m=0;i<t;i++)
+	{
+		job[i].pfc=pfc;
+		job[i].nib=mip->nib;
+		job[i].modulus=mip->modulus;
+		job[i].Asize=mip->Asize; job[i].A=mip->A;
+		job[i].Bsize=mip->Bsize; job[i].B=mip->B;
+		job[i].coord=mip->coord;
+		job[i].TWIST=mip->TWIST;
+		job[i].cnr=mip->cnr; job[i].sru=mip->sru;
+		job[i].n=(n-m)/(t-i);
+		job[i].QQ=QQ+m; job[i].PP=PP+m;
+		job[i].res=&part[i];
+		m+=job[i].n;
+	}
+	for (i=1;i<t;i++)
+		started[i]=(pthread_create(&tid[i],NULL,miller_thread<G>,&job[i])==0);
+	z=pfc->multi_miller(job[0].n,QQ,PP,1);
+	for (i=1;i<t;i++)
+	{
+		if (started[i]) pthread_join(tid[i],NULL);
+		else part[i]=pfc->multi_miller(job[i].n,job[i].QQ,job[i].PP,1);
+		z.g*=part[i].g;
+	}
+
+	delete [] started;
+	delete [] tid;
+	delete [] job;
+	delete [] part;
+	return z;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,299 @@
+/***************************************************************************
+                                                                           *
+Copyright 2013 CertiVox UK Ltd.                                           *
+                                                                           *
+This file is part of CertiVox MIRACL Crypto SDK.                           *
+                                                                           *
+The CertiVox MIRACL Crypto SDK provides developers with an                 *
+extensive and efficient set of cryptographic functions.                    *
+For further information about its features and functionalities please      *
+refer to http://www.certivox.com                                           *
+                                                                           *
+* The CertiVox MIRACL Crypto SDK is free software: you can                 *
+  redistribute it and/or modify it under the terms of the                  *
+  GNU Affero General Public License as published by the                    *
+  Free Software Foundation, either version 3 of the License,               *
+  or (at your option) any later version.                                   *
+                                                                           *
+* The CertiVox MIRACL Crypto SDK is distributed in the hope                *
+  that it will be useful, but WITHOUT ANY WARRANTY; without even the       *
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. *
+  See the GNU Affero General Public License for more details.              *
+                                                                           *
+* You should have received a copy of the GNU Affero General Public         *
+  License along with CertiVox MIRACL Crypto SDK.                           *
+  If not, see <http://www.gnu.org/licenses/>.                              *
+                                                                           *
+You can be released from the requirements of the license by purchasing     *
+a commercial license. Buying such a license is mandatory as soon as you    *
+develop commercial activities involving the CertiVox MIRACL Crypto SDK     *
+without disclosing the source code of your own applications, or shipping   *
+the CertiVox MIRACL Crypto SDK with a closed source product.               *
+                                                                           *
+***************************************************************************/
+/*
+ * pfc_bls.cpp
+ *
+ * Batch verification of BLS short signatures for type-3 pairings
+ *
+ * The signature on a message m with private key s is S=s.H(m) in G1, and
+ * the public key is V=s.Q in G2, for a fixed Q. S is good if
+ * e(Q,S)=e(V,H(m)).
+ *
+ * n signatures are checked at once by choosing small random r[i] and
+ * testing that
+ *
+ *     e(Q,sum r[i].S[i]) . prod e(V[i],-r[i].H(m[i])) = 1
+ *
+ * with a single multi-pairing, so with one final exponentiation.
+ * Signatures under the same public key share a pairing, the keys being
+ * grouped by sorting hashes of them. If the test fails the batch is halved
+ * and each half tested again, to find the bad ones. A precomputation for
+ * the pairing on Q or on any V[i] is used.
+ *
+ * The r[i] come from the PFC's random number generator or, if it has none,
+ * from a hash of the whole batch, so they cannot be known before the
+ * signatures are fixed. Where G1 is a proper subgroup of the curve, an S[i]
+ * not in G1 is found bad before the batch is checked.
+ *
+ * Compile with MR_PAIRING_* defined to match the pairing file, for example
+ *
+ * cl /O2 /GX /DMR_PAIRING_BN bls.cpp bn_pair.cpp pfc_bls.cpp zzn12a.cpp ...
+ */
+
+#include <stdlib.h>
+#include "pairing_3.h"
+
+#ifndef GT_TYPE
+#error "Define one of MR_PAIRING_CP, MR_PAIRING_MNT, MR_PAIRING_BN, MR_PAIRING_KSS or MR_PAIRING_BLS"
+#endif
+
+#define BATCH_BITS 64	// size of the random multipliers
+
+#if defined(MR_PAIRING_BLS) || defined(MR_PAIRING_KSS) || defined(MR_PAIRING_CP)
+#define G1_COFACTOR		// G1 is a proper subgroup of E(Fp), see hash_and_map()
+#endif
+
+typedef struct
+{
+	PFC *pfc;
+	G2 *Q;
+	G2 **V;		// keys of the signatures in the batch
+	G1 *T;		// -r[i].H(m[i])
+	G1 *U;		// r[i].S[i]
+	G1 *P;		// workspace for check()
+	G1 **g1;
+	G2 **g2;
+	int *key;	// V[i] is the key[i]-th distinct public key
+	int *slot;	// P[] used for each key in check(), or -1
+	BOOL *good;
+} batch;
+
+typedef struct
+{
+	unsigned int h;
+	int i;
+} keyhash;
+
+static int keycmp(const void *a,const void *b)
+{
+	unsigned int x=((keyhash *)a)->h,y=((keyhash *)b)->h;
+	if (x<y) return -1;
+	if (x>y) return 1;
+	return ((keyhash *)a)->i-((keyhash *)b)->i;
+}
+
+static void find_keys(PFC *pfc,int n,G2 **V,int *key)
+{ // number the distinct V[i], sorting them by hash
+	int i,j,k,nk=0;
+	keyhash *kh=new keyhash[n];
+	Big h,w=pow((Big)2,30);
+
+	for (i=0;i<n;i++)
+	{
+		pfc->start_hash();
+		pfc->add_to_hash(*V[i]);
+		h=pfc->finish_hash_to_group();
+		kh[i].h=(unsigned int)toint(h%w);
+		kh[i].i=i;
+	}
+	qsort(kh,n,sizeof(keyhash),keycmp);
+	for (i=0;i<n;i=j)
+	{ // run of equal hashes i..j-1 - almost always of the same key
+		for (j=i;j<n && kh[j].h==kh[i].h;j++)
+		{
+			for (k=i;k<j;k++)
+				if (V[kh[k].i]==V[kh[j].i] || *V[kh[k].i]==*V[kh[j].i]) break;
+			if (k<j) key[kh[j].i]=key[kh[k].i];
+			else key[kh[j].i]=nk++;
+		}
+	}
+	delete [] kh;
+}
+
+static BOOL check(batch *b,int lo,int hi)
+{ // test signatures lo..hi-1 together
+	int i,j,k=0;
+	G1 sum;
+
+	for (i=lo;i<hi;i++)
+	{
+		sum=sum+b->U[i];
+		j=b->slot[b->key[i]];
+		if (j>=0) b->P[j]=b->P[j]+b->T[i];
+		else
+		{
+			b->slot[b->key[i]]=k;
+			b->g2[k]=b->V[i];
+			b->P[k++]=b->T[i];
+		}
+	}
+	for (i=lo;i<hi;i++) b->slot[b->key[i]]=-1;
+	b->P[k]=sum;
+	b->g2[k]=b->Q;
+	for (j=0;j<=k;j++) b->g1[j]=&b->P[j];
+
+	return (b->pfc->multi_pairing(k+1,b->g2,b->g1)==1);
+}
+
+static int search(batch *b,int lo,int hi)
+{ // find the bad signatures among lo..hi-1, known to include at least one
+	int i,mid,bad;
+
+	if (hi-lo==1)
+	{
+		b->good[lo]=FALSE;
+		return 1;
+	}
+	mid=(lo+hi)/2;
+	if (check(b,lo,mid))
+	{
+		for (i=lo;i<mid;i++) b->good[i]=TRUE;
+		return search(b,mid,hi);
+	}
+	bad=search(b,lo,mid);
+	if (check(b,mid,hi))
+	{
+		for (i=mid;i<hi;i++) b->good[i]=TRUE;
+	}
+	else bad+=search(b,mid,hi);
+	return bad;
+}
+
+//
+// Verify n signatures S[i] on zero-terminated messages m[i] with public
+// keys V[i]. Returns the number of bad signatures, and if good is not NULL
+// sets good[i] to TRUE or FALSE for each one
+//
+
+int PFC::batch_verify(int n,char **m,G1 **S,G2 **V,G2& Q,BOOL *good)
+{
+	int i,j,nb,bad=0;
+	batch b;
+	int *idx;
+	BOOL *ok;
+	Big r,seed,w=pow((Big)2,BATCH_BITS);
+#ifdef G1_COFACTOR
+	ECn t;
+#endif
+
+	if (n<=0) return 0;
+
+	if (good==NULL) ok=new BOOL[n];
+	else ok=good;
+	idx=new int[n];
+	for (i=nb=0;i<n;i++)
+	{ // S[i] must be in G1
+#ifdef G1_COFACTOR
+		t=S[i]->g;
+		t*=*ord;
+		if (!t.iszero())
+		{
+			ok[i]=FALSE;
+			bad++;
+			continue;
+		}
+#endif
+		idx[nb++]=i;
+	}
+	if (nb==0)
+	{
+		delete [] idx;
+		if (good==NULL) delete [] ok;
+		return bad;
+	}
+
+	b.pfc=this;
+	b.Q=&Q;
+	b.V=new G2*[nb];
+	b.T=new G1[nb];
+	b.U=new G1[nb];
+	b.P=new G1[nb+1];
+	b.g1=new G1*[nb+1];
+	b.g2=new G2*[nb+1];
+	b.key=new int[nb];
+	b.slot=new int[nb];
+	b.good=new BOOL[nb];
+
+	for (j=0;j<nb;j++)
+	{
+		i=idx[j];
+		b.V[j]=V[i];
+		b.slot[j]=-1;
+		hash_and_map(b.T[j],m[i]);
+	}
+	find_keys(this,nb,b.V,b.key);
+
+#ifndef MR_NO_RAND
+	if (RNG==NULL)
+#endif
+	{ // hash the whole batch
+		start_hash();
+		for (j=0;j<nb;j++)
+		{
+			add_to_hash(b.T[j]);
+			add_to_hash(*S[idx[j]]);
+			add_to_hash(*b.V[j]);
+		}
+		add_to_hash(Q);
+		seed=finish_hash_to_group();
+	}
+
+	for (j=0;j<nb;j++)
+	{
+		do
+		{
+#ifndef MR_NO_RAND
+			if (RNG!=NULL) r=strong_rand(RNG,BATCH_BITS,2);
+			else
+#endif
+			{
+				start_hash();
+				add_to_hash(seed);
+				add_to_hash((Big)j);
+				seed=finish_hash_to_group();
+				r=seed%w;
+			}
+		} while (r==0);
+		b.T[j]=-mult(b.T[j],r);
+		b.U[j]=mult(*S[idx[j]],r);
+	}
+
+	if (check(&b,0,nb))
+		for (j=0;j<nb;j++) b.good[j]=TRUE;
+	else bad+=search(&b,0,nb);
+	for (j=0;j<nb;j++) ok[idx[j]]=b.good[j];
+
+	delete [] b.good;
+	delete [] b.slot;
+	delete [] b.key;
+	delete [] b.g2;
+	delete [] b.g1;
+	delete [] b.P;
+	delete [] b.U;
+	delete [] b.T;
+	delete [] b.V;
+	delete [] idx;
+	if (good==NULL) delete [] ok;
+	return bad;
+}
@@ -0,0 +1,500 @@
+/***************************************************************************
+                                                                           *
+Copyright 2013 CertiVox UK Ltd.                                           *
+                                                                           *
+This file is part of CertiVox MIRACL Crypto SDK.                           *
+                                                                           *
+The CertiVox MIRACL Crypto SDK provides developers with an                 *
+extensive and efficient set of cryptographic functions.                    *
+For further information about its features and functionalities please      *
+refer to http://www.certivox.com                                           *
+                                                                           *
+* The CertiVox MIRACL Crypto SDK is free software: you can                 *
+  redistribute it and/or modify it under the terms of the                  *
+  GNU Affero General Public License as published by the                    *
+  Free Software Foundation, either version 3 of the License,               *
+  or (at your option) any later version.                                   *
+                                                                           *
+* The CertiVox MIRACL Crypto SDK is distributed in the hope                *
+  that it will be useful, but WITHOUT ANY WARRANTY; without even the       *
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. *
+  See the GNU Affero General Public License for more details.              *
+                                                                           *
+* You should have received a copy of the GNU Affero General Public         *
+  License along with CertiVox MIRACL Crypto SDK.                           *
+  If not, see <http://www.gnu.org/licenses/>.                              *
+                                                                           *
+You can be released from the requirements of the license by purchasing     *
+a commercial license. Buying such a license is mandatory as soon as you    *
+develop commercial activities involving the CertiVox MIRACL Crypto SDK     *
+without disclosing the source code of your own applications, or shipping   *
+the CertiVox MIRACL Crypto SDK with a closed source product.               *
+                                                                           *
+***************************************************************************/
+/*
+ * pfc_tables.cpp
+ *
+ * Files of precomputed tables for type-3 pairings
+ *
+ * PFC::save_tables() writes a set of G1, G2 and GT instances, and any
+ * tables precomputed on them, to a file. PFC::load_tables() maps the
+ * file into memory and restores them, which is much faster than doing the
+ * precomputation again.
+ *
+ * Field elements are stored as the native words of their Montgomery
+ * representation, so loading them is just a copy. The file starts with
+ * a version number, the word size, the curve modulus and the number of
+ * each type of instance, and is only accepted by a build that agrees on
+ * all of them.
+ *
+ * Compile with MR_PAIRING_* defined to match the pairing file, for example
+ *
+ * cl /O2 /GX /DMR_PAIRING_BN ibe.cpp bn_pair.cpp pfc_tables.cpp zzn12a.cpp ...
+ *
+ * Define MR_NO_MMAP to read the file with stdio rather than mapping it.
+ */
+
+#include <stdio.h>
+
+#include "pairing_3.h"
+
+#ifndef GT_TYPE
+#error "Define one of MR_PAIRING_CP, MR_PAIRING_MNT, MR_PAIRING_BN, MR_PAIRING_KSS or MR_PAIRING_BLS"
+#endif
+
+#ifndef MR_NO_MMAP
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#endif
+
+#define TABLE_MAGIC 0x5450524D	// "MRPT"
+#define TABLE_VERSION 2
+
+// number of residues in an element of G2_SUBTYPE and of GT_TYPE
+
+#ifdef MR_PAIRING_BN
+#define G2_DEGREE 2
+#define GT_DEGREE 12
+#endif
+#ifdef MR_PAIRING_KSS
+#define G2_DEGREE 3
+#define GT_DEGREE 18
+#endif
+#ifdef MR_PAIRING_BLS
+#define G2_DEGREE 4
+#define GT_DEGREE 24
+#endif
+#ifdef MR_PAIRING_MNT
+#define G2_DEGREE 3
+#define GT_DEGREE 6
+#endif
+#ifdef MR_PAIRING_CP
+#define G2_DEGREE 1
+#define GT_DEGREE 2
+#endif
+
+// GT elements keep their "unitary" flag, which selects fast squaring
+
+#ifdef MR_PAIRING_CP
+static BOOL is_unitary(GT_TYPE&) {return FALSE;}
+static void set_unitary(GT_TYPE&,BOOL) {}
+#else
+static BOOL is_unitary(GT_TYPE& x) {return x.is_unitary();}
+static void set_unitary(GT_TYPE& x,BOOL u) {if (u) x.mark_as_unitary();}
+#endif
+
+static int residue_words(void)
+{
+	return get_mip()->nib-1;
+}
+
+static int ptable_size(PFC& pfc)
+{ // number of entries in a G2 ptable, as in PFC::spill()
+#ifndef MR_PAIRING_CP
+	Big n,X=*pfc.x;
+#endif
+#ifdef MR_PAIRING_BN
+	if (X<0) n=-(6*X+2);
+	else n=6*X+2;
+	return 2*(bits(n)+ham(n));
+#endif
+#ifdef MR_PAIRING_KSS
+	n=X/7;
+	return 2*(bits(n)+ham(n)+1);
+#endif
+#ifdef MR_PAIRING_BLS
+	return 2*(bits(X)+ham(X)-2);
+#endif
+#ifdef MR_PAIRING_MNT
+	return 2*(bits(X)-2+ham(X));
+#endif
+#ifdef MR_PAIRING_CP
+	return 2*(bits(*pfc.ord-1)-2+ham(*pfc.ord));
+#endif
+}
+
+//
+// Writing - one residue at a time
+//
+
+static void put_word(FILE *fp,mr_small w)
+{
+	fwrite(&w,sizeof(mr_small),1,fp);
+}
+
+static void put(FILE *fp,big x)
+{
+	int i,len=(int)(x->len&MR_OBITS);
+	for (i=0;i<residue_words();i++)
+		put_word(fp,(i<len) ? x->w[i] : 0);
+}
+
+static void put(FILE *fp,const ZZn& x)  {put(fp,x.getzzn());}
+
+static void put(FILE *fp,const ECn& P)
+{
+	ECn Q=P;
+	epoint *p;
+	normalise(Q);
+	p=Q.get_point();
+	put_word(fp,p->marker);
+	put(fp,p->X);
+	put(fp,p->Y);
+}
+
+#ifndef MR_PAIRING_KSS
+static void put(FILE *fp,const ZZn2& x) {ZZn a,b; x.get(a,b); put(fp,a); put(fp,b);}
+#endif
+#if defined(MR_PAIRING_KSS) || defined(MR_PAIRING_MNT)
+static void put(FILE *fp,const ZZn3& x) {ZZn a,b,c; x.get(a,b,c); put(fp,a); put(fp,b); put(fp,c);}
+#endif
+#if defined(MR_PAIRING_BN) || defined(MR_PAIRING_BLS)
+static void put(FILE *fp,const ZZn4& x) {ZZn2 a,b; x.get(a,b); put(fp,a); put(fp,b);}
+#endif
+#ifdef MR_PAIRING_BN
+static void put(FILE *fp,const ZZn12& x) {ZZn4 a,b,c; x.get(a,b,c); put(fp,a); put(fp,b); put(fp,c);}
+#endif
+#ifdef MR_PAIRING_KSS
+static void put(FILE *fp,const ZZn6& x) {ZZn3 a,b; x.get(a,b); put(fp,a); put(fp,b);}
+static void put(FILE *fp,const ZZn18& x) {ZZn6 a,b,c; x.get(a,b,c); put(fp,a); put(fp,b); put(fp,c);}
+#endif
+#ifdef MR_PAIRING_BLS
+static void put(FILE *fp,const ZZn8& x) {ZZn4 a,b; x.get(a,b); put(fp,a); put(fp,b);}
+static void put(FILE *fp,const ZZn24& x) {ZZn8 a,b,c; x.get(a,b,c); put(fp,a); put(fp,b); put(fp,c);}
+#endif
+#ifdef MR_PAIRING_MNT
+static void put(FILE *fp,const ZZn6& x) {ZZn2 a,b,c; x.get(a,b,c); put(fp,a); put(fp,b); put(fp,c);}
+#endif
+
+#ifndef MR_PAIRING_CP
+static void put(FILE *fp,const G2_TYPE& P)
+{
+	G2_SUBTYPE x,y;
+	if (P.iszero()) put_word(fp,MR_EPOINT_INFINITY);
+	else
+	{
+		put_word(fp,MR_EPOINT_NORMALIZED);
+		P.get(x,y);
+	}
+	put(fp,x);
+	put(fp,y);
+}
+#endif
+
+//
+// Reading - from words in memory
+//
+
+static void get(const mr_small *&w,big x)
+{
+	int i,n=residue_words();
+	for (i=0;i<n;i++) x->w[i]=*w++;
+	x->len=n;
+	mr_lzero(x);
+}
+
+static void get(const mr_small *&w,ZZn& x) {get(w,x.getzzn());}
+
+static void get(const mr_small *&w,ECn& P)
+{
+	epoint *p=P.get_point();
+	int marker=(int)*w++;
+	get(w,p->X);
+	get(w,p->Y);
+	copy(get_mip()->one,p->Z);
+	p->marker=marker;
+}
+
+#ifndef MR_PAIRING_KSS
+static void get(const mr_small *&w,ZZn2& x) {ZZn a,b; get(w,a); get(w,b); x.set(a,b);}
+#endif
+#if defined(MR_PAIRING_KSS) || defined(MR_PAIRING_MNT)
+static void get(const mr_small *&w,ZZn3& x) {ZZn a,b,c; get(w,a); get(w,b); get(w,c); x.set(a,b,c);}
+#endif
+#if defined(MR_PAIRING_BN) || defined(MR_PAIRING_BLS)
+static void get(const mr_small *&w,ZZn4& x) {ZZn2 a,b; get(w,a); get(w,b); x.set(a,b);}
+#endif
+#ifdef MR_PAIRING_BN
+static void get(const mr_small *&w,ZZn12& x) {ZZn4 a,b,c; get(w,a); get(w,b); get(w,c); x.set(a,b,c);}
+#endif
+#ifdef MR_PAIRING_KSS
+static void get(const mr_small *&w,ZZn6& x) {ZZn3 a,b; get(w,a); get(w,b); x.set(a,b);}
+static void get(const mr_small *&w,ZZn18& x) {ZZn6 a,b,c; get(w,a); get(w,b); get(w,c); x.set(a,b,c);}
+#endif
+#ifdef MR_PAIRING_BLS
+static void get(const mr_small *&w,ZZn8& x) {ZZn4 a,b; get(w,a); get(w,b); x.set(a,b);}
+static void get(const mr_small *&w,ZZn24& x) {ZZn8 a,b,c; get(w,a); get(w,b); get(w,c); x.set(a,b,c);}
+#endif
+#ifdef MR_PAIRING_MNT
+static void get(const mr_small *&w,ZZn6& x) {ZZn2 a,b,c; get(w,a); get(w,b); get(w,c); x.set(a,b,c);}
+#endif
+
+#ifndef MR_PAIRING_CP
+static void get(const mr_small *&w,G2_TYPE& P)
+{
+	G2_SUBTYPE x,y;
+	int marker=(int)*w++;
+	get(w,x);
+	get(w,y);
+	if (marker==MR_EPOINT_INFINITY) P.clear();
+	else P.set(x,y);
+}
+#endif
+
+//
+// Save instances of G1, G2 and GT, and their precomputed tables, to a file
+//
+
+BOOL PFC::save_tables(char *file,int n1,G1 **g1,int n2,G2 **g2,int nt,GT **gt)
+{
+	int i,j,m,nw=(1<<WINDOW_SIZE);
+	Big p=get_modulus();
+	FILE *fp=fopen(file,"wb");
+	if (fp==NULL) return FALSE;
+
+	put_word(fp,TABLE_MAGIC);
+	put_word(fp,TABLE_VERSION);
+	put_word(fp,MIRACL);
+	put_word(fp,residue_words());
+	put_word(fp,WINDOW_SIZE);
+	put_word(fp,n1); put_word(fp,n2); put_word(fp,nt);
+	put(fp,p.getbig());
+
+	for (i=0;i<n1;i++)
+	{
+		G1& w=*g1[i];
+		put_word(fp,w.mtable!=NULL);
+		put_word(fp,w.mtbits);
+		put(fp,w.g);
+		if (w.mtable!=NULL) for (j=0;j<nw;j++) put(fp,w.mtable[j]);
+	}
+	for (i=0;i<n2;i++)
+	{
+		G2& w=*g2[i];
+		if (w.ptable!=NULL) m=ptable_size(*this);
+		else m=0;
+		put_word(fp,w.mtable!=NULL);
+		put_word(fp,w.mtbits);
+		put_word(fp,m);
+		put(fp,w.g);
+		for (j=0;j<m;j++) put(fp,w.ptable[j]);
+		if (w.mtable!=NULL) for (j=0;j<nw;j++) put(fp,w.mtable[j]);
+	}
+	for (i=0;i<nt;i++)
+	{
+		GT& w=*gt[i];
+		put_word(fp,w.etable!=NULL);
+		put_word(fp,w.etbits);
+		put_word(fp,is_unitary(w.g));
+		put(fp,w.g);
+		if (w.etable!=NULL) for (j=0;j<nw;j++) put(fp,w.etable[j]);
+	}
+
+	if (ferror(fp)) {fclose(fp); return FALSE;}
+	return (fclose(fp)==0);
+}
+
+//
+// Restore instances saved by save_tables(). Any tables they already have
+// are replaced. Returns FALSE, leaving the instances as they were, if the
+// file does not match this curve and build, or is damaged
+//
+
+static BOOL room(const mr_small *w,const mr_small *e,long n)
+{
+	return (e-w>=n);
+}
+
+static BOOL read_tables(PFC& pfc,const mr_small *w,const mr_small *e,int n1,G1 **g1,int n2,G2 **g2,int nt,GT **gt)
+{ // everything is read into temporaries, and given to the instances only
+  // when the whole file has been found good
+	int i,j,m,has,u,nw=(1<<WINDOW_SIZE);
+	int *b1,*b2,*bt;		// mtbits and etbits
+	ECn *a1,**m1;
+	G2_TYPE *a2,**m2;
+	G2_SUBTYPE **p2;
+	GT_TYPE *at,**mt;
+	BOOL ok=TRUE;
+	long r=residue_words();
+	long pt=1+2*r,qt=1+2*G2_DEGREE*r;
+	Big p=get_modulus();
+	big x=p.getbig();
+
+	if (!room(w,e,8+r)) return FALSE;
+	if (w[0]!=(mr_small)TABLE_MAGIC || w[1]!=TABLE_VERSION || w[2]!=MIRACL || (long)w[3]!=r || w[4]!=WINDOW_SIZE) return FALSE;
+	if ((int)w[5]!=n1 || (int)w[6]!=n2 || (int)w[7]!=nt) return FALSE;
+	w+=8;
+	for (i=0;i<r;i++)
+		if (w[i]!=((i<(int)(x->len&MR_OBITS)) ? x->w[i] : 0)) return FALSE;
+	w+=r;
+
+	a1=new ECn[n1+1]; m1=new ECn*[n1+1]; b1=new int[n1+1];
+	a2=new G2_TYPE[n2+1]; m2=new G2_TYPE*[n2+1]; p2=new G2_SUBTYPE*[n2+1]; b2=new int[n2+1];
+	at=new GT_TYPE[nt+1]; mt=new GT_TYPE*[nt+1]; bt=new int[nt+1];
+	for (i=0;i<n1;i++) m1[i]=NULL;
+	for (i=0;i<n2;i++) {m2[i]=NULL; p2[i]=NULL;}
+	for (i=0;i<nt;i++) mt[i]=NULL;
+
+	for (i=0;ok && i<n1;i++)
+	{
+		if (!room(w,e,2+pt)) {ok=FALSE; break;}
+		has=(int)*w++;
+		b1[i]=(int)*w++;
+		get(w,a1[i]);
+		if (!has) continue;
+		if (!room(w,e,nw*pt)) {ok=FALSE; break;}
+		m1[i]=new ECn[nw];
+		for (j=0;j<nw;j++) get(w,m1[i][j]);
+	}
+	for (i=0;ok && i<n2;i++)
+	{
+		if (!room(w,e,3+qt)) {ok=FALSE; break;}
+		has=(int)*w++;
+		b2[i]=(int)*w++;
+		m=(int)*w++;
+		if (m!=0 && m!=ptable_size(pfc)) {ok=FALSE; break;}
+		get(w,a2[i]);
+		if (!room(w,e,m*G2_DEGREE*r+has*nw*qt)) {ok=FALSE; break;}
+		if (m!=0)
+		{
+			p2[i]=new G2_SUBTYPE[m];
+			for (j=0;j<m;j++) get(w,p2[i][j]);
+		}
+		if (has)
+		{
+			m2[i]=new G2_TYPE[nw];
+			for (j=0;j<nw;j++) get(w,m2[i][j]);
+		}
+	}
+	for (i=0;ok && i<nt;i++)
+	{
+		if (!room(w,e,3+GT_DEGREE*r)) {ok=FALSE; break;}
+		has=(int)*w++;
+		bt[i]=(int)*w++;
+		u=(int)*w++;
+		get(w,at[i]);
+		set_unitary(at[i],u);
+		if (!has) continue;
+		if (!room(w,e,nw*GT_DEGREE*r)) {ok=FALSE; break;}
+		mt[i]=new GT_TYPE[nw];
+		for (j=0;j<nw;j++)
+		{ // powers of g, so unitary if it is
+			get(w,mt[i][j]);
+			set_unitary(mt[i][j],u);
+		}
+	}
+
+	if (ok)
+	{ // replace the instances and any tables they had
+		for (i=0;i<n1;i++)
+		{
+			G1& g=*g1[i];
+			if (g.mtable!=NULL) delete [] g.mtable;
+			g.g=a1[i]; g.mtbits=b1[i]; g.mtable=m1[i];
+		}
+		for (i=0;i<n2;i++)
+		{
+			G2& g=*g2[i];
+			if (g.ptable!=NULL) delete [] g.ptable;
+			if (g.mtable!=NULL) delete [] g.mtable;
+			g.g=a2[i]; g.mtbits=b2[i]; g.ptable=p2[i]; g.mtable=m2[i];
+		}
+		for (i=0;i<nt;i++)
+		{
+			GT& g=*gt[i];
+			if (g.etable!=NULL) delete [] g.etable;
+			g.g=at[i]; g.etbits=bt[i]; g.etable=mt[i];
+		}
+	}
+	else
+	{
+		for (i=0;i<n1;i++) if (m1[i]!=NULL) delete [] m1[i];
+		for (i=0;i<n2;i++)
+		{
+			if (p2[i]!=NULL) delete [] p2[i];
+			if (m2[i]!=NULL) delete [] m2[i];
+		}
+		for (i=0;i<nt;i++) if (mt[i]!=NULL) delete [] mt[i];
+	}
+	delete [] bt; delete [] b2; delete [] b1;
+	delete [] mt; delete [] at;
+	delete [] p2; delete [] m2; delete [] a2;
+	delete [] m1; delete [] a1;
+	return ok;
+}
+
+BOOL PFC::load_tables(char *file,int n1,G1 **g1,int n2,G2 **g2,int nt,GT **gt)
+{
+	BOOL ok;
+	const mr_small *w;
+	long size;
+#ifdef MR_NO_MMAP
+	FILE *fp=fopen(file,"rb");
+	mr_small *buff;
+	if (fp==NULL) return FALSE;
+	fseek(fp,0,SEEK_END);
+	size=ftell(fp);
+	fseek(fp,0,SEEK_SET);
+	buff=new mr_small[size/sizeof(mr_small)+1];
+	ok=(fread(buff,1,size,fp)==(size_t)size);
+	fclose(fp);
+	w=buff;
+	if (ok) ok=read_tables(*this,w,w+size/sizeof(mr_small),n1,g1,n2,g2,nt,gt);
+	delete [] buff;
+#else
+#ifdef _WIN32
+	HANDLE fh,mh;
+	fh=CreateFileA(file,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+	if (fh==INVALID_HANDLE_VALUE) return FALSE;
+	size=(long)GetFileSize(fh,NULL);
+	mh=CreateFileMapping(fh,NULL,PAGE_READONLY,0,0,NULL);
+	if (mh==NULL) {CloseHandle(fh); return FALSE;}
+	w=(const mr_small *)MapViewOfFile(mh,FILE_MAP_READ,0,0,0);
+	ok=(w!=NULL);
+	if (ok) ok=read_tables(*this,w,w+size/sizeof(mr_small),n1,g1,n2,g2,nt,gt);
+	if (w!=NULL) UnmapViewOfFile(w);
+	CloseHandle(mh);
+	CloseHandle(fh);
+#else
+	struct stat st;
+	void *map;
+	int fd=open(file,O_RDONLY);
+	if (fd<0) return FALSE;
+	if (fstat(fd,&st)!=0 || st.st_size==0) {close(fd); return FALSE;}
+	size=(long)st.st_size;
+	map=mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if (map==MAP_FAILED) return FALSE;
+	w=(const mr_small *)map;
+	ok=read_tables(*this,w,w+size/sizeof(mr_small),n1,g1,n2,g2,nt,gt);
+	munmap(map,size);
+#endif
+#endif
+	return ok;
+}
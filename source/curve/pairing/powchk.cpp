@@ -0,0 +1,96 @@
+/*
+   Test program for powering in the cyclotomic subgroup
+
+   Compile with modules as specified in the selected header file. For
+   example for the MR_PAIRING_BN curve
+
+   cl /O2 /GX powchk.cpp bn_pair.cpp zzn12a.cpp ecn2.cpp zzn4.cpp zzn2.cpp big.cpp zzn.cpp ecn.cpp miracl.lib
+
+   pow() of a unitary value uses compressed squaring when the exponent is
+   sparse. Its results for sparse exponents, positive and negative, odd
+   and even, are compared with plain square-and-multiply, and g^r must
+   be 1 for g in GT.
+*/
+
+#include <iostream>
+
+//********* choose just one of these pairs **********
+#define MR_PAIRING_BN    // AES-128 or AES-192 security
+#define AES_SECURITY 128
+//#define AES_SECURITY 192
+
+//#define MR_PAIRING_KSS    // AES-192 security
+//#define AES_SECURITY 192
+
+//#define MR_PAIRING_BLS    // AES-256 security
+//#define AES_SECURITY 256
+//*********************************************
+
+#include "pairing_3.h"
+
+static GT_TYPE slow_pow(const GT_TYPE& x,const Big& k)
+{ // plain square-and-multiply
+	int i;
+	GT_TYPE u=x;
+	Big e=k;
+	if (e<0) e=-e;
+	for (i=bits(e)-2;i>=0;i--)
+	{
+		u*=u;
+		if (bit(e,i)) u*=x;
+	}
+	if (k<0) u=inverse(u);
+	return u;
+}
+
+int main()
+{
+	PFC pfc(AES_SECURITY);  // initialise pairing-friendly curve
+
+	G1 P;
+	G2 Q;
+	GT e;
+	GT_TYPE g,u,v;
+	Big k[8];
+	int i,bad=0;
+
+	pfc.hash_and_map(P,(char *)"Alice");
+	pfc.hash_and_map(Q,(char *)"Robert");
+	e=pfc.pairing(Q,P);
+	g=e.g;
+	if (!g.is_unitary())
+	{
+		cout << "Pairing value is not marked unitary" << endl;
+		bad++;
+	}
+
+	k[0]=*pfc.x;			// as in the final exponentiation
+	k[1]=-(*pfc.x);
+	k[2]=pow((Big)2,100);
+	k[3]=pow((Big)2,200)+pow((Big)2,50)+1;
+	k[4]=-(pow((Big)2,64)+8);
+	k[5]=2;
+	k[6]=(*pfc.x)*(*pfc.x);		// dense - not compressed
+	k[7]=*pfc.ord-1;
+
+	for (i=0;i<8;i++)
+	{
+		u=pow(g,k[i]);
+		v=slow_pow(g,k[i]);
+		if (u!=v)
+		{
+			cout << "pow() is wrong for exponent " << k[i] << endl;
+			bad++;
+		}
+	}
+	u=pow(g,*pfc.ord);
+	if (!u.isunity())
+	{
+		cout << "g^r is not 1" << endl;
+		bad++;
+	}
+
+	if (bad) cout << "FAILED" << endl;
+	else     cout << "All OK" << endl;
+	return bad;
+}
@@ -593,7 +593,7 @@ GT PFC::pairing(const G1& x,const G1& y)
 	return z;
 }
 
-GT PFC::multi_pairing(int n,G1 **y,G1 **x)
+GT PFC::multi_pairing(int n,G1 **y,G1 **x,int threads)
 {
 	int i;
 	GT z=1;
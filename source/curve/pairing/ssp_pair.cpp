@@ -49,6 +49,7 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 
 #define MR_PAIRING_SSP
 #include "pairing_1.h"
+#include "pairing_mt.h"
 
 // Supersingular curve parameters, A,B and n, where p=2nq-1
 // AES_SECURITY=80 bit curve
@@ -388,7 +389,7 @@ int PFC::precomp_for_pairing(G1& w)
 	return len;
 }
 
-GT PFC::multi_miller(int n,G1** QQ,G1** PP)
+GT PFC::multi_miller(int n,G1** QQ,G1** PP,int threads)
 {
 	GT z;
     ZZn *Px,*Py;
@@ -398,6 +399,14 @@ GT PFC::multi_miller(int n,G1** QQ,G1** PP)
     ZZn2 res;
 	Big iters=*ord-1;
 
+#ifdef MR_UNIX_MT
+	if (threads<=0) threads=MR_PAIRING_THREADS;
+	if (threads>n/2) threads=n/2;  // at least two pairs each
+	if (threads>1) return shared_miller(this,threads,n,QQ,PP);
+#else
+	(void)threads;
+#endif
+
 	Px=new ZZn[n];
 	Py=new ZZn[n];
 	Q=new ECn[n];
@@ -809,10 +818,10 @@ GT PFC::pairing(const G1& x,const G1& y)
 	return z;
 }
 
-GT PFC::multi_pairing(int n,G1 **y,G1 **x)
+GT PFC::multi_pairing(int n,G1 **y,G1 **x,int threads)
 {
 	GT z;
-	z=multi_miller(n,y,x);
+	z=multi_miller(n,y,x,threads);
 	z=final_exp(z);
 	return z;
 
@@ -0,0 +1,144 @@
+/*
+   Test program for files of precomputed tables
+
+   Compile with modules as specified in the selected header file, and
+   pfc_tables.cpp. For example for the MR_PAIRING_BN curve
+
+   cl /O2 /GX tabchk.cpp pfc_tables.cpp bn_pair.cpp zzn12a.cpp ecn2.cpp zzn4.cpp zzn2.cpp big.cpp zzn.cpp ecn.cpp miracl.lib
+
+   Instances of G1, G2 and GT, with and without tables, are saved and
+   loaded again, and must then give the same multiples, powers and
+   pairings. Truncated files and a file with the wrong number of
+   instances must be refused, leaving the instances as they were.
+*/
+
+#include <iostream>
+#include <stdio.h>
+
+//********* choose just one of these pairs **********
+//#define MR_PAIRING_CP      // AES-80 security
+//#define AES_SECURITY 80
+
+//#define MR_PAIRING_MNT	// AES-80 security
+//#define AES_SECURITY 80
+
+#define MR_PAIRING_BN    // AES-128 or AES-192 security
+#define AES_SECURITY 128
+//#define AES_SECURITY 192
+
+//#define MR_PAIRING_KSS    // AES-192 security
+//#define AES_SECURITY 192
+
+//#define MR_PAIRING_BLS    // AES-256 security
+//#define AES_SECURITY 256
+//*********************************************
+
+#include "pairing_3.h"
+
+int main()
+{
+	PFC pfc(AES_SECURITY);  // initialise pairing-friendly curve
+
+	G1 P,P0,L,L0,U,V,*g1[2],*h1[2];
+	G2 Q,Q0,M,M0,W,X,*g2[2],*h2[2];
+	GT e,e0,f,f0,s,t,*gt[2],*ht[2];
+	Big a;
+	FILE *fp;
+	char *buff;
+	long n,cut;
+	int i,bad=0;
+	BOOL ok;
+
+	irand(5L);
+	pfc.hash_and_map(P,(char *)"Alice");
+	pfc.hash_and_map(Q,(char *)"Robert");
+	e=pfc.pairing(Q,P);
+	P0=P; Q0=Q; e0=e;		// these without tables
+	pfc.precomp_for_mult(P);
+	pfc.precomp_for_mult(Q);
+	pfc.precomp_for_pairing(Q);
+	pfc.precomp_for_power(e);
+
+	g1[0]=&P; g1[1]=&P0;
+	g2[0]=&Q; g2[1]=&Q0;
+	gt[0]=&e; gt[1]=&e0;
+	h1[0]=&L; h1[1]=&L0;
+	h2[0]=&M; h2[1]=&M0;
+	ht[0]=&f; ht[1]=&f0;
+
+	if (!pfc.save_tables((char *)"tabchk.tab",2,g1,2,g2,2,gt) ||
+	    !pfc.load_tables((char *)"tabchk.tab",2,h1,2,h2,2,ht))
+	{
+		cout << "Could not save and load tables" << endl;
+		return 1;
+	}
+	if (L.mtable==NULL || M.mtable==NULL || M.ptable==NULL || f.etable==NULL ||
+	    L0.mtable!=NULL || M0.mtable!=NULL || M0.ptable!=NULL || f0.etable!=NULL)
+	{
+		cout << "Tables not restored as saved" << endl;
+		bad++;
+	}
+	for (i=0;i<10;i++)
+	{
+		a=rand(pfc.order());
+		if (i%2==1) a=-a;
+		U=pfc.mult(L,a); V=pfc.mult(P0,a);
+		if (U!=V) bad++;
+		U=pfc.mult(L0,a);
+		if (U!=V) bad++;
+		W=pfc.mult(M,a); X=pfc.mult(Q0,a);
+		if (W!=X) bad++;
+		s=pfc.power(f,a); t=pfc.power(e0,a);
+		if (s!=t) bad++;
+	}
+	s=pfc.pairing(M,L); t=pfc.pairing(M0,L0);
+	if (s!=e0 || t!=e0)
+	{
+		cout << "Pairing of loaded instances is wrong" << endl;
+		bad++;
+	}
+	if (bad) cout << "Loaded instances give wrong results" << endl;
+
+// damaged files are refused, and the instances left alone
+
+	fp=fopen("tabchk.tab","rb");
+	fseek(fp,0,SEEK_END);
+	n=ftell(fp);
+	fseek(fp,0,SEEK_SET);
+	buff=new char[n];
+	fread(buff,1,n,fp);
+	fclose(fp);
+	for (cut=8;cut<n;cut+=n/37+1)
+	{
+		fp=fopen("tabchk.tab","wb");
+		fwrite(buff,1,cut,fp);
+		fclose(fp);
+		ok=(!pfc.load_tables((char *)"tabchk.tab",2,h1,2,h2,2,ht) &&
+		    L.mtable!=NULL && M.ptable!=NULL && f.etable!=NULL);
+		if (ok)
+		{
+			s=pfc.pairing(M,L);
+			ok=(s==e0);
+		}
+		if (!ok)
+		{
+			cout << "File truncated to " << cut << " bytes was not refused cleanly" << endl;
+			bad++;
+			break;
+		}
+	}
+	fp=fopen("tabchk.tab","wb");
+	fwrite(buff,1,n,fp);
+	fclose(fp);
+	delete [] buff;
+	if (pfc.load_tables((char *)"tabchk.tab",1,h1,1,h2,1,ht))
+	{
+		cout << "File with the wrong number of instances accepted" << endl;
+		bad++;
+	}
+	remove("tabchk.tab");
+
+	if (bad) cout << "FAILED" << endl;
+	else     cout << "All OK" << endl;
+	return bad;
+}
@@ -49,6 +49,8 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 
 using namespace std;
 
+#define COMPRESS 4 // use compressed squaring if at most 1 in 4 bits are set
+
 // Frobenius X=x^p. Assumes p=1 mod 6
 
 ZZn12& ZZn12::powq(const ZZn2& X)
@@ -112,7 +114,41 @@ ZZn12& ZZn12::operator*=(const ZZn12& x)
 // Chung-Hasan SQR3 - actually calculate 2x^2 !
 // Slightly dangerous - but works as will be raised to p^{k/2}-1
 // which wipes out the 2.
-
+#ifndef MR_NO_LAZY_REDUCTION
+// Lazy reduction - the five squares are combined unreduced
+			zzn4 Z[5];
+			char *mem=zzn4_double_memalloc(5,Z);
+
+			zzn4_double_sqr(a.getzzn4(),&Z[0]);                 // a0^2
+			zzn4_double_mul(b.getzzn4(),c.getzzn4(),&Z[1]);     // a1.a2
+			zzn4_double_sqr(c.getzzn4(),&Z[2]);                 // a2^2
+			c+=a;
+			A=c; A+=b;
+			zzn4_double_sqr(A.getzzn4(),&Z[3]);                 // (a0+a1+a2)^2
+			c-=b;
+			zzn4_double_sqr(c.getzzn4(),&Z[4]);                 // (a0-a1+a2)^2
+
+			zzn4_double_add(&Z[0],&Z[0],&Z[0]);
+			zzn4_double_add(&Z[1],&Z[1],&Z[1]);
+			zzn4_double_add(&Z[1],&Z[1],&Z[1]);
+			zzn4_double_add(&Z[2],&Z[2],&Z[2]);
+
+			zzn4_double_add(&Z[4],&Z[3],&Z[4]);
+			zzn4_double_add(&Z[3],&Z[3],&Z[3]);
+			zzn4_double_sub(&Z[3],&Z[4],&Z[3]);
+			zzn4_double_sub(&Z[3],&Z[1],&Z[3]);
+			zzn4_double_sub(&Z[4],&Z[0],&Z[4]);
+			zzn4_double_sub(&Z[4],&Z[2],&Z[4]);
+			zzn4_double_tx(&Z[2]);
+			zzn4_double_add(&Z[3],&Z[2],&Z[3]);
+			zzn4_double_tx(&Z[1]);
+			zzn4_double_add(&Z[0],&Z[1],&Z[0]);
+
+			zzn4_redc(&Z[0],a.getzzn4());
+			zzn4_redc(&Z[3],b.getzzn4());
+			zzn4_redc(&Z[4],c.getzzn4());
+			memkill(mem,8*5);
+#else
 			A=a; A*=A;       // a0^2    = S0
 			C=c; C*=b; C+=C; // 2a1.a2  = S3
 			D=c; D*=D;       // a2^2    = S4
@@ -135,11 +171,57 @@ ZZn12& ZZn12::operator*=(const ZZn12& x)
 	a=A+tx(C);
     b=B+tx(D);
 */
+#endif
 		}
 	}
  }
  else
  { // Karatsuba
+#ifndef MR_NO_LAZY_REDUCTION
+// Lazy reduction - the six products are combined unreduced, and only the
+// three results reduced
+    zzn4 Z[5];
+    ZZn4 T0,T1;
+	BOOL zero_c,zero_b;
+	char *mem=zzn4_double_memalloc(5,Z);
+	zero_c=(x.c).iszero();
+	zero_b=(x.b).iszero();
+
+    zzn4_double_mul(a.getzzn4(),x.a.getzzn4(),&Z[0]);
+    if (!zero_b) zzn4_double_mul(b.getzzn4(),x.b.getzzn4(),&Z[2]);
+
+    zzn4_add(a.getzzn4(),b.getzzn4(),T0.getzzn4());
+    zzn4_add(x.a.getzzn4(),x.b.getzzn4(),T1.getzzn4());
+    zzn4_double_mul(T0.getzzn4(),T1.getzzn4(),&Z[1]);
+    zzn4_double_sub(&Z[1],&Z[0],&Z[1]);
+    if (!zero_b) zzn4_double_sub(&Z[1],&Z[2],&Z[1]);
+    zzn4_add(b.getzzn4(),c.getzzn4(),T0.getzzn4());
+    zzn4_add(x.b.getzzn4(),x.c.getzzn4(),T1.getzzn4());
+    zzn4_double_mul(T0.getzzn4(),T1.getzzn4(),&Z[3]);
+    if (!zero_b) zzn4_double_sub(&Z[3],&Z[2],&Z[3]);
+
+    zzn4_add(a.getzzn4(),c.getzzn4(),T0.getzzn4());
+    zzn4_add(x.a.getzzn4(),x.c.getzzn4(),T1.getzzn4());
+    zzn4_double_mul(T0.getzzn4(),T1.getzzn4(),&Z[4]);
+    zzn4_double_add(&Z[2],&Z[4],&Z[2]);
+    zzn4_double_sub(&Z[2],&Z[0],&Z[2]);
+
+	if (!zero_c)
+	{ // exploit special form of BN curve line function
+		zzn4_double_mul(c.getzzn4(),x.c.getzzn4(),&Z[4]);
+		zzn4_double_sub(&Z[2],&Z[4],&Z[2]);
+		zzn4_double_sub(&Z[3],&Z[4],&Z[3]);
+		zzn4_double_tx(&Z[4]);
+		zzn4_double_add(&Z[1],&Z[4],&Z[1]);
+	}
+    zzn4_double_tx(&Z[3]);
+    zzn4_double_add(&Z[0],&Z[3],&Z[0]);
+
+    zzn4_redc(&Z[0],a.getzzn4());
+    zzn4_redc(&Z[1],b.getzzn4());
+    zzn4_redc(&Z[2],c.getzzn4());
+    memkill(mem,8*5);
+#else
     ZZn4 Z0,Z1,Z2,Z3,T0,T1;
 	BOOL zero_c,zero_b;
 	zero_c=(x.c).iszero();
@@ -177,6 +259,7 @@ ZZn12& ZZn12::operator*=(const ZZn12& x)
 
     a=Z0+tx(Z3);
     c=Z2;
+#endif
 
     if (!x.unitary) unitary=FALSE;
  }
@@ -288,13 +371,107 @@ ZZn12 tx(const ZZn12& w)
     return u;
 }
 
+// Karabina's compressed squaring - see "Squaring in cyclotomic subgroups", 
+// Math. Comp. 82 (2013). If x is unitary the squares of b and c do not 
+// depend on a, which can be recovered later.
+
+static void compressed_sqr(ZZn4& b,ZZn4& c)
+{
+	ZZn4 B,C,D;
+	B=c; B*=B; B=tx(B); D=B; B+=B; B+=D;
+	C=b; C*=C;          D=C; C+=C; C+=D;
+	b.conj(); b+=b; c.conj(); c+=c; c=-c;
+	b+=B; c+=C;
+}
+
+// Recover a from b and c for n compressed values, sharing one inversion.
+// Fails if b0=0, which is most unlikely
+
+static BOOL decompress(int n,ZZn12 *x)
+{
+	int i;
+	ZZn4 a,b,c;
+	ZZn2 a0,a1,b0,b1,c0,c1,t;
+	ZZn2 *d=new ZZn2[n];
+	ZZn2 *s=new ZZn2[n];
+
+	for (i=0;i<n;i++)
+	{ // d[i]=4.b0, s[i]=d[0].d[1]...d[i]
+		x[i].get(a,b,c);
+		b.get(b0,b1);
+		if (b0.iszero())
+		{
+			delete [] s; delete [] d;
+			return FALSE;
+		}
+		d[i]=b0+b0; d[i]+=d[i];
+		if (i==0) s[i]=d[i];
+		else      s[i]=s[i-1]*d[i];
+	}
+	t=inverse(s[n-1]);
+	for (i=n-1;i>=0;i--)
+	{
+		x[i].get(a,b,c);
+		b.get(b0,b1);
+		c.get(c0,c1);
+		if (i>0) 
+		{
+			a0=t*s[i-1];   // 1/d[i]
+			t*=d[i];
+		}
+		else a0=t;
+		a1=c0*c0; a1*=3; a1+=txx(c1*c1); a1-=(b1+b1);
+		a1*=a0;        // a1=(3c0^2+n.c1^2-2b1)/4b0
+		a0=a1*a1; a0+=a0; a0+=b0*c1; a0-=3*(b1*c0);
+		a0=txx(a0); a0+=(ZZn2)1;  // a0=n.(2a1^2+b0.c1-3b1.c0)+1
+		a=ZZn4(a0,a1);
+		x[i].set(a,b,c);
+		x[i].mark_as_unitary();
+	}
+	delete [] s; delete [] d;
+	return TRUE;
+}
+
+// Square unitary x using compressed squarings, keeping a copy for each
+// set bit of e. These are decompressed together and multiplied
+
+static BOOL compressed_pow(const ZZn12& x,const Big& e,int n,ZZn12& r)
+{
+	int i,j,nb=bits(e);
+	ZZn4 a,b,c;
+	ZZn12 *y=new ZZn12[n];
+
+	x.get(a,b,c);
+	for (i=j=0;;i++)
+	{
+		if (bit(e,i))
+		{
+			y[j].set(a,b,c);
+			y[j++].mark_as_unitary();
+		}
+		if (i==nb-1) break;
+		compressed_sqr(b,c);
+	}
+	if (bit(e,0)) i=decompress(n-1,&y[1]);
+	else          i=decompress(n,y);
+	if (i)
+	{
+		if (bit(e,0)) y[0]=x;
+		r=y[0];
+		for (j=1;j<n;j++) r*=y[j];
+	}
+	delete [] y;
+	return i;
+}
+
 // regular ZZn12 powering
 
 // If k is low Hamming weight this will be just as good..
+// If x is also unitary, Karabina's compressed squaring is used
 
 ZZn12 pow(const ZZn12& x,const Big& k)
 {
-    int i,nb;
+    int i,nb,n;
     ZZn12 u=x;
     Big e=k;
     BOOL invert_it=FALSE;
@@ -308,6 +485,13 @@ ZZn12 pow(const ZZn12& x,const Big& k)
     }
 
     nb=bits(e);
+    for (n=i=0;i<nb;i++)
+        if (bit(e,i)) n++;
+    if (x.unitary && nb>1 && COMPRESS*n<=nb && compressed_pow(x,e,n,u))
+    {
+        if (invert_it) u=inverse(u);
+        return u;
+    }
     if (nb>1) for (i=nb-2;i>=0;i--)
     {
         u*=u;
@@ -49,6 +49,8 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 
 using namespace std;
 
+#define COMPRESS 4 // use compressed squaring if at most 1 in 4 bits are set
+
 // Frobenius X=x^p. Assumes p=13 mod 18. Ideally should be generalised depending on mip->pmod9.
 
 ZZn18& ZZn18::powq(ZZn& W)
@@ -282,9 +284,103 @@ ZZn18 tx(const ZZn18& w)
     return u;
 }
 
+// Karabina's compressed squaring - see "Squaring in cyclotomic subgroups", 
+// Math. Comp. 82 (2013). If x is unitary the squares of b and c do not 
+// depend on a, which can be recovered later.
+
+static void compressed_sqr(ZZn6& b,ZZn6& c)
+{
+	ZZn6 B,C,D;
+	B=c; B*=B; B=tx(B); D=B; B+=B; B+=D;
+	C=b; C*=C;          D=C; C+=C; C+=D;
+	b.conj(); b+=b; c.conj(); c+=c; c=-c;
+	b+=B; c+=C;
+}
+
+// Recover a from b and c for n compressed values, sharing one inversion.
+// Fails if b0=0, which is most unlikely
+
+static BOOL decompress(int n,ZZn18 *x)
+{
+	int i;
+	ZZn6 a,b,c;
+	ZZn3 a0,a1,b0,b1,c0,c1,t;
+	ZZn3 *d=new ZZn3[n];
+	ZZn3 *s=new ZZn3[n];
+
+	for (i=0;i<n;i++)
+	{ // d[i]=4.b0, s[i]=d[0].d[1]...d[i]
+		x[i].get(a,b,c);
+		b.get(b0,b1);
+		if (b0.iszero())
+		{
+			delete [] s; delete [] d;
+			return FALSE;
+		}
+		d[i]=b0+b0; d[i]+=d[i];
+		if (i==0) s[i]=d[i];
+		else      s[i]=s[i-1]*d[i];
+	}
+	t=inverse(s[n-1]);
+	for (i=n-1;i>=0;i--)
+	{
+		x[i].get(a,b,c);
+		b.get(b0,b1);
+		c.get(c0,c1);
+		if (i>0) 
+		{
+			a0=t*s[i-1];   // 1/d[i]
+			t*=d[i];
+		}
+		else a0=t;
+		a1=c0*c0; a1*=3; a1+=tx(c1*c1); a1-=(b1+b1);
+		a1*=a0;        // a1=(3c0^2+n.c1^2-2b1)/4b0
+		a0=a1*a1; a0+=a0; a0+=b0*c1; a0-=3*(b1*c0);
+		a0=tx(a0); a0+=(ZZn3)1;  // a0=n.(2a1^2+b0.c1-3b1.c0)+1
+		a=ZZn6(a0,a1);
+		x[i].set(a,b,c);
+		x[i].mark_as_unitary();
+	}
+	delete [] s; delete [] d;
+	return TRUE;
+}
+
+// Square unitary x using compressed squarings, keeping a copy for each
+// set bit of e. These are decompressed together and multiplied
+
+static BOOL compressed_pow(const ZZn18& x,const Big& e,int n,ZZn18& r)
+{
+	int i,j,nb=bits(e);
+	ZZn6 a,b,c;
+	ZZn18 *y=new ZZn18[n];
+
+	x.get(a,b,c);
+	for (i=j=0;;i++)
+	{
+		if (bit(e,i))
+		{
+			y[j].set(a,b,c);
+			y[j++].mark_as_unitary();
+		}
+		if (i==nb-1) break;
+		compressed_sqr(b,c);
+	}
+	if (bit(e,0)) i=decompress(n-1,&y[1]);
+	else          i=decompress(n,y);
+	if (i)
+	{
+		if (bit(e,0)) y[0]=x;
+		r=y[0];
+		for (j=1;j<n;j++) r*=y[j];
+	}
+	delete [] y;
+	return i;
+}
+
 // regular ZZn18 powering
 
 // If k is low Hamming weight this will be just as good..
+// If x is also unitary, Karabina's compressed squaring is used
 
 ZZn18 pow(const ZZn18& x,const Big& k)
 {
@@ -302,6 +398,13 @@ ZZn18 pow(const ZZn18& x,const Big& k)
     }
 
     nb=bits(e);
+    for (n=i=0;i<nb;i++)
+        if (bit(e,i)) n++;
+    if (x.unitary && nb>1 && COMPRESS*n<=nb && compressed_pow(x,e,n,u))
+    {
+        if (invert_it) u=inverse(u);
+        return u;
+    }
     if (nb>1) for (i=nb-2;i>=0;i--)
     {
         u*=u;
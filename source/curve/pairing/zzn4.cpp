@@ -64,6 +64,9 @@ ZZn4& ZZn4::powq(const ZZn2 &m)
     return *this;
 }
 
+zzn4* ZZn4::getzzn4(void) const
+         { return (zzn4 *)&fn;}
+
 void ZZn4::get(ZZn2& x,ZZn2& y) const  
 {zzn2_copy((zzn2 *)&fn.a,x.getzzn2()); zzn2_copy((zzn2 *)&fn.b,y.getzzn2());} 
 
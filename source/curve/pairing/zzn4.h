@@ -181,6 +181,8 @@ public:
     friend ostream& operator<<(ostream&,const ZZn4&);
 #endif
 
+    zzn4* getzzn4(void) const;
+
     ~ZZn4()  
 	{
 #ifndef ZZNS  
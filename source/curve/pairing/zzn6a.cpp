@@ -141,6 +141,46 @@ ZZn6& ZZn6::operator*=(const ZZn6& x)
  }
  else
  { // Karatsuba
+#ifndef MR_NO_LAZY_REDUCTION
+// Lazy reduction - the six products are combined unreduced, and only the
+// three results reduced
+    zzn2 Z[6];
+    ZZn2 T0,T1;
+    char *mem=zzn2_double_memalloc(6,Z);
+
+    zzn2_double_mul(a.getzzn2(),x.a.getzzn2(),&Z[0]);
+    zzn2_double_mul(b.getzzn2(),x.b.getzzn2(),&Z[2]);
+    zzn2_double_mul(c.getzzn2(),x.c.getzzn2(),&Z[4]);
+
+    zzn2_add(a.getzzn2(),b.getzzn2(),T0.getzzn2());
+    zzn2_add(x.a.getzzn2(),x.b.getzzn2(),T1.getzzn2());
+    zzn2_double_mul(T0.getzzn2(),T1.getzzn2(),&Z[1]);
+    zzn2_double_sub(&Z[1],&Z[0],&Z[1]);
+    zzn2_double_sub(&Z[1],&Z[2],&Z[1]);
+
+    zzn2_add(b.getzzn2(),c.getzzn2(),T0.getzzn2());
+    zzn2_add(x.b.getzzn2(),x.c.getzzn2(),T1.getzzn2());
+    zzn2_double_mul(T0.getzzn2(),T1.getzzn2(),&Z[3]);
+    zzn2_double_sub(&Z[3],&Z[2],&Z[3]);
+    zzn2_double_sub(&Z[3],&Z[4],&Z[3]);
+
+    zzn2_add(a.getzzn2(),c.getzzn2(),T0.getzzn2());
+    zzn2_add(x.a.getzzn2(),x.c.getzzn2(),T1.getzzn2());
+    zzn2_double_mul(T0.getzzn2(),T1.getzzn2(),&Z[5]);
+    zzn2_double_add(&Z[2],&Z[5],&Z[2]);
+    zzn2_double_sub(&Z[2],&Z[0],&Z[2]);
+    zzn2_double_sub(&Z[2],&Z[4],&Z[2]);
+
+    zzn2_double_txx(&Z[3]);
+    zzn2_double_add(&Z[0],&Z[3],&Z[0]);
+    zzn2_double_txx(&Z[4]);
+    zzn2_double_add(&Z[1],&Z[4],&Z[1]);
+
+    zzn2_redc(&Z[0],a.getzzn2());
+    zzn2_redc(&Z[1],b.getzzn2());
+    zzn2_redc(&Z[2],c.getzzn2());
+    memkill(mem,4*6);
+#else
     ZZn2 Z0,Z1,Z2,Z3,Z4,T0,T1;
     Z0=a*x.a;
     Z2=b*x.b;
@@ -165,6 +205,7 @@ ZZn6& ZZn6::operator*=(const ZZn6& x)
     a=Z0+txx(Z3);
     b=Z1+txx(Z4);
     c=Z2;
+#endif
 
 	if (!x.unitary) unitary=FALSE;
  }
@@ -87,6 +87,22 @@ ZZn8& ZZn8::operator*=(const ZZn8& x)
     }
     else 
     {
+#ifndef MR_NO_LAZY_REDUCTION
+// Lazy reduction - only the two results are reduced
+        zzn4 Z[3];
+        char *mem=zzn4_double_memalloc(3,Z);
+        ZZn4 t=a; t+=b;
+        ZZn4 t2=a; t2+=tx(b);
+        zzn4_double_mul(t.getzzn4(),t2.getzzn4(),&Z[0]);
+        zzn4_double_mul(b.getzzn4(),a.getzzn4(),&Z[1]);
+        zzn4_double_sub(&Z[0],&Z[1],&Z[0]);
+        zzn4_double_add(&Z[1],&Z[1],&Z[2]);
+        zzn4_double_tx(&Z[1]);
+        zzn4_double_sub(&Z[0],&Z[1],&Z[0]);
+        zzn4_redc(&Z[0],a.getzzn4());
+        zzn4_redc(&Z[2],b.getzzn4());
+        memkill(mem,8*3);
+#else
         ZZn4 t=a; t+=b;
         ZZn4 t2=a; t2+=tx(b);
         t*=t2;
@@ -95,15 +111,34 @@ ZZn8& ZZn8::operator*=(const ZZn8& x)
         t-=tx(b);
         b+=b;
         a=t;
+#endif
     }
  }
  else
  {
+#ifndef MR_NO_LAZY_REDUCTION
+// Lazy reduction - only the two results are reduced
+    zzn4 Z[3];
+    char *mem=zzn4_double_memalloc(3,Z);
+    ZZn4 s=a; s+=b;
+    ZZn4 t=x.a; t+=x.b;
+    zzn4_double_mul(a.getzzn4(),x.a.getzzn4(),&Z[0]);
+    zzn4_double_mul(b.getzzn4(),x.b.getzzn4(),&Z[1]);
+    zzn4_double_mul(s.getzzn4(),t.getzzn4(),&Z[2]);
+    zzn4_double_sub(&Z[2],&Z[0],&Z[2]);
+    zzn4_double_sub(&Z[2],&Z[1],&Z[2]);
+    zzn4_double_tx(&Z[1]);
+    zzn4_double_add(&Z[0],&Z[1],&Z[0]);
+    zzn4_redc(&Z[0],a.getzzn4());
+    zzn4_redc(&Z[2],b.getzzn4());
+    memkill(mem,8*3);
+#else
     ZZn4 ac=a; ac*=x.a;
     ZZn4 bd=b; bd*=x.b;
     ZZn4 t=x.a; t+=x.b;
     b+=a; b*=t; b-=ac; b-=bd;
     a=ac; a+=tx(bd);
+#endif
 
     if (!x.unitary) unitary=FALSE;
  }
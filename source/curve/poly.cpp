@@ -1,13 +1,17 @@
 /*
- * C++ class to implement a polynomial type and to allow 
+ * C++ class to implement a polynomial type and to allow
  * arithmetic on polynomials whose elements are from
  * the finite field mod p
  *
  * WARNING: This class has been cobbled together for a specific use with
- * the MIRACL library. It is not complete, and may not work in other 
+ * the MIRACL library. It is not complete, and may not work in other
  * applications
  *
- * See Knuth The Art of Computer Programming Vol.2, Chapter 4.6 
+ * The coefficients are stored densely in a single block of memory, so
+ * arithmetic works directly on them, and the FFT routines in mrfast.c are
+ * passed the coefficient array as it is.
+ *
+ * See Knuth The Art of Computer Programming Vol.2, Chapter 4.6
  */
 
 #include "poly.h"
@@ -15,18 +19,83 @@
 #include <iostream>
 using namespace std;
 
-Poly::Poly(const ZZn& c,int p)
+// make room for at least m coefficients, and extend to m
+// coefficients if necessary - new ones are zero
+
+void Poly::resize(int m)
+{
+    int i,newcap;
+    char *newmem;
+    big *newc;
+    if (m>cap)
+    {
+        newcap=2*cap;
+        if (newcap<m) newcap=m;
+        newmem=(char *)memalloc(newcap);
+        newc=(big *)mr_alloc(newcap,sizeof(big));
+        for (i=0;i<newcap;i++) newc[i]=mirvar_mem(newmem,i);
+        for (i=0;i<n;i++) copy(c[i],newc[i]);
+        if (mem!=NULL)
+        {
+            memkill(mem,cap);
+            mr_free(c);
+        }
+        mem=newmem;
+        c=newc;
+        cap=newcap;
+    }
+    if (m>n) n=m;
+}
+
+// remove leading zero coefficients
+
+void Poly::trim()
+{
+    while (n>0 && size(c[n-1])==0) n--;
+}
+
+void Poly::clear()
 {
-    start=NULL;
-    addterm(c,p);
+    int i;
+    for (i=0;i<n;i++) zero(c[i]);
+    n=0;
+}
+
+Poly::Poly(const ZZn& a,int p)
+{
+    n=cap=0; c=NULL; mem=NULL;
+    addterm(a,p);
 }
 
 Poly::Poly(Variable &x)
 {
-    start=NULL;
+    n=cap=0; c=NULL; mem=NULL;
     addterm((ZZn)1,1);
 }
 
+Poly::Poly(const Poly& p)
+{
+    n=cap=0; c=NULL; mem=NULL;
+    *this=p;
+}
+
+// free all memory - the polynomial becomes zero
+
+void Poly::release()
+{
+    if (mem!=NULL)
+    {
+        memkill(mem,cap);
+        mr_free(c);
+    }
+    n=cap=0; c=NULL; mem=NULL;
+}
+
+Poly::~Poly()
+{
+    release();
+}
+
 Poly operator-(const Poly& a)
 {
     Poly p=a;
@@ -60,12 +129,10 @@ BOOL operator!=(const Poly& a,const Poly& b)
     return TRUE;
 }
 
-void setpolymod(const Poly& p) 
-{ 
+void setpolymod(const Poly& p)
+{
     int n,m;
     Poly h;
-    term *ptr;
-    big *f,*rf;
     n=degree(p);
     if (n<FFT_BREAK_EVEN) return;
     h=reverse(p);
@@ -73,117 +140,61 @@ void setpolymod(const Poly& p)
     h=reverse(h);   // h=RECIP(f)
     m=degree(h);
     if (m<n-1) h=mulxn(h,n-1-m);
+    h.resize(n+1);
 
-    f=(big *)mr_alloc(n+1,sizeof(big));
-    rf=(big *)mr_alloc(n+1,sizeof(big));
- 
-    ptr=p.start;
-    while (ptr!=NULL)
-    {
-       f[ptr->n]=getbig(ptr->an);
-       ptr=ptr->next;
-    }   
-    ptr=h.start;
-    while (ptr!=NULL)
-    {
-       rf[ptr->n]=getbig(ptr->an);
-       ptr=ptr->next;
-    }   
- 
-    mr_polymod_set(n,rf,f);
-
-    mr_free(rf);
-    mr_free(f);
-}
-
-Poly::Poly(const Poly& p)
-{
-    term *ptr=p.start;
-    term *pos=NULL;
-    start=NULL;
-    while (ptr!=NULL)
-    {  
-        pos=addterm(ptr->an,ptr->n,pos);
-        ptr=ptr->next;
-    }    
-}
-
-
-Poly::~Poly()
-{
-   term *nx;
-   while (start!=NULL)
-   {   
-       nx=start->next;
-       delete start;
-       start=nx;
-   }
+    mr_polymod_set(n,h.c,p.c);
 }
 
 ZZn Poly::coeff(int power)  const
 {
-    ZZn c=0;
-    term *ptr=start;
-    while (ptr!=NULL)
-    {
-        if (ptr->n==power)
-        {
-            c=ptr->an;
-            return c;
-        }
-        ptr=ptr->next;
-    }
-    return c;
+    ZZn r=0;
+    if (power>=0 && power<n) r=c[power];
+    return r;
 }
 
 ZZn Poly::F(const ZZn& x) const
 {
     ZZn f=0;
-    int diff;
-    term *ptr=start;
+    int i;
 
 // Horner's rule
 
-    if (ptr==NULL) return f;
-    f=ptr->an;
-
-    while (ptr->next!=NULL)
+    if (n==0) return f;
+    f=c[n-1];
+    for (i=n-2;i>=0;i--)
     {
-        diff=ptr->n-ptr->next->n;
-        if (diff==1) f=f*x+ptr->next->an;
-        else         f=f*pow(x,diff)+ptr->next->an;    
-        ptr=ptr->next;
+        f*=x;
+        nres_modadd(getbig(f),c[i],getbig(f));
     }
-    f*=pow(x,ptr->n);
-
     return f;
 }
 
 ZZn Poly:: min() const
-{
-    term *ptr=start;
-    if (start==NULL) return (ZZn)0;
-    
-    while (ptr->next!=NULL) ptr=ptr->next;
-    return (ptr->an);
+{ // lowest non-zero coefficient
+    int i;
+    ZZn r=0;
+    for (i=0;i<n;i++) if (size(c[i])!=0)
+    {
+        r=c[i];
+        break;
+    }
+    return r;
 }
 
 Poly compose(const Poly& g,const Poly& b,const Poly& m)
 { // compose polynomials
   // assume G(x) = G3x^3 + G2x^2 + G1x^1 +G0
-  // Calculate G(B(x) = G3.(B(x))^3 + G2.(B(x))^2 ....   
-    Poly c,t;  
-    term *ptr;
+  // Calculate G(B(x) = G3.(B(x))^3 + G2.(B(x))^2 ....
+    Poly c,t;
     int i,d=degree(g);
     Poly *table=new Poly[d+1];
     table[0].addterm((ZZn)1,0);
     for (i=1;i<=d;i++) table[i]=(table[i-1]*b)%m;
-    ptr=g.start;
-    while (ptr!=NULL)
+    for (i=d;i>=0;i--)
     {
-        c+=ptr->an*table[ptr->n];
+        if (i>=g.n || size(g.c[i])==0) continue;
+        c+=g.coeff(i)*table[i];
         c=c%m;
-        ptr=ptr->next;
     }
     delete [] table;
     return c;
@@ -192,18 +203,16 @@ Poly compose(const Poly& g,const Poly& b,const Poly& m)
 Poly compose(const Poly& g,const Poly& b)
 { // compose polynomials
   // assume G(x) = G3x^3 + G2x^2 + G1x^1 +G0
-  // Calculate G(B(x) = G3.(B(x))^3 + G2.(B(x))^2 ....   
-    Poly c,t;  
-    term *ptr;
+  // Calculate G(B(x) = G3.(B(x))^3 + G2.(B(x))^2 ....
+    Poly c,t;
     int i,d=degree(g);
     Poly *table=new Poly[d+1];
     table[0].addterm((ZZn)1,0);
     for (i=1;i<=d;i++) table[i]=(table[i-1]*b);
-    ptr=g.start;
-    while (ptr!=NULL)
+    for (i=d;i>=0;i--)
     {
-        c+=ptr->an*table[ptr->n];
-        ptr=ptr->next;
+        if (i>=g.n || size(g.c[i])==0) continue;
+        c+=g.coeff(i)*table[i];
     }
     delete [] table;
     return c;
@@ -211,11 +220,7 @@ Poly compose(const Poly& g,const Poly& b)
 
 Poly reduce(const Poly &x,const Poly &m)
 {
-    Poly r;
-    int i,d;
-    ZZn t;
-    big *G,*R;
-    term *ptr,*pos=NULL;
+    Poly r,g;
     int degm=degree(m);
     int n=degree(x);
 
@@ -224,38 +229,14 @@ Poly reduce(const Poly &x,const Poly &m)
         r=x%m;
         return r;
     }
-    G=(big *)mr_alloc(n+1,sizeof(big));
-    char *memg=(char *)memalloc(n+1);
-    for (i=0;i<=n;i++) G[i]=mirvar_mem(memg,i);
-    R=(big *)mr_alloc(degm,sizeof(big));
-    char *memr=(char *)memalloc(degm);
-    for (i=0;i<degm;i++) R[i]=mirvar_mem(memr,i);
-
-    ptr=x.start;
-    while (ptr!=NULL)
-    {
-        copy(getbig(ptr->an),G[ptr->n]);
-        ptr=ptr->next; 
-    }
-    if (!mr_poly_rem(n,G,R))
+    g=x;            // overwritten by mr_poly_rem()
+    r.resize(degm);
+    if (!mr_poly_rem(n,g.c,r.c))
     {  // reset the modulus - things have changed
         setpolymod(m);
-        mr_poly_rem(n,G,R);
+        mr_poly_rem(n,g.c,r.c);
     }
- 
-    r.clear();
-
-    for (d=degm-1;d>=0;d--)
-    {
-        t=R[d];
-        if (t.iszero()) continue;
-        pos=r.addterm(t,d,pos);
-    }
-    memkill(memr,degm);
-
-    mr_free(R);
-    memkill(memg,n+1);
-    mr_free(G);
+    r.trim();
 
     return r;
 }
@@ -269,126 +250,78 @@ Poly modmult(const Poly &x,const Poly &y,const Poly &m)
 
 Poly operator*(const Poly& a,const Poly& b)
 {
-    int i,d,dega,degb,deg;
+    int i,k,lo,hi,dega,degb,deg;
     BOOL squaring;
-    ZZn t;
     Poly prod;
-    term *iptr,*pos;
-    term *ptr=b.start;
+    big *rb;
 
+    if (a.n==0 || b.n==0) return prod;
     squaring=FALSE;
     if (&a==&b) squaring=TRUE;
 
-    dega=degree(a);
+    dega=a.n-1;
+    degb=b.n-1;
     deg=dega;
-    if (!squaring)
-    {
-        degb=degree(b);
-        if (degb<dega) deg=degb;
-    }
-    else degb=dega;
-    if (deg>=FFT_BREAK_EVEN)      /* deg is minimum - both must be more than FFT_BREAK_EVEN */
-    { // use fast methods 
-        big *A,*B,*C;
-        deg=dega+degb;     // degree of product
-   
-        A=(big *)mr_alloc(dega+1,sizeof(big));
-        if (!squaring) B=(big *)mr_alloc(degb+1,sizeof(big));        
-        C=(big *)mr_alloc(deg+1,sizeof(big));
-        char *memc=(char *)memalloc(deg+1);
-        for (i=0;i<=deg;i++) C[i]=mirvar_mem(memc,i);
-        ptr=a.start;
-        while (ptr!=NULL)
-        {
-            A[ptr->n]=getbig(ptr->an);
-            ptr=ptr->next;
-        }
-
-        if (!squaring)
-        {
-            ptr=b.start;
-            while (ptr!=NULL)
-            {
-                B[ptr->n]=getbig(ptr->an);
-                ptr=ptr->next;
-            }
-            mr_poly_mul(dega,A,degb,B,C);
-        }
-        else mr_poly_sqr(dega,A,C);
-        pos=NULL;
-        for (d=deg;d>=0;d--)
-        {
-            t=C[d];
-            if (t.iszero()) continue;
-            pos=prod.addterm(t,d,pos);
-        }
-        memkill(memc,deg+1);
-        mr_free(C);
-        mr_free(A);
-        if (!squaring) mr_free(B);
+    if (degb<dega) deg=degb;
+    prod.resize(dega+degb+1);
 
+    if (deg>=FFT_BREAK_EVEN)      /* deg is minimum - both must be more than FFT_BREAK_EVEN */
+    { // use fast methods
+        if (squaring) mr_poly_sqr(dega,a.c,prod.c);
+        else          mr_poly_mul(dega,a.c,degb,b.c,prod.c);
+        prod.trim();
         return prod;
     }
 
-    if (squaring)
-    { // squaring
-        pos=NULL;
-        while (ptr!=NULL)
-        { // diagonal terms
-            pos=prod.addterm(ptr->an*ptr->an,ptr->n+ptr->n,pos);
-            ptr=ptr->next;
-        }
-        ptr=b.start;
-        while (ptr!=NULL)
-        { // above the diagonal
-            iptr=ptr->next;
-            pos=NULL;
-            while (iptr!=NULL)
-            {
-                t=ptr->an*iptr->an;
-                pos=prod.addterm(t+t,ptr->n+iptr->n,pos);
-                iptr=iptr->next;
-            }
-            ptr=ptr->next; 
-        }
-    }
-    else while (ptr!=NULL)
+// each coefficient of the product is a dot product of a with b reversed,
+// which needs only one modular reduction
+
+    rb=(big *)mr_alloc(degb+1,sizeof(big));
+    for (i=0;i<=degb;i++) rb[i]=b.c[degb-i];
+    for (k=0;k<=dega+degb;k++)
     {
-        pos=NULL;
-        iptr=a.start;
-        while (iptr!=NULL)
-        {
-            pos=prod.addterm(ptr->an*iptr->an,ptr->n+iptr->n,pos);
-            iptr=iptr->next;
-        }
-        ptr=ptr->next;
+        lo=k-degb; if (lo<0) lo=0;
+        hi=k;      if (hi>dega) hi=dega;
+        nres_dotprod(hi-lo+1,&a.c[lo],&rb[degb-k+lo],prod.c[k]);
     }
+    mr_free(rb);
+    prod.trim();
 
     return prod;
 }
 
-Poly& Poly::operator%=(const Poly&v)
+// Long division of r by v. r is replaced by the remainder,
+// and the quotient is returned in q, if not NULL
+
+static void longdiv(Poly& r,const Poly& v,Poly *q)
 {
-    ZZn m,pq;
-    int power;
-    term *rptr=start;
-    term *vptr=v.start;
-    term *ptr,*pos;
-    if (degree(*this)<degree(v)) return *this;
-    m=-((ZZn)1/vptr->an);
-    while (rptr!=NULL && rptr->n>=vptr->n)
+    int i,j,dv=v.n-1;
+    ZZn m,t,w;
+    if (r.n<v.n) return;
+    m=(ZZn)1/v.coeff(dv);
+    if (q!=NULL) q->resize(r.n-dv);
+    for (i=r.n-1;i>=dv;i--)
     {
-        pq=rptr->an*m;
-        power=rptr->n-vptr->n;
-        pos=NULL;
-        ptr=v.start;
-        while (ptr!=NULL)
+        if (size(r.c[i])==0) continue;
+        nres_modmult(r.c[i],getbig(m),getbig(t));
+        if (q!=NULL) copy(getbig(t),q->c[i-dv]);
+        nres_negate(getbig(t),getbig(t));
+        for (j=0;j<dv;j++)
         {
-            pos=addterm(ptr->an*pq,ptr->n+power,pos);
-            ptr=ptr->next;
-        } 
-        rptr=start;
+            nres_modmult(v.c[j],getbig(t),getbig(w));
+            nres_modadd(r.c[i-dv+j],getbig(w),r.c[i-dv+j]);
+        }
+        zero(r.c[i]);
     }
+    r.n=dv;
+    r.trim();
+    if (q!=NULL) q->trim();
+}
+
+Poly& Poly::operator%=(const Poly&v)
+{
+    if (degree(*this)<degree(v)) return *this;
+    longdiv(*this,v,NULL);
     return *this;
 }
 
@@ -404,91 +337,37 @@ Poly operator%(const Poly& u,const Poly&v)
 Poly divrem(Poly &r,const Poly& v)
 {
     Poly q;
-	ZZn m;
-    term *rptr=r.start;
-    term *vptr=v.start;
-    term *ptr,*pos;
-	m=((ZZn)1/vptr->an);
-    while (rptr!=NULL && rptr->n>=vptr->n)
-    {
-        Poly t=v;
-        ZZn pq=m*rptr->an;
-        int power=rptr->n-vptr->n;
-  // quotient
-        q.addterm(pq,power);
-        t.multerm(-pq,power);
-        ptr=t.start;
-        pos=NULL;
-        while (ptr!=NULL)
-        {
-            pos=r.addterm(ptr->an,ptr->n,pos);
-            ptr=ptr->next;
-        } 
-        rptr=r.start;
-    }
+    longdiv(r,v,&q);
     return q;
 }
 
 Poly operator/(const Poly& u,const Poly& v)
 {
     Poly q,r=u;
-	ZZn m;
-    term *rptr=r.start;
-    term *vptr=v.start;
-    term *ptr,*pos;
-	m=((ZZn)1/vptr->an);
-    while (rptr!=NULL && rptr->n>=vptr->n)
-    {
-        Poly t=v;
-        ZZn pq=m*rptr->an;
-        int power=rptr->n-vptr->n;
-  // quotient
-        q.addterm(pq,power);
-        t.multerm(-pq,power);
-        ptr=t.start;
-        pos=NULL;
-        while (ptr!=NULL)
-        {
-            pos=r.addterm(ptr->an,ptr->n,pos);
-            ptr=ptr->next;
-        } 
-        rptr=r.start;
-    }
+    longdiv(r,v,&q);
     return q;
 }
 
 Poly diff(const Poly& f)
 {
-   Poly d;
-   term *pos=NULL;
-   term *ptr=f.start;
-   while (ptr!=NULL)
-   {
-       pos=d.addterm(ptr->an*ptr->n,ptr->n-1,pos);
-       ptr=ptr->next;
-   }
-
-   return d;
+    return differentiate(f);
 }
 
 Poly gcd(const Poly& f,const Poly& g)
 {
     Poly a,b;
     a=f; b=g;
-    term *ptr;
     forever
     {
-        if (b.start==NULL)
+        if (b.n==0)
         {
-            ptr=a.start;
-            a.multerm((ZZn)1/ptr->an,0);
+            makemonic(a);
             return a;
         }
         a%=b;
-        if (a.start==NULL)
+        if (a.n==0)
         {
-            ptr=b.start;
-            b.multerm((ZZn)1/ptr->an,0);
+            makemonic(b);
             return b;
         }
         b%=a;
@@ -520,7 +399,7 @@ Poly pow(const Poly& f,int k)
            e-=w;
            u=(u*f);
         }
-        w/=2; 
+        w/=2;
     }
     return u;
 }
@@ -530,7 +409,7 @@ Poly pow(const Poly& f,const Big& k,const Poly& m)
     Poly u,t,u2,table[16];
     Big w,e;
     int i,j,nb,n,nbw,nzs;
-    if (k==0) 
+    if (k==0)
     {
         u.addterm((ZZn)1,0);
         return u;
@@ -547,7 +426,7 @@ Poly pow(const Poly& f,const Big& k,const Poly& m)
             table[i]=modmult(u2,table[i-1],m);
         nb=bits(k);
         if (nb>1) for (i=nb-2;i>=0;)
-        { 
+        {
             n=window(k,i,&nbw,&nzs,5);
             for (j=0;j<nbw;j++)
                 u=modmult(u,u,m);
@@ -556,7 +435,7 @@ Poly pow(const Poly& f,const Big& k,const Poly& m)
             if (nzs)
             {
                 for (j=0;j<nzs;j++) u=modmult(u,u,m);
-                i-=nzs;  
+                i-=nzs;
             }
         }
 
@@ -577,26 +456,26 @@ Poly pow(const Poly& f,const Big& k,const Poly& m)
             }
             w/=2;
         }
-    } 
+    }
     return u;
 }
 
 int degree(const Poly& p)
 {
-    if (p.start==NULL) return 0;
-    else return p.start->n;
+    if (p.n==0) return 0;
+    else return p.n-1;
 }
 
 
-BOOL iszero(const Poly& p) 
+BOOL iszero(const Poly& p)
 {
-    if (degree(p)==0 && p.coeff(0)==0) return TRUE;
+    if (p.n==0) return TRUE;
     else return FALSE;
 }
 
 BOOL isone(const Poly& p)
 {
-    if (degree(p)==0 && p.coeff(0)==1) return TRUE;
+    if (p.n==1 && mr_compare(p.c[0],get_mip()->one)==0) return TRUE;
     else return FALSE;
 }
 
@@ -631,18 +510,6 @@ Poly factor(const Poly& f,int d)
     return g;
 }
 
-void Poly::clear()
-{
-    term *ptr;
-    while (start!=NULL)
-    {   
-       ptr=start->next;
-       delete start;
-       start=ptr;
-    }
-    
-}
-
 Poly& Poly::operator=(int m)
 {
     clear();
@@ -659,14 +526,11 @@ Poly& Poly::operator=(const ZZn& m)
 
 Poly &Poly::operator=(const Poly& p)
 {
-    term *ptr,*pos=NULL;
+    int i;
+    if (this==&p) return *this;
     clear();
-    ptr=p.start;
-    while (ptr!=NULL)
-    {  
-        pos=addterm(ptr->an,ptr->n,pos);
-        ptr=ptr->next;
-    }    
+    resize(p.n);
+    for (i=0;i<p.n;i++) copy(p.c[i],c[i]);
     return *this;
 }
 
@@ -703,24 +567,22 @@ Poly operator-(const Poly& a,const Poly& b)
 
 Poly& Poly::operator+=(const Poly& p)
 {
-    term *ptr,*pos=NULL;
-    ptr=p.start;
-    while (ptr!=NULL)
-    {  
-        pos=addterm(ptr->an,ptr->n,pos);
-        ptr=ptr->next;
-    }    
+    int i;
+    if (p.n>n) resize(p.n);
+    for (i=0;i<p.n;i++) nres_modadd(c[i],p.c[i],c[i]);
+    trim();
     return *this;
 }
 
 Poly& Poly::operator*=(const ZZn& x)
 {
-    term *ptr=start;
-    while (ptr!=NULL)
+    int i;
+    if (x.iszero())
     {
-        ptr->an*=x;
-        ptr=ptr->next;
+        clear();
+        return *this;
     }
+    for (i=0;i<n;i++) nres_modmult(c[i],x.getzzn(),c[i]);
     return *this;
 }
 
@@ -749,36 +611,32 @@ Poly operator/(const Poly& a,const ZZn& b)
 Poly& Poly::operator/=(const ZZn& x)
 {
     ZZn t=(ZZn)1/x;
-    term *ptr=start;
-    while (ptr!=NULL)
-    {
-        ptr->an*=t;
-        ptr=ptr->next;
-    }
+    *this*=t;
     return *this;
 }
 
 Poly& Poly::operator-=(const Poly& p)
 {
-    term *ptr,*pos=NULL;
-    ptr=p.start;
-    while (ptr!=NULL)
-    {  
-        pos=addterm(-(ptr->an),ptr->n,pos);
-        ptr=ptr->next;
-    }    
+    int i;
+    if (p.n>n) resize(p.n);
+    for (i=0;i<p.n;i++) nres_modsub(c[i],p.c[i],c[i]);
+    trim();
     return *this;
 }
- 
+
+// multiply by a.x^power
+
 void Poly::multerm(const ZZn& a,int power)
 {
-    term *ptr=start;
-    while (ptr!=NULL)
+    int i,m=n;
+    if (n==0) return;
+    if (power>0)
     {
-        ptr->an*=a;
-        ptr->n+=power;
-        ptr=ptr->next;
+        resize(n+power);
+        for (i=m-1;i>=0;i--) copy(c[i],c[i+power]);
+        for (i=0;i<power;i++) zero(c[i]);
     }
+    if (mr_compare(a.getzzn(),get_mip()->one)!=0) *this*=a;
 }
 
 Poly invmodxn(const Poly& a,int n)
@@ -795,153 +653,73 @@ Poly invmodxn(const Poly& a,int n)
 Poly modxn(const Poly& a,int n)
 { // reduce polynomial mod x^n
     Poly b;
-    term* ptr=a.start;
-    term *pos=NULL;
-    while (ptr!=NULL && ptr->n>=n) ptr=ptr->next;
-    while (ptr!=NULL)
-    {
-        pos=b.addterm(ptr->an,ptr->n,pos);
-        ptr=ptr->next;
-    }
+    int i;
+    if (n>a.n) n=a.n;
+    if (n<=0) return b;
+    b.resize(n);
+    for (i=0;i<n;i++) copy(a.c[i],b.c[i]);
+    b.trim();
     return b;
 }
 
 Poly divxn(const Poly& a,int n)
 { // divide polynomial by x^n
     Poly b;
-    term *ptr=a.start;
-    term *pos=NULL;
-    while (ptr!=NULL)
-    {
-        if (ptr->n>=n)
-            pos=b.addterm(ptr->an,ptr->n-n,pos);
-        else break;
-        ptr=ptr->next;
-    }
+    int i;
+    if (a.n<=n) return b;
+    b.resize(a.n-n);
+    for (i=n;i<a.n;i++) copy(a.c[i],b.c[i-n]);
     return b;
 }
 
 Poly mulxn(const Poly& a,int n)
 { // multiply polynomial by x^n
     Poly b;
-    term *ptr=a.start;
-    term *pos=NULL;
-    while (ptr!=NULL)
-    {
-        pos=b.addterm(ptr->an,ptr->n+n,pos);
-        ptr=ptr->next;
-    }
+    int i;
+    if (a.n==0) return b;
+    b.resize(a.n+n);
+    for (i=0;i<a.n;i++) copy(a.c[i],b.c[i+n]);
     return b;
 }
 
 Poly reverse(const Poly& a)
 {
-    term *ptr=a.start;
-    int deg=degree(a);
+    int i,deg=degree(a);
     Poly b;
-    while (ptr!=NULL)
-    {
-        b.addterm(ptr->an,deg-ptr->n);
-        ptr=ptr->next;
-    } 
+    if (a.n==0) return b;
+    b.resize(deg+1);
+    for (i=0;i<=deg;i++) copy(a.c[i],b.c[deg-i]);
+    b.trim();
     return b;
 }
 
-// add term to polynomial. The pointer pos remembers the last
-// accessed element - this is faster. 
-// Polynomial is stored with large powers first, down to low powers
-// e.g. 9x^6 + x^4 + 3x^2 + 1
+// add term to polynomial. The pointer pos is no longer needed, as
+// terms are found directly, and is returned unchanged
 
 term* Poly::addterm(const ZZn& a,int power,term *pos)
 {
-    term* newone;  
-    term* ptr;
-    term *t,*iptr;
-    ptr=start;
-    iptr=NULL;
-    if (a.iszero()) return pos;
-// quick scan through to detect if term exists already
-// and to find insertion point
-    if (pos!=NULL) ptr=pos;      // start looking from here
-    while (ptr!=NULL) 
-    { 
-        if (ptr->n==power)
-        {
-            ptr->an+=a;
-            if (ptr->an.iszero()) 
-            { // delete term
-                if (ptr==start)
-                { // delete first one
-                    start=ptr->next;
-                    delete ptr;
-                    return start;
-                }
-                iptr=ptr;
-                ptr=start;
-                while (ptr->next!=iptr)ptr=ptr->next;
-                ptr->next=iptr->next;
-                delete iptr;
-                return ptr;
-            }
-            return ptr;
-        }
-        if (ptr->n>power) iptr=ptr;
-        else break;
-        ptr=ptr->next;
-    }
-    newone=new term;
-    newone->next=NULL;
-    newone->an=a;
-    newone->n=power;
-    pos=newone;
-    if (start==NULL)
-    {
-        start=newone;
-        return pos;
-    }
-
-// insert at the start
-
-    if (iptr==NULL)
-    { 
-        t=start;
-        start=newone;
-        newone->next=t;
-        return pos;
-    }
-
-// insert new term
-
-    t=iptr->next;
-    iptr->next=newone;
-    newone->next=t;
-    return pos;    
+    if (a.iszero() || power<0) return pos;
+    if (power>=n) resize(power+1);
+    nres_modadd(c[power],a.getzzn(),c[power]);
+    if (power==n-1) trim();
+    return pos;
 }
 
 // A function to differentiate a polynomial
 Poly differentiate(const Poly& orig)
 {
     Poly newpoly;
-    term *ptr = orig.start;
-    term *pos = NULL;
-    int power;
-
-    while (ptr!=NULL)
-    {   
-        power = ptr->n;
-        if(ptr->n > 0) 
-            pos = newpoly.addterm(ptr->an*power,ptr->n-1,pos);
-            
-        ptr = ptr->next;
-    }
-    
+    int i;
+    if (orig.n<=1) return newpoly;
+    newpoly.resize(orig.n-1);
+    for (i=1;i<orig.n;i++) nres_premult(orig.c[i],i,newpoly.c[i-1]);
+    newpoly.trim();
     return newpoly;
 }
 
 ZZn makemonic(Poly& p)
 {
-    term *ptr = p.start;
-	ZZn r=(ZZn)1/ptr->an;
+	ZZn r=(ZZn)1/p.coeff(p.n-1);
     p.multerm(r,0);
 	return r;
 }
@@ -951,14 +729,12 @@ ZZn makemonic(Poly& p)
 Poly inverse(Poly &u,const Poly&v)
 {
     Poly u1, u3, v1, v3, zero, q;
-	int t=0;
-    u1 = 1;  
+    u1 = 1;
     u3 = u;
     v1 = 0;
     v3 = v;
     zero = 0;
-    term *ptr;
-     
+
 	forever
 	{
 		if (v3==zero)
@@ -985,7 +761,7 @@ Poly inverse(Poly &u,const Poly&v)
 		v1 -=  u1*q;
 
 //cout << "tock " << t++ << " u3= " << degree(u3) << endl;
-	
+
 	}
 
 }
@@ -994,18 +770,16 @@ Poly inverse(Poly &u,const Poly&v)
 // The result is returned in an array of Polys, with the gcd
 // in first place, then the two coefficients
 void egcd(Poly result[], const Poly& u, const Poly& v)
-{       
+{
     Poly u1, u2, u3, v1, v2, v3, zero, q;
-	int t=0;
-    u1 = 1;  
+    u1 = 1;
     u2 = 0;
     u3 = u;
     v1 = 0;
     v2 = 1;
     v3 = v;
     zero = 0;
-    term *ptr;
-     
+
 	forever
 	{
 		if (v3==zero)
@@ -1026,12 +800,12 @@ void egcd(Poly result[], const Poly& u, const Poly& v)
 			result[1] = v1;
 			result[2] = v2;
 			break;
-		}	
+		}
 		q=v3/u3;
 		v1 -=  u1*q;
         v2 -=  u2*q;
         v3 -=  u3*q;
-	
+
 	}
 
 }
@@ -1040,35 +814,34 @@ ostream& operator<<(ostream& s,const Poly& p)
 {
     BOOL first=TRUE;
     ZZn a;
-    term *ptr=p.start;
-    if (ptr==NULL)
-    { 
+    int i;
+    if (p.n==0)
+    {
         s << "0";
         return s;
     }
-    while (ptr!=NULL)
+    for (i=p.n-1;i>=0;i--)
     {
-        a=ptr->an;
+        if (size(p.c[i])==0) continue;
+        a=p.c[i];
         if ((Big)a<get_modulus()/2)
         {
             if (!first) s << " + ";
         }
-        else 
+        else
         {
            a=(-a);
            s << " - ";
         }
-        if (ptr->n==0) 
-           s << (Big)a; 
-        else 
+        if (i==0)
+           s << (Big)a;
+        else
         {
-            if (a!=(ZZn)1)  s << (Big)a << "*x"; 
+            if (a!=(ZZn)1)  s << (Big)a << "*x";
             else            s << "x";
-            if (ptr->n!=1)  s << "^" << ptr->n;
+            if (i!=1)  s << "^" << i;
         }
         first=FALSE;
-        ptr=ptr->next;
     }
     return s;
-} 
-
+}
@@ -23,25 +23,32 @@
 
 #define FFT_BREAK_EVEN 16
 
-class term
-{
-public:
-    ZZn an;
-    int n;
-    term *next;
-};
+// Coefficients are held densely, c[i] being the coefficient of x^i, and
+// all in one block of bigs from memalloc(). So the c array can be passed
+// straight to mr_poly_mul() etc. Coefficients beyond n-1 are always zero.
+// 
+// term is no longer used, other than in the now redundant position hint
+// of addterm(), kept for compatibility
+
+class term;
 
 class Poly
 {
 public:
-    term *start;
-    Poly() {start=NULL;}
+    int n;          // number of coefficients - 0 for zero polynomial
+    int cap;        // number allocated
+    big *c;
+    char *mem;
+    Poly() {n=cap=0; c=NULL; mem=NULL;}
     Poly(const Poly&);
 
     Poly(const ZZn&,int);
     Poly(Variable &);
 
     void clear();
+    void release();
+    void resize(int);
+    void trim();
     term *addterm(const ZZn&,int,term *pos=NULL);
     void multerm(const ZZn&,int);
     ZZn F(const ZZn&) const;
@@ -15,7 +15,7 @@
 
 #include "polymod.h"
 
-Poly Modulus;
+MR_POLY_TLS Poly Modulus;
   
 BOOL iszero(const PolyMod& m)     {return iszero(m.p);}
 BOOL isone(const PolyMod& m)      {return isone(m.p);}
@@ -40,11 +40,9 @@ ZZn PolyMod::coeff(int i) const {return p.coeff(i);}
 
 PolyMod& PolyMod::operator*=(const PolyMod &b)
 {
-    int i,m,deg,dega,degb,degm=degree(Modulus);
-    big *G,*B,*R;
+    int deg,dega,degb,degm=degree(Modulus);
     BOOL squaring;
-    term *ptr=p.start;
-    term *newone,*iptr;
+    Poly g;
 
     squaring=FALSE;
     if (this==&b) squaring=TRUE;
@@ -64,79 +62,23 @@ PolyMod& PolyMod::operator*=(const PolyMod &b)
         return *this;
     }
 
-    R=(big *)mr_alloc(degm,sizeof(big));
-  // pad out this to have zero terms
-    iptr=NULL;
-    m=degm-1;
-    do 
-    {
-        if (ptr==NULL || ptr->n!=m) 
-        {
-            newone=new term;
-            newone->next=ptr;
-            newone->an=(ZZn)0;
-            newone->n=m;
-            ptr=newone;
-            if (iptr==NULL) p.start=ptr=newone;
-            else iptr->next=ptr;
-        }
-        R[m]=getbig(ptr->an);
-        m--;
-        iptr=ptr;
-        ptr=ptr->next;
-    } while (m>=0);
+// pad out this to have degm coefficients, to receive the remainder
 
-    deg=dega+degb;
+    p.resize(degm);
 
-    if (!squaring) B=(big *)mr_alloc(degb+1,sizeof(big));
-    G=(big *)mr_alloc(deg+1,sizeof(big));
-    char *memg=(char *)memalloc(deg+1);
-    for (i=0;i<=deg;i++) G[i]=mirvar_mem(memg,i);
+    deg=dega+degb;
+    g.resize(deg+1);
 
-    if (!squaring)
-    {
-        ptr=b.p.start;
-        while (ptr!=NULL)
-        {
-            B[ptr->n]=getbig(ptr->an);
-            ptr=ptr->next;
-        }
-        mr_poly_mul(dega,R,degb,B,G);
-    }
-    else mr_poly_sqr(dega,R,G);
+    if (!squaring) mr_poly_mul(dega,p.c,degb,b.p.c,g.c);
+    else           mr_poly_sqr(dega,p.c,g.c);
 
-    if (!mr_poly_rem(deg,G,R))
+    if (!mr_poly_rem(deg,g.c,p.c))
     {  // reset the modulus - things have changed
         setmod(Modulus);
-        mr_poly_rem(deg,G,R);
-    }
-
-// now delete any 0 terms
-
-    ptr=p.start;
-    iptr=NULL;
-    while (ptr!=NULL)
-    {
-        if (ptr->an.iszero())
-        {
-            if (ptr==p.start)
-                p.start=ptr->next;
-            else
-                iptr->next=ptr->next;
-            newone=ptr;
-            ptr=ptr->next;
-            delete newone;
-            continue;
-        }
-        iptr=ptr;
-        ptr=ptr->next;
+        mr_poly_rem(deg,g.c,p.c);
     }
+    p.trim();
 
-    mr_free(R);
-    memkill(memg,deg+1);
-    mr_free(G);
-    if (!squaring) mr_free(B);
-            
     return *this;
 }
 
@@ -149,10 +91,7 @@ PolyMod operator*(const PolyMod &a,const PolyMod& b)
 
 void reduce(const Poly& p,PolyMod& rem)
 {
-    int i,d;
-    ZZn t;
-    big *G,*R;
-    term *ptr,*pos=NULL;
+    Poly g;
     int n=degree(p);
     int degm=degree(Modulus);
     if (n-degm < FFT_BREAK_EVEN)
@@ -160,38 +99,16 @@ void reduce(const Poly& p,PolyMod& rem)
         rem=(PolyMod)p;
         return;
     }
-    G=(big *)mr_alloc(n+1,sizeof(big));
-    char *memg=(char *)memalloc(n+1);
-    for (i=0;i<=n;i++) G[i]=mirvar_mem(memg,i);
-    R=(big *)mr_alloc(degm,sizeof(big));
-    char *memr=(char *)memalloc(degm);
-    for (i=0;i<degm;i++) R[i]=mirvar_mem(memr,i);
-
-    ptr=p.start;
-    while (ptr!=NULL)
-    {
-        copy(getbig(ptr->an),G[ptr->n]);
-        ptr=ptr->next; 
-    }
-    if (!mr_poly_rem(n,G,R))
-    {  // reset the Modulus - things have changed
-        setmod(Modulus);
-        mr_poly_rem(n,G,R);
-    }
+    g=p;            // overwritten by mr_poly_rem()
  
     rem.clear();
-
-    for (d=degm-1;d>=0;d--)
-    {
-        t=R[d];
-        if (t.iszero()) continue;
-        pos=rem.addterm(t,d,pos);
+    rem.p.resize(degm);
+    if (!mr_poly_rem(n,g.c,rem.p.c))
+    {  // reset the Modulus - things have changed
+        setmod(Modulus);
+        mr_poly_rem(n,g.c,rem.p.c);
     }
-    memkill(memr,degm);
-    mr_free(R);
-    memkill(memg,n+1);
-    mr_free(G);
-
+    rem.p.trim();
 }
 
 void setmod(const Poly& p) 
@@ -200,6 +117,13 @@ void setmod(const Poly& p)
     setpolymod(p);
 }
 
+void freemod()
+{ // release the Modulus and FFT tables. A thread must do this before its 
+  // miracl instance is closed
+    Modulus.release();
+    fft_reset();
+}
+
 PolyMod operator-(const PolyMod& a,const PolyMod& b)
                                      {return (a.p-b.p)%Modulus;}
 PolyMod operator+(const PolyMod& a,const PolyMod& b)
@@ -242,7 +166,6 @@ PolyMod compose(const PolyMod& q,const PolyMod& p)
   // Calculate P(Q(x)) = P3.(Q(x))^3 + P2.(Q(x))^2 ....   
     PolyMod C,Q,T; 
     big t; 
-    term *xptr,*yptr;
     int i,j,ik,L,n=degree(Modulus);
     int k=isqrt(n+1,1);
     if (k*k<n+1) k++;
@@ -266,36 +189,13 @@ PolyMod compose(const PolyMod& q,const PolyMod& p)
         for (L=0;L<=n;L++)
         {
             zero(t);
-            xptr=q.p.start;
-            while (xptr!=NULL) 
-            {
-                if (xptr->n<=ik+k-1) break;
-                xptr=xptr->next;
-            }
             for (j=k-1;j>=0;j--)
             {
                 x[j]=t;
-                if (xptr!=NULL)
-                {
-                    if (ik+j==xptr->n) 
-                    {
-                        x[j]=getbig(xptr->an);
-                        xptr=xptr->next;
-                    }
-                }                
-                              // x[j]=q.coeff(i*k+j)
+                if (ik+j<q.p.n) x[j]=q.p.c[ik+j];   // x[j]=q.coeff(i*k+j)
                 y[j]=t;
-                yptr=P[j].p.start;
-                while (yptr!=NULL)
-                {
-                    if (yptr->n<=L)
-                    {
-                        if (yptr->n==L) y[j]=getbig(yptr->an);
-                        break;
-                    }
-                    yptr=yptr->next;
-                }
-            }                // y[j]=P[j].coeff(L)
+                if (L<P[j].p.n) y[j]=P[j].p.c[L];   // y[j]=P[j].coeff(L)
+            }
 
 // Asymptotically slow, but very fast in practise ...
 
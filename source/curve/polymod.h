@@ -18,7 +18,15 @@
 
 #include "poly.h"
 
-extern Poly Modulus;
+// With multi-threading each thread has its own Modulus
+
+#ifdef MR_OS_THREADS
+#define MR_POLY_TLS thread_local
+#else
+#define MR_POLY_TLS
+#endif
+
+extern MR_POLY_TLS Poly Modulus;
 
 class PolyMod
 {
@@ -72,6 +80,7 @@ public:
 };
 
 extern void setmod(const Poly&);
+extern void freemod();
 
 #endif
 
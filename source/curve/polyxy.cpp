@@ -38,14 +38,11 @@ PolyXY::PolyXY(const PolyXY& p)
 
 PolyXY::PolyXY(const Poly& p)
 {
-    term *ptr=p.start;
+    int i;
     termXY *pos=NULL;
     start=NULL;
-    while (ptr!=NULL)
-    {
-        pos=addterm(ptr->an,ptr->n,0,pos);
-        ptr=ptr->next;
-    }
+    for (i=p.n-1;i>=0;i--)
+        pos=addterm(p.coeff(i),i,0,pos);
 }
 
 PolyXY::~PolyXY()
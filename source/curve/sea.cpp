@@ -216,6 +216,9 @@
 #include <iomanip>
 #include <fstream>
 #include <cstring>
+#include <cstdlib>
+#include <sstream>
+#include <ctime>
 #include "ecn.h"         // Elliptic Curve Class
 #include "crt.h"         // Chinese Remainder Theorem Class
 
@@ -235,8 +238,19 @@
 #include "polymod.h"
 #include "polyxy.h"
 
+#ifdef MR_OS_THREADS
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <chrono>
+#endif
+
 using namespace std;
 
+#ifdef MR_OS_THREADS
+static int threading=(mr_init_threading(),0);   // must precede the first Miracl
+#endif
+
 #ifndef MR_NOFULLWIDTH
 Miracl precision=18;            // max. 18x32 bits per big number
 #else
@@ -250,6 +264,32 @@ ZZn A,B;         // Here ZZn are integers mod the prime p
 
 BOOL Edwards=FALSE;
 
+#ifdef MR_OS_THREADS
+
+// wall clock time, as clock() would sum the time of all threads
+
+typedef chrono::steady_clock Clock;
+
+long elapsed(Clock::time_point start)
+{ // milliseconds since start
+    return (long)chrono::duration_cast<chrono::milliseconds>(Clock::now()-start).count();
+}
+
+#else
+
+struct Clock
+{
+    typedef clock_t time_point;
+    static time_point now() {return clock();}
+};
+
+long elapsed(Clock::time_point start)
+{ // milliseconds since start
+    return (long)((clock()-start)*1000/CLOCKS_PER_SEC);
+}
+
+#endif
+
 // Elliptic curve Point duplication formula
 
 void elliptic_dup(PolyMod& X,PolyMod& Y,PolyMod& Z)
@@ -657,23 +697,546 @@ int phi(int n)
     return r;
 }
 
+//
+// The curve data needed to process the Elkies and Atkin primes. With 
+// multiple threads it is shared, and must not change while they are working
+//
+
+struct Curve
+{
+    Big p;
+    ZZn j,delta,E4b,E6b;
+    Poly Y2,Y4;
+    BOOL search,atkin;
+};
+
+#define SEA_NONE 0     // nothing learnt from this prime
+#define SEA_INFO 1     // candidates for NP mod lp reported, but not used
+#define SEA_GOOD 2     // NP mod lp = p+1-tau
+
+//
+// Process the small prime lp, with modular polynomial Gl. Output goes to out, 
+// and progress is shown as well if show is TRUE. Any result line is left 
+// unterminated, so the caller can add the time taken
+//
+
+int process_prime(const Curve& cv,int lp,const PolyXY& Gl,BOOL show,ostream& out,int& tau,BOOL& escape)
+{
+    int jj,k,is,r,v,n,ld,ld1,discrim,lambda,lower;
+    Big p=cv.p;
+    ZZn j=cv.j,delta=cv.delta,E4b=cv.E4b,E6b=cv.E6b;
+    ZZn g,qb,qc,el,s,E0b,E0bd,E2bs,Dg,Dj,Dgd,Djd,Dgs,Djs,jl,jld,p1,jd;
+    ZZn E4bl,E6bl,deltal,atilde,btilde,gd,f,fd,Eg,Ej,Exy;
+    ZZn cf[500],cft[500],ad,RF;
+    PolyMod XX,XP,YP,MY2,MY4;     // local MY2, MY4 - the globals belong to Schoof's method 
+    PolyXY MP,dGx,dGy,dGxx,dGxy,dGyy;
+    Poly F,G,Fl,WP[500],H,X,Y;
+    term *pos;
+
+    k=p%lp;
+    for (is=1;;is++)
+        if (is*(lp-1)%12==0) break;
+
+    el=lp;
+    s=is;
+
+// Get next Modular Polynomial
+
+    MP=Gl;
+
+// Evaluate bivariate polynomial at Y=j-invariant
+// and use as polynomial modulus
+
+    F=MP.F(j);
+    setmod(F);
+    if (show) out << setw(3) << lp << flush;
+    XX=0;
+    XX.addterm((ZZn)1,1);
+    XP=pow(XX,p);
+//
+// Determine "Splitting type" 
+//
+    if (show) out << "\b\b\bGCD" << flush;
+    G=gcd(XP-XX);
+
+    if (degree(G)==lp+1) 
+    {
+        if (show) out << "\b\b\b" << flush;
+        return SEA_NONE;      // pathological case
+    }
+    if (degree(G)==0)  // Atkin Prime
+    {
+        if (!cv.atkin && lp>100)    // Don't process large Atkin Primes
+        {
+            if (show) out << "\b\b\b" << flush;
+            return SEA_NONE;
+        }
+        BOOL useful=FALSE;
+        if (show) out << "\b\b\b" << flush;
+        if (show) out << "ATK" << flush;
+
+        PolyMod u[20];
+        int max_r,lim=1;
+        u[0]=XP;  
+        u[1]=compose(u[0],u[0]);
+
+//
+// The code for processing Atkin Primes is in here, but currently largely 
+// unused. However the simplest case is used, as it suggests only one 
+// value for NP mod lp, and so can be used just like an Elkies prime
+// 
+//
+        if (cv.atkin) max_r=lp+1;
+        else         max_r=2;
+        for (r=2;r<=max_r;r++)
+        {
+            PolyMod C;
+            int kk,m;
+            BOOL first;
+            if ((lp+1)%r!=0) continue;    // only keep good ones!
+            v=jac(k,lp);     // check Schoof Prop. 6.3
+            jj=(lp+1)/r;
+            if (jj%2==0 && v==(-1)) continue;
+            if (jj%2==1 && v==1) continue;
+   //         if (phi(r)>8) continue;       // > 8 candidates
+   //         if (lp<30 && phi(r)>2) continue;
+   //         if (lp<60 && phi(r)>4) continue;
+            kk=r; m=0;
+            first=TRUE;
+//
+// Right-to-Left Power Composition - find X^(P^r)
+//
+            forever
+            {
+                if (kk%2!=0)
+                {
+                    if (first) C=u[m]; 
+                    else       C=compose(u[m],C);
+                    first=FALSE;
+                }
+                kk/=2;
+                if (kk==0) break;
+                m++;
+                if (m>lim) 
+                { // remember them for next time
+                    u[m]=compose(u[m-1],u[m-1]);
+                    lim=m;
+                }
+            }
+
+            if (iszero(C-XX)) 
+            { // found splitting type
+                useful=TRUE;
+                break;
+            }
+        }
+        if (show) out << "\b\b\b" << flush;
+        if (!useful) return SEA_NONE;
+
+        out << "NP mod " << lp << " = " << flush;
+
+        int a,b,candidates,gx,gy,ord,qnr=2;
+        BOOL gen;
+        while (jac(qnr,lp)!=(-1)) qnr++;
+
+//
+// [4] Algorithm VII.4 - find a generator of F(lp^2)
+//
+        ord=lp*lp-1;
+        gy=1;
+        for (gx=1;gx<lp;gx++)
+        {
+            gen=TRUE;
+            for (jj=2;jj<=ord/2;jj++)
+            {
+                if (ord%jj!=0) continue;
+                powquad(lp,qnr,gx,gy,ord/jj,a,b);
+                if (a==1 && b==0) {gen=FALSE; break;}
+            }
+            if (gen) break;
+        }
+//
+// (gx,gy) is a generator
+//
+        candidates=0;
+        out << setw(3);
+        for (jj=1;jj<r;jj++)
+        {
+            if (jj>1 && igcd(jj,r)!=1) continue;
+            powquad(lp,qnr,gx,gy,jj*ord/r,a,b);
+
+            tau=((a+1)*k*(int)invers(2,lp))%lp;
+            if (tau==0)
+            {           // r must be 2 - I can make use of this!
+                        // Its an Atkin prime, but only one possibility
+                out << (p+1)%lp << flush;
+                if ((p+1)%lp==0)
+                {
+                    out << " ***";
+                    if (cv.search && (!Edwards || lp!=4)) escape=TRUE;
+                }
+                return SEA_GOOD;
+            }
+            else if (jac(tau,lp)==1)
+            {
+                candidates+=2;
+                tau=sqrmp(tau,lp);
+                tau=(2*tau)%lp;
+                if (candidates==phi(r))
+                { 
+                     out << (p+1-tau)%lp << " or " << (p+1+tau)%lp;   
+                     break;
+                }
+                else out << (p+1-tau)%lp << "," << (p+1+tau)%lp << "," << flush;
+            }  
+        }
+        return SEA_INFO;  
+    }
+
+//
+// Good Elkies prime - so use it!
+//
+// First solve quadratic for a root
+//
+    if (degree(G)==1)
+    {
+        discrim=0; 
+        g=-G.coeff(0); // Elkies Prime, one root, (2 possibilites)   
+    }
+    else               // degree(G)==2
+    {                  // Elkies Prime, two roots
+        discrim=1;
+        qb=G.coeff(1);
+        qc=G.coeff(0); 
+        g=sqrt(qb*qb-4*qc);
+        g=(-qb-g)/2;   // pick either one
+    }
+    if (show) out << "\b\b\bELK" << flush;
+//
+// Mueller's procedure for finding the atilde, btilde and p1
+// parameters of the isogenous curve
+// 3. page 111
+// 4. page 131-133
+// First we need partial differentials of bivariate Modular Polynomial
+//
+
+    dGx=diff_dx(MP);
+    dGy=diff_dy(MP);
+    dGxx=diff_dx(dGx);
+    dGxy=diff_dx(dGy);
+    dGyy=diff_dy(dGy);
+
+    Eg=dGx.F(g,j);   // Evaluated at (g,j)
+    Ej=dGy.F(g,j);
+    Exy=dGxy.F(g,j);
+
+    Dg=g*Eg;    
+    Dj=j*Ej;
+
+    deltal=delta*pow(g,12/is)/pow(el,12);
+
+    if (Dj==0)
+    {
+        E4bl=E4b/(el*el);
+        atilde=-3*pow(el,4)*E4bl;
+        jl=pow(E4bl,3)/deltal;
+        btilde=2*pow(el,6)*sqrt((jl-1728)*deltal);
+        p1=0;
+    }
+    else
+    {
+        E2bs=(-12*E6b*Dj)/(s*E4b*Dg);
+
+        gd=-(s/12)*E2bs*g;
+        jd=-E4b*E4b*E6b/delta;
+        E0b=E6b/(E4b*E2bs); 
+
+        Dgd=gd*Eg+g*(gd*dGxx.F(g,j)+jd*Exy);
+        Djd=jd*Ej+j*(jd*dGyy.F(g,j)+gd*Exy);  
+
+        E0bd=((-s*Dgd)/12-E0b*Djd)/Dj;
+
+        E4bl=(E4b-E2bs*(12*E0bd/E0b+6*E4b*E4b/E6b-4*E6b/E4b)+E2bs*E2bs)/(el*el);
+
+        jl=pow(E4bl,3)/deltal;
+        f=pow(el,is)/g; fd=s*E2bs*f/12;
+
+        Dgs=dGx.F(f,jl);
+        Djs=dGy.F(f,jl);
+
+        jld=-fd*Dgs/(el*Djs);
+        E6bl=-E4bl*jld/jl;
+
+        atilde=-3*pow(el,4)*E4bl;
+        btilde=-2*pow(el,6)*E6bl;
+        p1=-el*E2bs/2;            
+    }
+
+//
+// Find factor of Division Polynomial from atilde, btilde and p1 
+// Here we follow 3. p 116
+// Polynomials have been modified s.t x=z^2
+//
+// Note that all Polynomials can be reduced mod x^(d+1),
+// where d=(lp-1)/2, using modxn() function
+//
+
+    if (show) out << "\b\b\bFAC" << flush;
+    ld=(lp-1)/2;
+    ld1=(lp-3)/2;
+
+    get_ck(ld1,A,B,cf);
+
+    WP[1]=1;
+    pos=NULL;
+    for (k=ld1;k>0;k--)
+       pos=WP[1].addterm(cf[k],k+1,pos);
+    for (v=2;v<=ld;v++)
+        WP[v]=modxn(WP[v-1]*WP[1],ld+1);
+//
+// WPv have understood multiplier x^-v
+//            
+    get_ck(ld1,atilde,btilde,cft);
+
+    Y=0;
+    pos=NULL;
+    for (k=ld1;k>0;k--)
+        pos=Y.addterm((lp*cf[k]-cft[k])/(ZZn)((2*k+1)*(2*k+2)),k+1,pos);
+    Y.addterm(-p1,1,pos);
+
+    RF=1;
+    H=1;
+    X=1;
+    for (r=1;r<=ld;r++)
+    {
+        X=modxn(X*Y,ld+1);
+        RF*=r;
+        H+=(X/RF);
+    }
+//
+//  H has understood multiplier x^-d
+//
+    ad=1;
+    Fl=0;
+    pos=Fl.addterm(ad,ld);
+    for (v=ld-1;v>=0;v--)
+    {
+        H-=ad*WP[v+1];
+        H=divxn(H,1);
+        ad=H.min();
+        pos=Fl.addterm(ad,v,pos);
+    }
+
+    setmod(Fl);
+    MY2=cv.Y2;
+    MY4=cv.Y4;
+
+//
+// Only the Y-coordinate is calculated. No need for X^P !
+//
+    if (show) out << "\b\b\bY^P" << flush;
+    YP=pow(MY2,(p-1)/2);
+    if (show) out << "\b\b\b";
+
+// Calculate Divisor Polynomials for small primes - Schoof 1985 p.485
+// This time mod the new (small) modulus Fl
+// Set the first few by hand....
+
+    PolyMod Pf[300],P2f[300],P3f[300];
+    Pf[0]=0; Pf[1]=1; Pf[2]=2; Pf[3]=0; Pf[4]=0;
+
+    P2f[1]=1; P3f[1]=1;
+
+    P2f[2]=Pf[2]*Pf[2];
+    P3f[2]=P2f[2]*Pf[2];
+
+    Pf[3].addterm(-(A*A),0); Pf[3].addterm(12*B,1);
+    Pf[3].addterm(6*A,2)   ; Pf[3].addterm((ZZn)3,4);
+
+    P2f[3]=Pf[3]*Pf[3];
+    P3f[3]=P2f[3]*Pf[3];
+
+    Pf[4].addterm((ZZn)(-4)*(8*B*B+A*A*A),0);
+    Pf[4].addterm((ZZn)(-16)*(A*B),1);
+    Pf[4].addterm((ZZn)(-20)*(A*A),2);
+    Pf[4].addterm((ZZn)80*B,3);
+    Pf[4].addterm((ZZn)20*A,4);
+    Pf[4].addterm((ZZn)4,6);
+
+    P2f[4]=Pf[4]*Pf[4];
+    P3f[4]=P2f[4]*Pf[4];
+    lower=5;
+    
+//
+// Now looking for value of lambda which satisfies
+// (X^P,Y^P) = lambda.(XX,YY). 
+// 3. Page 118, Algorithm 7.9
+//
+// Note that it appears to be sufficient to only compare the Y coordinates (!?)
+// For a justification see page 120 of 3. 
+// Thank you SYSTRAN translation service! (www.altavista.com)
+//
+    if (show) out << "NP mod " << lp << " = " << flush;
+    for (lambda=1;lambda<=(lp-1)/2;lambda++)
+    {
+        int res=0;
+        PolyMod Ry,Ty;
+        tau=(lambda+invers(lambda,lp)*p)%lp;
+
+        k=(lp+tau*tau-(4*p)%lp)%lp;
+        if (jac(k,lp)!=discrim) continue; 
+//
+//  Possible values of tau could be eliminated here by an application of 
+//  Atkin's algorithm....  
+//  
+        if (show) out << setw(3) << (p+1-tau)%lp << flush; 
+
+  // This "loop" is usually executed just once
+        for (jj=lower;jj<=lambda+2;jj++)
+        { // different for even and odd 
+            if (jj%2==1)     // 2 mod-muls
+            { 
+                n=(jj-1)/2;
+                if (n%2==0)
+                    Pf[jj]=Pf[n+2]*P3f[n]*MY4-P3f[n+1]*Pf[n-1];
+                else
+                    Pf[jj]=Pf[n+2]*P3f[n]-MY4*P3f[n+1]*Pf[n-1];
+            }
+            else            // 3 mod-muls
+            {
+                n=jj/2;
+                Pf[jj]=Pf[n]*(Pf[n+2]*P2f[n-1]-Pf[n-2]*P2f[n+1])/(ZZn)2;
+            }
+            P2f[jj]=Pf[jj]*Pf[jj];     // square
+            P3f[jj]=P2f[jj]*Pf[jj];    // cube
+        }
+        if (lambda+3>lower) lower=lambda+3;
+
+ // compare Y-coordinates - 3 polynomial mod-muls required
+
+        if (lambda%2==0)
+        {
+            Ry=(Pf[lambda+2]*P2f[lambda-1]-Pf[lambda-2]*P2f[lambda+1])/4;
+            Ty=MY4*YP*P3f[lambda];
+        }
+        else
+        {
+            if (lambda==1) Ry=(Pf[lambda+2]*P2f[lambda-1]+P2f[lambda+1])/4;
+            else           Ry=(Pf[lambda+2]*P2f[lambda-1]-Pf[lambda-2]*P2f[lambda+1])/4;
+            Ty=YP*P3f[lambda];
+        }
+        if (iszero(Ty-Ry)) res=1;
+        if (iszero(Ty+Ry)) res=2;
+
+        if (show) out << "\b\b\b";
+        if (res!=0) 
+        {  // has it doubled, or become point at infinity?
+            if (res==2)
+            { // it doubled - wrong sign
+                tau=(lp-tau)%lp;
+            }
+            break;
+        }
+    }
+    if (!show) out << "NP mod " << lp << " = ";
+    out << setw(3) << (p+1-tau)%lp;
+    if ((p+1-tau)%lp==0)
+    {
+        out << " ***";
+        if (cv.search && (!Edwards || lp!=4)) escape=TRUE;
+    }
+    return SEA_GOOD;
+}
+
+#ifdef MR_OS_THREADS
+
+//
+// A pool of threads processes the Elkies and Atkin primes. Each thread has
+// its own miracl instance, and takes the next prime from the list until 
+// enough is known for the kangaroos
+//
+
+struct Pool
+{
+    const Curve *cv;
+    PolyXY *Gl;
+    mr_utype *l;
+    int max,SCHP,next;
+    int kind[100],tau[100];
+    Big accum,d;
+    BOOL done,escape;
+    mutex lock;
+};
+
+void sea_worker(Pool *pl)
+{
+#ifndef MR_NOFULLWIDTH
+    Miracl precision=18;
+#else
+    Miracl precision(18,MAXBASE);
+#endif
+    int i,lp,tau,kind;
+    long ms;
+    BOOL escape;
+    Clock::time_point start;
+
+    modulo(pl->cv->p);
+    forever
+    {
+        pl->lock.lock();
+        if (pl->done || pl->next>pl->max) 
+        {
+            pl->lock.unlock();
+            break;
+        }
+        i=pl->next++;
+        pl->lock.unlock();
+
+        lp=(int)pl->l[i];
+        if (lp<=pl->SCHP) continue;
+
+        ostringstream out;
+        escape=FALSE;
+        start=Clock::now();
+        kind=process_prime(*pl->cv,lp,pl->Gl[i],FALSE,out,tau,escape);
+        ms=elapsed(start);
+
+        pl->lock.lock();
+        pl->kind[i]=kind;
+        pl->tau[i]=tau;
+        if (kind==SEA_GOOD)
+        {
+            pl->accum*=lp;
+            if (pl->accum>pl->d) pl->done=TRUE;
+        }
+        if (escape) pl->escape=pl->done=TRUE;
+        if (kind!=SEA_NONE) cout << out.str() << "  " << ms << " ms" << endl;
+        pl->lock.unlock();
+    }
+    freemod();
+}
+
+#endif
+
 int main(int argc,char **argv)
 {
     ofstream ofile;
     ifstream mueller;
-    int SCHP,first,max,lower,ip,parity,pbits,lp,i,jj,is,n,nx,ny,nl;
-    int sl[8],k,tau,lambda;
+    int SCHP,first,max,ip,parity,pbits,lp,i,jj,n,nx,ny,nl,threads,kind;
+    int sl[8],k,tau;
     mr_utype good[100],l[100],t[100];
     Big a,b,c,p,nrp,x,y,d,accum;
     PolyMod XX,YY,XP,XPP,YP,YPP;
-    PolyXY MP,Gl[200];
+    PolyXY Gl[200];
     termXY *posXY;
-    Poly F,G,P[500],P2[500],P3[500],Y2,Y4;
+    Poly G,P[500],P2[500],P3[500],Y2,Y4;
     miracl *mip=&precision;
     BOOL escape,search,fout,gotI,gotA,gotB,atkin;
-    ZZn j,g,qb,qc,delta,el;
+    ZZn j,delta;
     ZZn EB,EA,T,T1,T3,A2,A4,AZ,AW;
     int Base; 
+    Curve cv;
+    Clock::time_point start;
 
     argv++; argc--;
     if (argc<1)
@@ -692,6 +1255,9 @@ int main(int argc,char **argv)
         cout << "To observe Atkin prime processing, use flag -a" << endl;
         cout << "NOTE: Atkin prime information is not currently used" << endl;
         cout << "To search for NP prime, incrementing B, use flag -s" << endl;
+#ifdef MR_OS_THREADS
+        cout << "To process the primes in parallel, use flag -t <number of threads>" << endl;
+#endif
 		cout << "(For Edwards curve the search is for NP=4*prime)" << endl;
         cout << "\nFreeware from Certivox, Dublin, Ireland" << endl;
         cout << "Full C++ source code and MIRACL multiprecision library available" << endl;
@@ -706,6 +1272,7 @@ int main(int argc,char **argv)
 
 // Interpret command line
     Base=10;
+    threads=1;
     while (ip<argc)
     {
         if (!fout && strcmp(argv[ip],"-o")==0)
@@ -760,6 +1327,21 @@ int main(int argc,char **argv)
             continue;
         }
 
+        if (strcmp(argv[ip],"-t")==0)
+        {
+            ip++;
+            if (ip<argc)
+            {
+                threads=atoi(argv[ip++]);
+                continue;
+            }
+            else
+            {
+                cout << "Error in command line" << endl;
+                return 0;
+            }
+        }
+
         if (strcmp(argv[ip],"-h")==0)
         {
             ip++;
@@ -799,6 +1381,9 @@ int main(int argc,char **argv)
         cout << "Error in command line" << endl;
         return 0;
     }
+#ifndef MR_OS_THREADS
+    if (threads>1) cout << "Not a multi-threaded build - flag -t ignored" << endl;
+#endif
 
 // get prime modulus from .pol file
 
@@ -941,13 +1526,7 @@ int main(int argc,char **argv)
     one=1;         // polynomial = 1
     zero=0;        // polynomial = 0
 
-    PolyXY dGx,dGy,dGxx,dGxy,dGyy;
-    ZZn E0b,E0bd,E2bs,E4b,E6b,Dg,Dj,Dgd,Djd,Dgs,Djs,jl,jld,p1,jd;
-    ZZn E4bl,E6bl,deltal,atilde,btilde,gd,f,fd,s,Eg,Ej,Exy;
-    int r,v,ld,ld1,discrim;
-    ZZn M,cf[500],cft[500],ad,K,RF;
-    Poly Fl,T,WP[500],H,X,Y,R;
-    term *pos;
+    ZZn E4b,E6b;
 
     E4b=-(A/3);
     E6b=-(B/2);
@@ -1145,6 +1724,36 @@ int main(int argc,char **argv)
         if (escape) break;       
     }
 
+//
+// Now the Elkies and Atkin primes, until enough is known for the kangaroos.
+// These are independent, so can be handed out to a pool of threads
+//
+
+    cv.p=p; cv.j=j; cv.delta=delta; cv.E4b=E4b; cv.E6b=E6b;
+    cv.Y2=Y2; cv.Y4=Y4; cv.search=search; cv.atkin=atkin;
+
+#ifdef MR_OS_THREADS
+    if (!escape && threads>1)
+    {
+        Pool pl;
+        vector<thread> pool;
+        pl.cv=&cv; pl.Gl=Gl; pl.l=l; pl.max=max; pl.SCHP=SCHP; pl.next=1;
+        pl.accum=accum; pl.d=d; pl.done=pl.escape=FALSE;
+        for (i=1;i<=max;i++) pl.kind[i]=SEA_NONE;
+        for (i=0;i<threads;i++) pool.push_back(thread(sea_worker,&pl));
+        for (i=0;i<threads;i++) pool[i].join();
+        for (i=1;i<=max;i++) if (pl.kind[i]==SEA_GOOD)
+        { // primes still in progress when enough was known are used as well
+            lp=l[i];
+            good[nl]=lp;
+            t[nl++]=pl.tau[i];
+            accum*=lp;
+        }
+        escape=pl.escape;
+        if (!escape && accum<=d) cout << "WARNING: Ran out of Modular Polynomials!" << endl;
+    }
+    else
+#endif
     if (!escape) for (i=1;accum<=d;i++)      
     {
         if (i>max)
@@ -1156,428 +1765,15 @@ int main(int argc,char **argv)
 
         if (lp<=SCHP) continue;
 
-        k=p%lp;
-        for (is=1;;is++)
-            if (is*(lp-1)%12==0) break;
-
-        el=lp;
-        s=is;
-
-// Get next Modular Polynomial
-
-        MP=Gl[i];
-
-// Evaluate bivariate polynomial at Y=j-invariant
-// and use as polynomial modulus
-
-        F=MP.F(j);
-        setmod(F);
-        cout << setw(3) << lp << flush;
-        XP=pow(XX,p);
-//
-// Determine "Splitting type" 
-//
-        cout << "\b\b\bGCD" << flush;
-        G=gcd(XP-XX);
-
-        if (degree(G)==lp+1) 
-        {
-            cout << "\b\b\b" << flush;
-            continue;      // pathological case
-        }
-        if (degree(G)==0)  // Atkin Prime
-        {
-            if (!atkin && lp>100)    // Don't process large Atkin Primes
-            {
-                cout << "\b\b\b" << flush;
-                continue;
-            }
-            BOOL useful=FALSE;
-            cout << "\b\b\b" << flush;
-            cout << "ATK" << flush;
-
-            PolyMod u[20];
-            int max_r,lim=1;
-            u[0]=XP;  
-            u[1]=compose(u[0],u[0]);
-
-//
-// The code for processing Atkin Primes is in here, but currently largely 
-// unused. However the simplest case is used, as it suggests only one 
-// value for NP mod lp, and so can be used just like an Elkies prime
-// 
-//
-            if (atkin) max_r=lp+1;
-            else       max_r=2;
-            for (r=2;r<=max_r;r++)
-            {
-                PolyMod C;
-                int kk,m;
-                BOOL first;
-                if ((lp+1)%r!=0) continue;    // only keep good ones!
-                v=jac(k,lp);     // check Schoof Prop. 6.3
-                jj=(lp+1)/r;
-                if (jj%2==0 && v==(-1)) continue;
-                if (jj%2==1 && v==1) continue;
-       //         if (phi(r)>8) continue;       // > 8 candidates
-       //         if (lp<30 && phi(r)>2) continue;
-       //         if (lp<60 && phi(r)>4) continue;
-                kk=r; m=0;
-                first=TRUE;
-//
-// Right-to-Left Power Composition - find X^(P^r)
-//
-                forever
-                {
-                    if (kk%2!=0)
-                    {
-                        if (first) C=u[m]; 
-                        else       C=compose(u[m],C);
-                        first=FALSE;
-                    }
-                    kk/=2;
-                    if (kk==0) break;
-                    m++;
-                    if (m>lim) 
-                    { // remember them for next time
-                        u[m]=compose(u[m-1],u[m-1]);
-                        lim=m;
-                    }
-                }
-
-                if (iszero(C-XX)) 
-                { // found splitting type
-                    useful=TRUE;
-                    break;
-                }
-            }
-            cout << "\b\b\b" << flush;
-            if (!useful) continue;
-
-            cout << "NP mod " << lp << " = " << flush;
-
-            int a,b,candidates,gx,gy,ord,qnr=2;
-            BOOL gen;
-            while (jac(qnr,lp)!=(-1)) qnr++;
-
-//
-// [4] Algorithm VII.4 - find a generator of F(lp^2)
-//
-            ord=lp*lp-1;
-            gy=1;
-            for (gx=1;gx<lp;gx++)
-            {
-                gen=TRUE;
-                for (jj=2;jj<=ord/2;jj++)
-                {
-                    if (ord%jj!=0) continue;
-                    powquad(lp,qnr,gx,gy,ord/jj,a,b);
-                    if (a==1 && b==0) {gen=FALSE; break;}
-                }
-                if (gen) break;
-            }
-//
-// (gx,gy) is a generator
-//
-            candidates=0;
-            cout << setw(3);
-            for (jj=1;jj<r;jj++)
-            {
-                if (jj>1 && igcd(jj,r)!=1) continue;
-                powquad(lp,qnr,gx,gy,jj*ord/r,a,b);
-
-                tau=((a+1)*k*(int)invers(2,lp))%lp;
-                if (tau==0)
-                {           // r must be 2 - I can make use of this!
-                            // Its an Atkin prime, but only one possibility
-                    candidates++;
-                    cout << (p+1)%lp << flush;
-                    if ((p+1)%lp==0)
-                    {
-                        cout << " ***" << endl;
-                        if (search && (!Edwards || lp!=4)) escape=TRUE;
-                    }
-                    else cout << endl; 
-                    good[nl]=lp;
-                    t[nl]=tau;
-                    nl++;
-                    accum*=lp;  
-                    break;
-                }
-                else if (jac(tau,lp)==1)
-                {
-                    candidates+=2;
-                    tau=sqrmp(tau,lp);
-                    tau=(2*tau)%lp;
-                    if (candidates==phi(r))
-                    { 
-                         cout << (p+1-tau)%lp << " or " << (p+1+tau)%lp << endl;   
-                         break;
-                    }
-                    else cout << (p+1-tau)%lp << "," << (p+1+tau)%lp << "," << flush;
-                }  
-            }
-            if (escape) break;
-            continue;  
-        }
-
-//
-// Good Elkies prime - so use it!
-//
-// First solve quadratic for a root
-//
-        if (degree(G)==1)
-        {
-            discrim=0; 
-            g=-G.coeff(0); // Elkies Prime, one root, (2 possibilites)   
-        }
-        else               // degree(G)==2
-        {                  // Elkies Prime, two roots
-            discrim=1;
-            qb=G.coeff(1);
-            qc=G.coeff(0); 
-            g=sqrt(qb*qb-4*qc);
-            g=(-qb-g)/2;   // pick either one
-        }
-        cout << "\b\b\bELK" << flush;
-//
-// Mueller's procedure for finding the atilde, btilde and p1
-// parameters of the isogenous curve
-// 3. page 111
-// 4. page 131-133
-// First we need partial differentials of bivariate Modular Polynomial
-//
-
-        dGx=diff_dx(MP);
-        dGy=diff_dy(MP);
-        dGxx=diff_dx(dGx);
-        dGxy=diff_dx(dGy);
-        dGyy=diff_dy(dGy);
-
-        Eg=dGx.F(g,j);   // Evaluated at (g,j)
-        Ej=dGy.F(g,j);
-        Exy=dGxy.F(g,j);
-
-        Dg=g*Eg;    
-        Dj=j*Ej;
-
-        deltal=delta*pow(g,12/is)/pow(el,12);
-
-        if (Dj==0)
+        start=Clock::now();
+        kind=process_prime(cv,lp,Gl[i],TRUE,cout,tau,escape);
+        if (kind!=SEA_NONE) cout << "  " << elapsed(start) << " ms" << endl;
+        if (kind==SEA_GOOD)
         {
-            E4bl=E4b/(el*el);
-            atilde=-3*pow(el,4)*E4bl;
-            jl=pow(E4bl,3)/deltal;
-            btilde=2*pow(el,6)*sqrt((jl-1728)*deltal);
-            p1=0;
-        }
-        else
-        {
-            E2bs=(-12*E6b*Dj)/(s*E4b*Dg);
-
-            gd=-(s/12)*E2bs*g;
-            jd=-E4b*E4b*E6b/delta;
-            E0b=E6b/(E4b*E2bs); 
-
-            Dgd=gd*Eg+g*(gd*dGxx.F(g,j)+jd*Exy);
-            Djd=jd*Ej+j*(jd*dGyy.F(g,j)+gd*Exy);  
-   
-            E0bd=((-s*Dgd)/12-E0b*Djd)/Dj;
-
-            E4bl=(E4b-E2bs*(12*E0bd/E0b+6*E4b*E4b/E6b-4*E6b/E4b)+E2bs*E2bs)/(el*el);
-
-            jl=pow(E4bl,3)/deltal;
-            f=pow(el,is)/g; fd=s*E2bs*f/12;
-
-            Dgs=dGx.F(f,jl);
-            Djs=dGy.F(f,jl);
-
-            jld=-fd*Dgs/(el*Djs);
-            E6bl=-E4bl*jld/jl;
-
-            atilde=-3*pow(el,4)*E4bl;
-            btilde=-2*pow(el,6)*E6bl;
-            p1=-el*E2bs/2;            
-        }
-
-//
-// Find factor of Division Polynomial from atilde, btilde and p1 
-// Here we follow 3. p 116
-// Polynomials have been modified s.t x=z^2
-//
-// Note that all Polynomials can be reduced mod x^(d+1),
-// where d=(lp-1)/2, using modxn() function
-//
-
-        cout << "\b\b\bFAC" << flush;
-        ld=(lp-1)/2;
-        ld1=(lp-3)/2;
-
-        get_ck(ld1,A,B,cf);
-
-        WP[1]=1;
-        pos=NULL;
-        for (k=ld1;k>0;k--)
-           pos=WP[1].addterm(cf[k],k+1,pos);
-        for (v=2;v<=ld;v++)
-            WP[v]=modxn(WP[v-1]*WP[1],ld+1);
-//
-// WPv have understood multiplier x^-v
-//            
-        get_ck(ld1,atilde,btilde,cft);
-
-        Y=0;
-        pos=NULL;
-        for (k=ld1;k>0;k--)
-            pos=Y.addterm((lp*cf[k]-cft[k])/(ZZn)((2*k+1)*(2*k+2)),k+1,pos);
-        Y.addterm(-p1,1,pos);
-
-        RF=1;
-        H=1;
-        X=1;
-        for (r=1;r<=ld;r++)
-        {
-            X=modxn(X*Y,ld+1);
-            RF*=r;
-            H+=(X/RF);
-        }
-//
-//  H has understood multiplier x^-d
-//
-        ad=1;
-        Fl=0;
-        pos=Fl.addterm(ad,ld);
-        for (v=ld-1;v>=0;v--)
-        {
-            H-=ad*WP[v+1];
-            H=divxn(H,1);
-            ad=H.min();
-            pos=Fl.addterm(ad,v,pos);
-        }
-
-        setmod(Fl);
-        MY2=Y2;
-        MY4=Y4;
-
-//
-// Only the Y-coordinate is calculated. No need for X^P !
-//
-        cout << "\b\b\bY^P" << flush;
-        YP=pow(MY2,(p-1)/2);
-        cout << "\b\b\b";
-
-// Calculate Divisor Polynomials for small primes - Schoof 1985 p.485
-// This time mod the new (small) modulus Fl
-// Set the first few by hand....
-    
-        PolyMod Pf[300],P2f[300],P3f[300];
-        Pf[0]=0; Pf[1]=1; Pf[2]=2; Pf[3]=0; Pf[4]=0;
-
-        P2f[1]=1; P3f[1]=1;
-
-        P2f[2]=Pf[2]*Pf[2];
-        P3f[2]=P2f[2]*Pf[2];
-
-        Pf[3].addterm(-(A*A),0); Pf[3].addterm(12*B,1);
-        Pf[3].addterm(6*A,2)   ; Pf[3].addterm((ZZn)3,4);
-
-        P2f[3]=Pf[3]*Pf[3];
-        P3f[3]=P2f[3]*Pf[3];
-
-        Pf[4].addterm((ZZn)(-4)*(8*B*B+A*A*A),0);
-        Pf[4].addterm((ZZn)(-16)*(A*B),1);
-        Pf[4].addterm((ZZn)(-20)*(A*A),2);
-        Pf[4].addterm((ZZn)80*B,3);
-        Pf[4].addterm((ZZn)20*A,4);
-        Pf[4].addterm((ZZn)4,6);
-
-        P2f[4]=Pf[4]*Pf[4];
-        P3f[4]=P2f[4]*Pf[4];
-        lower=5;
-        
-//
-// Now looking for value of lambda which satisfies
-// (X^P,Y^P) = lambda.(XX,YY). 
-// 3. Page 118, Algorithm 7.9
-//
-// Note that it appears to be sufficient to only compare the Y coordinates (!?)
-// For a justification see page 120 of 3. 
-// Thank you SYSTRAN translation service! (www.altavista.com)
-//
-        good[nl]=lp;
-        cout << "NP mod " << lp << " = " << flush;
-        for (lambda=1;lambda<=(lp-1)/2;lambda++)
-        {
-            int res=0;
-            PolyMod Ry,Ty;
-            tau=(lambda+invers(lambda,lp)*p)%lp;
-
-            k=(lp+tau*tau-(4*p)%lp)%lp;
-            if (jac(k,lp)!=discrim) continue; 
-//
-//  Possible values of tau could be eliminated here by an application of 
-//  Atkin's algorithm....  
-//  
-            cout << setw(3) << (p+1-tau)%lp << flush; 
-
-      // This "loop" is usually executed just once
-            for (jj=lower;jj<=lambda+2;jj++)
-            { // different for even and odd 
-                if (jj%2==1)     // 2 mod-muls
-                { 
-                    n=(jj-1)/2;
-                    if (n%2==0)
-                        Pf[jj]=Pf[n+2]*P3f[n]*MY4-P3f[n+1]*Pf[n-1];
-                    else
-                        Pf[jj]=Pf[n+2]*P3f[n]-MY4*P3f[n+1]*Pf[n-1];
-                }
-                else            // 3 mod-muls
-                {
-                    n=jj/2;
-                    Pf[jj]=Pf[n]*(Pf[n+2]*P2f[n-1]-Pf[n-2]*P2f[n+1])/(ZZn)2;
-                }
-                P2f[jj]=Pf[jj]*Pf[jj];     // square
-                P3f[jj]=P2f[jj]*Pf[jj];    // cube
-            }
-            if (lambda+3>lower) lower=lambda+3;
-
-     // compare Y-coordinates - 3 polynomial mod-muls required
-
-            if (lambda%2==0)
-            {
-                Ry=(Pf[lambda+2]*P2f[lambda-1]-Pf[lambda-2]*P2f[lambda+1])/4;
-                Ty=MY4*YP*P3f[lambda];
-            }
-            else
-            {
-                if (lambda==1) Ry=(Pf[lambda+2]*P2f[lambda-1]+P2f[lambda+1])/4;
-                else           Ry=(Pf[lambda+2]*P2f[lambda-1]-Pf[lambda-2]*P2f[lambda+1])/4;
-                Ty=YP*P3f[lambda];
-            }
-            if (iszero(Ty-Ry)) res=1;
-            if (iszero(Ty+Ry)) res=2;
-
-            if (res!=0) 
-            {  // has it doubled, or become point at infinity?
-                if (res==2)
-                { // it doubled - wrong sign
-                    tau=(lp-tau)%lp;
-                    cout << "\b\b\b";
-                    cout << setw(3) << (p+1-tau)%lp << flush; 
-                }
-                t[nl]=tau;
-                if ((p+1-tau)%lp==0)
-                {
-                    cout << " ***" << endl;
-                    if (search && (!Edwards || lp!=4)) escape=TRUE;
-                }
-                else cout << endl;
-                break;
-            }
-            cout << "\b\b\b";
+            good[nl]=lp;
+            t[nl++]=tau;
+            accum*=lp;
         }
-        nl++;        
-        accum*=lp;
         if (escape) break;
     }
     Modulus.clear();
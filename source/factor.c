@@ -18,6 +18,15 @@
  *   NOTE: The quadratic sieve program requires a lot of memory for 
  *   bigger numbers. It may fail if you system cannot provide the memory
  *   requested.
+ *
+ *   The quadratic sieve here is still the original MPQS, with Gaussian
+ *   elimination. qsieve.c itself now uses the faster self-initialising
+ *   variant with block Lanczos, so use it directly for larger numbers.
+ *
+ *   Lenstra's method runs batches of curves which share inversions, with
+ *   an FFT continuation for phase 2. If MIRACL is built with MR_UNIX_MT,
+ *   THREADS batches run at once. Compile with -D_REENTRANT and link with
+ *   -lpthread
  */
 
 #include <stdio.h>
@@ -25,21 +34,45 @@
 #include <string.h>
 #include <math.h>
 #include "miracl.h"
+#ifdef MR_UNIX_MT
+#include <pthread.h>
+#endif
 
 #define LIMIT 15000
 #define BTRIES 1000
 #define MULT 2310      /* 2*3*5*7*11    */
 #define NEXT 13        /* .. next prime */
+#define ECMB 8         /* curves sharing inversions     */
+#define DOTP 16        /* schoolbook below this degree  */
 #define mr_min(a,b) ((a) < (b)? (a) : (b))
 
+#ifdef MR_UNIX_MT
+#ifndef THREADS
+#define THREADS 4
+#endif
+#else
+#undef THREADS
+#define THREADS 1
+#endif
+
 static big *fu;
 static BOOL *cp,*plus,*minus;
 big n;
 FILE *output;
 static BOOL suppress=FALSE;
 static int PADDING;
+static int bytes;
 static miracl *mip;
 
+static miracl *instance(void)
+{ /* all instances must have the same size of big */
+#ifndef MR_NOFULLWIDTH
+    return mirsys(-bytes,0);
+#else
+    return mirsys(-bytes,MAXBASE);
+#endif
+}
+
 void brute(void)
 { /* find factors by brute force division */
     big x,y;
@@ -528,315 +561,457 @@ void williams(int lim1,long lim2,int ntrys)
 }
 
 
-static big ak,t,ww,s1,d1,s2,d2;
+typedef struct {
+    big ak,one,t,ww,s1,d1,s2,d2;
+} ecm_work;
+
+typedef struct {
+    int first,count,lim1;   /* curves first...first+count-1       */
+    long lim2;
+    int *primes;            /* phase 1 primes, less than lim1     */
+    big N,F;                /* number, and factor found (or zero) */
+} ecm_job;
 
-void duplication(big sum,big diff,big x,big z)
+static ecm_job ecm[THREADS];
+static int kurve=5;
+
+void duplication(ecm_work *e,big sum,big diff,big x,big z)
 { /* double a point on the curve P(x,z)=2.P(x1,z1) */
-    nres_modmult(sum,sum,t);
+    nres_modmult(sum,sum,e->t);
     nres_modmult(diff,diff,z);
-    nres_modmult(t,z,x);          /* x = sum^2.diff^2 */
-    nres_modsub(t,z,t);           /* t = sum^2-diff^2 */
-    nres_modmult(ak,t,ww);
-    nres_modadd(z,ww,z);           /* z = ak*t +diff^2 */
-    nres_modmult(z,t,z);          /* z = z.t          */
+    nres_modmult(e->t,z,x);          /* x = sum^2.diff^2 */
+    nres_modsub(e->t,z,e->t);        /* t = sum^2-diff^2 */
+    nres_modmult(e->ak,e->t,e->ww);
+    nres_modadd(z,e->ww,z);          /* z = ak*t +diff^2 */
+    nres_modmult(z,e->t,z);          /* z = z.t          */
 }
 
-void addition(big xd,big zd,big sm1,big df1,big sm2,big df2,big x,big z)
+void addition(ecm_work *e,big xd,big zd,big sm1,big df1,big sm2,big df2,big x,big z)
 { /* add two points on the curve P(x,z)=P(x1,z1)+P(x2,z2) *
    * given their difference P(xd,zd)                      */
     nres_modmult(df2,sm1,x);
     nres_modmult(df1,sm2,z);
-    nres_modadd(z,x,t);
+    nres_modadd(z,x,e->t);
     nres_modsub(z,x,z);
-    nres_modmult(t,t,x);
+    nres_modmult(e->t,e->t,x);
     nres_modmult(x,zd,x);     /* x = zd.[df1.sm2+sm1.df2]^2 */
     nres_modmult(z,z,z);
     nres_modmult(z,xd,z);     /* z = xd.[df1.sm2-sm1.df2]^2 */
 }
 
-void ellipse(big x,big z,int r,big x1,big z1,big x2,big z2)
+void ellipse(ecm_work *e,big x,big z,int r,big x1,big z1,big x2,big z2)
 { /* calculate point r.P(x,z) on curve */
     int k,rr;
     k=1;
     rr=r;
     copy(x,x1);            
     copy(z,z1);
-    nres_modadd(x1,z1,s1);
-    nres_modsub(x1,z1,d1);
-    duplication(s1,d1,x2,z2);  /* generate 2.P */
+    if (r==1) return;
+    nres_modadd(x1,z1,e->s1);
+    nres_modsub(x1,z1,e->d1);
+    duplication(e,e->s1,e->d1,x2,z2);  /* generate 2.P */
     while ((rr/=2)>1) k*=2;
     while (k>0)
     { /* use binary method */
-        nres_modadd(x1,z1,s1);         /* form sums and differences */
-        nres_modsub(x1,z1,d1);    /* x+z and x-z for P1 and P2 */
-        nres_modadd(x2,z2,s2);
-        nres_modsub(x2,z2,d2);
+        nres_modadd(x1,z1,e->s1);      /* form sums and differences */
+        nres_modsub(x1,z1,e->d1);      /* x+z and x-z for P1 and P2 */
+        nres_modadd(x2,z2,e->s2);
+        nres_modsub(x2,z2,e->d2);
         if ((r&k)==0)
         { /* double P(x1,z1) mP to 2mP */
-            addition(x,z,s1,d1,s2,d2,x2,z2);
-            duplication(s1,d1,x1,z1);
+            addition(e,x,z,e->s1,e->d1,e->s2,e->d2,x2,z2);
+            duplication(e,e->s1,e->d1,x1,z1);
         }
         else
         { /* double P(x2,z2) (m+1)P to (2m+2)P */
-            addition(x,z,s1,d1,s2,d2,x1,z1);
-            duplication(s2,d2,x2,z2);
+            addition(e,x,z,e->s1,e->d1,e->s2,e->d2,x1,z1);
+            duplication(e,e->s2,e->d2,x2,z2);
         }    
         k/=2;
     }
 }
 
-int lenstra(int lim1,long lim2,int nc,int kurve,int ncurves)
-{  /*  factoring program using Lenstras Elliptic Curve method */
-    int phase,m,iv,pos,btch,u,v,ncr;
-    long i,p,pa,interval;
-    big q,x,z,a,x1,z1,x2,z2,xt,zt,fvw;
-    q=mirvar(0);
-    x=mirvar(0);
-    z=mirvar(0);
-    a=mirvar(0);
-    x1=mirvar(0);
-    z1=mirvar(0);
-    x2=mirvar(0);
-    z2=mirvar(0);
-    s1=mirvar(0);
-    d1=mirvar(0);
-    s2=mirvar(0);
-    d2=mirvar(0);
-    ak=mirvar(0);
-    xt=mirvar(0);
-    zt=mirvar(0);
-    fvw=mirvar(0);
-    t=mirvar(0);
-    ww=mirvar(0);
-    gprime(lim1);
+void suyama(ecm_work *e,int sigma,big x,big z,big a)
+{ /* generate starting point (x,z) and constant ak of curve */
+    int u,v;
+    u=sigma*sigma-5;
+    v=4*sigma;
 
-    for (m=1;m<=MULT/2;m+=2)
-        if (igcd(MULT,m)==1)
-        {
-            fu[m]=mirvar(0);
-            cp[m]=TRUE;
-        }
-        else cp[m]=FALSE;
+    convert(u,x);  nres(x,x);
+    convert(v,z);  nres(z,z);
+    nres_modsub(z,x,a);   /* a=v-u */
 
+    copy(x,e->t);
+    nres_modmult(x,x,x);
+    nres_modmult(x,e->t,x);  /* x=u^3 */
 
-    prepare_monty(n);
-    /* try a new curve */             
-    /* generating an elliptic curve */
-        ncr=nc;
-        u=kurve*kurve-5;
-        v=4*kurve;
+    copy(z,e->t);
+    nres_modmult(z,z,z);
+    nres_modmult(z,e->t,z);  /* z=v^3 */
+
+    copy(a,e->t);
+    nres_modmult(e->t,e->t,e->t);
+    nres_modmult(e->t,a,e->t);  /* t=(v-u)^3 */
+
+    convert(3*u,a); nres(a,a);
+    convert(v,e->ak);  nres(e->ak,e->ak);
+    nres_modadd(a,e->ak,a);
+    nres_modmult(e->t,a,e->t);  /* t=(v-u)^3.(3u+v) */
+
+    convert(u,a);  nres(a,a);
+    copy(a,e->ak);
+    nres_modmult(a,a,a);
+    nres_modmult(a,e->ak,a);   /* a=u^3 */
+    convert(v,e->ak); nres(e->ak,e->ak);
+    nres_modmult(a,e->ak,a);   /* a=u^3.v */
+    nres_premult(a,16,a);
+    nres_moddiv(e->t,a,e->ak);  /* ak=(v-u)^3.(3u+v)/16u^3v */
+}
 
-        convert(u,x);  nres(x,x);
-        convert(v,z);  nres(z,z);
-        nres_modsub(z,x,a);   /* a=v-u */
+big *vars(int m)
+{ /* allocate an array of m big variables */
+    int i;
+    big *v=(big *)mr_alloc(m,sizeof(big));
+    for (i=0;i<m;i++) v[i]=mirvar(0);
+    return v;
+}
 
-        copy(x,t);
-        nres_modmult(x,x,x);
-        nres_modmult(x,t,x);  /* x=u^3 */
+void unvars(int m,big *v)
+{
+    int i;
+    for (i=0;i<m;i++) mr_free(v[i]);
+    mr_free(v);
+}
 
-        copy(z,t);
-        nres_modmult(z,z,z);
-        nres_modmult(z,t,z);  /* z=v^3 */
+void dotprod(int m,big *x,big *y,big t,big w)
+{ /* w = sum of x[i].y[i], in short runs to avoid overflow */
+    int i,r;
+    zero(w);
+    for (i=0;i<m;i+=DOTP)
+    {
+        r=mr_min(DOTP,m-i);
+        nres_dotprod(r,&x[i],&y[i],t);
+        nres_modadd(w,t,w);
+    }
+}
 
-        copy(a,t);
-        nres_modmult(t,t,t);
-        nres_modmult(t,a,t);  /* t=(v-u)^3 */
+void pmul(int da,big *a,int db,big *b,big *c,big *rb)
+{ /* c = a.b, where c is distinct from a and b */
+    int i,k,lo,hi;
+    if (da>=DOTP && db>=DOTP)
+    {
+        mr_poly_mul(da,a,db,b,c);
+        return;
+    }
+    for (i=0;i<=db;i++) rb[i]=b[db-i];
+    for (k=0;k<=da+db;k++)
+    { /* schoolbook - each coefficient needs only one reduction */
+        lo=k-db; if (lo<0) lo=0;
+        hi=k;    if (hi>da) hi=da;
+        nres_dotprod(hi-lo+1,&a[lo],&rb[db-k+lo],c[k]);
+    }
+}
 
-        convert(3*u,a); nres(a,a);
-        convert(v,ak);  nres(ak,ak);
-        nres_modadd(a,ak,a);
-        nres_modmult(t,a,t);  /* t=(v-u)^3.(3u+v) */
+void ptree(ecm_work *e,int m,big *a,big *b,big *p,big *w1,big *w2,big *rb)
+{ /* p = product of (a[i].X-b[i]), i<m, using a product tree. *
+   * If a is NULL the factors are monic. w1, w2 hold 2m+2     */
+    int i,c,nc,da,db;
+    big *s=w1,*d=w2,*w;
+    for (i=0;i<m;i++)
+    {
+        nres_negate(b[i],s[2*i]);
+        if (a==NULL) copy(e->one,s[2*i+1]);
+        else         copy(a[i],s[2*i+1]);
+    }
+    for (c=1;c<m;c*=2)
+    { /* chunk i of c roots starts at i*(c+1) */
+        nc=(m+c-1)/c;
+        for (i=0;2*i<nc;i++)
+        {
+            da=c;
+            db=m-(2*i+1)*c;
+            if (db<=0)
+            { /* odd one out */
+                for (da=0;da<=m-2*i*c;da++)
+                    copy(s[2*i*(c+1)+da],d[i*(2*c+1)+da]);
+                continue;
+            }
+            if (db>c) db=c;
+            pmul(da,&s[2*i*(c+1)],db,&s[(2*i+1)*(c+1)],&d[i*(2*c+1)],rb);
+        }
+        w=s; s=d; d=w;
+    }
+    for (i=0;i<=m;i++) copy(s[i],p[i]);
+}
 
-        convert(u,a);  nres(a,a);
-        copy(a,ak);
-        nres_modmult(a,a,a);
-        nres_modmult(a,ak,a);   /* a=u^3 */
-        convert(v,ak); nres(ak,ak);
-        nres_modmult(a,ak,a);   /* a=u^3.v */
-        nres_premult(a,16,a);
-        nres_moddiv(t,a,ak);     /* ak=(v-u)^3.(3u+v)/16u^3v */
+BOOL ecm_found(ecm_job *j,int m,big *v,big t,big g)
+{ /* look for a factor in the product of v[0]...v[m-1] */
+    int i;
+    copy(v[0],t);
+    for (i=1;i<m;i++) nres_modmult(t,v[i],t);
+    egcd(t,j->N,g);
+    if (size(g)==1) return FALSE;
+    copy(g,j->F);
+    if (mr_compare(g,j->N)!=0) return TRUE;
+    for (i=0;i<m;i++)
+    { /* more than one factor - try them one at a time */
+        egcd(v[i],j->N,g);
+        if (size(g)==1 || mr_compare(g,j->N)==0) continue;
+        copy(g,j->F);
+        break;
+    }
+    return TRUE;  /* F=N is a degenerate case */
+}
 
-        phase=1;
-        p=0;
-        i=0;
-        btch=50;
-        if (!suppress) printf("curve %3d phase 1 - trying all primes less than %d\n",nc,lim1);
-        if (!suppress) printf("prime= %8ld",p);
-        ncr++;
-        forever
-        { /* main loop */
-            if (phase==1)
+void curves(ecm_job *j)
+{ /* phase 1 and 2 for a batch of curves. Phase 2 builds     *
+   * F(X) with the baby step roots x(j.Q), then finds the    *
+   * product of F(x(i.MULT.Q)) over all giant steps i, using *
+   * FFT polynomial arithmetic modulo F                      */
+    int c,i,m,r,k,ng,i0,pa,p;
+    BOOL cp[1+MULT/2];
+    ecm_work e;
+    big *qx,*qz,*ak,*bx,*bz,*bi,*F,*A,*T,*H,*rf,*gx,*gz,*w1,*w2,*rb;
+    big x,z,x1,z1,x2,z2,xd,zd,sd,dd,t;
+
+    e.one=mirvar(0); e.t=mirvar(0); e.ww=mirvar(0);
+    e.s1=mirvar(0); e.d1=mirvar(0); e.s2=mirvar(0); e.d2=mirvar(0);
+    x=mirvar(0); z=mirvar(0); x1=mirvar(0); z1=mirvar(0);
+    x2=mirvar(0); z2=mirvar(0); xd=mirvar(0); zd=mirvar(0);
+    sd=mirvar(0); dd=mirvar(0); t=mirvar(0);
+
+    k=0;
+    for (m=1;m<=MULT/2;m+=2)
+    {
+        cp[m]=(igcd(MULT,m)==1);
+        if (cp[m]) k++;
+    }
+    qx=vars(j->count); qz=vars(j->count); ak=vars(j->count);
+    bx=vars(k*j->count); bz=vars(k*j->count); bi=vars(k*j->count);
+    F=vars(k+1); rf=vars(k+1); A=vars(k); H=vars(k+1); T=vars(2*k);
+    gx=vars(k); gz=vars(k); w1=vars(2*k+2); w2=vars(2*k+2);
+    rb=(big *)mr_alloc(2*k+1,sizeof(big));
+
+    prepare_monty(j->N);
+    convert(1,e.one); nres(e.one,e.one);
+    zero(j->F);
+
+    for (c=0;c<j->count;c++)
+    { /* phase 1 - multiply by all prime powers less than lim1 */
+        e.ak=ak[c];
+        suyama(&e,j->first+c,qx[c],qz[c],t);
+        for (i=0;(p=j->primes[i])!=0;i++)
+        {
+            pa=p;
+            while ((j->lim1/p) > pa) pa*=p;
+            ellipse(&e,qx[c],qz[c],pa,x1,z1,x2,z2);
+            copy(x1,qx[c]);
+            copy(z1,qz[c]);
+        }
+    }
+    if (ecm_found(j,j->count,qz,t,x)) goto done;
+
+    for (c=0;c<j->count;c++)
+    { /* baby steps x(m.Q), m<MULT/2 prime to MULT */
+        e.ak=ak[c];
+        r=c*k;
+        copy(qx[c],bx[r]); copy(qz[c],bz[r++]);
+        nres_modadd(qx[c],qz[c],e.s2);
+        nres_modsub(qx[c],qz[c],e.d2);               /*   Q = (s2,d2) */
+        duplication(&e,e.s2,e.d2,x,z);
+        nres_modadd(x,z,sd);
+        nres_modsub(x,z,dd);                         /* 2.Q = (sd,dd) */
+        copy(qx[c],x1); copy(qz[c],z1);
+        addition(&e,x1,z1,sd,dd,e.s2,e.d2,x2,z2);    /* 3.Q = (x2,z2) */
+        for (m=5;m<=MULT/2;m+=2)
+        {
+            nres_modadd(x2,z2,e.s2);
+            nres_modsub(x2,z2,e.d2);
+            addition(&e,x1,z1,e.s2,e.d2,sd,dd,x,z);
+            copy(x2,x1); copy(z2,z1);
+            copy(x,x2);  copy(z,z2);
+            if (!cp[m]) continue;
+            copy(x,bx[r]); copy(z,bz[r++]);
+        }
+    }
+    if (ecm_found(j,k*j->count,bz,t,x)) goto done;
+    nres_multi_inverse(k*j->count,bz,bi);        /* one inversion for all */
+    for (i=0;i<k*j->count;i++) nres_modmult(bx[i],bi[i],bx[i]);
+
+    i0=(j->lim1+MULT/2)/MULT;
+    if (i0<2) i0=2;
+    ng=(int)(j->lim2/MULT)+2-i0;
+    for (c=0;c<j->count;c++)
+    { /* phase 2 */
+        e.ak=ak[c];
+        ptree(&e,k,NULL,&bx[c*k],F,w1,w2,rb);
+        for (i=0;i<k;i++)
+        { /* T = 1/reverse(F) mod X^k */
+            if (i==0) copy(e.one,T[0]);
+            else
             {
-                p=mip->PRIMES[i];
-                if (mip->PRIMES[i+1]==0)
-                { /* now change gear */
-                    phase=2;
-                    if (!suppress) 
-                    {
-                        printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-                        printf("          phase 2 - trying last prime less than %ld\n",
-                            lim2);
-                        printf("prime= %8ld",p);
-                    }
-                    copy(x,xt);
-                    copy(z,zt);
-                    nres_modadd(x,z,s2);
-                    nres_modsub(x,z,d2);                    /*   P = (s2,d2) */
-                    duplication(s2,d2,x,z);
-                    nres_modadd(x,z,s1);
-                    nres_modsub(x,z,d1);                    /* 2.P = (s1,d1) */
-
-                    nres_moddiv(x1,z1,fu[1]);               /* fu[1] = x1/z1 */
-                    
-                    addition(x1,z1,s1,d1,s2,d2,x2,z2); /* 3.P = (x2,z2) */
-                    for (m=5;m<=MULT/2;m+=2)
-                    { /* calculate m.P = (x,z) and store fu[m] = x/z */
-                        nres_modadd(x2,z2,s2);
-                        nres_modsub(x2,z2,d2);
-                        addition(x1,z1,s2,d2,s1,d1,x,z);
-                        copy(x2,x1);
-                        copy(z2,z1);
-                        copy(x,x2);
-                        copy(z,z2);
-                        if (!cp[m]) continue;
-                        copy(z2,fu[m]);
-                        nres_moddiv(x2,fu[m],fu[m]);
-                    }
-                    ellipse(xt,zt,MULT,x,z,x2,z2);
-                    nres_modadd(x,z,xt);
-                    nres_modsub(x,z,zt);              /* MULT.P = (xt,zt) */
-                    iv=(int)(p/MULT);
-                    if (p%MULT>MULT/2) iv++;
-                    interval=(long)iv*MULT; 
-                    p=interval+1;
-                    marks(interval);
-                    ellipse(x,z,iv,x1,z1,x2,z2); /* (x1,z1) = iv.MULT.P */
-                    nres_moddiv(x1,z1,fvw);                /* fvw = x1/z1 */
-                    nres_modsub(fvw,fu[p%MULT],q);
-                    btch*=100;
-                    i++;
-                    continue;
-                }
-                pa=p;
-                while ((lim1/p) > pa) pa*=p;
-                ellipse(x,z,(int)pa,x1,z1,x2,z2);
-                copy(x1,x);
-                copy(z1,z);
-                copy(z,q);
+                dotprod(i,&F[k-i],&T[0],t,T[i]);
+                nres_negate(T[i],T[i]);
             }
-            else
-            { /* phase 2 - looking for last large PRIME FACTOR of (p+1+d) */
-                p+=2;
-                pos=(int)(p%MULT);
-                if (pos>MULT/2)
-                { /* increment giant step */
-                    iv++;
-                    interval=(long)iv*MULT;
-                    p=interval+1;
-                    marks(interval);
-                    pos=1;
-                    nres_moddiv(x2,z2,fvw);
-                    nres_modadd(x2,z2,s2);
-                    nres_modsub(x2,z2,d2);
-                    addition(x1,z1,s2,d2,xt,zt,x,z);
-                    copy(x2,x1);
-                    copy(z2,z1);
-                    copy(x,x2);
-                    copy(z,z2);
-                }
-                if (!cp[pos]) continue;
-
-        /* if neither interval +/- pos is prime, don't bother */
-                if (!plus[pos] && !minus[pos]) continue;
-
-                nres_modsub(fvw,fu[pos],t);
-                nres_modmult(q,t,q);
+        }
+        for (i=0;i<k;i++) copy(T[k-1-i],rf[i]);
+        mr_polymod_set(k,rf,F);
+
+        ellipse(&e,qx[c],qz[c],MULT,xd,zd,x2,z2);  /* MULT.Q = (xd,zd) */
+        nres_modadd(xd,zd,sd);
+        nres_modsub(xd,zd,dd);
+        ellipse(&e,xd,zd,i0-1,x1,z1,x2,z2);        /* (i0-1).MULT.Q */
+        ellipse(&e,xd,zd,i0,x2,z2,x,z);            /*  i0.MULT.Q    */
+        for (r=0;r<ng;)
+        { /* a batch of up to k giant steps */
+            for (m=0;m<k && r<ng;m++,r++)
+            {
+                copy(x2,gx[m]);
+                copy(z2,gz[m]);
+                nres_modadd(x2,z2,e.s2);
+                nres_modsub(x2,z2,e.d2);
+                addition(&e,x1,z1,e.s2,e.d2,sd,dd,x,z);
+                copy(x2,x1); copy(z2,z1);
+                copy(x,x2);  copy(z,z2);
             }
-            if (i++%btch==0)
-            { /* try for a solution */
-                if (!suppress) 
-                {
-                    printf("\b\b\b\b\b\b\b\b%8ld",p);
-                    fflush(stdout);
-                }
-                egcd(q,n,t);
-                if (size(t)==1)
-                {
-                    if (p>lim2) 
-                    {
-                        if (!suppress) 
-                        {
-                            printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-                            fflush(stdout);
-                        }
-                        break;
-                    }
-                    else continue;
-                }
-                if (mr_compare(t,n)==0)
-                {
-                    if (!suppress) 
-                    {
-                        printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-                        printf("degenerate case\n");
-                    }
-                    break;
-                }
-
-                if (!suppress) 
-                {
-                    printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-                    if (isprime(t)) printf("PRIME FACTOR     ");
-                    else            printf("COMPOSITE FACTOR ");
-                }
-                else if (!isprime(t)) printf("& ");
-                cotnum(t,output);
-                divide(n,t,n);
-                if (isprime(n))
-                {
-                    if (!suppress) printf("PRIME FACTOR     ");
-                    cotnum(n,output);
-                    exit(0);
-                }
-                ncr=ncurves+1;
-                break;
+            ptree(&e,m,gz,gx,H,w1,w2,rb);
+            if (m==k) for (i=0;i<k;i++)
+            { /* reduce H mod F */
+                nres_modmult(H[k],F[i],t);
+                nres_modsub(H[i],t,H[i]);
+            }
+            if (m==k) m--;
+            if (r<=k)
+            {
+                for (i=0;i<k;i++)
+                    if (i<=m) copy(H[i],A[i]);
+                    else      zero(A[i]);
+                continue;
+            }
+            pmul(k-1,A,m,H,T,rb);
+            for (i=k+m;i<2*k-1;i++) zero(T[i]);
+            if (!mr_poly_rem(2*k-2,T,A))
+            { /* FFT tables were destroyed - set them up again */
+                mr_polymod_set(k,rf,F);
+                pmul(k-1,A,m,H,T,rb);
+                for (i=k+m;i<2*k-1;i++) zero(T[i]);
+                mr_poly_rem(2*k-2,T,A);
             }
         }
- 
-    gprime(0);
-    mr_free(ww);
-    mr_free(t);
-    mr_free(q);
-    mr_free(x);
-    mr_free(z);
-    mr_free(a);
-    mr_free(x1);
-    mr_free(z1);
-    mr_free(x2);
-    mr_free(z2);
-    mr_free(s1);
-    mr_free(d1);
-    mr_free(s2);
-    mr_free(d2);
-    mr_free(ak);
-    mr_free(xt);
-    mr_free(zt);
-    mr_free(fvw);
-    for (m=1;m<=MULT/2;m+=2)
-        if (igcd(MULT,m)==1) mr_free(fu[m]);
-    return ncr;
+        copy(e.one,qz[c]);
+        for (r=c*k;r<(c+1)*k;r++)
+        { /* evaluate A at each root of F */
+            copy(A[k-1],x);
+            for (i=k-2;i>=0;i--)
+            {
+                nres_modmult(x,bx[r],x);
+                nres_modadd(x,A[i],x);
+            }
+            nres_modmult(qz[c],x,qz[c]);
+        }
+    }
+    ecm_found(j,j->count,qz,t,x);
+done:
+    fft_reset();
+    mr_free(rb);
+    unvars(2*k+2,w2); unvars(2*k+2,w1); unvars(k,gz); unvars(k,gx);
+    unvars(2*k,T); unvars(k+1,H); unvars(k,A); unvars(k+1,rf); unvars(k+1,F);
+    unvars(k*j->count,bi); unvars(k*j->count,bz); unvars(k*j->count,bx);
+    unvars(j->count,ak); unvars(j->count,qz); unvars(j->count,qx);
+    mr_free(t); mr_free(dd); mr_free(sd); mr_free(zd); mr_free(xd);
+    mr_free(z2); mr_free(x2); mr_free(z1); mr_free(x1); mr_free(z); mr_free(x);
+    mr_free(e.d2); mr_free(e.s2); mr_free(e.d1); mr_free(e.s1);
+    mr_free(e.ww); mr_free(e.t); mr_free(e.one);
 }
 
-void do_lenstra(int lim1,long lim2,int ncurves)
-{
-    int nc=1;
-    int kurve=5;
+#ifdef MR_UNIX_MT
+void *ecm_worker(void *arg)
+{ /* each thread needs its own MIRACL instance */
+    instance();
+    curves((ecm_job *)arg);
+    mirexit();
+    return NULL;
+}
+#endif
 
-    for (nc=1;nc<=ncurves;)
+void do_lenstra(int lim1,long lim2,int ncurves)
+{ /* run ncurves curves, THREADS batches of up to ECMB at a time */
+    int nc,nt,i,t;
+#ifdef MR_UNIX_MT
+    pthread_t tid[THREADS];
+    BOOL started[THREADS];
+#endif
+    BOOL found=FALSE;
+    gprime(lim1);
+    for (t=0;t<THREADS;t++)
     {
-        kurve++;
-        nc=lenstra(lim1,lim2,nc,kurve,ncurves);
+        ecm[t].N=mirvar(0);
+        ecm[t].F=mirvar(0);
     }
+    for (nc=0;nc<ncurves && !found;nc+=nt)
+    {
+        nt=0;
+        for (t=0;t<THREADS && nc+nt<ncurves;t++)
+        {
+            ecm[t].first=kurve+1;
+            ecm[t].count=mr_min(ECMB,(ncurves-nc+THREADS-1)/THREADS);
+            ecm[t].count=mr_min(ecm[t].count,ncurves-nc-nt);
+            ecm[t].lim1=lim1;
+            ecm[t].lim2=lim2;
+            ecm[t].primes=mip->PRIMES;
+            copy(n,ecm[t].N);
+            kurve+=ecm[t].count;
+            nt+=ecm[t].count;
+        }
+        if (!suppress) 
+        {
+            printf("curves %3d-%3d phase 1 - trying all primes less than %d\n",
+                    nc+1,nc+nt,lim1);
+            printf("              phase 2 - trying last prime less than %ld\n",lim2);
+        }
+#ifdef MR_UNIX_MT
+        for (i=0;i<t;i++)
+            started[i]=(pthread_create(&tid[i],NULL,ecm_worker,&ecm[i])==0);
+        for (i=0;i<t;i++)
+        {
+            if (started[i]) pthread_join(tid[i],NULL);
+            else curves(&ecm[i]);
+        }
+#else
+        for (i=0;i<t;i++) curves(&ecm[i]);
+#endif
+        for (i=0;i<t;i++)
+        {
+            if (size(ecm[i].F)==0) continue;
+            if (mr_compare(ecm[i].F,n)==0)
+            {
+                if (!suppress) printf("degenerate case\n");
+                continue;
+            }
+            if (!suppress) 
+            {
+                if (isprime(ecm[i].F)) printf("PRIME FACTOR     ");
+                else                   printf("COMPOSITE FACTOR ");
+            }
+            else if (!isprime(ecm[i].F)) printf("& ");
+            cotnum(ecm[i].F,output);
+            divide(n,ecm[i].F,n);
+            if (isprime(n))
+            {
+                if (!suppress) printf("PRIME FACTOR     ");
+                cotnum(n,output);
+                exit(0);
+            }
+            found=TRUE;
+            break;
+        }
+    }
+    for (t=0;t<THREADS;t++)
+    {
+        mr_free(ecm[t].F);
+        mr_free(ecm[t].N);
+    }
+    gprime(0);
 }
 
 #define SSIZE 100000    /* Maximum sieve size            */
@@ -1380,6 +1555,8 @@ int qsieve(int d)
 #define RAISE '#'
 #endif
 
+static big t;
+
 int digits(void)
 { /* size of n */
     int d;
@@ -1538,7 +1715,7 @@ LOOP:
 int main(int argc,char **argv)
 {
     FILE *ifile;
-    int ip,b,d=250;
+    int ip,d=250;
     argv++;argc--;
     if (argc<1)
     {
@@ -1568,12 +1745,11 @@ int main(int argc,char **argv)
       return 0;
     }
 
-    b=(d*45)/100;
-#ifndef MR_NOFULLWIDTH
-    mip=mirsys(-b,0);
-#else
-    mip=mirsys(-b,MAXBASE);
+#ifdef MR_UNIX_MT
+    mr_init_threading();    /* initialize MIRACL for multi-threading */
 #endif
+    bytes=(d*45)/100;
+    mip=instance();
 
     mip->NTRY=100;
     n=mirvar(0);
@@ -1589,12 +1765,8 @@ int main(int argc,char **argv)
             mr_free(n);
             mirexit();
             if (d<20) d=20;
-            b=(d*45)/100;
-#ifndef MR_NOFULLWIDTH
-            mip=mirsys(-b,0);
-#else
-            mip=mirsys(-b,MAXBASE);
-#endif
+            bytes=(d*45)/100;
+            mip=instance();
             mip->NTRY=100;
             n=mirvar(0);
             continue;
@@ -1671,16 +1843,16 @@ int main(int argc,char **argv)
     if (digits()>35)
     {
         if (!suppress) printf("now trying lenstra's method using 10 curves\n");
-        do_lenstra(20000,2000000L,10);
+        do_lenstra(20000,10000000L,10);
         if (digits()>64) 
         {
              if (!suppress) printf("now trying 80 more curves\n");
-             do_lenstra(20000,2000000L,80);
+             do_lenstra(20000,10000000L,80);
         }
         if (digits()>72)
         {
              if (!suppress) printf("trying 300 last curves\n");
-             do_lenstra(50000,5000000,300);
+             do_lenstra(50000,25000000L,300);
         } 
     }  
 
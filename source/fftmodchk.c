@@ -0,0 +1,93 @@
+/*
+ *   Program to check squaring modulo 2^q-1 and 2^q+1 by fft_mod_sqr()
+ *
+ *   Twenty steps x=x^2+c of a random x are compared with the same steps
+ *   done by multiply() and divide(), for several q. Then the Lucas-Lehmer
+ *   test, as used by mersenne.c, is run on known exponents.
+ */
+
+#include <stdio.h>
+#include "miracl.h"
+
+static int check(int q,int sign,int c)
+{
+    fft_mod f;
+    big m,x,y;
+    int i,bad=0;
+
+    m=mirvar(0);
+    x=mirvar(0);
+    y=mirvar(0);
+    expb2(q,m);
+    if (sign>0) incr(m,1,m);
+    else        decr(m,1,m);
+
+    if (fft_mod_init(&f,q,sign))
+    {
+        bigrand(m,x);
+        copy(x,y);
+        fft_mod_set(&f,x);
+        for (i=0;i<20;i++)
+        {
+            fft_mod_sqr(&f,c);
+            multiply(y,y,y);
+            if (c>=0) incr(y,c,y);
+            else      decr(y,-c,y);
+            divide(y,m,m);
+        }
+        fft_mod_get(&f,x);
+        fft_mod_end(&f);
+    }
+    if (mr_compare(x,y)!=0)
+    {
+        printf("x^2%+d mod 2^%d%+d is wrong\n",c,q,sign);
+        bad++;
+    }
+    mirkill(y);
+    mirkill(x);
+    mirkill(m);
+    return bad;
+}
+
+static BOOL mersenne_prime(int q)
+{ /* TRUE if 2^q-1 is prime */
+    fft_mod f;
+    big L;
+    int i;
+    BOOL prime;
+
+    L=mirvar(4);
+    if (!fft_mod_init(&f,q,-1)) return FALSE;
+    fft_mod_set(&f,L);
+    for (i=1;i<=q-2;i++) fft_mod_sqr(&f,-2);
+    fft_mod_get(&f,L);
+    fft_mod_end(&f);
+    prime=(size(L)==0);
+    mirkill(L);
+    return prime;
+}
+
+int main()
+{
+    static int q[]={127,1279,9689,11213,21701,0};
+    int i,bad=0;
+
+    mirsys(2000,0);
+    irand(1L);
+    for (i=0;q[i]!=0;i++)
+    {
+        bad+=check(q[i],-1,-2);
+        bad+=check(q[i],1,-2);
+        bad+=check(q[i],1,3);
+    }
+    if (!mersenne_prime(4423) || mersenne_prime(4421))
+    {
+        printf("Lucas-Lehmer test is wrong\n");
+        bad++;
+    }
+    mirexit();
+
+    if (bad) printf("FAILED\n");
+    else     printf("All OK\n");
+    return bad;
+}
@@ -14,8 +14,10 @@ int main()
 { /* calculate mersenne primes */
     BOOL compo;
     big L,m,T;
+    fft_mod f;
     int i,k,q,p,r;
     miracl *mip=mirsys(5000,0);
+    mip->FFT_THREADS=4;   /* used if built with MR_FFT_THREADS */
     L=mirvar(0);
     m=mirvar(0);
     T=mirvar(0);
@@ -52,7 +54,14 @@ int main()
         }
 
         convert(4,L);
-        for(i=1;i<=q-2;i++)
+        if (q>=10000 && fft_mod_init(&f,q,-1))
+        { /* Lucas-Lehmer test, squaring directly mod 2^q-1 */
+            fft_mod_set(&f,L);
+            for(i=1;i<=q-2;i++) fft_mod_sqr(&f,-2);
+            fft_mod_get(&f,L);
+            fft_mod_end(&f);
+        }
+        else for(i=1;i<=q-2;i++)
         { /* Lucas-Lehmer test */
             fft_mult(L,L,L);
             decr(L,2,L);
@@ -0,0 +1,101 @@
+/*
+ *   Program to check the fixed size Montgomery kernels of montfield.h
+ *
+ *   For each size N, MontField<N>::sqr(a) is compared with mul(a,a),
+ *   using random operands and operands with the top bits of their words
+ *   set, which exercise the carries of the doubled products. Then a
+ *   Montgomery squaring mod 2^255-19 is checked against a known value,
+ *   and operands with stale words above their length are tried.
+ *
+ *   Requires: big.cpp zzn.cpp
+ */
+
+#include <iostream>
+#include "zzn.h"
+#include "montfield.h"
+
+using namespace std;
+
+Miracl precision(40,0);
+
+static mr_small edge[]={(mr_small)0-2,((mr_small)1<<(MIRACL-1))+1,(mr_small)0-1,(mr_small)1<<(MIRACL-1),0,1};
+
+template <int N> struct Check
+{
+    static int run()
+    {
+        mr_small a[N],s[2*N],p[2*N];
+        int i,j,k,bad=0;
+
+        for (k=0;k<1000;k++)
+        {
+            for (i=0;i<N;i++)
+            {
+                if (k<6*6) a[i]=edge[(k/(i%2+1)+i)%6];
+                else if (k%2==0) a[i]=((mr_small)brand()<<(MIRACL/2))^(mr_small)brand();
+                else a[i]=(mr_small)0-1-(mr_small)brand();
+            }
+            MontField<N>::sqr(a,s);
+            MontField<N>::mul(a,a,p);
+            for (j=0;j<2*N;j++) if (s[j]!=p[j]) break;
+            if (j<2*N)
+            {
+                cout << "sqr!=mul for N= " << N << endl;
+                bad++;
+                break;
+            }
+        }
+        return bad+Check<N-1>::run();
+    }
+};
+
+template <> struct Check<MR_MONTFIELD_MIN-1>
+{
+    static int run() {return 0;}
+};
+
+int main()
+{
+    int bad;
+    Big p,x,y,r,t;
+    big z;
+
+    irand(3L);
+    bad=Check<MR_KERNEL_MAX>::run();
+
+    p=pow((Big)2,255)-19;
+    modulo(p);
+    x=pow((Big)2,127)+pow((Big)2,65)-2;
+    nres_modmult(x.getbig(),x.getbig(),r.getbig());    /* x*x/R mod p */
+    if (r!=(Big)(char *)"55610674436342646486650649470508623153961299045478881670502231428832014341156")
+    {
+        cout << "Montgomery squaring mod 2^255-19 failed" << endl;
+        bad++;
+    }
+
+// Only the words of an operand up to its length may be read
+
+    x=pow((Big)2,MIRACL)+3;
+    y=pow((Big)2,100)+5;
+    nres_modmult(x.getbig(),y.getbig(),t.getbig());
+    z=x.getbig();
+    z->w[2]=z->w[3]=(mr_small)0-1;    /* stale words above len */
+    nres_modmult(x.getbig(),y.getbig(),r.getbig());
+    if (r!=t)
+    {
+        cout << "kernel read beyond the length of an operand" << endl;
+        bad++;
+    }
+    nres_modmult(x.getbig(),x.getbig(),r.getbig());
+    z->w[2]=z->w[3]=0;
+    nres_modmult(x.getbig(),x.getbig(),t.getbig());
+    if (r!=t)
+    {
+        cout << "kernel read beyond the length of an operand" << endl;
+        bad++;
+    }
+
+    if (bad) cout << "FAILED" << endl;
+    else     cout << "All OK" << endl;
+    return bad;
+}
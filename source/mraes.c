@@ -49,11 +49,19 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 #include <stdlib.h> 
 #include "miracl.h"
 
-/* Define this if INTEL AES-NI intrinsics are supported - for example with GCC compiler - use flag -maes */ 
+/* Define this if INTEL AES-NI intrinsics are supported. The instructions are only used if the processor */
+/* reports them at run-time, otherwise the T-table code is used */ 
 /* #define AES_NI_SUPPORT */
 
 #ifdef AES_NI_SUPPORT
 #include <wmmintrin.h> 
+#ifdef __GNUC__
+#include <cpuid.h>
+#define MR_AESNI_TARGET __attribute__((target("aes,sse2")))
+#else
+#include <intrin.h>
+#define MR_AESNI_TARGET
+#endif
 #endif
 
 #define MR_WORD mr_unsign32
@@ -581,6 +589,100 @@ static MR_WORD InvMixCol(MR_WORD x)
     return y;
 }
 
+static void next_counter(aes *a,MR_BYTE *b)
+{ /* copy out the counter register, and increment its last 32 bits (big-endian) */
+    int i;
+    for (i=0;i<4*NB;i++) b[i]=a->f[i];
+    for (i=4*NB-1;i>=4*NB-4;i--)
+        if (++a->f[i]!=0) break;
+}
+
+#ifdef AES_NI_SUPPORT
+
+static int aesni_available(void)
+{ /* check at run-time that the processor supports AES-NI */
+#ifdef __GNUC__
+    unsigned int a,b,c,d;
+    if (!__get_cpuid(1,&a,&b,&c,&d)) return 0;
+    return ((c&bit_AES)!=0);
+#else
+    int r[4];
+    __cpuid(r,1);
+    return ((r[2]&0x2000000)!=0);
+#endif
+}
+
+MR_AESNI_TARGET static void aesni_ecb_encrypt(aes *a,MR_BYTE *buff)
+{
+    int i,k;
+	__m128i ky,m = _mm_loadu_si128((__m128i *) buff);
+	ky = _mm_loadu_si128((__m128i *) &a->fkey[0]);
+    m = _mm_xor_si128       (m, ky); 
+	k=NB;
+	for (i=1;i<a->Nr;i++)
+	{
+		ky=_mm_loadu_si128((__m128i *) &a->fkey[k]);
+		m =_mm_aesenc_si128(m, ky); 
+		k+=4;
+	}
+	ky=_mm_loadu_si128((__m128i *) &a->fkey[k]);
+    m=_mm_aesenclast_si128(m, ky);
+
+    _mm_storeu_si128((__m128i *)buff, m);
+}
+
+MR_AESNI_TARGET static void aesni_ecb_decrypt(aes *a,MR_BYTE *buff)
+{
+    int i,k;
+	__m128i ky,m = _mm_loadu_si128((__m128i *) buff);
+	ky = _mm_loadu_si128((__m128i *) &a->rkey[0]);
+    m = _mm_xor_si128       (m, ky); 
+	k=NB;
+	for (i=1;i<a->Nr;i++)
+	{
+		ky=_mm_loadu_si128((__m128i *) &a->rkey[k]);
+		m =_mm_aesdec_si128    (m, ky); 
+		k+=4;
+	}
+	ky=_mm_loadu_si128((__m128i *) &a->rkey[k]);
+    m=_mm_aesdeclast_si128(m, ky);
+
+    _mm_storeu_si128((__m128i *)buff, m);
+}
+
+MR_AESNI_TARGET static void aesni_ctr(aes *a,MR_BYTE *in,MR_BYTE *out,int nblocks)
+{ /* 8 counter blocks at a time, to keep the AES pipeline full */
+    int i,j,k,n;
+    MR_BYTE ctr[8][16];
+    __m128i ky,m[8];
+
+    while (nblocks>0)
+    {
+        n=nblocks; if (n>8) n=8;
+        for (j=0;j<n;j++) next_counter(a,ctr[j]);
+
+        ky=_mm_loadu_si128((__m128i *) &a->fkey[0]);
+        for (j=0;j<n;j++) m[j]=_mm_xor_si128(_mm_loadu_si128((__m128i *)ctr[j]),ky);
+        k=NB;
+        for (i=1;i<a->Nr;i++)
+        {
+            ky=_mm_loadu_si128((__m128i *) &a->fkey[k]);
+            for (j=0;j<n;j++) m[j]=_mm_aesenc_si128(m[j],ky);
+            k+=4;
+        }
+        ky=_mm_loadu_si128((__m128i *) &a->fkey[k]);
+        for (j=0;j<n;j++)
+        {
+            m[j]=_mm_aesenclast_si128(m[j],ky);
+            m[j]=_mm_xor_si128(m[j],_mm_loadu_si128((__m128i *)&in[16*j]));
+            _mm_storeu_si128((__m128i *)&out[16*j],m[j]);
+        }
+        in+=16*n; out+=16*n; nblocks-=n;
+    }
+}
+
+#endif
+
 void aes_reset(aes *a,int mode,char *iv)
 { /* reset mode, or reset iv */
     int i;
@@ -615,6 +717,11 @@ BOOL aes_init(aes* a,int mode,int nk,char *key,char *iv)
     nr=6+nk;
 
     a->Nk=nk; a->Nr=nr;
+#ifdef AES_NI_SUPPORT
+    a->ni=aesni_available();
+#else
+    a->ni=0;
+#endif
 
     aes_reset(a,mode,iv);
 
@@ -662,21 +769,12 @@ void aes_ecb_encrypt(aes *a,MR_BYTE *buff)
     MR_WORD p[4],q[4],*x,*y,*t;
 
 #ifdef AES_NI_SUPPORT
-	__m128i ky,m = _mm_loadu_si128((__m128i *) buff);
-	ky = _mm_loadu_si128((__m128i *) &a->fkey[0]);
-    m = _mm_xor_si128       (m, ky); 
-	k=NB;
-	for (i=1;i<a->Nr;i++)
-	{
-		ky=_mm_loadu_si128((__m128i *) &a->fkey[k]);
-		m =_mm_aesenc_si128(m, ky); 
-		k+=4;
-	}
-	ky=_mm_loadu_si128((__m128i *) &a->fkey[k]);
-    m=_mm_aesenclast_si128(m, ky);
-
-    _mm_storeu_si128((__m128i *)buff, m);
-#else
+    if (a->ni)
+    {
+        aesni_ecb_encrypt(a,buff);
+        return;
+    }
+#endif
 
     for (i=j=0;i<NB;i++,j+=4)
     {
@@ -753,7 +851,6 @@ void aes_ecb_encrypt(aes *a,MR_BYTE *buff)
         unpack(y[i],(MR_BYTE *)&buff[j]);
         x[i]=y[i]=0;   /* clean up stack */
     }
-#endif
 }
 
 void aes_ecb_decrypt(aes *a,MR_BYTE *buff)
@@ -762,21 +859,12 @@ void aes_ecb_decrypt(aes *a,MR_BYTE *buff)
     MR_WORD p[4],q[4],*x,*y,*t;
 
 #ifdef AES_NI_SUPPORT
-	__m128i ky,m = _mm_loadu_si128((__m128i *) buff);
-	ky = _mm_loadu_si128((__m128i *) &a->rkey[0]);
-    m = _mm_xor_si128       (m, ky); 
-	k=NB;
-	for (i=1;i<a->Nr;i++)
-	{
-		ky=_mm_loadu_si128((__m128i *) &a->rkey[k]);
-		m =_mm_aesdec_si128    (m, ky); 
-		k+=4;
-	}
-	ky=_mm_loadu_si128((__m128i *) &a->rkey[k]);
-    m=_mm_aesdeclast_si128(m, ky);
-
-    _mm_storeu_si128((__m128i *)buff, m);
-#else
+    if (a->ni)
+    {
+        aesni_ecb_decrypt(a,buff);
+        return;
+    }
+#endif
 
     for (i=j=0;i<NB;i++,j+=4)
     {
@@ -852,7 +940,81 @@ void aes_ecb_decrypt(aes *a,MR_BYTE *buff)
         unpack(y[i],(MR_BYTE *)&buff[j]);
         x[i]=y[i]=0;   /* clean up stack */
     }
+}
+
+/* one column of a full round, and of the last round, for the blocks below */
+
+#ifndef MR_SMALL_AES
+#define FCOL(w,b,c,d) (ftable[MR_TOBYTE(w)]^ftable1[MR_TOBYTE((b)>>8)]^ \
+                       ftable2[MR_TOBYTE((c)>>16)]^ftable3[(d)>>24])
+#else
+#define FCOL(w,b,c,d) (ftable[MR_TOBYTE(w)]^ROTL8(ftable[MR_TOBYTE((b)>>8)])^ \
+                       ROTL16(ftable[MR_TOBYTE((c)>>16)])^ROTL24(ftable[(d)>>24]))
 #endif
+#define FLAST(w,b,c,d) ((MR_WORD)fbsub[MR_TOBYTE(w)]^ROTL8((MR_WORD)fbsub[MR_TOBYTE((b)>>8)])^ \
+                        ROTL16((MR_WORD)fbsub[MR_TOBYTE((c)>>16)])^ROTL24((MR_WORD)fbsub[(d)>>24]))
+
+static void ecb_encrypt_blocks(aes *a,MR_BYTE b[4][16],int n)
+{ /* encrypt n<=4 blocks in place, a round of each in turn, so that the table 
+     lookups of the independent blocks overlap */
+    int i,j,k;
+    MR_WORD p[4][4],q[4][4],(*x)[4],(*y)[4],(*t)[4];
+
+    for (j=0;j<n;j++)
+        for (i=0;i<NB;i++) p[j][i]=pack(&b[j][4*i])^a->fkey[i];
+
+    k=NB;
+    x=p; y=q;
+    for (i=1;i<a->Nr;i++)
+    {
+        for (j=0;j<n;j++)
+        {
+            y[j][0]=a->fkey[k]^FCOL(x[j][0],x[j][1],x[j][2],x[j][3]);
+            y[j][1]=a->fkey[k+1]^FCOL(x[j][1],x[j][2],x[j][3],x[j][0]);
+            y[j][2]=a->fkey[k+2]^FCOL(x[j][2],x[j][3],x[j][0],x[j][1]);
+            y[j][3]=a->fkey[k+3]^FCOL(x[j][3],x[j][0],x[j][1],x[j][2]);
+        }
+        k+=4;
+        t=x; x=y; y=t;
+    }
+    for (j=0;j<n;j++)
+    {
+        y[j][0]=a->fkey[k]^FLAST(x[j][0],x[j][1],x[j][2],x[j][3]);
+        y[j][1]=a->fkey[k+1]^FLAST(x[j][1],x[j][2],x[j][3],x[j][0]);
+        y[j][2]=a->fkey[k+2]^FLAST(x[j][2],x[j][3],x[j][0],x[j][1]);
+        y[j][3]=a->fkey[k+3]^FLAST(x[j][3],x[j][0],x[j][1],x[j][2]);
+        for (i=0;i<NB;i++)
+        {
+            unpack(y[j][i],&b[j][4*i]);
+            x[j][i]=y[j][i]=0;   /* clean up stack */
+        }
+    }
+}
+
+void aes_ctr_encrypt_blocks(aes *a,char *in,char *out,int nblocks)
+{ /* Counter mode - XOR nblocks 16-byte blocks of in with the encrypted counter, into out. in and out may be the same.
+     The counter is the register set by the IV, and its last 32 bits are incremented (big-endian) after each block */
+    int i,j,n;
+    MR_BYTE ks[4][16];
+
+#ifdef AES_NI_SUPPORT
+    if (a->ni)
+    {
+        aesni_ctr(a,(MR_BYTE *)in,(MR_BYTE *)out,nblocks);
+        return;
+    }
+#endif
+    while (nblocks>0)
+    {
+        n=nblocks; if (n>4) n=4;
+        for (j=0;j<n;j++) next_counter(a,ks[j]);
+        ecb_encrypt_blocks(a,ks,n);
+        for (j=0;j<n;j++)
+            for (i=0;i<4*NB;i++) out[16*j+i]=in[16*j+i]^ks[j][i];
+        in+=16*n; out+=16*n; nblocks-=n;
+    }
+    for (j=0;j<4;j++)
+        for (i=0;i<4*NB;i++) ks[j][i]=0;
 }
 
 mr_unsign32 aes_encrypt(aes* a,char *buff)
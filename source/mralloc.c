@@ -42,13 +42,344 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
  *
  *   NOTE: uses calloc() which initialises memory to Zero, so make sure
  *   any substituted routine does the same!
+ *
+ *   If MR_ALLOC_POOL is defined in mirdef.h, each instance instead allocates
+ *   from its own pool. Freed blocks of up to MR_POOL_CLASSES distinct sizes 
+ *   (typically the bigs of a fixed nib) are kept on free lists and recycled.
+ *   Between mr_arena_mark() and mr_arena_release() all allocations are 
+ *   simply bumped off an arena, and are all discarded together on release.
+ *   The backing allocator can be replaced by mr_set_allocator(), and the 
+ *   traffic monitored by mr_alloc_counters().
+ *
+ *   Every block is preceded by a header recording the pool it came from, 
+ *   as mr_free() is not told the instance. A pool closed by mirexit()
+ *   lives on until its last block is freed. With MR_UNIX_MT a block may be
+ *   freed by a thread other than its owner's, so each pool has a mutex 
+ *   guarding its free lists and counters.
  */
 
 #include "miracl.h"
 #include <stdlib.h>
+#ifdef MR_ALLOC_POOL
+#include <string.h>
+#ifdef MR_UNIX_MT
+#include <pthread.h>
+#endif
+#endif
 
 #ifndef MR_STATIC
 
+#ifdef MR_ALLOC_POOL
+
+typedef union {
+    struct {
+        mr_pool *pool;      /* NULL for the system heap */
+        int cls;            /* size class, or one of.. */
+    } h;
+    double align[2];
+} mr_header;
+
+#define MR_HEAP_BLOCK  -1   /* ..not on a free list */
+#define MR_ARENA_BLOCK -2   /* ..arena, never freed individually */
+
+#ifdef MR_UNIX_MT
+#define POOL_LOCK(p)   pthread_mutex_lock((pthread_mutex_t *)(p)->lock)
+#define POOL_UNLOCK(p) pthread_mutex_unlock((pthread_mutex_t *)(p)->lock)
+#else
+#define POOL_LOCK(p)
+#define POOL_UNLOCK(p)
+#endif
+
+#define HDR sizeof(mr_header)
+#define CHK ((MR_ROUNDUP(sizeof(mr_chunk),HDR))*HDR)
+
+static void *heap_alloc(size_t n)
+{ /* default backing allocator */
+    return malloc(n);
+}
+
+static void *plain_alloc(size_t n)
+{ /* a block from the system heap, not belonging to any pool */
+    mr_header *b=(mr_header *)calloc(1,HDR+n);
+    if (b==NULL) return NULL;
+    b->h.pool=NULL;
+    b->h.cls=MR_HEAP_BLOCK;
+    return (void *)((char *)b+HDR);
+}
+
+mr_pool *mr_pool_create(void *(*alloc)(size_t),void (*dealloc)(void *))
+{
+    mr_pool *p=(mr_pool *)calloc(1,sizeof(mr_pool));
+    if (p==NULL) return NULL;
+    if (alloc==NULL || dealloc==NULL)
+    {
+        alloc=heap_alloc;
+        dealloc=free;
+    }
+    p->alloc=alloc;
+    p->dealloc=dealloc;
+#ifdef MR_UNIX_MT
+    p->lock=malloc(sizeof(pthread_mutex_t));
+    if (p->lock==NULL)
+    {
+        free(p);
+        return NULL;
+    }
+    pthread_mutex_init((pthread_mutex_t *)p->lock,NULL);
+#endif
+    return p;
+}
+
+static void pool_destroy(mr_pool *p)
+{
+    mr_chunk *c,*n;
+    for (c=p->first;c!=NULL;c=n)
+    {
+        n=c->next;
+        p->dealloc(c);
+    }
+#ifdef MR_UNIX_MT
+    pthread_mutex_destroy((pthread_mutex_t *)p->lock);
+    free(p->lock);
+#endif
+    free(p);
+}
+
+void mr_pool_close(mr_pool *p)
+{ /* return cached blocks and arena. Destroy pool when nothing is still out */
+    int i;
+    BOOL gone;
+    void *b,*n;
+    if (p==NULL) return;
+    POOL_LOCK(p);
+    for (i=0;i<MR_POOL_CLASSES;i++)
+    {
+        for (b=p->list[i];b!=NULL;b=n)
+        {
+            n=*(void **)b;
+            p->dealloc((char *)b-HDR);
+            p->live--;
+        }
+        p->list[i]=NULL;
+        p->count[i]=0;
+    }
+    p->closed=TRUE;
+    gone=(p->live==0);
+    POOL_UNLOCK(p);
+    if (gone) pool_destroy(p);
+}
+
+static void *arena_alloc(mr_pool *p,size_t n)
+{ /* bump allocate from current chunk, moving on to next if necessary */
+    mr_header *b;
+    mr_chunk *c=p->chunk,*nx;
+    n=HDR+(MR_ROUNDUP(n,HDR))*HDR;
+    if (c==NULL || c->top+n>c->size)
+    {
+        if (c==NULL) nx=p->first;
+        else         nx=c->next;
+        if (nx!=NULL && nx->size>=n)
+            c=nx;
+        else
+        { /* grab a new chunk, and link it in after the current one */
+            size_t sz=MR_ARENA_CHUNK;
+            if (n>sz) sz=n;
+            c=(mr_chunk *)p->alloc(CHK+sz);
+            if (c==NULL) return NULL;
+            p->stats.heap++;
+            c->size=sz;
+            if (p->chunk==NULL)
+            {
+                c->next=p->first;
+                p->first=c;
+            }
+            else
+            {
+                c->next=p->chunk->next;
+                p->chunk->next=c;
+            }
+        }
+        c->top=0;
+        p->chunk=c;
+    }
+    b=(mr_header *)((char *)c+CHK+c->top);
+    c->top+=n;
+    memset((char *)b,0,n);
+    b->h.pool=p;
+    b->h.cls=MR_ARENA_BLOCK;
+    p->stats.arena++;
+    return (void *)((char *)b+HDR);
+}
+
+static void *pool_get(mr_pool *p,size_t n)
+{
+    int i,cls=MR_HEAP_BLOCK;
+    mr_header *b;
+    void *r;
+
+    p->stats.allocs++;
+    if (p->scope>0) return arena_alloc(p,n);
+
+    if (n>=sizeof(void *))
+    { /* find its size class, or start a new one */
+        for (i=0;i<MR_POOL_CLASSES;i++)
+        {
+            if (p->size[i]==(int)n) break;
+            if (p->size[i]==0) {p->size[i]=(int)n; break;}
+        }
+        if (i<MR_POOL_CLASSES) cls=i;
+    }
+    if (cls>=0 && p->list[cls]!=NULL)
+    { /* recycle */
+        r=p->list[cls];
+        p->list[cls]=*(void **)r;
+        p->count[cls]--;
+        memset((char *)r,0,n);
+        p->stats.recycled++;
+        return r;
+    }
+
+    b=(mr_header *)p->alloc(HDR+n);
+    if (b==NULL) return NULL;
+    memset((char *)b,0,HDR+n);
+    b->h.pool=p;
+    b->h.cls=cls;
+    p->live++;
+    p->stats.heap++;
+    return (void *)((char *)b+HDR);
+}
+
+static void *pool_alloc(mr_pool *p,size_t n)
+{
+    void *r;
+    POOL_LOCK(p);
+    r=pool_get(p,n);
+    POOL_UNLOCK(p);
+    return r;
+}
+
+static void pool_free(mr_pool *p,mr_header *b)
+{ /* may be called from any thread */
+    int cls=b->h.cls;
+    BOOL gone;
+    void *r=(void *)((char *)b+HDR);
+    POOL_LOCK(p);
+    p->stats.frees++;
+    if (cls>=0 && !p->closed && p->count[cls]<MR_POOL_DEPTH)
+    {
+        *(void **)r=p->list[cls];
+        p->list[cls]=r;
+        p->count[cls]++;
+        POOL_UNLOCK(p);
+        return;
+    }
+    p->dealloc(b);
+    p->live--;
+    gone=(p->closed && p->live==0);
+    POOL_UNLOCK(p);
+    if (gone) pool_destroy(p);
+}
+
+void mr_set_allocator(_MIPD_ void *(*alloc)(size_t),void (*dealloc)(void *))
+{ /* start a new pool. Blocks from the old one will be returned to it. 
+     NULL parameters restore the system heap */
+    mr_pool *p;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return;
+    p=mr_pool_create(alloc,dealloc);
+    if (p==NULL)
+    {
+        mr_berror(_MIPP_ MR_ERR_OUT_OF_MEMORY);
+        return;
+    }
+    mr_pool_close(mr_mip->pool);
+    mr_mip->pool=p;
+}
+
+BOOL mr_arena_mark(_MIPDO_ )
+{ /* open an arena scope */
+    mr_pool *p;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    p=mr_mip->pool;
+    if (p==NULL || p->scope>=MR_ARENA_DEPTH) return FALSE;
+    p->mchunk[p->scope]=p->chunk;
+    p->mtop[p->scope]=(p->chunk==NULL)?0:p->chunk->top;
+    p->scope++;
+    return TRUE;
+}
+
+void mr_arena_release(_MIPDO_ )
+{ /* close innermost arena scope, discarding everything allocated within it */
+    mr_pool *p;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    p=mr_mip->pool;
+    if (p==NULL || p->scope==0) return;
+    p->scope--;
+    p->chunk=p->mchunk[p->scope];
+    if (p->chunk!=NULL) p->chunk->top=p->mtop[p->scope];
+}
+
+void mr_alloc_counters(_MIPD_ mr_alloc_stats *s,BOOL reset)
+{ /* report, and optionally reset, allocation counters */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->pool==NULL) return;
+    POOL_LOCK(mr_mip->pool);
+    if (s!=NULL) *s=mr_mip->pool->stats;
+    if (reset) memset((char *)&mr_mip->pool->stats,0,sizeof(mr_alloc_stats));
+    POOL_UNLOCK(mr_mip->pool);
+}
+
+miracl *mr_first_alloc()
+{
+    return (miracl *)plain_alloc(sizeof(miracl));
+}
+
+void *mr_alloc(_MIPD_ int num,int size)
+{
+    char *p; 
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+
+    if (mr_mip==NULL) 
+    {
+        p=(char *)plain_alloc((size_t)num*size);
+        return (void *)p;
+    }
+ 
+    if (mr_mip->ERNUM) return NULL;
+
+    if (mr_mip->pool==NULL) p=(char *)plain_alloc((size_t)num*size);
+    else                    p=(char *)pool_alloc(mr_mip->pool,(size_t)num*size);
+    if (p==NULL) mr_berror(_MIPP_ MR_ERR_OUT_OF_MEMORY);
+    return (void *)p;
+
+}
+
+void mr_free(void *addr)
+{
+    mr_header *b;
+    if (addr==NULL) return;
+    b=(mr_header *)((char *)addr-HDR);
+    if (b->h.pool==NULL)
+    {
+        free(b);
+        return;
+    }
+    if (b->h.cls==MR_ARENA_BLOCK) return;
+    pool_free(b->h.pool,b);
+}
+
+#else
+
 miracl *mr_first_alloc()
 {
     return (miracl *)calloc(1,sizeof(miracl));
@@ -83,3 +414,5 @@ void mr_free(void *addr)
 }
 
 #endif
+
+#endif
@@ -93,6 +93,620 @@ mr_small normalise(_MIPD_ big x,big y)
     return norm;
 }
 
+/* Karatsuba and Toom-3 multiplication, used by multiply() for full-width *
+ * bases when both numbers have at least mr_mip->KARATSUBA words, and     *
+ * Toom-3 from mr_mip->TOOM3 words. These work on arrays of words, with   *
+ * results always of length an+bn, and workspace ws of mr_tier_space()    */
+
+#if !defined(MR_STATIC) && !defined(MR_NOFULLWIDTH) && !defined(MR_FP)
+
+#define MR_TIERS
+
+static int mr_tier_space(int an,int bn)
+{ /* bound on workspace needed, in words */
+    return 6*(an+bn)+512;
+}
+
+static mr_small mr_wadd(mr_small *a,int an,mr_small *b,int bn,mr_small *r)
+{ /* r=a+b, an>=bn. Returns carry */
+    int i;
+    mr_small c=0,t;
+    for (i=0;i<bn;i++)
+    {
+        t=a[i]+c; c=(t<c);
+        r[i]=t+b[i]; c+=(r[i]<t);
+    }
+    for (;i<an;i++)
+    {
+        t=a[i]; r[i]=t+c; c=(r[i]<t);
+    }
+    return c;
+}
+
+static mr_small mr_wsub(mr_small *a,int an,mr_small *b,int bn,mr_small *r)
+{ /* r=a-b, an>=bn. Returns borrow */
+    int i;
+    mr_small c=0,t,u;
+    for (i=0;i<bn;i++)
+    {
+        t=a[i]; u=t-b[i];
+        r[i]=u-c; c=(u>t)+(r[i]>u);
+    }
+    for (;i<an;i++)
+    {
+        t=a[i]; r[i]=t-c; c=(r[i]>t);
+    }
+    return c;
+}
+
+static BOOL mr_wabsdiff(mr_small *a,int an,mr_small *b,int bn,mr_small *r)
+{ /* r=|a-b| to an words, an>=bn. Returns TRUE if a<b */
+    int i;
+    for (i=an-1;i>=bn;i--) if (a[i]!=0) break;
+    if (i<bn)
+    {
+        for (i=bn-1;i>=0;i--) if (a[i]!=b[i]) break;
+        if (i>=0 && a[i]<b[i])
+        {
+            mr_wsub(b,bn,a,bn,r);
+            for (i=bn;i<an;i++) r[i]=0;
+            return TRUE;
+        }
+    }
+    mr_wsub(a,an,b,bn,r);
+    return FALSE;
+}
+
+static void mr_wneg(mr_small *a,int n)
+{ /* two's complement negation */
+    int i;
+    mr_small c=1;
+    for (i=0;i<n;i++)
+    {
+        a[i]=~a[i]+c;
+        c=(c && a[i]==0);
+    }
+}
+
+static void mr_wmul(mr_small *a,int an,mr_small *b,int bn,mr_small *r)
+{ /* schoolbook r=a*b */
+    int i,j;
+    mr_small carry;
+#ifdef MR_ITANIUM
+    mr_small tm;
+#endif
+#ifdef MR_WIN64
+    mr_small tm,tr;
+#endif
+#ifdef MR_NOASM
+    union doubleword dble;
+#endif
+    for (j=0;j<bn;j++) r[j]=0;
+    for (i=0;i<an;i++)
+    {
+        carry=0;
+        for (j=0;j<bn;j++)
+        {
+#ifdef MR_NOASM
+            dble.d=(mr_large)a[i]*b[j]+carry+r[i+j];
+            r[i+j]=dble.h[MR_BOT];
+            carry=dble.h[MR_TOP];
+#else
+            muldvd2(a[i],b[j],&carry,&r[i+j]);
+#endif
+        }
+        r[bn+i]=carry;
+    }
+}
+
+static void mr_wsqr(mr_small *a,int n,mr_small *r)
+{ /* schoolbook r=a*a - only above the diagonal, doubled */
+    int i,j;
+    mr_small carry;
+#ifdef MR_ITANIUM
+    mr_small tm;
+#endif
+#ifdef MR_WIN64
+    mr_small tm,tr;
+#endif
+#ifdef MR_NOASM
+    union doubleword dble;
+#endif
+    for (i=0;i<2*n;i++) r[i]=0;
+    for (i=0;i<n-1;i++)
+    {
+        carry=0;
+        for (j=i+1;j<n;j++)
+        {
+#ifdef MR_NOASM
+            dble.d=(mr_large)a[i]*a[j]+carry+r[i+j];
+            r[i+j]=dble.h[MR_BOT];
+            carry=dble.h[MR_TOP];
+#else
+            muldvd2(a[i],a[j],&carry,&r[i+j]);
+#endif
+        }
+        r[n+i]=carry;
+    }
+    mr_wadd(r,2*n,r,2*n,r);
+    carry=0;
+    for (i=0;i<n;i++)
+    {
+#ifdef MR_NOASM
+        dble.d=(mr_large)a[i]*a[i]+carry+r[2*i];
+        r[2*i]=dble.h[MR_BOT];
+        carry=dble.h[MR_TOP];
+#else
+        muldvd2(a[i],a[i],&carry,&r[2*i]);
+#endif
+        r[2*i+1]+=carry;
+        carry=(r[2*i+1]<carry);
+    }
+}
+
+static void mr_wmult(mr_small *,int,mr_small *,int,mr_small *,mr_small *,int,int);
+
+static void mr_wkara(mr_small *a,int an,mr_small *b,int bn,mr_small *r,mr_small *ws,int kt,int tt)
+{ /* Karatsuba, an>=bn>(an+1)/2. a=a1.B^m+a0, b=b1.B^m+b0, and the  *
+   * middle term is a0.b0+a1.b1-(a0-a1).(b0-b1)                     */
+    int m=(an+1)/2,n=an+bn,ln;
+    BOOL sq=(a==b && an==bn),neg=FALSE;
+    mr_small *da=ws,*db=ws+m,*t=ws+2*m,*mid=ws+4*m,*w=ws+6*m+1;
+
+    neg=mr_wabsdiff(a,m,a+m,an-m,da);
+    if (sq)
+    { /* (a0-a1)^2 is always subtracted */
+        neg=FALSE;
+        mr_wmult(da,m,da,m,t,w,kt,tt);
+        mr_wmult(a,m,a,m,r,w,kt,tt);
+        mr_wmult(a+m,an-m,a+m,an-m,r+2*m,w,kt,tt);
+    }
+    else
+    {
+        if (mr_wabsdiff(b,m,b+m,bn-m,db)) neg=!neg;
+        mr_wmult(da,m,db,m,t,w,kt,tt);
+        mr_wmult(a,m,b,m,r,w,kt,tt);
+        mr_wmult(a+m,an-m,b+m,bn-m,r+2*m,w,kt,tt);
+    }
+    mid[2*m]=mr_wadd(r,2*m,r+2*m,n-2*m,mid);
+    if (neg) mid[2*m]+=mr_wadd(mid,2*m,t,2*m,mid);
+    else     mid[2*m]-=mr_wsub(mid,2*m,t,2*m,mid);
+    ln=n-m;
+    if (ln>2*m+1) ln=2*m+1;
+    mr_wadd(r+m,n-m,mid,ln,r+m);
+}
+
+static void mr_wtoom3(mr_small *a,int an,mr_small *b,int bn,mr_small *r,mr_small *ws,int kt,int tt)
+{ /* Toom-3, an>=bn>2k. Evaluate at 0,1,-1,-2 and infinity, and *
+   * interpolate as Bodrato. Signed values are two's complement  */
+    int i,k=(an+2)/3,e=k+2,l=2*k+3,n=an+bn,ln;
+    BOOL sq=(a==b && an==bn),na,nb;
+    mr_small c,*ea1,*eam1,*eam2,*eb1,*ebm1,*ebm2,*r1,*rm1,*rm2,*rinf,*w;
+
+    ea1=ws; eam1=ea1+e; eam2=eam1+e;
+    eb1=eam2+e; ebm1=eb1+e; ebm2=ebm1+e;
+    r1=ebm2+e; rm1=r1+l; rm2=rm1+l; rinf=rm2+l; w=rinf+l;
+
+    for (i=0;i<2;i++)
+    {
+        mr_small *x=(i==0)?a:b,*p1=(i==0)?ea1:eb1,*pm1=(i==0)?eam1:ebm1,*pm2=(i==0)?eam2:ebm2;
+        int xn=(i==0)?an:bn;
+        if (i==1 && sq) break;
+        p1[k]=mr_wadd(x,k,x+2*k,xn-2*k,p1); p1[k+1]=0;   /* a0+a2 */
+        for (xn=0;xn<e;xn++) pm1[xn]=p1[xn];
+        xn=(i==0)?an:bn;
+        mr_wsub(pm1,e,x+k,k,pm1);                         /* a0-a1+a2 */
+        mr_wadd(p1,e,x+k,k,p1);                           /* a0+a1+a2 */
+        mr_wadd(pm1,e,x+2*k,xn-2*k,pm2);
+        mr_wadd(pm2,e,pm2,e,pm2);
+        mr_wsub(pm2,e,x,k,pm2);                           /* a0-2a1+4a2 */
+    }
+    if (sq) { eb1=ea1; ebm1=eam1; ebm2=eam2; }
+
+    na=(eam1[e-1]>>(MIRACL-1))!=0; if (na) mr_wneg(eam1,e);
+    nb=(ebm1[e-1]>>(MIRACL-1))!=0; if (nb && !sq) mr_wneg(ebm1,e);
+    mr_wmult(eam1,k+1,ebm1,k+1,rm1,w,kt,tt);
+    rm1[l-1]=0;
+    if (na!=nb && !sq) mr_wneg(rm1,l);
+
+    na=(eam2[e-1]>>(MIRACL-1))!=0; if (na) mr_wneg(eam2,e);
+    nb=(ebm2[e-1]>>(MIRACL-1))!=0; if (nb && !sq) mr_wneg(ebm2,e);
+    mr_wmult(eam2,k+1,ebm2,k+1,rm2,w,kt,tt);
+    rm2[l-1]=0;
+    if (na!=nb && !sq) mr_wneg(rm2,l);
+
+    mr_wmult(ea1,k+1,eb1,k+1,r1,w,kt,tt);
+    r1[l-1]=0;
+    for (i=an+bn-4*k;i<l;i++) rinf[i]=0;
+    mr_wmult(a+2*k,an-2*k,b+2*k,bn-2*k,rinf,w,kt,tt);
+    mr_wmult(a,k,b,k,r,w,kt,tt);       /* r0 in place */
+    for (i=2*k;i<n;i++) r[i]=0;
+
+/* r3=(rm2-r1)/3, held in rm2 */
+    mr_wsub(rm2,l,r1,l,rm2);
+    na=(rm2[l-1]>>(MIRACL-1))!=0; if (na) mr_wneg(rm2,l);
+    for (c=0,i=l-1;i>=0;i--)
+    {
+#ifdef MR_NOASM
+        mr_large d=((mr_large)c<<MIRACL)+rm2[i];
+        rm2[i]=(mr_small)(d/3); c=(mr_small)(d%3);
+#else
+        rm2[i]=muldvm(c,rm2[i],(mr_small)3,&c);
+#endif
+    }
+    if (na) mr_wneg(rm2,l);
+/* r1=(r1-rm1)/2 */
+    mr_wsub(r1,l,rm1,l,r1);
+    for (i=0;i<l-1;i++) r1[i]=(r1[i]>>1)|(r1[i+1]<<(MIRACL-1));
+    r1[l-1]=(mr_small)((mr_utype)r1[l-1]>>1);
+/* r2=rm1-r0, held in rm1 */
+    mr_wsub(rm1,l,r,2*k,rm1);
+/* r3=(r2-r3)/2+2.rinf */
+    mr_wsub(rm1,l,rm2,l,rm2);
+    for (i=0;i<l-1;i++) rm2[i]=(rm2[i]>>1)|(rm2[i+1]<<(MIRACL-1));
+    rm2[l-1]=(mr_small)((mr_utype)rm2[l-1]>>1);
+    mr_wadd(rm2,l,rinf,l,rm2);
+    mr_wadd(rm2,l,rinf,l,rm2);
+/* r2=r2+r1-rinf */
+    mr_wadd(rm1,l,r1,l,rm1);
+    mr_wsub(rm1,l,rinf,l,rm1);
+/* r1=r1-r3 */
+    mr_wsub(r1,l,rm2,l,r1);
+
+/* recombine - all coefficients are now positive */
+    ln=n-k;   if (ln>l) ln=l; mr_wadd(r+k,n-k,r1,ln,r+k);
+    ln=n-2*k; if (ln>l) ln=l; mr_wadd(r+2*k,n-2*k,rm1,ln,r+2*k);
+    ln=n-3*k; if (ln>l) ln=l; mr_wadd(r+3*k,n-3*k,rm2,ln,r+3*k);
+    ln=n-4*k; if (ln>l) ln=l; mr_wadd(r+4*k,n-4*k,rinf,ln,r+4*k);
+}
+
+static void mr_wmult(mr_small *a,int an,mr_small *b,int bn,mr_small *r,mr_small *ws,int kt,int tt)
+{ /* r=a*b, choosing the method by size */
+    int i,k,ln;
+    mr_small c,*t;
+    if (an<bn)
+    {
+        t=a; a=b; b=t;
+        i=an; an=bn; bn=i;
+    }
+    if (bn<kt)
+    {
+        if (a==b && an==bn && an>SQR_FASTER_THRESHOLD) mr_wsqr(a,an,r);
+        else mr_wmul(a,an,b,bn,r);
+        return;
+    }
+    if (2*bn<=an+1)
+    { /* unbalanced - split a into pieces the size of b */
+        mr_wmult(a,bn,b,bn,r,ws,kt,tt);
+        for (k=bn;k<an;k+=bn)
+        {
+            ln=an-k;
+            if (ln>bn) ln=bn;
+            mr_wmult(a+k,ln,b,bn,ws,ws+2*bn,kt,tt);
+            c=mr_wadd(r+k,bn,ws,bn,r+k);
+            for (i=0;i<ln;i++) r[k+bn+i]=ws[bn+i];
+            if (c!=0) mr_wadd(r+k+bn,ln,&c,1,r+k+bn);
+        }
+        return;
+    }
+    if (tt>0 && bn>=tt && bn>2*((an+2)/3)) mr_wtoom3(a,an,b,bn,r,ws,kt,tt);
+    else mr_wkara(a,an,b,bn,r,ws,kt,tt);
+}
+
+static BOOL mr_tier_mult(_MIPD_ mr_small *a,int an,mr_small *b,int bn,mr_small *r)
+{ /* r=a*b by Karatsuba/Toom-3, FALSE if out of memory */
+    int kt;
+    mr_small *ws;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    kt=mr_mip->KARATSUBA;
+    ws=(mr_small *)mr_alloc(_MIPP_ mr_tier_space(an,bn),sizeof(mr_small));
+    if (ws==NULL) return FALSE;
+    if (kt<4) kt=4;
+    mr_wmult(a,an,b,bn,r,ws,kt,mr_mip->TOOM3);
+    mr_free(ws);
+    return TRUE;
+}
+
+/* Division for full-width bases, on arrays of words. mr_wdivbase() is   *
+ * Knuth's algorithm D, mr_wdiv21() the Burnikel-Ziegler recursion over  *
+ * it, used by divide() when both divisor and quotient have at least     *
+ * mr_mip->BURNIKEL words. mr_wbarrett() reduces with a reciprocal of    *
+ * the divisor, which divide() keeps for the last divisor of at least    *
+ * mr_mip->BARRETT words, for when the next division is by the same one  */
+
+static int mr_wcmp(mr_small *a,mr_small *b,int n)
+{
+    int i;
+    for (i=n-1;i>=0;i--)
+    {
+        if (a[i]>b[i]) return 1;
+        if (a[i]<b[i]) return -1;
+    }
+    return 0;
+}
+
+static void mr_wdivbase(mr_small *a,int an,mr_small *b,int bn,mr_small *q)
+{ /* q=a/b, a=a mod b. b normalised, bn>=2, and a<B^(an-bn).b */
+    int i,j;
+    mr_small qh,rh,ldb,sdb,carry,brw,hi,lo,t,u;
+    BOOL over;
+#ifdef MR_ITANIUM
+    mr_small tm;
+#endif
+#ifdef MR_WIN64
+    mr_small tm;
+#endif
+    ldb=b[bn-1];
+    sdb=b[bn-2];
+    for (j=an-bn-1;j>=0;j--)
+    { /* guess next quotient digit */
+        over=FALSE;
+        if (a[j+bn]==ldb)
+        {
+            qh=(mr_small)(-1);
+            rh=ldb+a[j+bn-1];
+            over=(rh<ldb);
+        }
+        else qh=muldvm(a[j+bn],a[j+bn-1],ldb,&rh);
+        while (!over)
+        { /* refine it */
+            hi=muldvd(sdb,qh,(mr_small)0,&lo);
+            if (hi<rh || (hi==rh && lo<=a[j+bn-2])) break;
+            qh--;
+            rh+=ldb;
+            over=(rh<ldb);
+        }
+        carry=brw=0;
+        for (i=0;i<bn;i++)
+        {
+            hi=muldvd(qh,b[i],carry,&lo);
+            carry=hi;
+            t=a[j+i]; u=t-lo;
+            a[j+i]=u-brw; brw=(u>t)+(a[j+i]>u);
+        }
+        t=a[j+bn]; u=t-carry;
+        a[j+bn]=u-brw;
+        if (u>t || a[j+bn]>u)
+        { /* over did it */
+            qh--;
+            mr_wadd(a+j,bn+1,b,bn,a+j);
+        }
+        q[j]=qh;
+    }
+}
+
+static void mr_wdiv21(mr_small *,mr_small *,int,mr_small *,mr_small *,int,int,int);
+
+static void mr_wdiv32(mr_small *a,mr_small *b,int h,mr_small *q,mr_small *ws,int bt,int kt,int tt)
+{ /* q=a/b, a=a mod b, a of 3h words, b=b1.B^h+b2 of 2h, a<B^h.b */
+    int i;
+    if (mr_wcmp(a+2*h,b+h,h)<0) mr_wdiv21(a+h,b+h,h,q,ws,bt,kt,tt);
+    else
+    { /* top of a equals b1 - quotient digit is B^h-1 */
+        for (i=0;i<h;i++) q[i]=(mr_small)(-1);
+        a[2*h]=mr_wadd(a+h,h,b+h,h,a+h);
+        for (i=2*h+1;i<3*h;i++) a[i]=0;
+    }
+    mr_wmult(q,h,b,h,ws,ws+2*h,kt,tt);
+    if (mr_wsub(a,2*h+1,ws,2*h,a))
+    { /* at most two add-backs */
+        do
+        {
+            for (i=0;i<h;i++) if (q[i]--!=0) break;
+        } while (!mr_wadd(a,2*h+1,b,2*h,a));
+    }
+}
+
+static void mr_wdiv21(mr_small *a,mr_small *b,int n,mr_small *q,mr_small *ws,int bt,int kt,int tt)
+{ /* q=a/b, a=a mod b, a of 2n words, b of n, a<B^n.b */
+    int h;
+    if ((n&1) || n<bt)
+    {
+        mr_wdivbase(a,2*n,b,n,q);
+        return;
+    }
+    h=n/2;
+    mr_wdiv32(a+h,b,h,q+h,ws,bt,kt,tt);
+    mr_wdiv32(a,b,h,q,ws,bt,kt,tt);
+}
+
+static int mr_tier_kt(_MIPDO_ )
+{ /* Karatsuba crossover for the multiplications in division */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->KARATSUBA<=0) return MR_TOOBIG;
+    if (mr_mip->KARATSUBA<4) return 4;
+    return mr_mip->KARATSUBA;
+}
+
+static BOOL mr_tier_divide(_MIPD_ mr_small *a,int an,mr_small *b,int bn,mr_small *q)
+{ /* q=a/b to an-bn words if q!=NULL, a=a mod b. b normalised, and    *
+   * a<B^(an-bn).b. Divisor is padded with zero words to n=j.2^k, j<bt *
+   * and a is taken n words at a time, any short top piece by algorithm *
+   * D. FALSE if out of memory                                          */
+    int i,m,n,s,c,r,len,bt;
+    mr_small *mem,*ta,*tb,*tq,*ws;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    bt=mr_mip->BURNIKEL;
+    if (bt<4) bt=4;
+    for (m=1;(bn+m-1)/m>=bt;m*=2) ;
+    n=m*((bn+m-1)/m);
+    s=n-bn;
+    c=(an-bn)/n;
+    r=an-bn-c*n;
+    if (2*r>=n)
+    { /* pad a with zeros instead */
+        c++;
+        r=0;
+    }
+    len=(c+1)*n+r;
+    mem=(mr_small *)mr_alloc(_MIPP_ len+n+c*n+r+2*n+mr_tier_space(n,n),sizeof(mr_small));
+    if (mem==NULL) return FALSE;
+    ta=mem; tb=ta+len; tq=tb+n; ws=tq+c*n+r;
+
+    for (i=0;i<s;i++) ta[i]=tb[i]=0;
+    for (i=0;i<an;i++) ta[s+i]=a[i];
+    for (i=s+an;i<len;i++) ta[i]=0;
+    for (i=0;i<bn;i++) tb[s+i]=b[i];
+
+    if (r>0) mr_wdivbase(ta+c*n,n+r,tb,n,tq+c*n);
+    for (i=c-1;i>=0;i--)
+        mr_wdiv21(ta+i*n,tb,n,tq+i*n,ws,bt,mr_tier_kt(_MIPPO_ ),mr_mip->TOOM3);
+
+    if (q!=NULL) for (i=0;i<an-bn;i++) q[i]=tq[i];
+    for (i=0;i<bn;i++) a[i]=ta[s+i];
+    for (;i<an;i++) a[i]=0;
+    mr_free(mem);
+    return TRUE;
+}
+
+static void mr_wmulhi(mr_small *a,int an,mr_small *b,int bn,int k,mr_small *r)
+{ /* r=a*b, omitting partial products below word k-1. Words from *
+   * k+1 up are short by at most one, if k<B                       */
+    int i,j;
+    mr_small carry;
+#ifdef MR_ITANIUM
+    mr_small tm;
+#endif
+#ifdef MR_WIN64
+    mr_small tm,tr;
+#endif
+#ifdef MR_NOASM
+    union doubleword dble;
+#endif
+    for (j=0;j<an+bn;j++) r[j]=0;
+    for (i=0;i<an;i++)
+    {
+        carry=0;
+        for (j=(i<k-1)?k-1-i:0;j<bn;j++)
+        {
+#ifdef MR_NOASM
+            dble.d=(mr_large)a[i]*b[j]+carry+r[i+j];
+            r[i+j]=dble.h[MR_BOT];
+            carry=dble.h[MR_TOP];
+#else
+            muldvd2(a[i],b[j],&carry,&r[i+j]);
+#endif
+        }
+        r[bn+i]=carry;
+    }
+}
+
+static void mr_wmullo(mr_small *a,int an,mr_small *b,int bn,int k,mr_small *r)
+{ /* r=a*b mod B^k */
+    int i,j;
+    mr_small carry;
+#ifdef MR_ITANIUM
+    mr_small tm;
+#endif
+#ifdef MR_WIN64
+    mr_small tm,tr;
+#endif
+#ifdef MR_NOASM
+    union doubleword dble;
+#endif
+    for (j=0;j<k;j++) r[j]=0;
+    for (i=0;i<an && i<k;i++)
+    {
+        carry=0;
+        for (j=0;j<bn && i+j<k;j++)
+        {
+#ifdef MR_NOASM
+            dble.d=(mr_large)a[i]*b[j]+carry+r[i+j];
+            r[i+j]=dble.h[MR_BOT];
+            carry=dble.h[MR_TOP];
+#else
+            muldvd2(a[i],b[j],&carry,&r[i+j]);
+#endif
+        }
+        if (i+bn<k) r[i+bn]=carry;
+    }
+}
+
+static void mr_wbarrett(mr_small *a,int an,mr_small *b,int n,mr_small *mu,mr_small *q,mr_small *ws,int kt,int tt)
+{ /* q=a/b if q!=NULL, a=a mod b, with mu=(B^2n-1)/b. The top n words *
+   * of a are less than b. Each step takes l<=n words of quotient,    *
+   * using short products below the Karatsuba crossover              */
+    int i,j,l,p;
+    mr_small *t=ws,*u=ws+2*n+2,*w=u+2*n+2;
+    p=an-n;
+    while (p>0)
+    {
+        l=p;
+        if (l>n) l=n;
+        p-=l;
+        if (n<kt)
+        {
+            mr_wmulhi(a+p+n-1,l+1,mu,n+1,n,t);
+            mr_wmullo(t+n+1,l,b,n,n+1,u);
+        }
+        else
+        {
+            mr_wmult(a+p+n-1,l+1,mu,n+1,t,w,kt,tt);
+            mr_wmult(t+n+1,l,b,n,u,w,kt,tt);
+        }
+        mr_wsub(a+p,n+1,u,n+1,a+p);     /* estimate is short by at most 4 */
+        for (i=n+1;i<n+l;i++) a[p+i]=0;
+        while (a[p+n]!=0 || mr_wcmp(a+p,b,n)>=0)
+        {
+            a[p+n]-=mr_wsub(a+p,n,b,n,a+p);
+            for (j=0;j<l;j++) if (++t[n+1+j]!=0) break;
+        }
+        if (q!=NULL) for (j=0;j<l;j++) q[p+j]=t[n+1+j];
+    }
+}
+
+static BOOL mr_tier_reduce(_MIPD_ mr_small *a,int an,mr_small *b,int bn,mr_small *q)
+{ /* as mr_tier_divide(), but with the cached reciprocal of b, and b  *
+   * need not be normalised. FALSE if b is not the cached divisor, in *
+   * which case b is remembered, and its reciprocal found next time   */
+    int i,sh;
+    mr_small *mu,*ws,*t;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->rdiv==NULL || mr_mip->rlen!=bn || mr_wcmp(mr_mip->rdiv,b,bn)!=0)
+    {
+        if (mr_mip->rlen!=bn)
+        {
+            mr_free(mr_mip->rdiv);
+            mr_mip->rlen=0;
+            mr_mip->rdiv=(mr_small *)mr_alloc(_MIPP_ 2*bn+1+4*bn+4+mr_tier_space(2*bn+2,2*bn+2),sizeof(mr_small));
+            if (mr_mip->rdiv==NULL) return FALSE;
+            mr_mip->rlen=bn;
+        }
+        for (i=0;i<bn;i++) mr_mip->rdiv[i]=b[i];
+        mr_mip->rready=FALSE;
+        return FALSE;
+    }
+    mu=mr_mip->rdiv+bn;
+    ws=mu+bn+1;
+    if (!mr_mip->rready)
+    { /* second time - find mu=(B^2n-1)/b, normalising b for the division */
+        t=ws;
+        for (sh=0;(b[bn-1]<<sh)<((mr_small)1<<(MIRACL-1));sh++) ;
+        for (i=0;i<bn;i++)
+        {
+            t[2*bn+1+i]=(b[i]<<sh);
+            if (sh>0 && i>0) t[2*bn+1+i]|=(b[i-1]>>(MIRACL-sh));
+        }
+        for (i=0;i<2*bn;i++) t[i]=(mr_small)(-1);
+        t[0]<<=sh;
+        t[2*bn]=(sh>0)?(((mr_small)1<<sh)-1):0;
+        if (!mr_tier_divide(_MIPP_ t,2*bn+1,t+2*bn+1,bn,mu)) return FALSE;
+        mr_mip->rready=TRUE;
+    }
+    mr_wbarrett(a,an,b,bn,mu,q,ws,mr_tier_kt(_MIPPO_ ),mr_mip->TOOM3);
+    return TRUE;
+}
+
+#endif
+
 void multiply(_MIPD_ big x,big y,big z)
 {  /*  multiply two big numbers: z=x.y  */
     int i,xl,yl,j,ti;
@@ -149,6 +763,12 @@ void multiply(_MIPD_ big x,big y,big z)
 #endif
 #ifndef MR_NOFULLWIDTH
         xg=x->w; yg=y->w; w0g=w0->w; 
+#ifdef MR_TIERS
+        if (mr_mip->KARATSUBA>0 && xl>=mr_mip->KARATSUBA && yl>=mr_mip->KARATSUBA
+            && mr_tier_mult(_MIPP_ xg,xl,yg,yl,w0g))
+        { /* sub-quadratic */ }
+        else
+#endif
         if (x==y && xl>SQR_FASTER_THRESHOLD)    
                              /* extra hassle make it not    */
                              /* worth it for small numbers */
@@ -973,6 +1593,34 @@ void divide(_MIPD_ big x,big y,big z)
         MR_OUT
         return;
     }
+#ifdef MR_TIERS
+#ifndef MR_SIMPLE_BASE
+    if (mr_mip->base==0)
+#endif
+    if (mr_mip->BARRETT>0 && y0>=mr_mip->BARRETT)
+    { /* same divisor as last time? */
+        w0->w[w00]=0;
+        if (y!=z) zero(z);
+        if (mr_tier_reduce(_MIPP_ w0->w,w00+1,y->w,y0,(y!=z)?z->w:NULL))
+        {
+            if (y!=z)
+            {
+                z->len=((w00-y0+1)|sz);
+                mr_lzero(z);
+            }
+            w0->len=y0;
+            mr_lzero(w0);
+            if (x!=z)
+            {
+                copy(w0,x);
+                if (x->len!=0) x->len|=sx;
+            }
+            y->len|=sy;
+            MR_OUT
+            return;
+        }
+    }
+#endif
     if (y!=z) zero(z);
     d=normalise(_MIPP_ y,y);
     check=mr_mip->check;
@@ -986,6 +1634,12 @@ void divide(_MIPD_ big x,big y,big z)
         ldy=y->w[y0-1];
         sdy=y->w[y0-2];
         w0g=w0->w; yg=y->w;
+#ifdef MR_TIERS
+        if (mr_mip->BURNIKEL>0 && y0>=mr_mip->BURNIKEL && w00+1-y0>=mr_mip->BURNIKEL
+            && mr_tier_divide(_MIPP_ w0g,w00+1,yg,y0,(y!=z)?z->w:NULL))
+        { /* sub-quadratic */ }
+        else
+#endif
         for (k=w00-1;k>=y0-1;k--)
         {  /* long division */
 #ifdef INLINE_ASM
@@ -88,6 +88,11 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
         return (miracl *)TlsGetValue(mr_key); 
     }
 
+    void set_mip(miracl *mip)
+    {
+        TlsSetValue(mr_key,mip);
+    }
+
     void mr_init_threading()
     {
         mr_key=TlsAlloc();
@@ -109,6 +114,11 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
         return (miracl *)pthread_getspecific(mr_key); 
     }
 
+    void set_mip(miracl *mip)
+    {
+        pthread_setspecific(mr_key,mip);
+    }
+
     void mr_init_threading()
     {
         pthread_key_create(&mr_key,(void(*)(void *))NULL);
@@ -234,9 +244,12 @@ static char *names[] =
 (char *)"ecn2_brick_init",(char *)"ecn2_mul_brick_gls",(char *)"ecn2_multn",(char *)"zzn3_timesi2",
 (char *)"nres_complex",(char *)"zzn4_from_int",(char *)"zzn4_negate",(char *)"zzn4_conj",(char *)"zzn4_add",(char *)"zzn4_sadd",(char *)"zzn4_sub",(char *)"zzn4_ssub",(char *)"zzn4_smul",(char *)"zzn4_sqr",
 (char *)"zzn4_mul",(char *)"zzn4_inv",(char *)"zzn4_div2",(char *)"zzn4_powq",(char *)"zzn4_tx",(char *)"zzn4_imul",(char *)"zzn4_lmul",(char *)"zzn4_from_big",
-(char *)"ecn2_mult4"};
+(char *)"ecn2_mult4",(char *)"nxprime_step",(char *)"fft_mod_init",(char *)"fft_mod_set",
+(char *)"fft_mod_get",(char *)"nres_double_lazy",(char *)"nres_double_redc",
+(char *)"zzn2_double_mul",(char *)"zzn2_double_txx",(char *)"zzn2_redc",(char *)"zzn4_double_mul",
+(char *)"zzn4_double_sqr",(char *)"zzn4_double_tx",(char *)"zzn4_redc"};
 
-/* 0 - 243 (244 in all) */
+/* 0 - 256 (257 in all) */
 
 #endif
 #endif
@@ -1239,6 +1252,13 @@ miracl *mirsys_basic(miracl *mr_mip,int nd,mr_small nb)
     mr_mip->ERNUM=0;
     
     mr_mip->NTRY=6;
+#ifndef MR_STATIC
+    mr_mip->KARATSUBA=MR_KARATSUBA_THRESHOLD;
+    mr_mip->TOOM3=MR_TOOM3_THRESHOLD;
+    mr_mip->BURNIKEL=MR_BURNIKEL_THRESHOLD;
+    mr_mip->BARRETT=MR_BARRETT_THRESHOLD;
+    mr_mip->FFT_THREADS=1;
+#endif
     mr_mip->MONTY=ON;
 #ifdef MR_FLASH
     mr_mip->EXACT=TRUE;
@@ -1257,6 +1277,11 @@ miracl *mirsys_basic(miracl *mr_mip,int nd,mr_small nb)
     mr_mip->PRIMES=mr_small_primes;
 #else
     mr_mip->PRIMES=NULL;
+    mr_mip->rdiv=NULL;
+    mr_mip->rlen=0;
+#ifdef MR_ALLOC_POOL
+    mr_mip->pool=mr_pool_create(NULL,NULL);
+#endif
 #ifndef MR_SIMPLE_IO
     mr_mip->IOBUFF=(char *)mr_alloc(_MIPP_ MR_DEFAULT_BUFFER_SIZE+1,1);
 #endif
@@ -1451,6 +1476,7 @@ void mirexit(_MIPDO_ )
     set_io_buffer_size(_MIPP_ 0);
 #endif
     if (mr_mip->PRIMES!=NULL) mr_free(mr_mip->PRIMES);
+    mr_free(mr_mip->rdiv);
 #else
 #ifndef MR_SIMPLE_IO
     for (i=0;i<=MR_DEFAULT_BUFFER_SIZE;i++)
@@ -1459,6 +1485,10 @@ void mirexit(_MIPDO_ )
 #endif
 
 #ifndef MR_STATIC
+#ifdef MR_ALLOC_POOL
+    mr_pool_close(mr_mip->pool);
+    mr_mip->pool=NULL;
+#endif
     mr_free(mr_mip);
 #ifdef MR_WINDOWS_MT
 	TlsSetValue(mr_key, NULL);		/* Thank you Thales */
@@ -63,8 +63,14 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 #include <intrin.h>
 #endif
 
+#ifdef MR_FFT_THREADS
+#include <pthread.h>
+#endif
+
 #ifndef MR_STATIC
 
+#define MR_FFT_MAX_THREADS 64    /* most workers used at once */
+
 static mr_utype twop(int n)
 { /* 2^n */
 #ifdef MR_FP
@@ -199,27 +205,21 @@ void fft_reset(_MIPDO_ )
     if (mr_mip->chin.NP!=0) scrt_end(&mr_mip->chin);
 }
 
-void mr_dif_fft(_MIPD_ int logn,int pr,mr_utype *data)
-{ /* decimate-in-frequency fourier transform */
-    int mmax,m,j,k,istep,i,ii,jj,newn,offset;
-    mr_utype w,temp,prime,*roots;
+static void dif_fft(int logn,int offset,mr_utype prime,mr_utype *roots,mr_utype *data)
+{ /* decimate-in-frequency fourier transform, mod prime. roots[i-1] is *
+   * the i-th power of a primitive 2^(logn+offset)-th root of unity.   *
+   * Touches no instance, so it can run on any thread                  */
+    int mmax,m,j,k,istep,i,ii,jj,newn;
+    mr_utype w,temp;
 #ifdef MR_NOASM
     mr_large dble,ldres;
 #endif
-#ifdef MR_OS_THREADS
-    miracl *mr_mip=get_mip();
-#endif
 #ifdef MR_FP_ROUNDING
     mr_large iprime;
-#endif
-    prime=mr_mip->prime[pr];
-    roots=mr_mip->roots[pr];
-#ifdef MR_FP_ROUNDING
     iprime=mr_invert(prime);
 #endif
 
     newn=(1<<logn);
-    offset=(mr_mip->logN-logn);
     mmax=newn;
     for (k=0;k<logn;k++) {
         istep=mmax;
@@ -349,23 +349,15 @@ void mr_dif_fft(_MIPD_ int logn,int pr,mr_utype *data)
     }
 }
 
-void mr_dit_fft(_MIPD_ int logn,int pr,mr_utype *data)
-{ /* decimate-in-time inverse fourier transform */
-    int mmax,m,j,k,i,istep,ii,jj,newn,offset;
-    mr_utype w,temp,prime,*roots;
+static void dit_fft(int logn,int offset,mr_utype prime,mr_utype *roots,mr_utype *data)
+{ /* decimate-in-time inverse fourier transform, unscaled */
+    int mmax,m,j,k,i,istep,ii,jj,newn;
+    mr_utype w,temp;
 #ifdef MR_NOASM
     mr_large dble,ldres;
 #endif
-#ifdef MR_OS_THREADS
-    miracl *mr_mip=get_mip();
-#endif
 #ifdef MR_FP_ROUNDING
     mr_large iprime;
-#endif
-    prime=mr_mip->prime[pr];
-    roots=mr_mip->roots[pr];
-    offset=(mr_mip->logN-logn);
-#ifdef MR_FP_ROUNDING
     iprime=mr_invert(prime);
 #endif
     newn=(1<<logn);
@@ -495,116 +487,332 @@ hop5:
     }
 }
 
-static void modxn_1(_MIPD_ int n,int deg,big *x)
-{  /* set X (of degree deg) =X mod x^n-1 = X%x^n + X/x^n */
-    int i;
-    for (i=0;n+i<=deg;i++)
-    {
-        nres_modadd(_MIPP_ x[i],x[n+i],x[i]);
-        zero(x[n+i]);
-    }
+void mr_dif_fft(_MIPD_ int logn,int pr,mr_utype *data)
+{ /* decimate-in-frequency fourier transform */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    dif_fft(logn,mr_mip->logN-logn,mr_mip->prime[pr],mr_mip->roots[pr],data);
 }
 
-BOOL mr_poly_rem(_MIPD_ int dg,big *G,big *R)
-{ /* G is a polynomial of degree dg - G is overwritten */
-    int i,j,newn,logn,np,n;
-    mr_utype p,inv,fac;
+void mr_dit_fft(_MIPD_ int logn,int pr,mr_utype *data)
+{ /* decimate-in-time inverse fourier transform */
 #ifdef MR_OS_THREADS
     miracl *mr_mip=get_mip();
 #endif
-#ifdef MR_FP_ROUNDING
-    mr_large ip;
-#endif
+    dit_fft(logn,mr_mip->logN-logn,mr_mip->prime[pr],mr_mip->roots[pr],data);
+}
 
-    n=mr_mip->degree;  /* degree of modulus */
-    if (n==0) return FALSE; /* the preset tables have been destroyed */
-    np=mr_mip->nprimes;
+/* The work below is split into tasks that only read the instance, *
+ * so that with MR_FFT_THREADS they can be spread over threads     */
 
-    newn=1; logn=0;
-    while (2*n>newn) { newn<<=1; logn++; }
+typedef void (*fft_task)(void *,int,int);
 
-    for (i=0;i<np;i++)
+typedef struct
+{
+    fft_task fn;
+    void *arg;
+    int k,n,threads;
+} fft_share;
+
+static void *fft_worker(void *arg)
+{ /* tasks k, k+threads, k+2*threads.. for worker k */
+    fft_share *s=(fft_share *)arg;
+    int i;
+    for (i=s->k;i<s->n;i+=s->threads) (s->fn)(s->arg,i,s->k);
+    return NULL;
+}
+
+static void fft_run(int threads,int n,fft_task fn,void *arg)
+{ /* fn(arg,i,k) for tasks i=0..n-1, by workers k=0..threads-1 */
+    int k;
+    fft_share s[MR_FFT_MAX_THREADS];
+#ifdef MR_FFT_THREADS
+    pthread_t tid[MR_FFT_MAX_THREADS];
+    BOOL started[MR_FFT_MAX_THREADS];
+#endif
+    for (k=0;k<threads;k++)
     {
-        p=mr_mip->prime[i];
-#ifdef MR_FP_ROUNDING
-        ip=mr_invert(p);
-        for (j=n;j<=dg;j++)
-            mr_mip->t[i][j-n]=mr_sdiv(_MIPP_ G[j],p,ip,mr_mip->w1); 
+        s[k].fn=fn;
+        s[k].arg=arg;
+        s[k].k=k;
+        s[k].n=n;
+        s[k].threads=threads;
+    }
+#ifdef MR_FFT_THREADS
+    for (k=1;k<threads;k++)
+        started[k]=(pthread_create(&tid[k],NULL,fft_worker,&s[k])==0);
+    fft_worker(&s[0]);
+    for (k=1;k<threads;k++)
+    { /* if a thread could not be started, do its share here */
+        if (started[k]) pthread_join(tid[k],NULL);
+        else fft_worker(&s[k]);
+    }
 #else
-        for (j=n;j<=dg;j++)
-            mr_mip->t[i][j-n]=mr_sdiv(_MIPP_ G[j],p,mr_mip->w1); 
+    for (k=0;k<threads;k++) fft_worker(&s[k]);
 #endif
-        for (j=dg-n+1;j<newn;j++) mr_mip->t[i][j]=0;
-        mr_dif_fft(_MIPP_ logn,i,mr_mip->t[i]);
-        for (j=0;j<newn;j++)
+}
+
+static int fft_threads(miracl *mr_mip,int points,int n)
+{ /* workers to use for n tasks, over this many transform points */
+    int threads=1;
+#ifdef MR_FFT_THREADS
+    if (points>=MR_FFT_THREAD_POINTS) threads=mr_mip->FFT_THREADS;
+    if (threads>MR_FFT_MAX_THREADS) threads=MR_FFT_MAX_THREADS;
+    if (threads>n) threads=n;
+    if (threads<1) threads=1;
+#endif
+    return threads;
+}
+
+static mr_utype fft_rem(miracl *mr_mip,big x,mr_utype p)
+{ /* x mod p, for x>=0 */
+    int i;
+    mr_small r=0;
 #ifdef MR_FP_ROUNDING
-            imuldiv(mr_mip->t[i][j],mr_mip->s1[i][j],(mr_small)0,p,ip,(mr_small *)&mr_mip->t[i][j]);
-#else
-            muldiv(mr_mip->t[i][j],mr_mip->s1[i][j],(mr_small)0,p,(mr_small *)&mr_mip->t[i][j]);
+    mr_large ip=mr_invert(p);
 #endif
-        mr_dit_fft(_MIPP_ logn,i,mr_mip->t[i]);
-        inv=mr_mip->inverse[i];
-        if (mr_mip->logN > logn)
-        { /* adjust 1/N log p for N/2, N/4 etc */
-            fac=twop(mr_mip->logN-logn);
-            inv=smul(fac,inv,p);
-        }
-        for (j=0;j<n;j++)
+    if (x==NULL) return 0;
+    for (i=(int)(x->len&MR_OBITS)-1;i>=0;i--)
+    {
+#ifndef MR_SIMPLE_BASE
+        if (mr_mip->base!=0)
+        {
 #ifdef MR_FP_ROUNDING
-            imuldiv(mr_mip->t[i][j+n-1],inv,(mr_small)0,p,ip,(mr_small *)&mr_mip->t[i][j+n-1]);
+            imuldiv(r,mr_mip->base,x->w[i],(mr_small)p,ip,&r);
 #else
-            muldiv(mr_mip->t[i][j+n-1],inv,(mr_small)0,p,(mr_small *)&mr_mip->t[i][j+n-1]);
+            muldiv(r,mr_mip->base,x->w[i],(mr_small)p,&r);
+#endif
+            continue;
+        }
+#endif
+#ifndef MR_NOFULLWIDTH
+        muldvm(r,x->w[i],(mr_small)p,&r);
 #endif
     }
+    return (mr_utype)r;
+}
 
-    mr_mip->check=OFF;
-    mr_shift(_MIPP_ mr_mip->modulus,(int)mr_mip->modulus->len,mr_mip->w6);
-       /* w6 = N.R */
-    for (j=0;j<n;j++)
+/* Polynomial products modulo each FFT prime, and their recombination */
+
+typedef struct
+{
+    miracl *mip;
+    int logn,newn;
+    big *x,*y;        /* x[0..dx] times y[0..dy] */
+    int dx,dy;
+    mr_utype **s;     /* ..or times rows already transformed.. */
+                      /* ..or squared, if y and s are NULL      */
+    int lo,hi;        /* coefficients wanted */
+    int blk;          /* coefficients per CRT task */
+    mr_utype **w;     /* scratch row for each worker */
+} fft_poly;
+
+static void poly_prime(void *arg,int i,int k)
+{ /* product mod the i-th prime, into t[i] */
+    fft_poly *f=(fft_poly *)arg;
+    miracl *mr_mip=f->mip;
+    int j,newn=f->newn,off=mr_mip->logN-f->logn;
+    mr_utype p,inv,fac,*t,*a;
+#ifdef MR_FP_ROUNDING
+    mr_large ip;
+#endif
+    p=mr_mip->prime[i];
+#ifdef MR_FP_ROUNDING
+    ip=mr_invert(p);
+#endif
+    t=mr_mip->t[i];
+    for (j=0;j<=f->dx;j++) t[j]=fft_rem(mr_mip,f->x[j],p);   /* np*np*N/2 muldivs */
+    for (;j<newn;j++) t[j]=0;
+    dif_fft(f->logn,off,p,mr_mip->roots[i],t);                          /* np*N*lgN     */
+    if (f->y!=NULL)
     {
-        for (i=0;i<np;i++)
-            mr_mip->cr[i]=mr_mip->t[i][j+n-1];
-        scrt(_MIPP_ &mr_mip->chin,mr_mip->cr,mr_mip->w7);
-        divide(_MIPP_ mr_mip->w7,mr_mip->w6,mr_mip->w6);  /* R[j] may be too big for redc */ 
-        redc(_MIPP_ mr_mip->w7,R[j]);
+        a=f->w[k];
+        for (j=0;j<=f->dy;j++) a[j]=fft_rem(mr_mip,f->y[j],p);
+        for (;j<newn;j++) a[j]=0;
+        dif_fft(f->logn,off,p,mr_mip->roots[i],a);
     }
-    mr_mip->check=ON;
+    else if (f->s!=NULL) a=f->s[i];
+    else a=t;
 
-    for (i=0;i<np;i++)
-    {
-        p=mr_mip->prime[i];
+    for (j=0;j<newn;j++)
+    {  /* multiply FFTs */
 #ifdef MR_FP_ROUNDING
-        ip=mr_invert(p);
-        for (j=0;j<n;j++)
-            mr_mip->t[i][j]=mr_sdiv(_MIPP_ R[j],p,ip,mr_mip->w1);
+        imuldiv(t[j],a[j],(mr_small)0,p,ip,(mr_small *)&t[j]);
 #else
-        for (j=0;j<n;j++)
-            mr_mip->t[i][j]=mr_sdiv(_MIPP_ R[j],p,mr_mip->w1);
+        muldiv(t[j],a[j],(mr_small)0,p,(mr_small *)&t[j]);
 #endif
-        for (j=n;j<1+newn/2;j++) mr_mip->t[i][j]=0;
+    }
+    dit_fft(f->logn,off,p,mr_mip->roots[i],t);
 
-        mr_dif_fft(_MIPP_ logn-1,i,mr_mip->t[i]);  /* Note: Half size */
-        for (j=0;j<newn/2;j++)
+    inv=mr_mip->inverse[i];
+    if (mr_mip->logN>f->logn)
+    { /* adjust 1/N mod p for smaller N */
+        fac=twop(mr_mip->logN-f->logn);
+        inv=smul(fac,inv,p);
+    }
+    for (j=f->lo;j<=f->hi;j++)
 #ifdef MR_FP_ROUNDING
-            imuldiv(mr_mip->t[i][j],mr_mip->s2[i][j],(mr_small)0,p,ip,(mr_small *)&mr_mip->t[i][j]);
+        imuldiv(t[j],inv,(mr_small)0,p,ip,(mr_small *)&t[j]);
 #else
-            muldiv(mr_mip->t[i][j],mr_mip->s2[i][j],(mr_small)0,p,(mr_small *)&mr_mip->t[i][j]);
+        muldiv(t[j],inv,(mr_small)0,p,(mr_small *)&t[j]);
 #endif
-        mr_dit_fft(_MIPP_ logn-1,i,mr_mip->t[i]);
+}
 
-        inv=mr_mip->inverse[i];
-        if (mr_mip->logN > logn-1)
-        {
-            fac=twop(mr_mip->logN-logn+1);
-            inv=smul(fac,inv,p);
+static void poly_crt(void *arg,int b,int k)
+{ /* Chinese remainder theorem on a block of columns of t. Each column *
+   * of residues is replaced by the words of the integer they give    */
+    fft_poly *f=(fft_poly *)arg;
+    miracl *mr_mip=f->mip;
+    mr_utype *C=mr_mip->chin.C,*M=mr_mip->chin.M,*v,r;
+    mr_small *z,carry;
+    int i,j,m,c,lo,hi,np=mr_mip->nprimes;
+#ifdef MR_ITANIUM
+    mr_small tm;
+#endif
+#ifdef MR_WIN64
+    mr_small tm;
+#endif
+#ifdef MR_FP
+    mr_small dres;
+#endif
+    v=f->w[k];
+    z=(mr_small *)(v+np);
+    lo=f->lo+b*f->blk;
+    hi=lo+f->blk-1;
+    if (hi>f->hi) hi=f->hi;
+    for (j=lo;j<=hi;j++)
+    {
+        for (c=0,i=0;i<np;i++)
+        { /* mixed radix digits, Knuth P. 274 */
+            v[i]=mr_mip->t[i][j];
+            for (m=0;m<i;m++,c++)
+            {
+                r=MR_REMAIN(v[i]-v[m],M[i]);
+                if (r<0) r+=M[i];
+                v[i]=smul(r,C[c],M[i]);
+            }
         }
-        for (j=0;j<n;j++)
+        z[0]=v[np-1];
+        for (i=np-2;i>=0;i--)
+        { /* z=z*M[i]+v[i] */
+            carry=v[i];
+            for (m=0;m<np-1-i;m++)
+            {
+#ifndef MR_SIMPLE_BASE
+                if (mr_mip->base!=0)
+                {
 #ifdef MR_FP_ROUNDING
-            imuldiv(mr_mip->t[i][j],inv,(mr_small)0,p,ip,(mr_small *)&mr_mip->t[i][j]);
+                    carry=imuldiv(M[i],z[m],carry,mr_mip->base,mr_mip->inverse_base,&z[m]);
 #else
-            muldiv(mr_mip->t[i][j],inv,(mr_small)0,p,(mr_small *)&mr_mip->t[i][j]);
+                    carry=muldiv(M[i],z[m],carry,mr_mip->base,&z[m]);
+#endif
+                    continue;
+                }
+#endif
+#ifndef MR_NOFULLWIDTH
+                carry=muldvd(M[i],z[m],carry,&z[m]);
 #endif
+            }
+            z[np-1-i]=carry;
+        }
+        for (i=0;i<np;i++) mr_mip->t[i][j]=(mr_utype)z[i];
+    }
+}
+
+static BOOL poly_products(_MIPD_ fft_poly *f)
+{ /* all products mod the primes, then all the CRTs */
+    int k,n,len,threads,np;
+    BOOL ok=TRUE;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    np=mr_mip->nprimes;
+    if (mr_mip->chin.NP!=np) return FALSE;  /* no CRT set up for these primes */
+
+    f->mip=mr_mip;
+    f->newn=(1<<f->logn);
+    threads=fft_threads(mr_mip,f->newn*np,np);
+    len=f->newn;
+    if (len<2*np) len=2*np;
+    f->w=(mr_utype **)mr_alloc(_MIPP_ threads,sizeof(mr_utype *));
+    if (f->w==NULL) return FALSE;
+    for (k=0;k<threads;k++)
+    {
+        f->w[k]=(mr_utype *)mr_alloc(_MIPP_ len,sizeof(mr_utype));
+        if (f->w[k]==NULL) ok=FALSE;
+    }
+    n=f->hi-f->lo+1;
+    if (ok && n>0)
+    {
+        fft_run(threads,np,poly_prime,f);
+        f->blk=(n+threads-1)/threads;
+        fft_run(threads,(n+f->blk-1)/f->blk,poly_crt,f);
+    }
+    for (k=0;k<threads;k++) mr_free(f->w[k]);
+    mr_free(f->w);
+    return ok;
+}
+
+static void poly_column(_MIPD_ int j,big x)
+{ /* x = integer in column j of t, after poly_products() */
+    int i;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    zero(x);
+    for (i=0;i<mr_mip->nprimes;i++) x->w[i]=(mr_small)mr_mip->t[i][j];
+    x->len=mr_mip->nprimes;
+    mr_lzero(x);
+}
+
+static void modxn_1(_MIPD_ int n,int deg,big *x)
+{  /* set X (of degree deg) =X mod x^n-1 = X%x^n + X/x^n */
+    int i;
+    for (i=0;n+i<=deg;i++)
+    {
+        nres_modadd(_MIPP_ x[i],x[n+i],x[i]);
+        zero(x[n+i]);
+    }
+}
+
+BOOL mr_poly_rem(_MIPD_ int dg,big *G,big *R)
+{ /* G is a polynomial of degree dg - G is overwritten */
+    int j,newn,logn,n;
+    fft_poly f;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+
+    n=mr_mip->degree;  /* degree of modulus */
+    if (n==0) return FALSE; /* the preset tables have been destroyed */
+
+    newn=1; logn=0;
+    while (2*n>newn) { newn<<=1; logn++; }
+
+    f.logn=logn;
+    f.x=G+n; f.dx=dg-n;
+    f.y=NULL; f.dy=0;
+    f.s=mr_mip->s1;
+    f.lo=n-1; f.hi=2*n-2;
+    if (!poly_products(_MIPP_ &f)) return FALSE;
+
+    mr_mip->check=OFF;
+    mr_shift(_MIPP_ mr_mip->modulus,(int)mr_mip->modulus->len,mr_mip->w6);
+       /* w6 = N.R */
+    for (j=0;j<n;j++)
+    {
+        poly_column(_MIPP_ j+n-1,mr_mip->w7);
+        divide(_MIPP_ mr_mip->w7,mr_mip->w6,mr_mip->w6);  /* R[j] may be too big for redc */ 
+        redc(_MIPP_ mr_mip->w7,R[j]);
     }
+    mr_mip->check=ON;
+
+    f.logn=logn-1;    /* Note: Half size */
+    f.x=R; f.dx=n-1;
+    f.s=mr_mip->s2;
+    f.lo=0; f.hi=n-1;
+    if (!poly_products(_MIPP_ &f)) return FALSE;
 
     modxn_1(_MIPP_ newn/2,dg,G);    /* G=G mod 2^x - 1 */
 
@@ -613,9 +821,7 @@ BOOL mr_poly_rem(_MIPD_ int dg,big *G,big *R)
        /* w6 = N.R */
     for (j=0;j<n;j++)
     {
-        for (i=0;i<np;i++)
-            mr_mip->cr[i]=mr_mip->t[i][j];
-        scrt(_MIPP_ &mr_mip->chin,mr_mip->cr,mr_mip->w7);
+        poly_column(_MIPP_ j,mr_mip->w7);
         divide(_MIPP_ mr_mip->w7,mr_mip->w6,mr_mip->w6);  /* R[j] may be too big for redc */ 
         redc(_MIPP_ mr_mip->w7,R[j]);
         nres_modsub(_MIPP_ G[j],R[j],R[j]);
@@ -705,13 +911,10 @@ void mr_polymod_set(_MIPD_ int n, big *rf,big *f)
 
 int mr_ps_zzn_mul(_MIPD_ int deg,big *x,big *y,big *z)
 {
-    int i,j,newn,logn,np;
-    mr_utype inv,p,fac;
+    int j,newn,logn,np;
+    fft_poly f;
 #ifdef MR_OS_THREADS
     miracl *mr_mip=get_mip();
-#endif
-#ifdef MR_FP_ROUNDING
-    mr_large ip;
 #endif
     newn=1; logn=0;
     while (2*deg>newn) { newn <<=1; logn++; }
@@ -719,64 +922,18 @@ int mr_ps_zzn_mul(_MIPD_ int deg,big *x,big *y,big *z)
         np=mr_fft_init(_MIPP_ logn,mr_mip->modulus,mr_mip->modulus,TRUE);
     else np=mr_mip->nprimes;
 
-    for (i=0;i<np;i++)
-    {
-        p=mr_mip->prime[i];
-#ifdef MR_FP_ROUNDING
-        ip=mr_invert(p);
-#endif
-        for (j=0;j<deg;j++)
-        {
-            if (x[j]==NULL) mr_mip->wa[j]=0;
-#ifdef MR_FP_ROUNDING
-            else mr_mip->wa[j]=mr_sdiv(_MIPP_ x[j],p,ip,mr_mip->w1);
-#else
-            else mr_mip->wa[j]=mr_sdiv(_MIPP_ x[j],p,mr_mip->w1);
-#endif
-        }
-        for (j=deg;j<newn;j++) mr_mip->wa[j]=0;
-
-        mr_dif_fft(_MIPP_ logn,i,mr_mip->wa);  
-        for (j=0;j<deg;j++)
-        {
-            if (y[j]==NULL) mr_mip->t[i][j]=0;
-#ifdef MR_FP_ROUNDING
-            else mr_mip->t[i][j]=mr_sdiv(_MIPP_ y[j],p,ip,mr_mip->w1);
-#else
-            else mr_mip->t[i][j]=mr_sdiv(_MIPP_ y[j],p,mr_mip->w1);
-#endif
-        }  
-        for (j=deg;j<newn;j++) mr_mip->t[i][j]=0;
-        mr_dif_fft(_MIPP_ logn,i,mr_mip->t[i]);
-  /* multiply FFTs */
-        for (j=0;j<newn;j++)
-#ifdef MR_FP_ROUNDING
-            imuldiv(mr_mip->wa[j],mr_mip->t[i][j],(mr_small)0,p,ip,(mr_small *)&mr_mip->t[i][j]);
-#else
-            muldiv(mr_mip->wa[j],mr_mip->t[i][j],(mr_small)0,p,(mr_small *)&mr_mip->t[i][j]);
-#endif
-        mr_dit_fft(_MIPP_ logn,i,mr_mip->t[i]);           /* np*N*lgN */
+    f.logn=logn;
+    f.x=x; f.dx=deg-1;
+    f.y=y; f.dy=deg-1;
+    f.s=NULL;
+    f.lo=0; f.hi=deg-1;
+    if (!poly_products(_MIPP_ &f)) return np;
 
-        inv=mr_mip->inverse[i];
-        if (mr_mip->logN > logn)
-        {
-            fac=twop(mr_mip->logN-logn);
-            inv=smul(fac,inv,p);
-        }
-        for (j=0;j<deg;j++)                   /* np*N */
-#ifdef MR_FP_ROUNDING
-            imuldiv(mr_mip->t[i][j],inv,(mr_small)0,p,ip,(mr_small *)&mr_mip->t[i][j]);
-#else
-            muldiv(mr_mip->t[i][j],inv,(mr_small)0,p,(mr_small *)&mr_mip->t[i][j]);
-#endif
-    }
     mr_mip->check=OFF;
     mr_shift(_MIPP_ mr_mip->modulus,(int)mr_mip->modulus->len,mr_mip->w6);
     for (j=0;j<deg;j++)
     {
-        for (i=0;i<np;i++)
-            mr_mip->cr[i]=mr_mip->t[i][j];
-        scrt(_MIPP_ &mr_mip->chin,mr_mip->cr,mr_mip->w7);
+        poly_column(_MIPP_ j,mr_mip->w7);
         divide(_MIPP_ mr_mip->w7,mr_mip->w6,mr_mip->w6);
         redc(_MIPP_ mr_mip->w7,z[j]);
     }
@@ -924,13 +1081,10 @@ int mr_ps_big_mul(_MIPD_ int deg,big *x,big *y,big *z)
 
 int mr_poly_mul(_MIPD_ int degx,big *x,int degy,big *y,big *z)
 { /*  Multiply two polynomials. The big arrays are of size degree */
-    int i,j,newn,logn,np,degree;
-    mr_utype inv,p,fac;
+    int j,logn,newn,degree;
+    fft_poly f;
 #ifdef MR_OS_THREADS
     miracl *mr_mip=get_mip();
-#endif
-#ifdef MR_FP_ROUNDING
-    mr_large ip;
 #endif
     degree=degx+degy;
     if (x==y) 
@@ -942,70 +1096,22 @@ int mr_poly_mul(_MIPD_ int degx,big *x,int degy,big *y,big *z)
     while (degree+1>newn) { newn<<=1; logn++; }
 
     if (mr_mip->logN<logn)
-        np=mr_fft_init(_MIPP_ logn,mr_mip->modulus,mr_mip->modulus,TRUE);
-    else np=mr_mip->nprimes;
+        mr_fft_init(_MIPP_ logn,mr_mip->modulus,mr_mip->modulus,TRUE);
 
-/* compute coefficients modulo fft primes */    
-    for (i=0;i<np;i++)
-    {                                              
-        p=mr_mip->prime[i];
-#ifdef MR_FP_ROUNDING
-        ip=mr_invert(p);
-#endif
-        for (j=0;j<=degx;j++)
-        {
-            if (x[j]==NULL) mr_mip->wa[j]=0;
-#ifdef MR_FP_ROUNDING
-            else mr_mip->wa[j]=mr_sdiv(_MIPP_ x[j],p,ip,mr_mip->w1);      /* np*np*N/2 muldivs */
-#else
-            else mr_mip->wa[j]=mr_sdiv(_MIPP_ x[j],p,mr_mip->w1);      /* np*np*N/2 muldivs */
-#endif
-        }
-        for (j=degx+1;j<newn;j++) mr_mip->wa[j]=0;
-        mr_dif_fft(_MIPP_ logn,i,mr_mip->wa);              /* np*N*lgN     */
-
-        for (j=0;j<=degy;j++)
-        {
-            if (y[j]==NULL) mr_mip->t[i][j]=0;
-#ifdef MR_FP_ROUNDING
-            else mr_mip->t[i][j]=mr_sdiv(_MIPP_ y[j],p,ip,mr_mip->w1);   /* np*np*N/2   */
-#else
-            else mr_mip->t[i][j]=mr_sdiv(_MIPP_ y[j],p,mr_mip->w1);   /* np*np*N/2   */
-#endif
-        }
-        for (j=degy+1;j<newn;j++) mr_mip->t[i][j]=0;
-        mr_dif_fft(_MIPP_ logn,i,mr_mip->t[i]);           /* np*N*lgN */
-
-   /* multiply FFTs */
-        for (j=0;j<newn;j++)                       /* np*N */
-#ifdef MR_FP_ROUNDING
-            imuldiv(mr_mip->wa[j],mr_mip->t[i][j],(mr_small)0,p,ip,(mr_small *)&mr_mip->t[i][j]);
-#else
-            muldiv(mr_mip->wa[j],mr_mip->t[i][j],(mr_small)0,p,(mr_small *)&mr_mip->t[i][j]);
-#endif
-        mr_dit_fft(_MIPP_ logn,i,mr_mip->t[i]);           /* np*N*lgN */
+/* compute coefficients modulo fft primes, and recombine */
+    f.logn=logn;
+    f.x=x; f.dx=degx;
+    f.y=y; f.dy=degy;
+    f.s=NULL;
+    f.lo=0; f.hi=degree;
+    if (!poly_products(_MIPP_ &f)) return degree;
 
-        inv=mr_mip->inverse[i];
-        if (mr_mip->logN > logn)
-        {
-            fac=twop(mr_mip->logN-logn);
-            inv=smul(fac,inv,p);
-        }
-        for (j=0;j<=degree;j++)                   /* np*N */
-#ifdef MR_FP_ROUNDING
-            imuldiv(mr_mip->t[i][j],inv,(mr_small)0,p,ip,(mr_small *)&mr_mip->t[i][j]);
-#else
-            muldiv(mr_mip->t[i][j],inv,(mr_small)0,p,(mr_small *)&mr_mip->t[i][j]);
-#endif
-    }
     mr_mip->check=OFF;
     mr_shift(_MIPP_ mr_mip->modulus,(int)mr_mip->modulus->len,mr_mip->w6);
        /* w6 = N.R */
     for (j=0;j<=degree;j++)
     {
-        for (i=0;i<np;i++)
-            mr_mip->cr[i]=mr_mip->t[i][j];
-        scrt(_MIPP_ &mr_mip->chin,mr_mip->cr,mr_mip->w7); /* N*3*np*np/2 */
+        poly_column(_MIPP_ j,mr_mip->w7);
         divide(_MIPP_ mr_mip->w7,mr_mip->w6,mr_mip->w6);  /* z[j] may be too big for redc */ 
         redc(_MIPP_ mr_mip->w7,z[j]);
     }                                        /* np*np*N/4 */
@@ -1015,72 +1121,32 @@ int mr_poly_mul(_MIPD_ int degx,big *x,int degy,big *y,big *z)
 
 int mr_poly_sqr(_MIPD_ int degx,big *x,big *z)
 { /*  Multiply two polynomials. The big arrays are of size degree */
-    int i,j,newn,logn,np,degree;
-    mr_utype inv,p,fac;
+    int j,newn,logn,degree;
+    fft_poly f;
 #ifdef MR_OS_THREADS
     miracl *mr_mip=get_mip();
-#endif
-#ifdef MR_FP_ROUNDING
-    mr_large ip;
 #endif
     degree=2*degx;
     newn=1; logn=0;
     while (degree+1>newn) { newn<<=1; logn++; }
 
     if (mr_mip->logN<logn)
-        np=mr_fft_init(_MIPP_ logn,mr_mip->modulus,mr_mip->modulus,TRUE);
-    else np=mr_mip->nprimes;
+        mr_fft_init(_MIPP_ logn,mr_mip->modulus,mr_mip->modulus,TRUE);
 
-/* compute coefficients modulo fft primes */    
-    for (i=0;i<np;i++)
-    {
-        p=mr_mip->prime[i];
-#ifdef MR_FP_ROUNDING
-        ip=mr_invert(p);
-#endif
-        for (j=0;j<=degx;j++)
-        {
-            if (x[j]==NULL) mr_mip->t[i][j]=0;
-#ifdef MR_FP_ROUNDING
-            else mr_mip->t[i][j]=mr_sdiv(_MIPP_ x[j],p,ip,mr_mip->w1);
-#else
-            else mr_mip->t[i][j]=mr_sdiv(_MIPP_ x[j],p,mr_mip->w1);
-#endif
-        }
-        for (j=degx+1;j<newn;j++) mr_mip->t[i][j]=0;
-        mr_dif_fft(_MIPP_ logn,i,mr_mip->t[i]);
-
-   /* multiply FFTs */
-        for (j=0;j<newn;j++)
-#ifdef MR_FP_ROUNDING
-            imuldiv(mr_mip->t[i][j],mr_mip->t[i][j],(mr_small)0,p,ip,(mr_small *)&mr_mip->t[i][j]);
-#else
-            muldiv(mr_mip->t[i][j],mr_mip->t[i][j],(mr_small)0,p,(mr_small *)&mr_mip->t[i][j]);
-#endif
-        mr_dit_fft(_MIPP_ logn,i,mr_mip->t[i]);
+/* compute coefficients modulo fft primes, and recombine */    
+    f.logn=logn;
+    f.x=x; f.dx=degx;
+    f.y=NULL; f.dy=0;
+    f.s=NULL;
+    f.lo=0; f.hi=degree;
+    if (!poly_products(_MIPP_ &f)) return degree;
 
-        inv=mr_mip->inverse[i];
-        if (mr_mip->logN > logn)
-        { /* adjust 1/N log p for smaller N  */
-            fac=twop(mr_mip->logN-logn);
-            inv=smul(fac,inv,p);
-        }
-        for (j=0;j<=degree;j++)
-#ifdef MR_FP_ROUNDING
-            imuldiv(mr_mip->t[i][j],inv,(mr_small)0,p,ip,(mr_small *)&mr_mip->t[i][j]);
-#else
-            muldiv(mr_mip->t[i][j],inv,(mr_small)0,p,(mr_small *)&mr_mip->t[i][j]);
-#endif
-    }
     mr_mip->check=OFF;
     mr_shift(_MIPP_ mr_mip->modulus,(int)mr_mip->modulus->len,mr_mip->w6);
        /* w6 = N.R */
     for (j=0;j<=degree;j++)
-    { /* apply CRT to each column */
-        for (i=0;i<np;i++)
-            mr_mip->cr[i]=mr_mip->t[i][j];
-
-        scrt(_MIPP_ &mr_mip->chin,mr_mip->cr,mr_mip->w7);
+    { /* integer in each column */
+        poly_column(_MIPP_ j,mr_mip->w7);
         divide(_MIPP_ mr_mip->w7,mr_mip->w6,mr_mip->w6);  /* z[j] may be too big for redc */ 
         redc(_MIPP_ mr_mip->w7,z[j]);
     }
@@ -1137,27 +1203,126 @@ BOOL fastmultop(_MIPD_ int n,big x,big y,big z)
     return FALSE;
 }
 
+/* Integer product modulo each of the three primes, then recombination */
+
+typedef struct
+{
+    miracl *mip;
+    big x,y;
+    int logn,newn,zl;
+    BOOL ynew;        /* y's transform is not left over from last time */
+    int blk;          /* words per CRT task */
+} fft_int;
+
+static void int_prime(void *arg,int pr,int k)
+{ /* multiply mod the pr-th prime, into t[pr] */
+    fft_int *f=(fft_int *)arg;
+    miracl *mr_mip=f->mip;
+    big x=f->x,y=f->y;
+    int i,xl,yl,newn=f->newn,off=mr_mip->logN-f->logn;
+    mr_small p,fac,inv;
+    mr_utype *dptr,*wptr;
+#ifdef MR_FP
+    mr_small dres;
+#endif
+#ifdef MR_FP_ROUNDING
+    mr_large ip;
+#endif
+    xl=(int)(x->len&MR_OBITS);
+    yl=(int)(y->len&MR_OBITS);
+    p=mr_mip->prime[pr];
+    inv=mr_mip->inverse[pr];  
+#ifdef MR_FP_ROUNDING
+    ip=mr_invert(p);
+#endif         
+    fac=twop(mr_mip->logN-f->logn);
+    if (fac!=1) inv=smul(fac,inv,p);  /* adjust 1/N mod p */
+        
+    dptr=mr_mip->t[pr];
+    if (pr==0) wptr=mr_mip->wa;
+    else if (pr==1) wptr=mr_mip->wb;
+    else wptr=mr_mip->wc;
+
+    for (i=0;i<xl;i++) dptr[i]=MR_REMAIN(x->w[i],p);
+    for (i=xl;i<newn;i++) dptr[i]=0;
+                                   
+    dif_fft(f->logn,off,p,mr_mip->roots[pr],dptr);
+
+    if (x!=y)
+    {
+        if (f->ynew)
+        {   
+            for (i=0;i<yl;i++) wptr[i]=MR_REMAIN(y->w[i],p);
+            for (i=yl;i<newn;i++) wptr[i]=0;
+            dif_fft(f->logn,off,p,mr_mip->roots[pr],wptr);
+        } 
+    }
+    else wptr=dptr;
+
+    for (i=0;i<newn;i++)
+    {  /* "multiply" Fourier transforms */
+#ifdef MR_FP_ROUNDING
+        imuldiv(dptr[i],wptr[i],(mr_small)0,p,ip,(mr_small *)&dptr[i]);
+#else
+        muldiv(dptr[i],wptr[i],(mr_small)0,p,(mr_small *)&dptr[i]);
+#endif
+    }
+
+    dit_fft(f->logn,off,p,mr_mip->roots[pr],dptr);
+
+    for (i=0;i<f->zl;i++)
+    {  /* multiply by 1/N mod p */
+#ifdef MR_FP_ROUNDING
+        imuldiv(dptr[i],inv,(mr_small)0,p,ip,(mr_small *)&dptr[i]); 
+#else
+        muldiv(dptr[i],inv,(mr_small)0,p,(mr_small *)&dptr[i]); 
+#endif
+    }
+}
+
+static void int_crt(void *arg,int b,int k)
+{ /* convert a block of words to mixed radix form, *
+   * using chinese remainder thereom               */
+    fft_int *f=(fft_int *)arg;
+    miracl *mr_mip=f->mip;
+    int i,lo,hi;
+    mr_utype t,*d0,*d1,*d2;
+
+    d0=mr_mip->t[0]; d1=mr_mip->t[1]; d2=mr_mip->t[2];
+    lo=b*f->blk;
+    hi=lo+f->blk;
+    if (hi>f->zl) hi=f->zl;
+    for (i=lo;i<hi;i++)
+    {
+        t=d1[i]-d0[i];
+        while (t<0) t+=mr_mip->prime[1];
+        muldiv(t,mr_mip->const1,(mr_small)0,mr_mip->prime[1],(mr_small *)&d1[i]);
+
+        t=d2[i]-d0[i];
+        while (t<0) t+=mr_mip->prime[2];
+        muldiv(t,mr_mip->const2,(mr_small)0,mr_mip->prime[2],(mr_small *)&t);
+        t-=d1[i];
+        while (t<0) t+=mr_mip->prime[2];
+        muldiv(t,mr_mip->const3,(mr_small)0,mr_mip->prime[2],(mr_small *)&d2[i]);
+    }
+}
+
 void fft_mult(_MIPD_ big x,big y,big z)
 { /* "fast" O(n.log n) multiplication */
-    int i,pr,xl,yl,zl,newn,logn;
-    mr_small v1,v2,v3,ic,c1,c2,p,fac,inv;
+    int i,xl,yl,zl,newn,logn,threads;
+    mr_small v1,v2,v3,ic,c1,c2;
+    fft_int f;
 
 #ifdef MR_ITANIUM
     mr_small tm;
 #endif
 #ifdef MR_WIN64
     mr_small tm;
-#endif
-#ifdef MR_FP
-    mr_small dres;
 #endif
     mr_lentype sz;
-    mr_utype *w[3],*wptr,*dptr,*d0,*d1,*d2,t;
+    mr_utype *d0,*d1,*d2;
 #ifdef MR_OS_THREADS
     miracl *mr_mip=get_mip();
-#endif
-#ifdef MR_FP_ROUNDING
-    mr_large ip;
 #endif
     if (mr_mip->ERNUM) return;
     if (y->len==0 || x->len==0) 
@@ -1208,78 +1373,16 @@ void fft_mult(_MIPD_ big x,big y,big z)
         return;
     }
 
-    d0=mr_mip->t[0]; d1=mr_mip->t[1]; d2=mr_mip->t[2];
-    w[0]=mr_mip->wa; w[1]=mr_mip->wb; w[2]=mr_mip->wc;
-
-    fac=twop(mr_mip->logN-logn);
-    
-    for (pr=0;pr<3;pr++)
-    { /* multiply mod each prime */
-        p=mr_mip->prime[pr];
-        inv=mr_mip->inverse[pr];  
-#ifdef MR_FP_ROUNDING
-        ip=mr_invert(p);
-#endif         
-        if (fac!=1) inv=smul(fac,inv,p);  /* adjust 1/N mod p */
-        
-        dptr=mr_mip->t[pr];
-        wptr=w[pr];
-
-        for (i=0;i<xl;i++) dptr[i]=MR_REMAIN(x->w[i],p);
-        for (i=xl;i<newn;i++) dptr[i]=0;
-                                   
-        mr_dif_fft(_MIPP_ logn,pr,dptr);
-
-
-        if (x!=y)
-        {
-            if (!mr_mip->same || !mr_mip->first_one)
-            {   
-                for (i=0;i<yl;i++) wptr[i]=MR_REMAIN(y->w[i],p);
-                for (i=yl;i<newn;i++) wptr[i]=0;
-                mr_dif_fft(_MIPP_ logn,pr,wptr);
-            } 
-        }
-        else wptr=dptr;
-
-        for (i=0;i<newn;i++)
-        {  /* "multiply" Fourier transforms */
-#ifdef MR_FP_ROUNDING
-            imuldiv(dptr[i],wptr[i],(mr_small)0,p,ip,(mr_small *)&dptr[i]);
-#else
-            muldiv(dptr[i],wptr[i],(mr_small)0,p,(mr_small *)&dptr[i]);
-#endif
-        }
-
-        mr_dit_fft(_MIPP_ logn,pr,dptr);
-
-        for (i=0;i<newn;i++)
-        {  /* convert to mixed radix form     *
-            * using chinese remainder thereom *
-            * but first multiply by 1/N mod p */
-#ifdef MR_FP_ROUNDING
-            imuldiv(dptr[i],inv,(mr_small)0,p,ip,(mr_small *)&dptr[i]); 
-#else
-            muldiv(dptr[i],inv,(mr_small)0,p,(mr_small *)&dptr[i]); 
-#endif
-            if (pr==1)
-            {
-                t=d1[i]-d0[i];
-                while (t<0) t+=mr_mip->prime[1];
-                muldiv(t,mr_mip->const1,(mr_small)0,mr_mip->prime[1],(mr_small *)&d1[i]);
-            } 
-            if (pr==2)
-            {
-                t=d2[i]-d0[i];
-                while (t<0) t+=mr_mip->prime[2];
-                muldiv(t,mr_mip->const2,(mr_small)0,mr_mip->prime[2],(mr_small *)&t);
-                t-=d1[i];
-                while (t<0) t+=mr_mip->prime[2];
-                muldiv(t,mr_mip->const3,(mr_small)0,mr_mip->prime[2],(mr_small *)&d2[i]);
-            }
-        }    
-    }
+    f.mip=mr_mip;
+    f.x=x; f.y=y;
+    f.logn=logn; f.newn=newn; f.zl=zl;
+    f.ynew=(!mr_mip->same || !mr_mip->first_one);
+    threads=fft_threads(mr_mip,3*newn,3);
+    fft_run(threads,3,int_prime,&f);     /* multiply mod each prime */
+    f.blk=(zl+threads-1)/threads;
+    fft_run(threads,(zl+f.blk-1)/f.blk,int_crt,&f);
 
+    d0=mr_mip->t[0]; d1=mr_mip->t[1]; d2=mr_mip->t[2];
     mr_mip->first_one=TRUE;
 
     zero(z);
@@ -1319,6 +1422,360 @@ void fft_mult(_MIPD_ big x,big y,big z)
     MR_OUT
 }
 
+#if !defined(MR_NOFULLWIDTH) && !defined(MR_FP)
+
+/* Squaring modulo 2^q-1 or 2^q+1 by an irrational base discrete weighted   *
+ * transform. See "Discrete Weighted Transforms and Large-Integer            *
+ * Arithmetic" by R. Crandall and B. Fagin, Math. Comp. 62 (1994) pp305-324 *
+ *                                                                          *
+ * The number is held as n digits, of floor(q/n) or ceil(q/n) bits, and the *
+ * digit at bit ceil(q.j/n) is weighted by 2^(ceil(q.j/n)-q.j/n). Then a    *
+ * cyclic convolution of length n squares it with no zero padding, and the  *
+ * reduction is just the carry out of the top digit added back at the       *
+ * bottom. For 2^q+1 the weights also include a 2n-th root of -1, to make   *
+ * the convolution negacyclic. The weights are powers of an n-th root of 2  *
+ * modulo two FFT primes, chosen so that such a root exists                 */
+
+static BOOL fft_mod_prime(mr_small p)
+{ /* Miller-Rabin test - these bases suffice for p<2^64 */
+    static int base[]={2,3,5,7,11,13,17,19,23,29,31,37};
+    int i,j,s;
+    mr_small d,x;
+    for (d=p-1,s=0;d%2==0;s++) d/=2;
+    for (i=0;i<12;i++)
+    {
+        x=spmd((mr_small)base[i],d,p);
+        if (x==1 || x==p-1) continue;
+        for (j=1;j<s;j++)
+        {
+            x=smul(x,x,p);
+            if (x==p-1) break;
+        }
+        if (j>=s) return FALSE;
+    }
+    return TRUE;
+}
+
+static mr_small fft_mod_search(mr_small top,mr_small low,int logn,int s)
+{ /* largest prime low<p<top, p=1 mod 2^s, in which 2 is a 2^logn-th *
+   * power. Only one in 2^logn such primes qualify, so sieve first    */
+    static int sp[]={3,5,7,11,13,17,19,23,29,31,37,41,43,47};
+    int i;
+    mr_small p;
+    for (p=(((top-2)>>s)<<s)+1;p>low;p-=((mr_small)1<<s))
+    {
+        for (i=0;i<14;i++) if (p%sp[i]==0) break;
+        if (i<14) continue;
+        if (spmd((mr_small)2,(p-1)>>logn,p)!=1) continue;
+        if (fft_mod_prime(p)) return p;
+    }
+    return 0;
+}
+
+static int fft_mod_log(mr_small p)
+{ /* floor(log2(p)) */
+    int e=0;
+    while (p>1) {p>>=1; e++;}
+    return e;
+}
+
+void fft_mod_end(fft_mod *f)
+{ /* free the tables */
+    int k;
+    if (f->n==0) return;
+    for (k=0;k<2;k++)
+    {
+        mr_free(f->roots[k]);
+        mr_free(f->wt[k]);
+        mr_free(f->iwt[k]);
+        mr_free(f->t[k]);
+    }
+    mr_free(f->d);
+    mr_free(f->shift);
+    f->n=0;
+}
+
+BOOL fft_mod_init(_MIPD_ fft_mod *f,int q,int sign)
+{ /* set up f for squaring mod 2^q+sign, sign is 1 or -1. *
+   * Returns FALSE if suitable primes cannot be found     */
+    int j,k,s,b,logn,n;
+    mr_small p,r,z,w,ninv,wj,fl,rem,low,pr[2];
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    f->n=0;
+    if (mr_mip->ERNUM) return FALSE;
+
+    MR_IN(245)
+
+    if (q<8 || (sign!=1 && sign!=-1))
+    {
+        mr_berror(_MIPP_ MR_ERR_BAD_PARAMETERS);
+        MR_OUT
+        return FALSE;
+    }
+
+/* smallest power of 2 length for which the digits fit in a word, *
+ * and the convolution fits in the product of two FFT primes       */
+
+    low=((mr_small)1<<(MIRACL-5));
+    for (logn=3;;logn++)
+    {
+        n=(1<<logn);
+        if (logn>MIRACL-10 || n>q)
+        {
+            MR_OUT
+            return FALSE;
+        }
+        b=(q+n-1)/n;
+        if (b>MIRACL-4 || 2*b+logn+2>2*MIRACL-6) continue;
+        s=logn;
+        if (sign>0) s++;
+        pr[0]=fft_mod_search((mr_small)1<<(MIRACL-2),low,logn,s);
+        if (pr[0]==0) continue;
+        pr[1]=fft_mod_search(pr[0],low,logn,s);
+        if (pr[1]==0) continue;
+        if (2*b+logn+2<=fft_mod_log(pr[0])+fft_mod_log(pr[1])) break;
+    }
+    f->q=q; f->sign=sign; f->logn=logn;
+
+    f->shift=(int *)mr_alloc(_MIPP_ n+1,sizeof(int));
+    f->d=(mr_utype *)mr_alloc(_MIPP_ n,sizeof(mr_utype));
+    for (k=0;k<2;k++)
+    {
+        f->roots[k]=(mr_utype *)mr_alloc(_MIPP_ n,sizeof(mr_utype));
+        f->wt[k]=(mr_utype *)mr_alloc(_MIPP_ n,sizeof(mr_utype));
+        f->iwt[k]=(mr_utype *)mr_alloc(_MIPP_ n,sizeof(mr_utype));
+        f->t[k]=(mr_utype *)mr_alloc(_MIPP_ n,sizeof(mr_utype));
+    }
+    f->n=n;
+    if (mr_mip->ERNUM)
+    {
+        fft_mod_end(f);
+        MR_OUT
+        return FALSE;
+    }
+
+    for (k=0;k<2;k++)
+    {
+        p=pr[k];
+        f->prime[k]=(mr_utype)p;
+
+        z=p-1;                       /* root of unity of order 2^s */
+        for (j=1;j<s;j++) z=sqrmp(z,p);
+        w=z;
+        if (sign>0) w=smul(z,z,p);   /* root of unity of order n */
+        f->roots[k][0]=(mr_utype)w;
+        for (j=1;j<n;j++) f->roots[k][j]=(mr_utype)smul((mr_small)f->roots[k][j-1],w,p);
+
+        r=2;                         /* r^n=2 - any square root will do */
+        for (j=0;j<logn;j++) r=sqrmp(r,p);
+        ninv=invers((mr_small)n,p);
+        fl=rem=0;                    /* q.j = n.fl+rem */
+        wj=1;
+        for (j=0;j<n;j++)
+        {
+            f->shift[j]=(int)fl+(rem>0);
+            f->wt[k][j]=(mr_utype)smul(spmd(r,rem>0?n-rem:0,p),wj,p);
+            f->iwt[k][j]=(mr_utype)smul(invers((mr_small)f->wt[k][j],p),ninv,p);
+            if (sign>0) wj=smul(wj,z,p);
+            fl+=q/n;
+            rem+=q%n;
+            if (rem>=(mr_small)n) {rem-=n; fl++;}
+        }
+    }
+    f->shift[n]=q;
+    f->c=(mr_utype)invers(pr[0]%pr[1],pr[1]);
+    for (j=0;j<n;j++) f->d[j]=0;
+
+    MR_OUT
+    return TRUE;
+}
+
+static mr_small fft_mod_bits(big x,int from,int n)
+{ /* bits from..from+n-1 of x, for n<MIRACL */
+    int w=from/MIRACL,o=from%MIRACL,len=(int)(x->len&MR_OBITS);
+    mr_small v=0;
+    if (w<len) v=(x->w[w]>>o);
+    if (o+n>MIRACL && w+1<len) v|=(x->w[w+1]<<(MIRACL-o));
+    return v&(((mr_small)1<<n)-1);
+}
+
+static void fft_mod_modulus(_MIPD_ fft_mod *f,big m)
+{ /* m=2^q+sign */
+    expb2(_MIPP_ f->q,m);
+    if (f->sign>0) incr(_MIPP_ m,1,m);
+    else           decr(_MIPP_ m,1,m);
+}
+
+void fft_mod_set(_MIPD_ fft_mod *f,big x)
+{ /* load x mod 2^q+sign into f */
+    int j,n=f->n;
+    big m,y;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM || n==0) return;
+
+    MR_IN(246)
+
+    m=mirvar(_MIPP_ 0);
+    y=mirvar(_MIPP_ 0);
+    fft_mod_modulus(_MIPP_ f,m);
+    copy(x,y);
+    divide(_MIPP_ y,m,m);
+    if (size(y)<0) add(_MIPP_ y,m,y);
+    fft_mod_modulus(_MIPP_ f,m);
+    for (j=0;j<n-1;j++)
+        f->d[j]=(mr_utype)fft_mod_bits(y,f->shift[j],f->shift[j+1]-f->shift[j]);
+    f->d[n-1]=(mr_utype)fft_mod_bits(y,f->shift[n-1],f->q+1-f->shift[n-1]);   /* y may be 2^q */
+
+    mr_free(y);
+    mr_free(m);
+    MR_OUT
+}
+
+void fft_mod_get(_MIPD_ fft_mod *f,big x)
+{ /* x=number in f, reduced to 0..2^q+sign-1 */
+    int j,w,o,words,n=f->n;
+    mr_small v;
+    big m,y;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM || n==0) return;
+
+    MR_IN(247)
+
+    words=(f->q+MIRACL-1)/MIRACL;
+    if (words>(int)mr_mip->nib && mr_mip->check)
+    {
+        mr_berror(_MIPP_ MR_ERR_OVERFLOW);
+        MR_OUT
+        return;
+    }
+    m=mirvar(_MIPP_ 0);
+    y=mirvar(_MIPP_ 0);
+
+    zero(x);
+    for (j=0;j<n-1;j++)
+    { /* these digits are all in range, so just place their bits */
+        v=(mr_small)f->d[j];
+        w=f->shift[j]/MIRACL; o=f->shift[j]%MIRACL;
+        x->w[w]|=(v<<o);
+        if (o>0 && w+1<words) x->w[w+1]|=(v>>(MIRACL-o));
+    }
+    x->len=words;
+    mr_lzero(x);
+
+    v=(mr_small)f->d[n-1];           /* top digit may be -1 or 2^b */
+    if (f->d[n-1]<0) v=(mr_small)(-f->d[n-1]);
+    y->w[0]=v; y->len=1;
+    mr_lzero(y);
+    sftbit(_MIPP_ y,f->shift[n-1],y);
+    if (f->d[n-1]<0) subtract(_MIPP_ x,y,x);
+    else             add(_MIPP_ x,y,x);
+
+    fft_mod_modulus(_MIPP_ f,m);
+    if (size(x)<0) add(_MIPP_ x,m,x);
+    while (mr_compare(x,m)>=0) subtract(_MIPP_ x,m,x);
+
+    mr_free(y);
+    mr_free(m);
+    MR_OUT
+}
+
+static void mod_prime(void *arg,int k,int wk)
+{ /* weighted cyclic square mod the k-th prime */
+    fft_mod *f=(fft_mod *)arg;
+    int j,n=f->n;
+    mr_utype p,r,*t=f->t[k],*wt=f->wt[k],*iwt=f->iwt[k];
+
+    p=f->prime[k];
+    for (j=0;j<n;j++)
+    {
+        r=MR_REMAIN(f->d[j],p);
+        if (r<0) r+=p;
+        muldiv(r,wt[j],(mr_small)0,p,(mr_small *)&t[j]);
+    }
+    dif_fft(f->logn,0,p,f->roots[k],t);
+    for (j=0;j<n;j++) muldiv(t[j],t[j],(mr_small)0,p,(mr_small *)&t[j]);
+    dit_fft(f->logn,0,p,f->roots[k],t);
+    for (j=0;j<n;j++) muldiv(t[j],iwt[j],(mr_small)0,p,(mr_small *)&t[j]);
+}
+
+void fft_mod_sqr(_MIPD_ fft_mod *f,int c)
+{ /* f=f^2+c mod 2^q+sign */
+    int j,b,n=f->n;
+    mr_small p0,p1,v,hi,lo,ch,cl,ph,pl,hh,hl,neg,bw;
+    mr_utype *t0,*t1,r;
+#ifdef MR_ITANIUM
+    mr_small tm;
+#endif
+#ifdef MR_WIN64
+    mr_small tm;
+#endif
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM || n==0) return;
+
+    fft_run(fft_threads(mr_mip,2*n,2),2,mod_prime,f);
+
+    p0=(mr_small)f->prime[0]; p1=(mr_small)f->prime[1];
+    t0=f->t[0]; t1=f->t[1];
+    ph=muldvd(p0,p1,(mr_small)0,&pl);     /* P=p0.p1 */
+    hl=(pl>>1)|(ph<<(MIRACL-1));           /* P/2 */
+    hh=(ph>>1);
+
+    cl=(mr_small)c;                        /* carry in, two's complement */
+    ch=0;
+    if (c<0) ch=~ch;
+    for (j=0;j<n;j++)
+    { /* Chinese remainder thereom, then propagate carries */
+        r=MR_REMAIN(t1[j]-t0[j],(mr_utype)p1);
+        if (r<0) r+=p1;
+        muldiv((mr_small)r,(mr_small)f->c,(mr_small)0,p1,&v);
+        hi=muldvd(p0,v,(mr_small)t0[j],&lo);
+        if (hi>hh || (hi==hh && lo>hl))
+        { /* in top half of range, so negative */
+            bw=(lo<pl);
+            lo-=pl;
+            hi-=(ph+bw);
+        }
+        lo+=cl;
+        hi+=ch+(lo<cl);
+        b=f->shift[j+1]-f->shift[j];
+        f->d[j]=(mr_utype)(lo&(((mr_small)1<<b)-1));
+        neg=(hi>>(MIRACL-1));
+        cl=(lo>>b)|(hi<<(MIRACL-b));
+        ch=(hi>>b);
+        if (neg) ch|=((~(mr_small)0)<<(MIRACL-b));
+    }
+
+/* carry out of the top is times 2^q, which is 1 mod 2^q-1, -1 mod 2^q+1 */
+
+    if (f->sign>0)
+    {
+        cl=~cl+1;
+        ch=~ch+(cl==0);
+    }
+    for (j=0;j<n-1 && (ch|cl)!=0;j++)
+    {
+        lo=(mr_small)f->d[j]+cl;
+        hi=ch+(lo<cl);
+        b=f->shift[j+1]-f->shift[j];
+        f->d[j]=(mr_utype)(lo&(((mr_small)1<<b)-1));
+        neg=(hi>>(MIRACL-1));
+        cl=(lo>>b)|(hi<<(MIRACL-b));
+        ch=(hi>>b);
+        if (neg) ch|=((~(mr_small)0)<<(MIRACL-b));
+    }
+    if (j==n-1) f->d[n-1]+=(mr_utype)cl;  /* so top digit may be -1 or 2^b */
+}
+
+#endif
+
 #endif
 
 /*
@@ -48,6 +48,10 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
  * 5. call gcm_add_cipher one last time with any length of cipher/plaintext
  * 6. call gcm_finish to extract the tag.
  *
+ * GHASH is computed using Shoup's method, 4 bits at a time from a 256 byte table, or 8 bits at a time 
+ * from a 4k byte table if MR_GCM_TABLE8 is defined in mirdef.h. If PCLMUL_SUPPORT is defined below and 
+ * the processor supports it, the carry-less multiply instruction is used instead.
+ *
  * See http://www.mindspring.com/~dmcgrew/gcm-nist-6.pdf
  */
 
@@ -55,8 +59,25 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 #include <string.h>
 #include "miracl.h"
 
+/* Define this if INTEL PCLMULQDQ carry-less multiply intrinsics are supported. It is only used if the 
+   processor reports the instruction at run-time, otherwise the table-driven code is used */
+/* #define PCLMUL_SUPPORT */
+
+#ifdef PCLMUL_SUPPORT
+#include <wmmintrin.h>
+#include <tmmintrin.h>
+#ifdef __GNUC__
+#include <cpuid.h>
+#define MR_CLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+#else
+#include <intrin.h>
+#define MR_CLMUL_TARGET
+#endif
+#endif
+
 #define NB 4
 #define MR_WORD mr_unsign32
+#define GCM_CHUNK 16   /* blocks enciphered before they are hashed */
 
 static MR_WORD pack(const MR_BYTE *b)
 { /* pack bytes into a 32-bit Word */
@@ -71,40 +92,224 @@ static void unpack(MR_WORD a,MR_BYTE *b)
     b[0]=MR_TOBYTE(a>>24);
 }
 
+/* Reduction constants for Shoup's method - what must be added back into the top
+   16 bits of the accumulator when the bottom 4 bits are shifted off the end */
+
+static const MR_WORD last4[16]=
+{0x0000,0x1c20,0x3840,0x2460,0x7080,0x6ca0,0x48c0,0x54e0,
+ 0xe100,0xfd20,0xd940,0xc560,0x9180,0x8da0,0xa9c0,0xb5e0};
+
+#ifdef MR_GCM_TABLE8
+#define GCM_BITS 8
+#define DIGIT(X,i) (X)[(i)]
+#define REDUCE(r) (((last4[(r)&0xF]>>4)^last4[(r)>>4])<<16)
+#else
+#define GCM_BITS 4
+#define DIGIT(X,i) (((i)&1) ? (X)[(i)>>1]&0xF : (X)[(i)>>1]>>4)
+#define REDUCE(r) (last4[(r)]<<16)
+#endif
+
+#ifdef PCLMUL_SUPPORT
+
+/* GHASH using the carry-less multiply instruction. The field elements are held 
+   byte-reversed, and 4 blocks are accumulated before a single reduction, using
+   precomputed H, H^2, H^3 and H^4. See Gueron & Kounavis, "Intel Carry-Less 
+   Multiplication Instruction and its Usage for Computing the GCM Mode" */
+
+static int clmul_available(void)
+{ /* check at run-time that the processor supports PCLMULQDQ and PSHUFB */
+#ifdef __GNUC__
+	unsigned int a,b,c,d;
+	if (!__get_cpuid(1,&a,&b,&c,&d)) return 0;
+	return ((c&bit_PCLMUL) && (c&bit_SSSE3));
+#else
+	int r[4];
+	__cpuid(r,1);
+	return ((r[2]&0x2) && (r[2]&0x200));
+#endif
+}
+
+MR_CLMUL_TARGET static __m128i clmul_load(const MR_BYTE *b)
+{ /* load 16 bytes, and reverse them */
+	const __m128i BSWAP=_mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+	return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)b),BSWAP);
+}
+
+MR_CLMUL_TARGET static void clmul_store(__m128i x,MR_BYTE *b)
+{
+	const __m128i BSWAP=_mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+	_mm_storeu_si128((__m128i *)b,_mm_shuffle_epi8(x,BSWAP));
+}
+
+MR_CLMUL_TARGET static void clmul_mul(__m128i a,__m128i b,__m128i *lo,__m128i *hi)
+{ /* unreduced 256-bit product of a and b */
+	__m128i t0,t1,t2,t3;
+	t0=_mm_clmulepi64_si128(a,b,0x00);
+	t1=_mm_clmulepi64_si128(a,b,0x10);
+	t2=_mm_clmulepi64_si128(a,b,0x01);
+	t3=_mm_clmulepi64_si128(a,b,0x11);
+	t1=_mm_xor_si128(t1,t2);
+	*lo=_mm_xor_si128(t0,_mm_slli_si128(t1,8));
+	*hi=_mm_xor_si128(t3,_mm_srli_si128(t1,8));
+}
+
+MR_CLMUL_TARGET static __m128i clmul_reduce(__m128i lo,__m128i hi)
+{ /* shift 256-bit product left by one bit (bit-reflection), and reduce mod the irreducible polynomial */
+	__m128i t2,t4,t5,t7,t8,t9;
+	t7=_mm_srli_epi32(lo,31);
+	t8=_mm_srli_epi32(hi,31);
+	lo=_mm_slli_epi32(lo,1);
+	hi=_mm_slli_epi32(hi,1);
+	t9=_mm_srli_si128(t7,12);
+	t8=_mm_slli_si128(t8,4);
+	t7=_mm_slli_si128(t7,4);
+	lo=_mm_or_si128(lo,t7);
+	hi=_mm_or_si128(hi,t8);
+	hi=_mm_or_si128(hi,t9);
+
+	t7=_mm_slli_epi32(lo,31);
+	t8=_mm_slli_epi32(lo,30);
+	t9=_mm_slli_epi32(lo,25);
+	t7=_mm_xor_si128(t7,t8);
+	t7=_mm_xor_si128(t7,t9);
+	t8=_mm_srli_si128(t7,4);
+	t7=_mm_slli_si128(t7,12);
+	lo=_mm_xor_si128(lo,t7);
+
+	t2=_mm_srli_epi32(lo,1);
+	t4=_mm_srli_epi32(lo,2);
+	t5=_mm_srli_epi32(lo,7);
+	t2=_mm_xor_si128(t2,t4);
+	t2=_mm_xor_si128(t2,t5);
+	t2=_mm_xor_si128(t2,t8);
+	lo=_mm_xor_si128(lo,t2);
+	return _mm_xor_si128(hi,lo);
+}
+
+MR_CLMUL_TARGET static void clmul_precompute(gcm *g,MR_BYTE *H)
+{ /* powers of H */
+	int i;
+	__m128i lo,hi,h,p;
+	h=p=clmul_load(H);
+	clmul_store(h,g->Hpow[0]);
+	for (i=1;i<GCM_HPOWERS;i++)
+	{
+		clmul_mul(p,h,&lo,&hi);
+		p=clmul_reduce(lo,hi);
+		clmul_store(p,g->Hpow[i]);
+	}
+}
+
+MR_CLMUL_TARGET static void clmul_ghash(gcm *g,const MR_BYTE *data,int nblocks)
+{ /* X=(X+D_1).H^n + D_2.H^(n-1) + ... + D_n.H */
+	__m128i X,D,lo,hi,l,h,H1,H2,H3,H4;
+	X=clmul_load(g->stateX);
+	H1=clmul_load(g->Hpow[0]);
+	if (nblocks>=4)
+	{
+		H2=clmul_load(g->Hpow[1]);
+		H3=clmul_load(g->Hpow[2]);
+		H4=clmul_load(g->Hpow[3]);
+		while (nblocks>=4)
+		{
+			D=_mm_xor_si128(X,clmul_load(data));
+			clmul_mul(D,H4,&lo,&hi);
+			clmul_mul(clmul_load(data+16),H3,&l,&h);
+			lo=_mm_xor_si128(lo,l); hi=_mm_xor_si128(hi,h);
+			clmul_mul(clmul_load(data+32),H2,&l,&h);
+			lo=_mm_xor_si128(lo,l); hi=_mm_xor_si128(hi,h);
+			clmul_mul(clmul_load(data+48),H1,&l,&h);
+			lo=_mm_xor_si128(lo,l); hi=_mm_xor_si128(hi,h);
+			X=clmul_reduce(lo,hi);
+			data+=64; nblocks-=4;
+		}
+	}
+	while (nblocks>0)
+	{
+		if (data!=NULL) {X=_mm_xor_si128(X,clmul_load(data)); data+=16;}
+		clmul_mul(X,H1,&lo,&hi);
+		X=clmul_reduce(lo,hi);
+		nblocks--;
+	}
+	clmul_store(X,g->stateX);
+}
+
+#endif
+
 static void precompute(gcm *g,MR_BYTE *H)
-{ /* precompute small 2k bytes gf2m table of x^n.H */
-	int i,j;
+{ /* precompute Shoup table of all multiples of H by GCM_BITS-bit digits - 256 bytes for 4 bits, 4k bytes for 8 bits */
+	int i,j,k;
 	MR_WORD *last,*next,b;
 
-	for (i=j=0;i<NB;i++,j+=4) g->table[0][i]=pack((MR_BYTE *)&H[j]);
+	next=g->table[GCM_TABLE_SIZE/2];  /* top bit only is H */
+	for (i=j=0;i<NB;i++,j+=4) next[i]=pack((MR_BYTE *)&H[j]);
 
-	for (i=1;i<128;i++)
-	{
-		next=g->table[i]; last=g->table[i-1]; b=0;
+	for (k=GCM_TABLE_SIZE/4;k>0;k>>=1)
+	{ /* each bit further down is x times the last */
+		next=g->table[k]; last=g->table[2*k]; b=0;
 		for (j=0;j<NB;j++) {next[j]=b|(last[j])>>1; b=last[j]<<31;}
 		if (b) next[0]^=0xE1000000; /* irreducible polynomial */
 	}
+	for (j=0;j<NB;j++) g->table[0][j]=0;
+	for (k=2;k<GCM_TABLE_SIZE;k<<=1)
+	{ /* fill in the rest by linearity */
+		for (i=1;i<k;i++)
+			for (j=0;j<NB;j++) g->table[k+i][j]=g->table[k][j]^g->table[i][j];
+	}
+
+#ifdef PCLMUL_SUPPORT
+	g->clmul=clmul_available();
+	if (g->clmul) clmul_precompute(g,H);
+#else
+	g->clmul=0;
+#endif
 }
 
 static void gf2mul(gcm *g)
-{ /* gf2m mul - Z=H*X mod 2^128 */
-	int i,j,m,k;
-	MR_WORD P[4];
-	MR_BYTE b;
-
-	P[0]=P[1]=P[2]=P[3]=0;
-	j=8; m=0;
-	for (i=0;i<128;i++)
+{ /* gf2m mul - Z=H*X mod 2^128, using Shoup's method, GCM_BITS of X at a time */
+	int i,k;
+	MR_WORD P[4],r;
+	MR_WORD *T;
+
+#ifdef PCLMUL_SUPPORT
+	if (g->clmul)
 	{
-		b=(g->stateX[m]>>(--j))&1;
-		if (b) for (k=0;k<NB;k++) P[k]^=g->table[i][k];
-		if (j==0)
-		{
-			j=8; m++;
-			if (m==16) break;
-		}
+		clmul_ghash(g,NULL,1);
+		return;
+	}
+#endif
+	i=128/GCM_BITS-1;
+	T=g->table[DIGIT(g->stateX,i)];
+	for (k=0;k<NB;k++) P[k]=T[k];
+	while (--i>=0)
+	{
+		r=P[3]&(GCM_TABLE_SIZE-1);
+		P[3]=(P[3]>>GCM_BITS)|(P[2]<<(32-GCM_BITS));
+		P[2]=(P[2]>>GCM_BITS)|(P[1]<<(32-GCM_BITS));
+		P[1]=(P[1]>>GCM_BITS)|(P[0]<<(32-GCM_BITS));
+		P[0]=(P[0]>>GCM_BITS)^REDUCE(r);
+		T=g->table[DIGIT(g->stateX,i)];
+		for (k=0;k<NB;k++) P[k]^=T[k];
+	}
+	for (i=k=0;i<NB;i++,k+=4) unpack(P[i],(MR_BYTE *)&g->stateX[k]);
+}
+
+static void ghash(gcm *g,const MR_BYTE *data,int nblocks)
+{ /* absorb a run of complete 16-byte blocks */
+	int i;
+#ifdef PCLMUL_SUPPORT
+	if (g->clmul)
+	{
+		clmul_ghash(g,data,nblocks);
+		return;
+	}
+#endif
+	while (nblocks>0)
+	{
+		for (i=0;i<16;i++) g->stateX[i]^=data[i];
+		gf2mul(g);
+		data+=16; nblocks--;
 	}
-	for (i=j=0;i<NB;i++,j+=4) unpack(P[i],(MR_BYTE *)&g->stateX[j]);
 }
 
 static void gcm_wrap(gcm *g)
@@ -127,6 +332,7 @@ static void gcm_wrap(gcm *g)
 void gcm_init(gcm* g,int nk,char *key,int niv,char *iv)
 { /* iv size niv is usually 12 bytes (96 bits). AES key size nk can be 16,24 or 32 bytes */
 	int i;
+	MR_WORD counter;
 	MR_BYTE H[16];
 	for (i=0;i<16;i++) {H[i]=0; g->stateX[i]=0;}
 
@@ -149,63 +355,79 @@ void gcm_init(gcm* g,int nk,char *key,int niv,char *iv)
 		for (i=0;i<16;i++) {g->a.f[i]=g->stateX[i];g->Y_0[i]=g->a.f[i];g->stateX[i]=0;}
 		g->lenA[0]=g->lenC[0]=g->lenA[1]=g->lenC[1]=0;
 	}
+	counter=pack((MR_BYTE *)&(g->a.f[12]));
+	unpack(counter+1,(MR_BYTE *)&(g->a.f[12]));  /* counter register now holds Y_1 */
 	g->status=GCM_ACCEPTING_HEADER;
 }
 
 BOOL gcm_add_header(gcm* g,char *header,int len)
 { /* Add some header. Won't be encrypted, but will be authenticated. len is length of header */
-	int i,j=0;
+	int i,j;
+	mr_unsign32 t;
 	if (g->status!=GCM_ACCEPTING_HEADER) return FALSE;
 
-	while (j<len)
+	j=len&(~15);
+	ghash(g,(MR_BYTE *)header,j>>4);
+	if (j<len)
 	{
-		for (i=0;i<16 && j<len;i++)
-		{
-			g->stateX[i]^=header[j++];
-			g->lenA[1]++; if (g->lenA[1]==0) g->lenA[0]++;
-		}
+		for (i=0;j<len;i++) g->stateX[i]^=header[j++];
 		gf2mul(g);
 	}
+	t=g->lenA[1]; g->lenA[1]+=(mr_unsign32)len; if (g->lenA[1]<t) g->lenA[0]++;
+
 	if (len%16!=0) g->status=GCM_ACCEPTING_CIPHER;
 	return TRUE;
 }
 
 BOOL gcm_add_cipher(gcm *g,int mode,char *plain,int len,char *cipher)
 { /* Add plaintext to extract ciphertext, or visa versa, depending on mode. len is length of plaintext/ciphertext. Note this file combines GHASH() functionality with encryption/decryption */
-	int i,j=0;
-	MR_WORD counter;
+	int i,j,n,nb;
+	mr_unsign32 t;
 	MR_BYTE B[16];
 	if (g->status==GCM_ACCEPTING_HEADER) g->status=GCM_ACCEPTING_CIPHER;
 	if (g->status!=GCM_ACCEPTING_CIPHER) return FALSE;
 
-	while (j<len)
-	{
+	nb=len>>4;
+	if (cipher==NULL) ghash(g,(MR_BYTE *)plain,nb);
+	else for (j=0;j<nb;j+=n)
+	{ /* complete blocks are processed GCM_CHUNK at a time, so they are still in cache for GHASH */
+		n=nb-j; if (n>GCM_CHUNK) n=GCM_CHUNK;
+		if (mode==GCM_ENCRYPTING)
+		{
+			aes_ctr_encrypt_blocks(&(g->a),&plain[16*j],&cipher[16*j],n);
+			ghash(g,(MR_BYTE *)&cipher[16*j],n);
+		}
+		else
+		{
+			ghash(g,(MR_BYTE *)&cipher[16*j],n);
+			aes_ctr_encrypt_blocks(&(g->a),&cipher[16*j],&plain[16*j],n);
+		}
+	}
+
+	j=16*nb;
+	if (j<len)
+	{ /* last partial block */
 		if (cipher!=NULL)
 		{
-			counter=pack((MR_BYTE *)&(g->a.f[12]));
-			counter++;
-			unpack(counter,(MR_BYTE *)&(g->a.f[12]));  /* increment counter */
-			for (i=0;i<16;i++) B[i]=g->a.f[i];
-			aes_ecb_encrypt(&(g->a),B);        /* encrypt it  */
+			for (i=0;i<16;i++) B[i]=0;
+			aes_ctr_encrypt_blocks(&(g->a),(char *)B,(char *)B,1);
 		}
-		for (i=0;i<16 && j<len;i++)
+		for (i=0;j<len;i++,j++)
 		{
 			if (cipher==NULL)
-				g->stateX[i]^=plain[j++];
+				g->stateX[i]^=plain[j];
 			else
 			{
 				if (mode==GCM_ENCRYPTING) cipher[j]=plain[j]^B[i];
 				g->stateX[i]^=cipher[j];
 				if (mode==GCM_DECRYPTING) plain[j]=cipher[j]^B[i];
-				j++;
-				/*if (mode==GCM_ENCRYPTING) cipher[j]=plain[j]^B[i];
-				if (mode==GCM_DECRYPTING) plain[j]=cipher[j]^B[i];
-				g->stateX[i]^=cipher[j++]; */
 			}
-			g->lenC[1]++; if (g->lenC[1]==0) g->lenC[0]++;
 		}
 		gf2mul(g);
+		for (i=0;i<16;i++) B[i]=0;
 	}
+	t=g->lenC[1]; g->lenC[1]+=(mr_unsign32)len; if (g->lenC[1]<t) g->lenC[0]++;
+
 	if (len%16!=0) g->status=GCM_NOT_ACCEPTING_MORE;
 	return TRUE;
 }
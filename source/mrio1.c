@@ -230,7 +230,7 @@ int instr(_MIPD_ flash x,char *string)
 			continue;
 		}
 		
-        putdig(_MIPP_ ch,x,n);
+        if (ch!=0) putdig(_MIPP_ ch,x,n);   /* x starts at zero */
     }
 
 	if (pads && lc>0)
@@ -42,11 +42,187 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 #ifndef MR_SIMPLE_BASE
 #ifndef MR_SIMPLE_IO
 
+#ifndef MR_FP
+
+static int cbase_bits(mr_small b)
+{ /* bits in base b, if a power of 2, else 0 */
+    int n=0;
+    if (b==0) return MIRACL;
+    if ((b&(b-1))!=0) return 0;
+    while (b>1)
+    {
+        b>>=1;
+        n++;
+    }
+    return n;
+}
+
+static void cbase_pack(big x,int ob,int nb,big y)
+{ /* repack x from ob bits per word to nb bits per word - linear time */
+    int i,j,p,got,k,n,bits;
+    mr_small w;
+    bits=(int)x->len*ob;
+    n=(bits+nb-1)/nb;
+    p=0;
+    for (j=0;j<n;j++)
+    {
+        w=0;
+        for (got=0;got<nb && p<bits;got+=k)
+        {
+            i=p%ob;
+            k=ob-i;
+            if (k>nb-got) k=nb-got;
+            if (k>bits-p) k=bits-p;
+            w|=((x->w[p/ob]>>i)&(k==MIRACL?(mr_small)(-1):(((mr_small)1<<k)-1)))<<got;
+            p+=k;
+        }
+        y->w[j]=w;
+    }
+    for (j=n;j<(int)(y->len&MR_OBITS);j++) y->w[j]=0;
+    y->len=n;
+    mr_lzero(y);
+}
+
+#endif
+
+/* Divide-and-conquer conversion to and from a full-width base, by  *
+ * splitting on the powers ob^(2^j), or nb^(2^j), so that the work  *
+ * is in multiply() and divide(). Digit by digit below CBASE_SPLIT  */
+
+#if !defined(MR_STATIC) && !defined(MR_NOFULLWIDTH) && !defined(MR_FP)
+
+#define MR_CBASE_FAST
+#define CBASE_SPLIT 32
+
+static void cbase_in(_MIPD_ mr_small *d,int n,mr_small ob,big *pw,big *t,int j,big r)
+{ /* r=sum of d[i].ob^i for i<n, where n<=2^(j+1). Base is 0 */
+    int i,h;
+    if (n<=CBASE_SPLIT)
+    {
+        zero(r);
+        for (i=n-1;i>=0;i--)
+        {
+            mr_pmul(_MIPP_ r,ob,r);
+            zero(t[0]);
+            t[0]->w[0]=d[i];
+            if (d[i]!=0) t[0]->len=1;
+            add(_MIPP_ r,t[0],r);
+        }
+        return;
+    }
+    h=(1<<j);
+    if (n<=h)
+    {
+        cbase_in(_MIPP_ d,n,ob,pw,t,j-1,r);
+        return;
+    }
+    cbase_in(_MIPP_ d,h,ob,pw,t,j-1,r);
+    cbase_in(_MIPP_ d+h,n-h,ob,pw,t,j-1,t[j+1]);
+    multiply(_MIPP_ t[j+1],pw[j],t[j+1]);
+    add(_MIPP_ r,t[j+1],r);
+}
+
+static void cbase_out(_MIPD_ big v,mr_small nb,big *pw,big *t,int j,mr_small *d)
+{ /* d[i] for i<2^(j+1) = digits of v<nb^(2^(j+1)). v is lost. Base is 0 */
+    int i,n=(2<<j);
+    if (n<=CBASE_SPLIT || size(v)==0)
+    {
+        for (i=0;i<n;i++) d[i]=mr_sdiv(_MIPP_ v,nb,v);
+        return;
+    }
+    divide(_MIPP_ v,pw[j],t[j+1]);
+    cbase_out(_MIPP_ v,nb,pw,t,j-1,d);
+    cbase_out(_MIPP_ t[j+1],nb,pw,t,j-1,d+(n>>1));
+}
+
+static BOOL cbase_split(_MIPD_ big x,mr_small oldbase,big y)
+{ /* y=x in the current base, for non-negative integer x. FALSE if *
+   * neither base is full-width, or x is too small to be worth it  */
+    int i,j,k,n,nw,lg,nt;
+    mr_small b,nb,*d;
+    big *pw,*t;
+    char *mem;
+    BOOL ok;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    nw=(int)x->len;
+    nb=mr_mip->base;
+    if (nw<=2*CBASE_SPLIT || (oldbase!=0 && nb!=0)) return FALSE;
+    if (oldbase==0)
+    { /* bound on number of digits out */
+        for (lg=0,b=nb;b>1;b>>=1) lg++;
+        n=(nw*MIRACL+lg-1)/lg;
+        b=nb;
+    }
+    else
+    {
+        n=nw;
+        b=oldbase;
+    }
+    for (k=0;(1<<(k+1))<n;k++) ;
+
+    nt=2*k+4;
+    pw=(big *)mr_alloc(_MIPP_ nt,sizeof(big));
+    if (pw==NULL) return FALSE;
+    mem=(char *)memalloc(_MIPP_ nt);
+    if (mem==NULL)
+    {
+        mr_free(pw);
+        return FALSE;
+    }
+    for (j=0;j<nt;j++) pw[j]=mirvar_mem(_MIPP_ mem,j);
+    t=pw+k+2;
+    d=NULL;
+
+    mr_mip->base=0;          /* work in the full-width base */
+    pw[0]->w[0]=b;
+    pw[0]->len=1;
+    if (oldbase!=0)
+    {
+        for (j=1;j<=k;j++) multiply(_MIPP_ pw[j-1],pw[j-1],pw[j]);
+        cbase_in(_MIPP_ x->w,n,b,pw,t,k,y);
+        ok=TRUE;
+    }
+    else
+    { /* find the smallest power with square greater than x */
+        for (j=0;j<k;j++)
+        {
+            if (2*(int)pw[j]->len-1>nw) break;
+            multiply(_MIPP_ pw[j],pw[j],pw[j+1]);
+            if (mr_compare(pw[j+1],x)>0) break;
+        }
+        k=j;
+        d=(mr_small *)mr_alloc(_MIPP_ 2<<k,sizeof(mr_small));
+        ok=(d!=NULL);
+        if (ok) cbase_out(_MIPP_ x,b,pw,t,k,d);
+    }
+    mr_mip->base=nb;
+
+    if (d!=NULL)
+    {
+        zero(y);
+        for (i=(2<<k)-1;i>0;i--) if (d[i]!=0) break;
+        y->len=i+1;
+        for (;i>=0;i--) y->w[i]=d[i];
+        mr_lzero(y);
+        mr_free(d);
+    }
+    memkill(_MIPP_ mem,nt);
+    mr_free(pw);
+    return (ok && mr_mip->ERNUM==0);
+}
+
+#endif
+
 static void cbase(_MIPD_ big x,mr_small oldbase,big y)
 {  /*  change radix of x from oldbase to base  */
     int i,s;
     mr_small n;
     BOOL done;
+#ifndef MR_FP
+    int ob,nb;
+#endif
 #ifdef MR_OS_THREADS
     miracl *mr_mip=get_mip();
 #endif
@@ -59,6 +235,10 @@ static void cbase(_MIPD_ big x,mr_small oldbase,big y)
 
     MR_IN(13)
 
+#ifndef MR_FP
+    ob=cbase_bits(oldbase);
+    nb=cbase_bits(mr_mip->base);
+#endif
     s=exsign(x);
 #ifdef MR_FLASH
     numer(_MIPP_ x,mr_mip->w1);
@@ -74,11 +254,19 @@ static void cbase(_MIPD_ big x,mr_small oldbase,big y)
     {
         zero(mr_mip->w6);
         convert(_MIPP_ 1,mr_mip->w0);
-
+#ifndef MR_FP
+        if (ob!=0 && nb!=0)
+        { /* both bases are powers of 2 */
+            cbase_pack(mr_mip->w1,ob,nb,mr_mip->w6);
+            zero(mr_mip->w1);
+        }
+#endif
+#ifdef MR_CBASE_FAST
+        if (cbase_split(_MIPP_ mr_mip->w1,oldbase,mr_mip->w6))
+            zero(mr_mip->w1);
+#endif
         for (i=0;i<(int)mr_mip->w1->len;i++)  
-        { /* this is a bit slow - but not time critical */
-
-
+        {
             mr_pmul(_MIPP_ mr_mip->w0,mr_mip->w1->w[i],mr_mip->w5);
 
             add(_MIPP_ mr_mip->w6,mr_mip->w5,mr_mip->w6);
@@ -71,11 +71,24 @@ extern int fpc,fpa;
 extern void mod256(_MIPD_ big,big);
 #endif
 
+/* fixed size kernels, indexed by modulus length in words */
+
+static mr_kernel kernel_mult[MR_KERNEL_MAX+1];
+static mr_kernel kernel_sqr[MR_KERNEL_MAX+1];
+
+void mr_set_kernel(int n,mr_kernel mult,mr_kernel sqr)
+{ /* register Montgomery multiplication and squaring for n word moduli */
+    if (n<1 || n>MR_KERNEL_MAX) return;
+    kernel_mult[n]=mult;
+    kernel_sqr[n]=sqr;
+}
+
 void kill_monty(_MIPDO_ )
 {
 #ifdef MR_OS_THREADS
     miracl *mr_mip=get_mip();
 #endif
+    monty_use(_MIPP_ NULL);
     zero(mr_mip->modulus);
 #ifdef MR_KCM
     zero(mr_mip->big_ndash);
@@ -100,9 +113,15 @@ mr_small prepare_monty(_MIPD_ big n)
 /* Is it set-up already? */
     if (size(mr_mip->modulus)!=0)
         if (mr_compare(n,mr_mip->modulus)==0) return mr_mip->ndash;
+    if (mr_mip->cmonty!=NULL)
+    { /* leave the context in use intact */
+        monty_use(_MIPP_ NULL);
+        return prepare_monty(_MIPP_ n);
+    }
 
     MR_IN(80)
 
+    mr_mip->kmult=mr_mip->ksqr=NULL;
     if (size(n)<=2) 
     {
         mr_berror(_MIPP_ MR_ERR_BAD_MODULUS);
@@ -235,6 +254,11 @@ if (mr_mip->base!=0)
 
     mr_mip->ndash=mr_mip->base-mr_mip->w14->w[0]; /* = N' mod b */
     copy(n,mr_mip->modulus);
+    if (mr_mip->base==0 && n->len<=MR_KERNEL_MAX && kernel_mult[n->len]!=NULL)
+    { /* fixed size kernel available for this modulus */
+        mr_mip->kmult=kernel_mult[n->len];
+        mr_mip->ksqr=kernel_sqr[n->len];
+    }
     mr_mip->check=OFF;
     mr_shift(_MIPP_ mr_mip->modulus,(int)mr_mip->modulus->len,mr_mip->pR);
     mr_mip->check=ON;
@@ -838,6 +862,93 @@ fpa+=2;
 
 }
 
+/* double length product, without reduction */
+
+static void double_mult(_MIPD_ big x,big y,big w)
+{
+#if defined(MR_OS_THREADS) && (defined(MR_COMBA) || defined(MR_KCM))
+    miracl *mr_mip=get_mip();
+#endif
+#ifdef MR_COMBA
+    if (mr_mip->ACTIVE)
+    {
+        comba_mult(x,y,w);
+        return;
+    }
+#endif
+#ifdef MR_KCM
+    if (mr_mip->ACTIVE)
+    {
+        kcm_mul(_MIPP_ x,y,w);
+        return;
+    }
+#endif
+    multiply(_MIPP_ x,y,w);
+}
+
+/*
+As nres_lazy(), but the Karatsuba product is left unreduced, with r and i
+double length values mod pR. Sums and differences of such values can be
+formed with nres_double_modadd/sub, and reduced once with nres_double_redc,
+which is how longer tower products avoid most of their reductions.
+r and i must be double length, and not w0, w1, w2 or w6
+*/
+
+void nres_double_lazy(_MIPD_ big a0,big a1,big b0,big b1,big r,big i)
+{
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return;
+
+    MR_IN(248)
+    mr_mip->check=OFF;
+
+    double_mult(_MIPP_ a0,b0,r);
+    double_mult(_MIPP_ a1,b1,i);
+    nres_double_modadd(_MIPP_ r,i,mr_mip->w6);   /* w6 = a0.b0+a1.b1 */
+    nres_double_modsub(_MIPP_ r,i,r);
+    if (mr_mip->qnr==-2)
+        nres_double_modsub(_MIPP_ r,i,r);        /* r = a0.b0+D.a1.b1 */
+
+    nres_modadd(_MIPP_ a0,a1,mr_mip->w1);
+    nres_modadd(_MIPP_ b0,b1,mr_mip->w2);
+    double_mult(_MIPP_ mr_mip->w1,mr_mip->w2,i);
+    nres_double_modsub(_MIPP_ i,mr_mip->w6,i);   /* i = (a0+a1)(b0+b1)-w6 */
+
+    mr_mip->check=ON;
+    MR_OUT
+}
+
+/* reduce double length x mod pR to an n-residue w */
+
+void nres_double_redc(_MIPD_ big x,big w)
+{
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return;
+#ifdef MR_COMBA
+    if (mr_mip->ACTIVE)
+    {
+        copy(x,mr_mip->w0);
+        comba_redc(_MIPP_ mr_mip->w0,w);
+        return;
+    }
+#endif
+#ifdef MR_KCM
+    if (mr_mip->ACTIVE)
+    {
+        copy(x,mr_mip->w0);
+        kcm_redc(_MIPP_ mr_mip->w0,w);
+        return;
+    }
+#endif
+    MR_IN(249)
+    redc(_MIPP_ x,w);
+    MR_OUT
+}
+
 #endif
 
 #ifndef MR_STATIC
@@ -951,6 +1062,93 @@ void nres_div5(_MIPD_ big x,big w)
 /* mod pR addition and subtraction */
 #ifndef MR_NO_LAZY_REDUCTION
 
+/*
+Fixed length versions for a full width base, as used for lazy reduction.
+x and y are less than pR, and all words above their length are zero
+*/
+
+static void double_add(_MIPD_ big x,big y,big w)
+{ /* w=x+y mod pR */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    int i,n,lw;
+    mr_small carry,s,t,*gx,*gy,*gw,*gp;
+
+    n=(int)mr_mip->pR->len;
+    lw=(int)(w->len&MR_OBITS);
+    gx=x->w; gy=y->w; gw=w->w; gp=mr_mip->pR->w;
+    carry=0;
+    for (i=0;i<n;i++)
+    {
+        s=gx[i]+carry;
+        carry=(s<carry);
+        t=s+gy[i];
+        carry+=(t<s);
+        gw[i]=t;
+    }
+    for (;i<lw;i++) gw[i]=0;
+
+    if (!carry)
+    { /* subtract pR only if w>=pR */
+        for (i=n-1;i>=0;i--)
+            if (gw[i]!=gp[i]) break;
+        if (i>=0 && gw[i]<gp[i]) carry=2;
+    }
+    if (carry!=2)
+    {
+        carry=0;
+        for (i=0;i<n;i++)
+        {
+            s=gw[i]-carry;
+            carry=(s>gw[i]);
+            t=s-gp[i];
+            carry+=(t>s);
+            gw[i]=t;
+        }
+    }
+    w->len=n;
+    mr_lzero(w);
+}
+
+static void double_sub(_MIPD_ big x,big y,big w)
+{ /* w=x-y mod pR */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    int i,n,lw;
+    mr_small borrow,s,t,*gx,*gy,*gw,*gp;
+
+    n=(int)mr_mip->pR->len;
+    lw=(int)(w->len&MR_OBITS);
+    gx=x->w; gy=y->w; gw=w->w; gp=mr_mip->pR->w;
+    borrow=0;
+    for (i=0;i<n;i++)
+    {
+        s=gx[i]-borrow;
+        borrow=(s>gx[i]);
+        t=s-gy[i];
+        borrow+=(t>s);
+        gw[i]=t;
+    }
+    for (;i<lw;i++) gw[i]=0;
+
+    if (borrow)
+    { /* add back pR */
+        borrow=0;
+        for (i=0;i<n;i++)
+        {
+            s=gw[i]+borrow;
+            borrow=(s<borrow);
+            t=s+gp[i];
+            borrow+=(t<s);
+            gw[i]=t;
+        }
+    }
+    w->len=n;
+    mr_lzero(w);
+}
+
 void nres_double_modadd(_MIPD_ big x,big y,big w)
 {
 #ifdef MR_OS_THREADS
@@ -968,6 +1166,15 @@ void nres_double_modadd(_MIPD_ big x,big y,big w)
 #endif 
 
         if (mr_mip->ERNUM) return;
+#ifndef MR_SIMPLE_BASE
+        if (mr_mip->base==0)
+        {
+#endif
+            double_add(_MIPP_ x,y,w);
+            return;
+#ifndef MR_SIMPLE_BASE
+        }
+#endif
         MR_IN(153)
 
         mr_padd(_MIPP_ x,y,w);
@@ -997,6 +1204,15 @@ void nres_double_modsub(_MIPD_ big x,big y,big w)
 #endif 
 
         if (mr_mip->ERNUM) return;
+#ifndef MR_SIMPLE_BASE
+        if (mr_mip->base==0)
+        {
+#endif
+            double_sub(_MIPP_ x,y,w);
+            return;
+#ifndef MR_SIMPLE_BASE
+        }
+#endif
         MR_IN(154)
 
         if (mr_compare(x,y)>=0)
@@ -1183,6 +1399,172 @@ void nres_premult(_MIPD_ big x,int k,big w)
     MR_OUT
 }
 
+/* Modulus contexts. Each holds a prepared Montgomery modulus, so that *
+ * switching between moduli is just a matter of swapping in pointers   *
+ * to its constants, and n-residues remain valid across switches.      */
+
+static void monty_save(miracl *mr_mip,mr_monty *m)
+{ /* copy current modulus into m */
+    m->modulus=mr_mip->modulus;
+    m->pR=mr_mip->pR;
+    m->one=mr_mip->one;
+#ifdef MR_KCM
+    m->big_ndash=mr_mip->big_ndash;
+#endif
+    m->ndash=mr_mip->ndash;
+    m->qnr=mr_mip->qnr;
+    m->pmod8=mr_mip->pmod8;
+    m->pmod9=mr_mip->pmod9;
+    m->NO_CARRY=mr_mip->NO_CARRY;
+    m->ACTIVE=mr_mip->ACTIVE;
+    m->MONTY=mr_mip->MONTY;
+    m->kmult=mr_mip->kmult;
+    m->ksqr=mr_mip->ksqr;
+}
+
+static void monty_load(miracl *mr_mip,mr_monty *m)
+{ /* make m the current modulus */
+    mr_mip->modulus=m->modulus;
+    mr_mip->pR=m->pR;
+    mr_mip->one=m->one;
+#ifdef MR_KCM
+    mr_mip->big_ndash=m->big_ndash;
+#endif
+    mr_mip->ndash=m->ndash;
+    mr_mip->qnr=m->qnr;
+    mr_mip->pmod8=m->pmod8;
+    mr_mip->pmod9=m->pmod9;
+    mr_mip->NO_CARRY=m->NO_CARRY;
+    mr_mip->ACTIVE=m->ACTIVE;
+    mr_mip->MONTY=m->MONTY;
+    mr_mip->kmult=m->kmult;
+    mr_mip->ksqr=m->ksqr;
+}
+
+void monty_use(_MIPD_ mr_monty *m)
+{ /* switch to modulus context m, or back to our own if m is NULL */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (m==mr_mip->cmonty) return;
+    if (mr_mip->cmonty==NULL) monty_save(mr_mip,&mr_mip->monty);
+    if (m==NULL) monty_load(mr_mip,&mr_mip->monty);
+    else         monty_load(mr_mip,m);
+    mr_mip->cmonty=m;
+}
+
+#ifndef MR_STATIC
+
+BOOL monty_init(_MIPD_ mr_monty *m,big n)
+{ /* prepare a context for modulus n */
+    mr_monty own,*last;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return FALSE;
+    m->mem=(char *)memalloc(_MIPP_ MR_MONTY_SPACES);
+    if (m->mem==NULL) return FALSE;
+    m->modulus=mirvar_mem(_MIPP_ m->mem,0);
+    m->pR=mirvar_mem(_MIPP_ m->mem,1);     /* double length */
+    m->one=mirvar_mem(_MIPP_ m->mem,3);
+#ifdef MR_KCM
+    m->big_ndash=mirvar_mem(_MIPP_ m->mem,4);
+#endif
+    m->kmult=m->ksqr=NULL;
+    m->qnr=m->pmod8=m->pmod9=0;
+    m->NO_CARRY=m->ACTIVE=m->MONTY=FALSE;
+    m->ndash=0;
+
+/* set it up in place with prepare_monty() */
+
+    last=mr_mip->cmonty;
+    monty_use(_MIPP_ NULL);
+    monty_save(mr_mip,&own);
+    monty_load(mr_mip,m);
+    prepare_monty(_MIPP_ n);
+    monty_save(mr_mip,m);
+    monty_load(mr_mip,&own);
+    monty_use(_MIPP_ last);
+
+    if (mr_mip->ERNUM)
+    {
+        memkill(_MIPP_ m->mem,MR_MONTY_SPACES);
+        m->mem=NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void monty_end(_MIPD_ mr_monty *m)
+{
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (m->mem==NULL) return;
+    if (mr_mip->cmonty==m) monty_use(_MIPP_ NULL);
+    memkill(_MIPP_ m->mem,MR_MONTY_SPACES);
+    m->mem=NULL;
+}
+
+#endif
+
+/* n-residue arithmetic with respect to context m, whatever the current modulus */
+
+void monty_nres(_MIPD_ mr_monty *m,big x,big y)
+{
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    mr_monty *last=mr_mip->cmonty;
+    monty_use(_MIPP_ m);
+    nres(_MIPP_ x,y);
+    monty_use(_MIPP_ last);
+}
+
+void monty_redc(_MIPD_ mr_monty *m,big x,big y)
+{
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    mr_monty *last=mr_mip->cmonty;
+    monty_use(_MIPP_ m);
+    redc(_MIPP_ x,y);
+    monty_use(_MIPP_ last);
+}
+
+void monty_modmult(_MIPD_ mr_monty *m,big x,big y,big w)
+{
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    mr_monty *last=mr_mip->cmonty;
+    monty_use(_MIPP_ m);
+    nres_modmult(_MIPP_ x,y,w);
+    monty_use(_MIPP_ last);
+}
+
+void monty_modadd(_MIPD_ mr_monty *m,big x,big y,big w)
+{
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    mr_monty *last=mr_mip->cmonty;
+    monty_use(_MIPP_ m);
+    nres_modadd(_MIPP_ x,y,w);
+    monty_use(_MIPP_ last);
+}
+
+void monty_modsub(_MIPD_ mr_monty *m,big x,big y,big w)
+{
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    mr_monty *last=mr_mip->cmonty;
+    monty_use(_MIPP_ m);
+    nres_modsub(_MIPP_ x,y,w);
+    monty_use(_MIPP_ last);
+}
+
 void nres_modmult(_MIPD_ big x,big y,big w)
 { /* Modular multiplication using n-residues w=x*y mod n */
 #ifdef MR_OS_THREADS
@@ -1229,6 +1611,13 @@ fpc++;
 #endif
         if (mr_mip->ERNUM) return;
 
+        if (mr_mip->kmult!=NULL && x->len<=mr_mip->modulus->len && y->len<=mr_mip->modulus->len)
+        { /* fixed size kernel, see montfield.h */
+            if (x==y) (*mr_mip->ksqr)(x,x,mr_mip->modulus,mr_mip->ndash,w);
+            else      (*mr_mip->kmult)(x,y,mr_mip->modulus,mr_mip->ndash,w);
+            return;
+        }
+
         MR_IN(83)
 
         mr_mip->check=OFF;
@@ -179,37 +179,12 @@ int trial_division(_MIPD_ big x,big y)
     return 2;
 }
 
-BOOL isprime(_MIPD_ big x)
-{  /*  test for primality (probably); TRUE if x is prime. test done NTRY *
-    *  times; chance of wrong identification << (1/4)^NTRY. Note however *
-    *  that this is an extreme upper bound. For example for a 100 digit  *
-    *  "prime" the chances of false witness are actually < (.00000003)^NTRY *
-    *  See Kim & Pomerance "The probability that a random probable prime *
-    *  is Composite", Math. Comp. October 1989 pp.721-741                *
-    *  The value of NTRY is now adjusted internally to account for this. */
+static BOOL miller_rabin(_MIPD_ big x)
+{ /* Miller-Rabin part of isprime(), for odd x with no small factors */
     int j,k,n,r,times,d;
-
 #ifdef MR_OS_THREADS
     miracl *mr_mip=get_mip();
 #endif
-    if (mr_mip->ERNUM) return TRUE;
-    if (size(x)<=1) return FALSE;
-
-    MR_IN(22)
-
-    k=trial_division(_MIPP_ x,x);
-    if (k==0) 
-    {
-        MR_OUT
-        return FALSE;
-    }
-    if (k==1)
-    {
-        MR_OUT
-        return TRUE;
-    }
-
-/* Miller-Rabin */
 
     decr(_MIPP_ x,1,mr_mip->w1); /* calculate k and mr_w8 ...    */
     k=0;
@@ -246,7 +221,6 @@ BOOL isprime(_MIPD_ big x)
             j++;
             if ((j>1 && size(mr_mip->w9)==1) || j==k)
             { /* definitely not prime */
-                MR_OUT
                 return FALSE;
             }
             mad(_MIPP_ mr_mip->w9,mr_mip->w9,mr_mip->w9,x,x,mr_mip->w9);
@@ -254,18 +228,182 @@ BOOL isprime(_MIPD_ big x)
 
         if (mr_mip->user!=NULL) if (!(*mr_mip->user)())
         {
-            MR_OUT
             return FALSE;
         }
     }
 
-    MR_OUT
     return TRUE;  /* probably prime */
 }
 
+BOOL isprime(_MIPD_ big x)
+{  /*  test for primality (probably); TRUE if x is prime. test done NTRY *
+    *  times; chance of wrong identification << (1/4)^NTRY. Note however *
+    *  that this is an extreme upper bound. For example for a 100 digit  *
+    *  "prime" the chances of false witness are actually < (.00000003)^NTRY *
+    *  See Kim & Pomerance "The probability that a random probable prime *
+    *  is Composite", Math. Comp. October 1989 pp.721-741                *
+    *  The value of NTRY is now adjusted internally to account for this. */
+    int k;
+    BOOL res;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return TRUE;
+    if (size(x)<=1) return FALSE;
+
+    MR_IN(22)
+
+    k=trial_division(_MIPP_ x,x);
+    if (k==0) 
+    {
+        MR_OUT
+        return FALSE;
+    }
+    if (k==1)
+    {
+        MR_OUT
+        return TRUE;
+    }
+
+/* Miller-Rabin */
+
+    res=miller_rabin(_MIPP_ x);
+
+    MR_OUT
+    return res;
+}
+
+#ifndef MR_STATIC
+
+#define MR_SIEVE 1024   /* candidates sieved at a time */
+
+#if MR_IBITS>16
+#define MR_SIEVE_BOUND 65536   /* sieve with the primes less than this */
+#else
+#define MR_SIEVE_BOUND MR_MAXPRIME
+#endif
+
+static int sieve_start(_MIPD_ big x,int s,int p)
+{ /* first k>=0 such that p divides x+k.s, or -1 if none */
+    int r=remain(_MIPP_ x,p);
+    if (s%p==0) return -1;
+    return (int)smul((mr_small)((p-r)%p),invers((mr_small)(s%p),(mr_small)p),(mr_small)p);
+}
+
+static int *sieve_primes(_MIPD_ int *np)
+{ /* odd primes less than MR_SIEVE_BOUND, or those in PRIMES if *
+   * there are more of them. Free with mr_free() if not PRIMES  */
+    int i,k,n,m,prime,*pr;
+    char *sv;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    for (n=0;mr_mip->PRIMES[n]!=0;n++) ;
+    if (mr_mip->PRIMES[n-1]>=MR_SIEVE_BOUND)
+    {
+        *np=n-1;
+        return mr_mip->PRIMES+1;
+    }
+    m=MR_SIEVE_BOUND/2-1;
+    sv=(char *)mr_alloc(_MIPP_ m,1);
+    if (sv==NULL) return NULL;
+    for (i=0;i<m;i++) sv[i]=TRUE;
+    for (n=i=0;i<m;i++)
+    if (sv[i])
+    { /* sv[i] for i+i+3 */
+        prime=i+i+3;
+        for (k=i+prime;k<m;k+=prime) sv[k]=FALSE;
+        n++;
+    }
+    pr=(int *)mr_alloc(_MIPP_ n,sizeof(int));
+    if (pr!=NULL)
+    {
+        for (n=i=0;i<m;i++)
+            if (sv[i]) pr[n++]=i+i+3;
+    }
+    mr_free(sv);
+    *np=n;
+    return pr;
+}
+
+static BOOL sieve_search(_MIPD_ big x,int sx,big y,int sy,int e)
+{ /* Search x, x+sx, x+2.sx ... for the first prime for which y (if not  *
+   * NULL), stepping by sy, is also prime, and x-1 is not divisible by   *
+   * e (if e>1). Candidates are first sieved by the small primes, using  *
+   * residues calculated once, then survivors get the Miller-Rabin test. *
+   * x and y must be bigger than MR_SIEVE_BOUND and the primes in PRIMES */
+    int i,k,m,np=0,p,*pr,*nx=NULL,*ny=NULL;
+    char *sv;
+    BOOL found=FALSE;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    pr=sieve_primes(_MIPP_ &np);
+    sv=(char *)mr_alloc(_MIPP_ MR_SIEVE,1);
+    if (pr!=NULL) nx=(int *)mr_alloc(_MIPP_ np,sizeof(int));
+    if (pr!=NULL && y!=NULL) ny=(int *)mr_alloc(_MIPP_ np,sizeof(int));
+    if (pr==NULL || sv==NULL || nx==NULL || (y!=NULL && ny==NULL))
+    {
+        mr_berror(_MIPP_ MR_ERR_OUT_OF_MEMORY);
+        np=0;
+    }
+    for (i=0;i<np;i++)
+    {
+        p=pr[i];
+        nx[i]=sieve_start(_MIPP_ x,sx,p);
+        if (y!=NULL) ny[i]=sieve_start(_MIPP_ y,sy,p);
+    }
+
+    while (!found && np>0 && !mr_mip->ERNUM)
+    {
+        for (k=0;k<MR_SIEVE;k++) sv[k]=TRUE;
+        for (i=0;i<np;i++)
+        {
+            p=pr[i];
+            if (nx[i]>=0)
+            {
+                for (k=nx[i];k<MR_SIEVE;k+=p) sv[k]=FALSE;
+                nx[i]=k-MR_SIEVE;
+            }
+            if (y!=NULL && ny[i]>=0)
+            {
+                for (k=ny[i];k<MR_SIEVE;k+=p) sv[k]=FALSE;
+                ny[i]=k-MR_SIEVE;
+            }
+        }
+        for (m=k=0;k<MR_SIEVE;k++)
+        {
+            if (!sv[k]) continue;
+            if (mr_mip->user!=NULL) if (!(*mr_mip->user)()) break;
+            incr(_MIPP_ x,(k-m)*sx,x);
+            if (y!=NULL) incr(_MIPP_ y,(k-m)*sy,y);
+            m=k;
+            if (e>1 && remain(_MIPP_ x,e)==1) continue;
+            if (y!=NULL && !miller_rabin(_MIPP_ y)) continue;
+            if (miller_rabin(_MIPP_ x))
+            {
+                found=TRUE;
+                break;
+            }
+        }
+        if (k<MR_SIEVE) break;   /* found, or user abort */
+        incr(_MIPP_ x,(MR_SIEVE-m)*sx,x);
+        if (y!=NULL) incr(_MIPP_ y,(MR_SIEVE-m)*sy,y);
+    }
+
+    if (ny!=NULL) mr_free(ny);
+    if (nx!=NULL) mr_free(nx);
+    if (sv!=NULL) mr_free(sv);
+    if (pr!=NULL && pr!=mr_mip->PRIMES+1) mr_free(pr);
+    return found;
+}
+
+#endif
+
 BOOL nxprime(_MIPD_ big w,big x)
 {  /*  find next highest prime from w using     * 
     *  probabilistic primality test             */
+    BOOL found;
 #ifdef MR_OS_THREADS
     miracl *mr_mip=get_mip();
 #endif
@@ -282,6 +420,15 @@ BOOL nxprime(_MIPD_ big w,big x)
     }
     if (subdiv(_MIPP_ x,2,mr_mip->w1)==0) incr(_MIPP_ x,1,x);
     else                           incr(_MIPP_ x,2,x);
+#ifndef MR_STATIC
+    if (mr_mip->PRIMES==NULL) gprime(_MIPP_ MR_MAXPRIME);
+    if (size(x)==MR_TOOBIG)
+    {
+        found=sieve_search(_MIPP_ x,2,NULL,0,0);
+        MR_OUT
+        return found;
+    }
+#endif
     while (!isprime(_MIPP_ x)) 
     {
         incr(_MIPP_ x,2,x);
@@ -296,6 +443,42 @@ BOOL nxprime(_MIPD_ big w,big x)
 }
 
 
+BOOL nxprime_step(_MIPD_ int step,int e,big w,big x)
+{ /* find the next prime x>w with x=w mod step, and  *
+   * for which e does not divide x-1 if e>1. w must  *
+   * be odd and step even                            */
+    BOOL found;
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return FALSE;
+
+    MR_IN(244)
+
+    incr(_MIPP_ w,step,x);
+#ifndef MR_STATIC
+    if (mr_mip->PRIMES==NULL) gprime(_MIPP_ MR_MAXPRIME);
+    if (size(x)==MR_TOOBIG)
+    {
+        found=sieve_search(_MIPP_ x,step,NULL,0,e);
+        MR_OUT
+        return found;
+    }
+#endif
+    forever
+    {
+        if (mr_mip->user!=NULL) if (!(*mr_mip->user)())
+        {
+            MR_OUT
+            return FALSE;
+        }
+        if ((e<=1 || remain(_MIPP_ x,e)!=1) && isprime(_MIPP_ x)) break;
+        incr(_MIPP_ x,step,x);
+    }
+    MR_OUT
+    return TRUE;
+}
+
 BOOL nxsafeprime(_MIPD_ int type,int subset,big w,big p)
 { /* If type=0 finds next highest "safe" prime p >= w *
    * A safe prime is one for which q=(p-1)/2 is also  *
@@ -306,6 +489,7 @@ BOOL nxsafeprime(_MIPD_ int type,int subset,big w,big p)
    * q=3 mod 4, subset=0 if you don't care which      */
 
     int rem,increment;
+    BOOL found;
 #ifdef MR_OS_THREADS
     miracl *mr_mip=get_mip();
 #endif
@@ -357,6 +541,18 @@ BOOL nxsafeprime(_MIPD_ int type,int subset,big w,big p)
     else         incr(_MIPP_ p,1,mr_mip->w10);
     subdiv(_MIPP_ mr_mip->w10,2,mr_mip->w10);
 
+#ifndef MR_STATIC
+    if (mr_mip->PRIMES==NULL) gprime(_MIPP_ MR_MAXPRIME);
+    if (size(mr_mip->w10)==MR_TOOBIG)
+    { /* sieve for p and q together */
+        incr(_MIPP_ p,increment,p);
+        incr(_MIPP_ mr_mip->w10,increment/2,mr_mip->w10);
+        found=sieve_search(_MIPP_ p,increment,mr_mip->w10,increment/2,0);
+        MR_OUT
+        return found;
+    }
+#endif
+
     forever
     {
         do {
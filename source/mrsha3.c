@@ -36,7 +36,8 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
  * Implementation of the Secure Hashing Algorithm SHA3 - Keccak
  * M. Scott 19/06/2013
  *
- * For use with byte-oriented messages only. 
+ * For use with byte-oriented messages only. Whole buffers can be absorbed
+ * 8 bytes at a time by sha3_update(). 
  *
  * NOTE: This requires a 64-bit integer type to be defined
  */
@@ -115,9 +116,14 @@ static void shs_transform(sha3 *sh)
 		B[3][2]=rotl(sh->S[4][3],8);
 		B[4][0]=rotl(sh->S[4][4],14);
 
-		for (i=0;i<5;i++)
-			for (j=0;j<5;j++)
-				sh->S[i][j]=B[i][j]^(~B[(i+1)%5][j]&B[(i+2)%5][j]);
+		for (j=0;j<5;j++)
+		{
+			sh->S[0][j]=B[0][j]^(~B[1][j]&B[2][j]);
+			sh->S[1][j]=B[1][j]^(~B[2][j]&B[3][j]);
+			sh->S[2][j]=B[2][j]^(~B[3][j]&B[4][j]);
+			sh->S[3][j]=B[3][j]^(~B[4][j]&B[0][j]);
+			sh->S[4][j]=B[4][j]^(~B[0][j]&B[1][j]);
+		}
 
 		sh->S[0][0]^=RC[k];
 	}
@@ -145,11 +151,41 @@ void sha3_process(sha3 *sh,int byte)
 	int i,j,b=cnt%8;
 	cnt/=8;
 	i=cnt%5; j=cnt/5;  /* process by columns! */
-	sh->S[i][j]^=((mr_unsign64)byte<<(8*b));
+	sh->S[i][j]^=((mr_unsign64)(byte&0xFF)<<(8*b));
 	sh->length++;
 	if (sh->length%sh->rate==0) shs_transform(sh);
 }
 
+void sha3_update(sha3 *sh,char *data,int len)
+{ /* absorb len message bytes - a 64-bit lane at a time where possible */
+	int cnt,i,j,k;
+	mr_unsign64 el;
+	MR_BYTE *b;
+
+	while (len>0 && (sh->length%8)!=0)
+	{
+		sha3_process(sh,*data++);
+		len--;
+	}
+	while (len>=8)
+	{
+		b=(MR_BYTE *)data;
+		el=0;
+		for (k=7;k>=0;k--) el=(el<<8)|b[k];
+		cnt=(int)(sh->length%sh->rate)/8;
+		i=cnt%5; j=cnt/5;  /* process by columns! */
+		sh->S[i][j]^=el;
+		sh->length+=8;
+		if (sh->length%sh->rate==0) shs_transform(sh);
+		data+=8; len-=8;
+	}
+	while (len>0)
+	{
+		sha3_process(sh,*data++);
+		len--;
+	}
+}
+
 void sha3_hash(sha3 *sh,char *hash)
 { /* pad message and finish - supply digest */
 	int i,j,k,m=0;
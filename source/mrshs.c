@@ -146,6 +146,33 @@ void shs_process(sha *sh,int byte)
     if ((sh->length[0]%512)==0) shs_transform(sh);
 }
 
+void shs_update(sha *sh,char *data,int len)
+{ /* process len message bytes - complete blocks are taken straight from the buffer */
+    int i;
+    MR_BYTE *b;
+
+    while (len>0 && (sh->length[0]%512)!=0)
+    { /* fill up a partial block */
+        shs_process(sh,*data++);
+        len--;
+    }
+    while (len>=64)
+    {
+        b=(MR_BYTE *)data;
+        for (i=0;i<16;i++,b+=4)
+            sh->w[i]=((mr_unsign32)b[0]<<24)|((mr_unsign32)b[1]<<16)|((mr_unsign32)b[2]<<8)|(mr_unsign32)b[3];
+        shs_transform(sh);
+        sh->length[0]+=512;
+        if (sh->length[0]==0L) sh->length[1]++;
+        data+=64; len-=64;
+    }
+    while (len>0)
+    {
+        shs_process(sh,*data++);
+        len--;
+    }
+}
+
 void shs_hash(sha *sh,char hash[20])
 { /* pad message and finish - supply digest */
     int i;
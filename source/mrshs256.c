@@ -38,12 +38,48 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
  * Generates a 256 bit message digest. It should be impossible to come
  * come up with two messages that hash to the same value ("collision free").
  *
- * For use with byte-oriented messages only. Could/Should be speeded
- * up by unwinding loops in shs_transform(), and assembly patches.
+ * For use with byte-oriented messages only. Whole buffers can be processed
+ * by shs256_update(), which transforms complete 64-byte blocks directly from
+ * the buffer. If SHA_NI_SUPPORT is defined below, and the processor supports
+ * them, the Intel SHA extensions are used for these blocks.
+ *
+ * shs256_hash_batch() hashes many independent messages at once. If
+ * SHA_AVX2_SUPPORT is defined, eight messages are processed together, one
+ * per 32-bit lane of the AVX2 registers.
  */
 
 #include "miracl.h"
 
+/* Define this if INTEL SHA extension intrinsics are supported. The instructions are only used if the */
+/* processor reports them at run-time */
+/* #define SHA_NI_SUPPORT */
+
+#ifdef SHA_NI_SUPPORT
+#include <immintrin.h>
+#ifdef __GNUC__
+#include <cpuid.h>
+#define MR_SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#else
+#include <intrin.h>
+#define MR_SHANI_TARGET
+#endif
+#endif
+
+/* Define this if AVX2 intrinsics are supported, for multi-buffer hashing. Again the instructions */
+/* are only used if the processor reports them at run-time */
+/* #define SHA_AVX2_SUPPORT */
+
+#ifdef SHA_AVX2_SUPPORT
+#include <immintrin.h>
+#ifdef __GNUC__
+#define MR_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#include <intrin.h>
+#define MR_AVX2_TARGET
+#endif
+#define LANES 8
+#endif
+
 #define H0 0x6A09E667L
 #define H1 0xBB67AE85L
 #define H2 0x3C6EF372L
@@ -78,9 +114,16 @@ static const mr_unsign32 K[64]={
 #define theta0(x)  (S(7,x)^S(18,x)^R(3,x))
 #define theta1(x)  (S(17,x)^S(19,x)^R(10,x))
 
+/* one round - the variables rotate rather than being shifted */
+
+#define ROUND(a,b,c,d,e,f,g,h,j) \
+    t1=h+Sig1(e)+Ch(e,f,g)+K[j]+sh->w[j]; \
+    d+=t1; \
+    h=t1+Sig0(a)+Maj(a,b,c);
+
 static void shs_transform(sha256 *sh)
 { /* basic transformation step */
-    mr_unsign32 a,b,c,d,e,f,g,h,t1,t2;
+    mr_unsign32 a,b,c,d,e,f,g,h,t1;
     int j;
     for (j=16;j<64;j++) 
         sh->w[j]=theta1(sh->w[j-2])+sh->w[j-7]+theta0(sh->w[j-15])+sh->w[j-16];
@@ -88,21 +131,107 @@ static void shs_transform(sha256 *sh)
     a=sh->h[0]; b=sh->h[1]; c=sh->h[2]; d=sh->h[3]; 
     e=sh->h[4]; f=sh->h[5]; g=sh->h[6]; h=sh->h[7];
 
-    for (j=0;j<64;j++)
+    for (j=0;j<64;j+=8)
     { /* 64 times - mush it up */
-        t1=h+Sig1(e)+Ch(e,f,g)+K[j]+sh->w[j];
-        t2=Sig0(a)+Maj(a,b,c);
-        h=g; g=f; f=e;
-        e=d+t1;
-        d=c;
-        c=b;
-        b=a;
-        a=t1+t2;        
+        ROUND(a,b,c,d,e,f,g,h,j)
+        ROUND(h,a,b,c,d,e,f,g,j+1)
+        ROUND(g,h,a,b,c,d,e,f,j+2)
+        ROUND(f,g,h,a,b,c,d,e,j+3)
+        ROUND(e,f,g,h,a,b,c,d,j+4)
+        ROUND(d,e,f,g,h,a,b,c,j+5)
+        ROUND(c,d,e,f,g,h,a,b,j+6)
+        ROUND(b,c,d,e,f,g,h,a,j+7)
     }
     sh->h[0]+=a; sh->h[1]+=b; sh->h[2]+=c; sh->h[3]+=d; 
     sh->h[4]+=e; sh->h[5]+=f; sh->h[6]+=g; sh->h[7]+=h; 
 } 
 
+#ifdef SHA_NI_SUPPORT
+
+static int sha_ni=-1;   /* not yet known */
+
+static int shani_available(void)
+{ /* check at run-time that the processor supports the SHA extensions and SSE4.1 */
+#ifdef __GNUC__
+    unsigned int a,b,c,d;
+    if (!__get_cpuid(1,&a,&b,&c,&d) || !(c&bit_SSE4_1)) return 0;
+    if (!__get_cpuid_count(7,0,&a,&b,&c,&d)) return 0;
+    return ((b&bit_SHA)!=0);
+#else
+    int r[4];
+    __cpuid(r,1);
+    if (!(r[2]&0x80000)) return 0;
+    __cpuidex(r,7,0);
+    return ((r[1]&0x20000000)!=0);
+#endif
+}
+
+MR_SHANI_TARGET static void shani_blocks(sha256 *sh,const MR_BYTE *data,int n)
+{ /* transform n 64-byte blocks. State is held as ABEF and CDGH */
+    int i;
+    __m128i S0,S1,M[4],MSG,T,ABEF,CDGH;
+    const __m128i MASK=_mm_set_epi64x(0x0c0d0e0f08090a0bLL,0x0405060700010203LL);
+
+    T=_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&sh->h[0]),0xB1);
+    S1=_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&sh->h[4]),0x1B);
+    S0=_mm_alignr_epi8(T,S1,8);
+    S1=_mm_blend_epi16(S1,T,0xF0);
+
+    while (n>0)
+    {
+        ABEF=S0; CDGH=S1;
+        for (i=0;i<4;i++) 
+            M[i]=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&data[16*i]),MASK);
+
+        for (i=0;i<16;i++)
+        { /* 4 rounds at a time, while extending the message schedule 4 words ahead */
+            MSG=_mm_add_epi32(M[i&3],_mm_loadu_si128((const __m128i *)&K[4*i]));
+            S1=_mm_sha256rnds2_epu32(S1,S0,MSG);
+            if (i>=3 && i<15)
+            {
+                T=_mm_alignr_epi8(M[i&3],M[(i-1)&3],4);
+                M[(i+1)&3]=_mm_add_epi32(M[(i+1)&3],T);
+                M[(i+1)&3]=_mm_sha256msg2_epu32(M[(i+1)&3],M[i&3]);
+            }
+            MSG=_mm_shuffle_epi32(MSG,0x0E);
+            S0=_mm_sha256rnds2_epu32(S0,S1,MSG);
+            if (i>=1 && i<13) M[(i-1)&3]=_mm_sha256msg1_epu32(M[(i-1)&3],M[i&3]);
+        }
+        S0=_mm_add_epi32(S0,ABEF);
+        S1=_mm_add_epi32(S1,CDGH);
+        data+=64; n--;
+    }
+
+    T=_mm_shuffle_epi32(S0,0x1B);
+    S1=_mm_shuffle_epi32(S1,0xB1);
+    S0=_mm_blend_epi16(T,S1,0xF0);
+    S1=_mm_alignr_epi8(S1,T,8);
+    _mm_storeu_si128((__m128i *)&sh->h[0],S0);
+    _mm_storeu_si128((__m128i *)&sh->h[4],S1);
+}
+
+#endif
+
+static void shs_blocks(sha256 *sh,const MR_BYTE *data,int n)
+{ /* transform n complete blocks taken straight from the buffer */
+    int i;
+#ifdef SHA_NI_SUPPORT
+    if (sha_ni<0) sha_ni=shani_available();
+    if (sha_ni)
+    {
+        shani_blocks(sh,data,n);
+        return;
+    }
+#endif
+    while (n>0)
+    {
+        for (i=0;i<16;i++,data+=4)
+            sh->w[i]=((mr_unsign32)data[0]<<24)|((mr_unsign32)data[1]<<16)|((mr_unsign32)data[2]<<8)|(mr_unsign32)data[3];
+        shs_transform(sh);
+        n--;
+    }
+}
+
 void shs256_init(sha256 *sh)
 { /* re-initialise */
     int i;
@@ -132,6 +261,33 @@ void shs256_process(sha256 *sh,int byte)
     if ((sh->length[0]%512)==0) shs_transform(sh);
 }
 
+void shs256_update(sha256 *sh,char *data,int len)
+{ /* process len message bytes */
+    int n;
+
+    while (len>0 && (sh->length[0]%512)!=0)
+    { /* fill up a partial block */
+        shs256_process(sh,*data++);
+        len--;
+    }
+    n=len/64;
+    if (n>0)
+    {
+        shs_blocks(sh,(MR_BYTE *)data,n);
+        data+=64*n; len-=64*n;
+        while (n-->0)
+        {
+            sh->length[0]+=512;
+            if (sh->length[0]==0L) sh->length[1]++;
+        }
+    }
+    while (len>0)
+    {
+        shs256_process(sh,*data++);
+        len--;
+    }
+}
+
 void shs256_hash(sha256 *sh,char hash[32])
 { /* pad message and finish - supply digest */
     int i;
@@ -150,6 +306,202 @@ void shs256_hash(sha256 *sh,char hash[32])
     shs256_init(sh);
 }
 
+
+/* Multi-buffer hashing. Each message is padded into its own lane, and all
+   lanes are fed to the compression function together */
+
+typedef struct {
+    const MR_BYTE *msg;
+    int full,nb;                 /* complete blocks in msg, total blocks */
+    MR_BYTE tail[128];           /* the last one or two padded blocks */
+    mr_unsign32 h[8];
+} lane256;
+
+static void lane_init(lane256 *ln,sha256 *sh,char *msg,int len)
+{ /* continue from state sh, which must be on a block boundary */
+    int i,rem;
+    mr_unsign32 len0,len1;
+    static const mr_unsign32 iv[8]={H0,H1,H2,H3,H4,H5,H6,H7};
+
+    if (sh==NULL) {len0=len1=0L; for (i=0;i<8;i++) ln->h[i]=iv[i];}
+    else {len0=sh->length[0]; len1=sh->length[1]; for (i=0;i<8;i++) ln->h[i]=sh->h[i];}
+
+    len1+=(mr_unsign32)len>>29;
+    len0+=(mr_unsign32)len<<3;
+    if (len0<((mr_unsign32)len<<3)) len1++;
+
+    ln->msg=(const MR_BYTE *)msg;
+    ln->full=len/64;
+    rem=len%64;
+    for (i=0;i<rem;i++) ln->tail[i]=(MR_BYTE)msg[64*ln->full+i];
+    ln->tail[rem++]=PAD;
+    if (rem>56) ln->nb=ln->full+2;
+    else        ln->nb=ln->full+1;
+    while (rem<64*(ln->nb-ln->full)-8) ln->tail[rem++]=ZERO;
+    for (i=0;i<4;i++) ln->tail[rem+i]=(MR_BYTE)(len1>>(24-8*i));
+    for (i=0;i<4;i++) ln->tail[rem+4+i]=(MR_BYTE)(len0>>(24-8*i));
+}
+
+static void lane_digest(mr_unsign32 *h,char *hash)
+{
+    int i;
+    for (i=0;i<32;i++) hash[i]=(char)((h[i/4]>>(8*(3-i%4))) & 0xffL);
+}
+
+#ifdef SHA_AVX2_SUPPORT
+
+static const MR_BYTE *lane_block(lane256 *ln,int k)
+{
+    if (k<ln->full) return ln->msg+64*k;
+    return ln->tail+64*(k-ln->full);
+}
+
+static int avx2=-1;
+
+static int avx2_available(void)
+{
+#ifdef __GNUC__
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    int r[4];
+    __cpuid(r,1);
+    if ((r[2]&0x18000000)!=0x18000000) return 0;    /* OSXSAVE and AVX */
+    if ((_xgetbv(0)&6)!=6) return 0;                 /* YMM state saved by OS */
+    __cpuidex(r,7,0);
+    return ((r[1]&0x20)!=0);
+#endif
+}
+
+#define VROR(x,n) _mm256_or_si256(_mm256_srli_epi32(x,n),_mm256_slli_epi32(x,32-n))
+#define VXOR3(x,y,z) _mm256_xor_si256(_mm256_xor_si256(x,y),z)
+#define VSIG0(x) VXOR3(VROR(x,2),VROR(x,13),VROR(x,22))
+#define VSIG1(x) VXOR3(VROR(x,6),VROR(x,11),VROR(x,25))
+#define VTHETA0(x) VXOR3(VROR(x,7),VROR(x,18),_mm256_srli_epi32(x,3))
+#define VTHETA1(x) VXOR3(VROR(x,17),VROR(x,19),_mm256_srli_epi32(x,10))
+#define VCH(x,y,z) _mm256_xor_si256(_mm256_and_si256(x,y),_mm256_andnot_si256(x,z))
+#define VMAJ(x,y,z) _mm256_or_si256(_mm256_and_si256(x,y),_mm256_and_si256(z,_mm256_or_si256(x,y)))
+
+#define VROUND(a,b,c,d,e,f,g,h,j) \
+    t1=_mm256_add_epi32(_mm256_add_epi32(h,VSIG1(e)),_mm256_add_epi32(VCH(e,f,g),_mm256_add_epi32(_mm256_set1_epi32((int)K[j]),W[(j)&15]))); \
+    d=_mm256_add_epi32(d,t1); \
+    h=_mm256_add_epi32(t1,_mm256_add_epi32(VSIG0(a),VMAJ(a,b,c)));
+
+MR_AVX2_TARGET static void avx2_transform(__m256i *S,const MR_BYTE **blk)
+{ /* one block in each lane. S holds the transposed state */
+    int i,j;
+    __m256i a,b,c,d,e,f,g,h,t1,W[16];
+    const __m256i BSWAP=_mm256_set_epi64x(0x0c0d0e0f08090a0bLL,0x0405060700010203LL,
+                                           0x0c0d0e0f08090a0bLL,0x0405060700010203LL);
+    for (i=0;i<16;i++)
+    {
+        W[i]=_mm256_set_epi32(*(const int *)&blk[7][4*i],*(const int *)&blk[6][4*i],
+                              *(const int *)&blk[5][4*i],*(const int *)&blk[4][4*i],
+                              *(const int *)&blk[3][4*i],*(const int *)&blk[2][4*i],
+                              *(const int *)&blk[1][4*i],*(const int *)&blk[0][4*i]);
+        W[i]=_mm256_shuffle_epi8(W[i],BSWAP);
+    }
+    a=S[0]; b=S[1]; c=S[2]; d=S[3]; e=S[4]; f=S[5]; g=S[6]; h=S[7];
+    for (j=0;j<64;j+=8)
+    {
+        if (j>=16) for (i=j;i<j+8;i++)
+            W[i&15]=_mm256_add_epi32(_mm256_add_epi32(VTHETA1(W[(i-2)&15]),W[(i-7)&15]),
+                                     _mm256_add_epi32(VTHETA0(W[(i-15)&15]),W[i&15]));
+        VROUND(a,b,c,d,e,f,g,h,j)
+        VROUND(h,a,b,c,d,e,f,g,j+1)
+        VROUND(g,h,a,b,c,d,e,f,j+2)
+        VROUND(f,g,h,a,b,c,d,e,j+3)
+        VROUND(e,f,g,h,a,b,c,d,j+4)
+        VROUND(d,e,f,g,h,a,b,c,j+5)
+        VROUND(c,d,e,f,g,h,a,b,j+6)
+        VROUND(b,c,d,e,f,g,h,a,j+7)
+    }
+    S[0]=_mm256_add_epi32(S[0],a); S[1]=_mm256_add_epi32(S[1],b);
+    S[2]=_mm256_add_epi32(S[2],c); S[3]=_mm256_add_epi32(S[3],d);
+    S[4]=_mm256_add_epi32(S[4],e); S[5]=_mm256_add_epi32(S[5],f);
+    S[6]=_mm256_add_epi32(S[6],g); S[7]=_mm256_add_epi32(S[7],h);
+}
+
+MR_AVX2_TARGET static void avx2_lanes(lane256 *ln,int n,char **hash)
+{ /* up to LANES messages. Spare lanes, and lanes that have finished, 
+     hash a dummy block whose result is ignored */
+    int i,j,k,nb;
+    mr_unsign32 st[8][LANES];
+    __m256i S[8];
+    const MR_BYTE *blk[LANES];
+    static const MR_BYTE dummy[64]={0};
+
+    nb=0;
+    for (j=0;j<8;j++) for (i=0;i<LANES;i++) st[j][i]=(i<n)?ln[i].h[j]:0L;
+    for (j=0;j<8;j++) S[j]=_mm256_loadu_si256((const __m256i *)st[j]);
+    for (i=0;i<n;i++) if (ln[i].nb>nb) nb=ln[i].nb;
+
+    for (k=0;k<nb;k++)
+    {
+        for (i=0;i<LANES;i++)
+        {
+            if (i<n && k<ln[i].nb) blk[i]=lane_block(&ln[i],k);
+            else                   blk[i]=dummy;
+        }
+        avx2_transform(S,blk);
+        for (i=0;i<n;i++) if (ln[i].nb==k+1)
+        { /* lane i is done */
+            for (j=0;j<8;j++) _mm256_storeu_si256((__m256i *)st[j],S[j]);
+            for (j=0;j<8;j++) ln[i].h[j]=st[j][i];
+            lane_digest(ln[i].h,hash[i]);
+        }
+    }
+}
+
+#endif
+
+void shs256_hash_batch(int n,sha256 **sh,char **msg,int *len,char **hash)
+{ /* hash[i] = SHA-256 digest of message msg[i] of len[i] bytes, for i=0..n-1. If sh is not
+     NULL, message i continues from state sh[i], which is left unchanged. So a common prefix, 
+     such as an HMAC key block, need only be hashed once */
+    int i,m;
+    sha256 t;
+    lane256 ln[8];
+
+    for (i=0;i<n;i+=m)
+    {
+        m=0;
+        while (m<8 && i+m<n)
+        {
+            if (sh!=NULL && (sh[i+m]->length[0]%512)!=0) break;
+            lane_init(&ln[m],(sh==NULL)?NULL:sh[i+m],msg[i+m],len[i+m]);
+            m++;
+        }
+        if (m==0)
+        { /* not on a block boundary - do it the slow way */
+            t=*sh[i];
+            shs256_update(&t,msg[i],len[i]);
+            shs256_hash(&t,hash[i]);
+            m=1;
+            continue;
+        }
+#ifdef SHA_AVX2_SUPPORT
+        if (avx2<0) avx2=avx2_available();
+        if (avx2 && m>1)
+        {
+            avx2_lanes(ln,m,&hash[i]);
+            continue;
+        }
+#endif
+        {
+            int j,k;
+            for (j=0;j<m;j++)
+            {
+                for (k=0;k<8;k++) t.h[k]=ln[j].h[k];
+                t.length[0]=t.length[1]=0L;
+                shs_blocks(&t,ln[j].msg,ln[j].full);
+                shs_blocks(&t,ln[j].tail,ln[j].nb-ln[j].full);
+                lane_digest(t.h,hash[i+j]);
+            }
+        }
+    }
+}
+
 /* test program: should produce digest  
 
 248d6a61 d20638b8 e5c02693 0c3e6039 a33ce459 64ff2167 f6ecedd4 19db06c1
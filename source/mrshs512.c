@@ -38,8 +38,9 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
  * Generates a a 384 or 512 bit message digest. It should be impossible to come
  * come up with two messages that hash to the same value ("collision free").
  *
- * For use with byte-oriented messages only. Could/Should be speeded
- * up by unwinding loops in shs_transform(), and assembly patches.
+ * For use with byte-oriented messages only. Whole buffers can be processed
+ * by shs512_update()/shs384_update(), which transform complete 128-byte 
+ * blocks directly from the buffer.
  *
  * NOTE: This requires a 64-bit integer type to be defined
  */
@@ -105,9 +106,16 @@ static const mr_unsign64 K[80]=
 #define theta0(x)  (S(1,x)^S(8,x)^R(7,x))
 #define theta1(x)  (S(19,x)^S(61,x)^R(6,x))
 
+/* one round - the variables rotate rather than being shifted */
+
+#define ROUND(a,b,c,d,e,f,g,h,j) \
+    t1=h+Sig1(e)+Ch(e,f,g)+K[j]+sh->w[j]; \
+    d+=t1; \
+    h=t1+Sig0(a)+Maj(a,b,c);
+
 static void shs_transform(sha512 *sh)
 { /* basic transformation step */
-    mr_unsign64 a,b,c,d,e,f,g,h,t1,t2;
+    mr_unsign64 a,b,c,d,e,f,g,h,t1;
     int j;
     for (j=16;j<80;j++) 
         sh->w[j]=theta1(sh->w[j-2])+sh->w[j-7]+theta0(sh->w[j-15])+sh->w[j-16];
@@ -115,21 +123,49 @@ static void shs_transform(sha512 *sh)
     a=sh->h[0]; b=sh->h[1]; c=sh->h[2]; d=sh->h[3]; 
     e=sh->h[4]; f=sh->h[5]; g=sh->h[6]; h=sh->h[7];
 
-    for (j=0;j<80;j++)
+    for (j=0;j<80;j+=8)
     { /* 80 times - mush it up */
-        t1=h+Sig1(e)+Ch(e,f,g)+K[j]+sh->w[j];
-        t2=Sig0(a)+Maj(a,b,c);
-        h=g; g=f; f=e;
-        e=d+t1;
-        d=c;
-        c=b;
-        b=a;
-        a=t1+t2;        
+        ROUND(a,b,c,d,e,f,g,h,j)
+        ROUND(h,a,b,c,d,e,f,g,j+1)
+        ROUND(g,h,a,b,c,d,e,f,j+2)
+        ROUND(f,g,h,a,b,c,d,e,j+3)
+        ROUND(e,f,g,h,a,b,c,d,j+4)
+        ROUND(d,e,f,g,h,a,b,c,j+5)
+        ROUND(c,d,e,f,g,h,a,b,j+6)
+        ROUND(b,c,d,e,f,g,h,a,j+7)
     }
     sh->h[0]+=a; sh->h[1]+=b; sh->h[2]+=c; sh->h[3]+=d; 
     sh->h[4]+=e; sh->h[5]+=f; sh->h[6]+=g; sh->h[7]+=h; 
 } 
 
+static void shs_absorb(sha512 *sh,char *data,int len)
+{ /* process len message bytes - complete blocks are taken straight from the buffer */
+    int i;
+    MR_BYTE *b;
+
+    while (len>0 && (sh->length[0]%1024)!=0)
+    { /* fill up a partial block */
+        shs512_process(sh,*data++);
+        len--;
+    }
+    while (len>=128)
+    {
+        b=(MR_BYTE *)data;
+        for (i=0;i<16;i++,b+=8)
+            sh->w[i]=((mr_unsign64)b[0]<<56)|((mr_unsign64)b[1]<<48)|((mr_unsign64)b[2]<<40)|((mr_unsign64)b[3]<<32)|
+                     ((mr_unsign64)b[4]<<24)|((mr_unsign64)b[5]<<16)|((mr_unsign64)b[6]<<8)|(mr_unsign64)b[7];
+        shs_transform(sh);
+        sh->length[0]+=1024;
+        if (sh->length[0]==0L) sh->length[1]++;
+        data+=128; len-=128;
+    }
+    while (len>0)
+    {
+        shs512_process(sh,*data++);
+        len--;
+    }
+}
+
 void shs512_init(sha512 *sh)
 { /* re-initialise */
     int i;
@@ -191,6 +227,16 @@ void shs384_process(sha384 *sh,int byte)
 }
 
 
+void shs512_update(sha512 *sh,char *data,int len)
+{ /* process len message bytes */
+    shs_absorb(sh,data,len);
+}
+
+void shs384_update(sha384 *sh,char *data,int len)
+{ /* process len message bytes */
+    shs_absorb(sh,data,len);
+}
+
 void shs512_hash(sha512 *sh,char hash[64])
 { /* pad message and finish - supply digest */
     int i;
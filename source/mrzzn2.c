@@ -319,6 +319,115 @@ fpmq++;
     MR_OUT
 }
 
+#ifndef MR_NO_LAZY_REDUCTION
+
+/*
+Unreduced zzn2 arithmetic. A "double" zzn2 has double length components,
+kept mod pR, holding a product that has not yet been reduced. Several such
+products can be added and subtracted before a single zzn2_redc(), which
+saves reductions in the larger extension fields built on top of zzn2.
+Double zzn2 arguments must not use w0, w1, w2 or w6
+*/
+
+void zzn2_double_mul(_MIPD_ zzn2 *x,zzn2 *y,zzn2 *w)
+{ /* w = x*y, unreduced */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return;
+    MR_IN(250)
+    nres_double_lazy(_MIPP_ x->a,x->b,y->a,y->b,w->a,w->b);
+    MR_OUT
+}
+
+void zzn2_double_add(_MIPD_ zzn2 *x,zzn2 *y,zzn2 *w)
+{
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return;
+    nres_double_modadd(_MIPP_ x->a,y->a,w->a);
+    nres_double_modadd(_MIPP_ x->b,y->b,w->b);
+}
+
+void zzn2_double_sub(_MIPD_ zzn2 *x,zzn2 *y,zzn2 *w)
+{
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return;
+    nres_double_modsub(_MIPP_ x->a,y->a,w->a);
+    nres_double_modsub(_MIPP_ x->b,y->b,w->b);
+}
+
+void zzn2_double_txx(_MIPD_ zzn2 *u)
+{ /* as zzn2_txx(), for a double zzn2. Uses w6 */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    big t;
+    if (mr_mip->ERNUM) return;
+    MR_IN(251)
+
+    t=mr_mip->w6;
+    switch (mr_mip->pmod8)
+    {
+    case 5:    /* (a,b) -> (-2b,a) */
+        copy(u->b,t);
+        copy(u->a,u->b);
+        nres_double_modadd(_MIPP_ t,t,u->a);
+        if (size(u->a)!=0) mr_psub(_MIPP_ mr_mip->pR,u->a,u->a);
+        break;
+    case 3:    /* (a,b) -> (a-b,a+b) */
+        copy(u->a,t);
+        nres_double_modsub(_MIPP_ u->a,u->b,u->a);
+        nres_double_modadd(_MIPP_ u->b,t,u->b);
+        break;
+    case 7:    /* (a,b) -> (2a-b,2b+a) */
+        copy(u->a,t);
+        nres_double_modadd(_MIPP_ u->a,u->a,u->a);
+        nres_double_modsub(_MIPP_ u->a,u->b,u->a);
+        nres_double_modadd(_MIPP_ u->b,u->b,u->b);
+        nres_double_modadd(_MIPP_ u->b,t,u->b);
+        break;
+    default: break;
+    }
+    MR_OUT
+}
+
+void zzn2_redc(_MIPD_ zzn2 *x,zzn2 *w)
+{ /* reduce double zzn2 x to zzn2 w */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return;
+    MR_IN(252)
+    nres_double_redc(_MIPP_ x->a,w->a);
+    nres_double_redc(_MIPP_ x->b,w->b);
+    MR_OUT
+}
+
+#ifndef MR_STATIC
+
+/* allocate num double zzn2 from the heap. Free with memkill(mem,4*num) */
+
+char *zzn2_double_memalloc(_MIPD_ int num,zzn2 *z)
+{
+    int i;
+    char *mem=(char *)memalloc(_MIPP_ 4*num);
+    if (mem==NULL) return NULL;
+    for (i=0;i<num;i++)
+    { /* a double length big takes two slots */
+        z[i].a=mirvar_mem(_MIPP_ mem,4*i);
+        z[i].b=mirvar_mem(_MIPP_ mem,4*i+2);
+    }
+    return mem;
+}
+
+#endif
+
+#endif
+
 
 /*
 void zzn2_print(_MIPD_ char *label, zzn2 *x)
@@ -437,3 +437,153 @@ void zzn4_tx(_MIPD_ zzn4* w)
 
 	MR_OUT
 }
+
+#ifndef MR_NO_LAZY_REDUCTION
+
+/*
+Unreduced zzn4 arithmetic, on "double" zzn4 with double length components
+- see zzn2_double_mul(). Double zzn4 arguments must not use any workspace
+*/
+
+#ifndef MR_STATIC
+
+/* allocate num double zzn4 from the heap. Free with memkill(mem,8*num) */
+
+char *zzn4_double_memalloc(_MIPD_ int num,zzn4 *z)
+{
+    int i;
+    char *mem=(char *)memalloc(_MIPP_ 8*num);
+    if (mem==NULL) return NULL;
+    for (i=0;i<num;i++)
+    { /* a double length big takes two slots */
+        z[i].a.a=mirvar_mem(_MIPP_ mem,8*i);
+        z[i].a.b=mirvar_mem(_MIPP_ mem,8*i+2);
+        z[i].b.a=mirvar_mem(_MIPP_ mem,8*i+4);
+        z[i].b.b=mirvar_mem(_MIPP_ mem,8*i+6);
+        z[i].unitary=FALSE;
+    }
+    return mem;
+}
+
+#endif
+
+void zzn4_double_mul(_MIPD_ zzn4 *x,zzn4 *y,zzn4 *w)
+{ /* w = x*y, unreduced. Three unreduced zzn2 products, no reductions */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    zzn2 t,s1,s2;
+    if (mr_mip->ERNUM) return;
+    MR_IN(FUNC_BASE+27)
+
+    t.a=mr_mip->w5;
+    t.b=mr_mip->w7;
+    s1.a=mr_mip->w8;
+    s1.b=mr_mip->w9;
+    s2.a=mr_mip->w10;
+    s2.b=mr_mip->w11;
+
+    zzn2_add(_MIPP_ &(x->a),&(x->b),&s1);
+    zzn2_add(_MIPP_ &(y->a),&(y->b),&s2);
+    zzn2_double_mul(_MIPP_ &s1,&s2,&t);          /* t = (x->a + x->b)*(y->a + y->b) */
+    zzn2_double_mul(_MIPP_ &(x->a),&(y->a),&(w->a));
+    zzn2_double_mul(_MIPP_ &(x->b),&(y->b),&(w->b));
+    zzn2_double_sub(_MIPP_ &t,&(w->a),&t);
+    zzn2_double_sub(_MIPP_ &t,&(w->b),&t);
+    zzn2_double_txx(_MIPP_ &(w->b));
+    zzn2_double_add(_MIPP_ &(w->a),&(w->b),&(w->a));   /* w->a = x->a*y->a + tx(x->b*y->b) */
+    zzn2_copy(&t,&(w->b));
+    w->unitary=FALSE;
+
+    MR_OUT
+}
+
+void zzn4_double_sqr(_MIPD_ zzn4 *x,zzn4 *w)
+{ /* w = x^2, unreduced */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    zzn2 t,s1,s2;
+    if (mr_mip->ERNUM) return;
+    MR_IN(FUNC_BASE+28)
+
+    t.a=mr_mip->w5;
+    t.b=mr_mip->w7;
+    s1.a=mr_mip->w8;
+    s1.b=mr_mip->w9;
+    s2.a=mr_mip->w10;
+    s2.b=mr_mip->w11;
+
+    zzn2_add(_MIPP_ &(x->a),&(x->b),&s1);
+    zzn2_copy(&(x->b),&s2);
+    zzn2_txx(_MIPP_ &s2);
+    zzn2_add(_MIPP_ &s2,&(x->a),&s2);
+    zzn2_double_mul(_MIPP_ &s1,&s2,&t);          /* t = (a+b)*(a+tx(b)) */
+    zzn2_double_mul(_MIPP_ &(x->a),&(x->b),&(w->b));   /* ab */
+    zzn2_copy(&(w->b),&(w->a));
+    zzn2_double_txx(_MIPP_ &(w->a));
+    zzn2_double_sub(_MIPP_ &t,&(w->a),&t);
+    zzn2_double_sub(_MIPP_ &t,&(w->b),&(w->a));  /* a^2+tx(b^2) */
+    zzn2_double_add(_MIPP_ &(w->b),&(w->b),&(w->b));   /* 2ab */
+    w->unitary=FALSE;
+
+    MR_OUT
+}
+
+void zzn4_double_add(_MIPD_ zzn4 *x,zzn4 *y,zzn4 *w)
+{
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return;
+    zzn2_double_add(_MIPP_ &(x->a),&(y->a),&(w->a));
+    zzn2_double_add(_MIPP_ &(x->b),&(y->b),&(w->b));
+    w->unitary=FALSE;
+}
+
+void zzn4_double_sub(_MIPD_ zzn4 *x,zzn4 *y,zzn4 *w)
+{
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return;
+    zzn2_double_sub(_MIPP_ &(x->a),&(y->a),&(w->a));
+    zzn2_double_sub(_MIPP_ &(x->b),&(y->b),&(w->b));
+    w->unitary=FALSE;
+}
+
+void zzn4_double_tx(_MIPD_ zzn4 *w)
+{ /* as zzn4_tx(), for a double zzn4 */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    zzn2 t;
+    if (mr_mip->ERNUM) return;
+    MR_IN(FUNC_BASE+29)
+
+    t.a=mr_mip->w5;
+    t.b=mr_mip->w7;
+    zzn2_copy(&(w->b),&t);
+    zzn2_double_txx(_MIPP_ &t);
+    zzn2_copy(&(w->a),&(w->b));
+    zzn2_copy(&t,&(w->a));
+
+    MR_OUT
+}
+
+void zzn4_redc(_MIPD_ zzn4 *x,zzn4 *w)
+{ /* reduce double zzn4 x to zzn4 w */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
+    if (mr_mip->ERNUM) return;
+    MR_IN(FUNC_BASE+30)
+
+    zzn2_redc(_MIPP_ &(x->a),&(w->a));
+    zzn2_redc(_MIPP_ &(x->b),&(w->b));
+    w->unitary=FALSE;
+
+    MR_OUT
+}
+
+#endif
@@ -0,0 +1,158 @@
+
+/***************************************************************************
+                                                                           *
+Copyright 2013 CertiVox UK Ltd.                                           *
+                                                                           *
+This file is part of CertiVox MIRACL Crypto SDK.                           *
+                                                                           *
+The CertiVox MIRACL Crypto SDK provides developers with an                 *
+extensive and efficient set of cryptographic functions.                    *
+For further information about its features and functionalities please      *
+refer to http://www.certivox.com                                           *
+                                                                           *
+* The CertiVox MIRACL Crypto SDK is free software: you can                 *
+  redistribute it and/or modify it under the terms of the                  *
+  GNU Affero General Public License as published by the                    *
+  Free Software Foundation, either version 3 of the License,               *
+  or (at your option) any later version.                                   *
+                                                                           *
+* The CertiVox MIRACL Crypto SDK is distributed in the hope                *
+  that it will be useful, but WITHOUT ANY WARRANTY; without even the       *
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. *
+  See the GNU Affero General Public License for more details.              *
+                                                                           *
+* You should have received a copy of the GNU Affero General Public         *
+  License along with CertiVox MIRACL Crypto SDK.                           *
+  If not, see <http://www.gnu.org/licenses/>.                              *
+                                                                           *
+You can be released from the requirements of the license by purchasing     *
+a commercial license. Buying such a license is mandatory as soon as you    *
+develop commercial activities involving the CertiVox MIRACL Crypto SDK     *
+without disclosing the source code of your own applications, or shipping   *
+the CertiVox MIRACL Crypto SDK with a closed source product.               *
+                                                                           *
+***************************************************************************/
+/*
+ *   Program to find the crossover points for Karatsuba and Toom-3
+ *   multiplication in multiply(), and for Burnikel-Ziegler division 
+ *   and the cached Barrett reciprocal in divide(), for this compiler 
+ *   and processor. Add the #defines that it outputs to mirdef.h, and
+ *   rebuild the library.
+ *
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "miracl.h"
+
+/* define minimum duration of each timing, and largest size tried */
+
+#define MIN_TIME 0.05
+#define MAX_WORDS 1024
+
+#ifndef MR_STATIC
+
+static double timing(big x,big y,big z,big w,BOOL div)
+{ /* time for x*y plus x*x, or for x/y, best of three */
+    int i,j,iterations;
+    clock_t start;
+    double elapsed,best=0.0;
+
+    for (j=0;j<3;j++)
+    {
+        iterations=0;
+        start=clock();
+        do
+        {
+            for (i=0;i<10;i++)
+            {
+                if (div)
+                {
+                    copy(x,w);
+                    divide(w,y,z);
+                }
+                else
+                {
+                    multiply(x,y,z);
+                    multiply(x,x,z);
+                }
+            }
+            iterations+=10;
+            elapsed=(clock()-start)/(double)CLOCKS_PER_SEC;
+        } while (elapsed<MIN_TIME);
+        elapsed/=iterations;
+        if (j==0 || elapsed<best) best=elapsed;
+    }
+    return best;
+}
+
+static int crossover(big x,big y,big z,big w,int from,int *method,BOOL div)
+{ /* smallest size from which the method wins three times running, *
+   * against it turned off. Division is of 2n words by n           */
+    int n,wins=0,first=0;
+    double slow,fast;
+
+    for (n=from;n<=MAX_WORDS;n+=(n/8>4?n/8:4))
+    {
+        bigbits((div?2*n:n)*MIRACL,x);
+        bigbits(n*MIRACL,y);
+        *method=0;
+        slow=timing(x,y,z,w,div);
+        *method=n;
+        fast=timing(x,y,z,w,div);
+        printf("%5d words %10.2f %10.2f us\n",n,1e6*slow,1e6*fast);
+        if (fast<slow)
+        {
+            if (wins==0) first=n;
+            if (++wins==3) return first;
+        }
+        else wins=0;
+    }
+    return 0;
+}
+
+int main()
+{
+    int kara,toom,bz,bar;
+    big x,y,z,w;
+    miracl *mip=mirsys(2*MAX_WORDS+2,0);
+    x=mirvar(0);
+    y=mirvar(0);
+    z=mirvar(0);
+    w=mirvar(0);
+    irand(1L);
+    mip->TOOM3=mip->BURNIKEL=mip->BARRETT=0;
+
+    printf("Schoolbook against Karatsuba\n");
+    kara=crossover(x,y,z,w,8,&mip->KARATSUBA,FALSE);
+    mip->KARATSUBA=kara;
+    if (kara==0) toom=0;
+    else
+    {
+        printf("Karatsuba against Toom-3\n");
+        toom=crossover(x,y,z,w,3*kara,&mip->TOOM3,FALSE);
+    }
+    mip->TOOM3=toom;
+    printf("Algorithm D against Burnikel-Ziegler\n");
+    bz=crossover(x,y,z,w,16,&mip->BURNIKEL,TRUE);
+    mip->BURNIKEL=bz;
+    printf("Division against cached Barrett reciprocal\n");
+    bar=crossover(x,y,z,w,(bz>0)?bz:16,&mip->BARRETT,TRUE);
+
+    printf("\nAdd to mirdef.h\n\n");
+    printf("#define MR_KARATSUBA_THRESHOLD %d\n",kara);
+    printf("#define MR_TOOM3_THRESHOLD %d\n",toom);
+    printf("#define MR_BURNIKEL_THRESHOLD %d\n",bz);
+    printf("#define MR_BARRETT_THRESHOLD %d\n",bar);
+    return 0;
+}
+
+#else
+
+int main()
+{
+    printf("multiply() and divide() have no crossovers in MR_STATIC builds\n");
+    return 0;
+}
+
+#endif
@@ -125,6 +125,24 @@ Also create mrcomba.c using MEX utility, and add mrcomba.c in build
 
 #include "ecdh.h"
 
+/* Define ECDH_THREADS to run the batch ECDSA functions on a pool of POSIX   *
+ * threads. This needs MR_GENERIC_MT, so that each call has its own miracl   *
+ * instance, or MR_UNIX_MT, so that each thread has its own (in which case   *
+ * mr_init_threading() must be called first).                               */
+
+/* #define ECDH_THREADS */
+
+#ifdef MR_UNIX_MT
+#define ECDH_THREADS
+#endif
+
+#ifdef ECDH_THREADS
+#if !defined(MR_GENERIC_MT) && !defined(MR_OS_THREADS)
+#error ECDH_THREADS needs MR_GENERIC_MT or MR_UNIX_MT
+#endif
+#include <pthread.h>
+#endif
+
 /* Elliptic Curve parameters - NIST P256 Curve */
 
 #if MIRACL==64
@@ -152,7 +170,8 @@ const mr_small ecrom[]={
 
 static void hash(octet *p,int n,octet *x,octet *y,octet *w)
 {
-    int i,hlen,c[4];
+    int i,hlen;
+    char c[4];
     HASHFUNC sha;
     char hh[HASH_BYTES];
 
@@ -160,19 +179,19 @@ static void hash(octet *p,int n,octet *x,octet *y,octet *w)
 
     SHS_INIT(&sha);
     if (p!=NULL)
-        for (i=0;i<p->len;i++) SHS_PROCESS(&sha,p->val[i]);
+        SHS_UPDATE(&sha,p->val,p->len);
 	if (n>0)
     {
-        c[0]=(n>>24)&0xff;
-        c[1]=(n>>16)&0xff;
-        c[2]=(n>>8)&0xff;
-        c[3]=(n)&0xff;
-		for (i=0;i<4;i++) SHS_PROCESS(&sha,c[i]);
+        c[0]=(char)((n>>24)&0xff);
+        c[1]=(char)((n>>16)&0xff);
+        c[2]=(char)((n>>8)&0xff);
+        c[3]=(char)((n)&0xff);
+		SHS_UPDATE(&sha,c,4);
     }
     if (x!=NULL)
-        for (i=0;i<x->len;i++) SHS_PROCESS(&sha,x->val[i]);    
+        SHS_UPDATE(&sha,x->val,x->len);    
     if (y!=NULL)
-        for (i=0;i<y->len;i++) SHS_PROCESS(&sha,y->val[i]);    
+        SHS_UPDATE(&sha,y->val,y->len);    
 	
        
     SHS_HASH(&sha,hh);
@@ -308,6 +327,65 @@ void PBKDF2(octet *p,octet *s,int rep,int olen,octet *key)
 	OCTET_CHOP(key,olen,NULL);
 }
 
+/* Batched PBKDF2 - n independent derivations, key[i] from password p[i] and salt s[i].  
+   With SHA-256 the HMAC iterations of all n are run together, through shs256_hash_batch() */
+
+void PBKDF2_BATCH(int n,octet **p,octet **s,int rep,int olen,octet **key)
+{
+#if HASH_BYTES==32
+	int i,j,k,b,m,len[PBKDF2_LANES],d=MR_ROUNDUP(olen,HASH_BYTES);
+	char k0[HASH_BLOCK],f[PBKDF2_LANES][HASH_BYTES],u[PBKDF2_LANES][HASH_BYTES];
+	char *msg[PBKDF2_LANES],*out[PBKDF2_LANES];
+	sha256 ipad[PBKDF2_LANES],opad[PBKDF2_LANES],*ip[PBKDF2_LANES],*op[PBKDF2_LANES];
+	octet K0={0,sizeof(k0),k0};
+
+	for (m=0;m<n;m+=PBKDF2_LANES)
+	{
+		int nl=n-m;
+		if (nl>PBKDF2_LANES) nl=PBKDF2_LANES;
+		for (k=0;k<nl;k++)
+		{ /* hash the two HMAC key blocks once only */
+			if (p[m+k]->len > HASH_BLOCK) hash(p[m+k],-1,NULL,NULL,&K0);
+			else                          OCTET_COPY(p[m+k],&K0);
+			OCTET_JOIN_BYTE(0,HASH_BLOCK-K0.len,&K0);
+			OCTET_XOR_BYTE(0x36,&K0);
+			shs256_init(&ipad[k]); shs256_update(&ipad[k],K0.val,HASH_BLOCK);
+			OCTET_XOR_BYTE(0x6a,&K0);
+			shs256_init(&opad[k]); shs256_update(&opad[k],K0.val,HASH_BLOCK);
+			ip[k]=&ipad[k]; op[k]=&opad[k];
+			OCTET_EMPTY(key[m+k]);
+		}
+		for (i=1;i<=d;i++)
+		{
+			for (k=0;k<nl;k++)
+			{ /* U_1 = HMAC(s||i) */
+				OCTET_JOIN_LONG(i,4,s[m+k]);
+				msg[k]=s[m+k]->val; len[k]=s[m+k]->len; out[k]=u[k];
+			}
+			shs256_hash_batch(nl,ip,msg,len,out);
+			for (k=0;k<nl;k++) s[m+k]->len-=4;
+			for (k=0;k<nl;k++) {msg[k]=u[k]; len[k]=HASH_BYTES;}
+			shs256_hash_batch(nl,op,msg,len,out);
+			for (k=0;k<nl;k++) memcpy(f[k],u[k],EFS);
+
+			for (j=2;j<=rep;j++)
+			{
+				for (k=0;k<nl;k++) len[k]=EFS;
+				shs256_hash_batch(nl,ip,msg,len,out);
+				for (k=0;k<nl;k++) len[k]=HASH_BYTES;
+				shs256_hash_batch(nl,op,msg,len,out);
+				for (k=0;k<nl;k++) for (b=0;b<EFS;b++) f[k][b]^=u[k][b];
+			}
+			for (k=0;k<nl;k++) OCTET_JOIN_BYTES(f[k],EFS,key[m+k]);
+		}
+		for (k=0;k<nl;k++) OCTET_CHOP(key[m+k],olen,NULL);
+	}
+#else
+	int i;
+	for (i=0;i<n;i++) PBKDF2(p[i],s[i],rep,olen,key[i]);
+#endif
+}
+
 /* AES encryption/decryption */
 
 void AES_CBC_IV0_ENCRYPT(octet *k,octet *m,octet *c)
@@ -928,6 +1006,290 @@ int ECPVP_DSA(ecp_domain *DOM,octet *W,octet *F, octet *C,octet *D)
     return res;
 }
 
+#if !defined(MR_STATIC) && !defined(MR_NOSUPPORT_COMPRESSION)
+
+/* Combined verification of m<=ECDH_GROUP signatures (c,d) on F[i] with     *
+ * public keys W[i], for random z[i]. Each R[i] is recovered from c[i] up to *
+ * sign, so with u[i]=f[i]/d[i] and v[i]=c[i]/d[i] mod r we look for signs   *
+ * e[i] such that                                                            *
+ *                                                                           *
+ *   (sum z[i].u[i]).G + sum z[i].v[i].W[i] = sum e[i].z[i].R[i]             *
+ *                                                                           *
+ * The left hand side is a single ecurve_multn(), the signs are searched in  *
+ * Gray code order, one point addition per step. The x coordinate of R[i]    *
+ * is c[i] or, if less than q, c[i]+r, so where both are on the curve each   *
+ * choice is tried in turn.                                                  */
+
+static int dsa_verify_all(ecp_domain *DOM,csprng *RNG,int m,octet **W,octet **F,octet **C,octet **D)
+{
+	char h[HASH_BYTES],zb[8];
+	octet H={0,sizeof(h),h};
+	miracl *mr_mip=mirsys(DOM->nibbles,16);
+    big q,r,a,b,gx,gy,wx,wy,f,c,d,z,t,e[ECDH_GROUP+1];
+    epoint *P[ECDH_GROUP+1],*T[2][ECDH_GROUP],*U[2][ECDH_GROUP],*X[2][ECDH_GROUP],*L,*V;
+    int i,j,g,s,k,two,must,err,res=0;
+    char *mem=(char *)memalloc(_MIPP_ 13+ECDH_GROUP+1);
+    char *mem1=(char *)ecp_memalloc(_MIPP_ 5*ECDH_GROUP+3);
+
+    if (mr_mip==NULL || mem==NULL || mem1==NULL) res= ECDH_OUT_OF_MEMORY;
+    mr_mip->ERCON=TRUE;
+
+    if (res==0)
+    {
+        q=mirvar_mem(_MIPP_ mem, 0);
+        a=mirvar_mem(_MIPP_ mem, 1);
+        b=mirvar_mem(_MIPP_ mem, 2);
+        gx=mirvar_mem(_MIPP_ mem, 3);
+        gy=mirvar_mem(_MIPP_ mem, 4);
+        r=mirvar_mem(_MIPP_ mem, 5);
+        wx=mirvar_mem(_MIPP_ mem, 6);
+        wy=mirvar_mem(_MIPP_ mem, 7);
+        f=mirvar_mem(_MIPP_ mem, 8);
+        c=mirvar_mem(_MIPP_ mem, 9);
+        d=mirvar_mem(_MIPP_ mem, 10);
+        z=mirvar_mem(_MIPP_ mem, 11);
+        t=mirvar_mem(_MIPP_ mem, 12);
+        for (i=0;i<=m;i++) e[i]=mirvar_mem(_MIPP_ mem,13+i);
+
+		bytes_to_big(_MIPP_ EFS,DOM->Q,q);
+		bytes_to_big(_MIPP_ EGS,DOM->R,r);
+		bytes_to_big(_MIPP_ EFS,DOM->Gx,gx);
+		bytes_to_big(_MIPP_ EFS,DOM->Gy,gy);
+		bytes_to_big(_MIPP_ EFS,DOM->A,a);
+		bytes_to_big(_MIPP_ EFS,DOM->B,b);
+
+        ecurve_init(_MIPP_ a,b,q,MR_PROJECTIVE);
+        for (i=0;i<=m;i++) P[i]=epoint_init_mem(_MIPP_ mem1,i);
+        for (i=0;i<m;i++)
+        {
+            T[0][i]=epoint_init_mem(_MIPP_ mem1,m+1+4*i);
+            T[1][i]=epoint_init_mem(_MIPP_ mem1,m+2+4*i);
+            U[0][i]=epoint_init_mem(_MIPP_ mem1,m+3+4*i);
+            U[1][i]=epoint_init_mem(_MIPP_ mem1,m+4+4*i);
+        }
+        L=epoint_init_mem(_MIPP_ mem1,5*m+1);
+        V=epoint_init_mem(_MIPP_ mem1,5*m+2);
+        epoint_set(_MIPP_ gx,gy,0,P[0]);
+        zero(e[0]);
+        two=must=0;
+
+        for (i=0;i<m && res==0;i++)
+        {
+			hash(F[i],-1,NULL,NULL,&H);
+			bytes_to_big(_MIPP_ C[i]->len,C[i]->val,c);
+			bytes_to_big(_MIPP_ D[i]->len,D[i]->val,d);
+			bytes_to_big(_MIPP_ H.len,H.val,f);
+            if (size(c)<1 || mr_compare(c,r)>=0 || size(d)<1 || mr_compare(d,r)>=0)
+            {
+                res=ECDH_INVALID;
+                break;
+            }
+			bytes_to_big(_MIPP_ EFS,&(W[i]->val[1]),wx);
+			bytes_to_big(_MIPP_ EFS,&(W[i]->val[EFS+1]),wy);
+            if (!epoint_set(_MIPP_ wx,wy,0,P[i+1])) res=ECDH_ERROR;
+            if (res!=0) break;
+
+            add(_MIPP_ c,r,t);                                       /* R[i] */
+            if (mr_compare(t,q)<0 && epoint_set(_MIPP_ t,t,0,U[0][i])) two|=(1<<i);
+            if (!epoint_set(_MIPP_ c,c,0,T[0][i]))
+            {
+                if (!((two>>i)&1))
+                {
+                    res=ECDH_INVALID;
+                    break;
+                }
+                must|=(1<<i);
+            }
+
+            for (j=0;j<8;j++) zb[j]=strong_rng(RNG);
+            bytes_to_big(_MIPP_ 8,zb,z);
+            if (size(z)==0) convert(_MIPP_ 1,z);
+
+            xgcd(_MIPP_ d,r,d,d,d);
+            mad(_MIPP_ f,d,f,r,r,f);
+            mad(_MIPP_ c,d,c,r,r,c);
+            mad(_MIPP_ z,f,e[0],r,r,e[0]);
+            mad(_MIPP_ z,c,c,r,r,e[i+1]);
+            if (!((must>>i)&1))
+            {
+                ecurve_mult(_MIPP_ z,T[0][i],T[0][i]);
+                epoint_copy(T[0][i],T[1][i]);
+                ecurve_double(_MIPP_ T[1][i]);
+            }
+            if ((two>>i)&1)
+            {
+                ecurve_mult(_MIPP_ z,U[0][i],U[0][i]);
+                epoint_copy(U[0][i],U[1][i]);
+                ecurve_double(_MIPP_ U[1][i]);
+            }
+        }
+    }
+    if (res==0)
+    {
+        ecurve_multn(_MIPP_ m+1,e,P,L);
+        res=ECDH_INVALID;
+
+        for (k=must;k<(1<<m) && res!=0;k++)
+        { /* k selects x=c+r for R[i] */
+            if ((k&~two)!=0 || (must&~k)!=0) continue;
+            epoint_copy(L,V);
+            for (i=0;i<m;i++)
+            { /* V=lhs-sum X[0][i], X[1][i]=2X[0][i] */
+                for (j=0;j<2;j++) X[j][i]=((k>>i)&1)? U[j][i] : T[j][i];
+                ecurve_sub(_MIPP_ X[0][i],V);
+            }
+            for (g=1,s=0;;g++)
+            {
+                if (point_at_infinity(V))
+                {
+                    res=0;
+                    break;
+                }
+                if (g==(1<<m)) break;
+                for (j=0;((g>>j)&1)==0;j++) ;
+                if ((s>>j)&1) ecurve_sub(_MIPP_ X[1][j],V);
+                else          ecurve_add(_MIPP_ X[1][j],V);
+                s^=(1<<j);
+            }
+        }
+    }
+    memkill(_MIPP_ mem,13+ECDH_GROUP+1);
+    ecp_memkill(_MIPP_ mem1,5*ECDH_GROUP+3);
+
+    err=mr_mip->ERNUM;
+    mirexit(_MIPPO_ );
+    if (err==MR_ERR_OUT_OF_MEMORY) return ECDH_OUT_OF_MEMORY;
+    if (err==MR_ERR_DIV_BY_ZERO) return ECDH_DIV_BY_ZERO;
+    if (err!=0) return -(1000+err);
+    return res;
+}
+
+#endif
+
+/* Batch ECDSA. Work is shared out over a pool of threads, each with its own *
+ * random number generator seeded from the caller's.                        */
+
+#define ECDH_SIGN   0
+#define ECDH_VERIFY 1
+#define ECDH_ALL    2
+
+typedef struct
+{
+	int type,n,count,first,step,res;
+	ecp_domain *DOM;
+	csprng RNG;
+	octet **S,**F,**C,**D;
+	int *r;
+} ecdh_job;
+
+static void *ecdh_worker(void *arg)
+{
+	ecdh_job *job=(ecdh_job *)arg;
+	int i,k,m,res;
+
+	for (i=job->first;i<job->n;i+=job->step)
+	{
+		switch (job->type)
+		{
+		case ECDH_SIGN:
+			res=ECPSP_DSA(job->DOM,&job->RNG,job->S[i],job->F[i],job->C[i],job->D[i]);
+			break;
+		case ECDH_VERIFY:
+			res=ECPVP_DSA(job->DOM,job->S[i],job->F[i],job->C[i],job->D[i]);
+			break;
+		default:   /* unit i is the group of signatures from m */
+			m=i*ECDH_GROUP;
+			k=job->count-m;
+			if (k>ECDH_GROUP) k=ECDH_GROUP;
+#if !defined(MR_STATIC) && !defined(MR_NOSUPPORT_COMPRESSION)
+			res=dsa_verify_all(job->DOM,&job->RNG,k,&job->S[m],&job->F[m],&job->C[m],&job->D[m]);
+#else
+			for (res=0,k+=m;m<k && res==0;m++)
+				res=ECPVP_DSA(job->DOM,job->S[m],job->F[m],job->C[m],job->D[m]);
+#endif
+			break;
+		}
+		if (job->type!=ECDH_ALL && job->r!=NULL) job->r[i]=res;
+		if (res!=0 && job->res==0) job->res=res;
+		if (job->type==ECDH_ALL && res!=0) break;
+	}
+	return NULL;
+}
+
+static int ecdh_batch(int type,ecp_domain *DOM,csprng *RNG,int threads,int n,octet **S,octet **F,octet **C,octet **D,int *r)
+{
+	ecdh_job job[ECDH_MAX_THREADS];
+	char raw[32];
+	int i,j,res,units=n;
+#ifdef ECDH_THREADS
+	pthread_t tid[ECDH_MAX_THREADS];
+#endif
+	if (type==ECDH_ALL) units=(MR_ROUNDUP(n,ECDH_GROUP));
+	if (threads<1) threads=1;
+	if (threads>ECDH_MAX_THREADS) threads=ECDH_MAX_THREADS;
+	if (threads>units) threads=units;
+
+	for (i=0;i<threads;i++)
+	{
+		job[i].type=type;
+		job[i].n=units;
+		job[i].count=n;
+		job[i].first=i;
+		job[i].step=threads;
+		job[i].res=0;
+		job[i].DOM=DOM;
+		job[i].S=S; job[i].F=F; job[i].C=C; job[i].D=D;
+		job[i].r=r;
+		if (RNG!=NULL)
+		{
+			for (j=0;j<32;j++) raw[j]=strong_rng(RNG);
+			strong_init(&job[i].RNG,32,raw,(mr_unsign32)i);
+		}
+	}
+#ifdef ECDH_THREADS
+	for (i=1;i<threads;i++)
+		if (pthread_create(&tid[i],NULL,ecdh_worker,&job[i])!=0) ecdh_worker(&job[i]); 
+	ecdh_worker(&job[0]);
+	for (i=1;i<threads;i++) pthread_join(tid[i],NULL);
+#else
+	for (i=0;i<threads;i++) ecdh_worker(&job[i]);
+#endif
+	for (res=0,i=0;i<threads;i++)
+	{
+		if (res==0) res=job[i].res;
+		if (RNG!=NULL) strong_kill(&job[i].RNG);
+	}
+	for (j=0;j<32;j++) raw[j]=0;
+	return res;
+}
+
+/* Sign n messages F[i] with private keys S[i], giving signatures (C[i],D[i]). *
+ * Per-message results go to res[i] if res is not NULL. Returns 0 if all OK.  */
+
+int ECPSP_DSA_BATCH(ecp_domain *DOM,csprng *RNG,int threads,int n,octet **S,octet **F,octet **C,octet **D,int *res)
+{
+	if (n<=0) return 0;
+	return ecdh_batch(ECDH_SIGN,DOM,RNG,threads,n,S,F,C,D,res);
+}
+
+/* Verify n signatures (C[i],D[i]) on F[i] using public keys W[i]. Returns 0 if *
+ * all are valid, and per-signature results in res[i] if res is not NULL       */
+
+int ECPVP_DSA_BATCH(ecp_domain *DOM,int threads,int n,octet **W,octet **F,octet **C,octet **D,int *res)
+{
+	if (n<=0) return 0;
+	return ecdh_batch(ECDH_VERIFY,DOM,NULL,threads,n,W,F,C,D,res);
+}
+
+/* As ECPVP_DSA_BATCH, but only determines whether or not all are valid, by  *
+ * checking random linear combinations of ECDH_GROUP signatures at a time.   *
+ * Cheaper, but a failure does not tell which one. Random numbers from RNG.  */
+
+int ECPVP_DSA_ALL(ecp_domain *DOM,csprng *RNG,int threads,int n,octet **W,octet **F,octet **C,octet **D)
+{
+	if (n<=0) return 0;
+	return ecdh_batch(ECDH_ALL,DOM,RNG,threads,n,W,F,C,D,NULL);
+}
 
 void ECP_ECIES_ENCRYPT(ecp_domain *DOM,octet *P1,octet *P2,csprng *RNG,octet *W,octet *M,int tlen,octet *V,octet *C,octet *T)
 { /* Inputs: Input params, random number generator, his public key, the message to be encrypted and the MAC length */
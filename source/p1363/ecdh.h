@@ -78,6 +78,7 @@ typedef struct
 	#define HASHFUNC sha
 	#define SHS_INIT shs_init
 	#define SHS_PROCESS shs_process
+	#define SHS_UPDATE shs_update
 	#define SHS_HASH shs_hash
 	#define HASH_BLOCK 64
 #endif
@@ -86,6 +87,7 @@ typedef struct
 	#define HASHFUNC sha256
 	#define SHS_INIT shs256_init
 	#define SHS_PROCESS shs256_process
+	#define SHS_UPDATE shs256_update
 	#define SHS_HASH shs256_hash
 	#define HASH_BLOCK 64
 #endif
@@ -94,6 +96,7 @@ typedef struct
 	#define HASHFUNC sha384
 	#define SHS_INIT shs384_init
 	#define SHS_PROCESS shs384_process
+	#define SHS_UPDATE shs384_update
 	#define SHS_HASH shs384_hash
 	#define HASH_BLOCK 128
 #endif
@@ -102,10 +105,16 @@ typedef struct
 	#define HASHFUNC sha512
 	#define SHS_INIT shs512_init
 	#define SHS_PROCESS shs512_process
+	#define SHS_UPDATE shs512_update
 	#define SHS_HASH shs512_hash
 	#define HASH_BLOCK 128
 #endif
 
+#define PBKDF2_LANES 8   /* derivations run together by PBKDF2_BATCH */
+
+#define ECDH_MAX_THREADS 64  /* workers used by the batch ECDSA functions */
+#define ECDH_GROUP 4         /* signatures combined by ECPVP_DSA_ALL */
+
 /* ECDH Auxiliary Functions */
 
 extern void CREATE_CSPRNG(csprng *,octet *);
@@ -115,6 +124,7 @@ extern BOOL HMAC(octet *,octet *,int,octet *);
 extern void KDF1(octet *,int,octet *);
 extern void KDF2(octet *,octet *,int,octet *);
 extern void PBKDF2(octet *,octet *,int,int,octet *);
+extern void PBKDF2_BATCH(int,octet **,octet **,int,int,octet **);
 extern void AES_CBC_IV0_ENCRYPT(octet *,octet *,octet *);
 extern BOOL AES_CBC_IV0_DECRYPT(octet *,octet *,octet *);
 
@@ -137,5 +147,12 @@ extern BOOL ECP_ECIES_DECRYPT(ecp_domain *,octet *,octet *,octet *,octet *,octet
 /* ECDSA functions */
 extern int ECPSP_DSA(ecp_domain *,csprng *,octet *,octet *,octet *,octet *);
 extern int ECPVP_DSA(ecp_domain *,octet *,octet *,octet *,octet *);
+
+/* Batch ECDSA, on up to ECDH_MAX_THREADS threads. With MR_UNIX_MT the  *
+ * program must call mr_init_threading() before calling these, as each *
+ * worker thread creates its own miracl instance.                       */
+extern int ECPSP_DSA_BATCH(ecp_domain *,csprng *,int,int,octet **,octet **,octet **,octet **,int *);
+extern int ECPVP_DSA_BATCH(ecp_domain *,int,int,octet **,octet **,octet **,octet **,int *);
+extern int ECPVP_DSA_ALL(ecp_domain *,csprng *,int,int,octet **,octet **,octet **,octet **);
 #endif
 
@@ -192,6 +192,33 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 #include <stdlib.h>
 #include "p1363.h"
 
+/* Define P1363_THREADS to compute the two CRT halves of an RSA/RW private  *
+ * key operation on separate POSIX threads, when the primes are at least   *
+ * P1363_CRT_BITS long, and to run IFDP_RSA_BATCH on a pool of threads.    *
+ * This needs MR_GENERIC_MT or MR_UNIX_MT (in which case mr_init_threading()*
+ * must be called first). The second CRT half goes to one of               *
+ * P1363_CRT_WORKERS persistent threads, each with its own MIRACL instance,*
+ * started on first use. If all are busy the caller does both halves.      */
+
+/* #define P1363_THREADS */
+
+#ifdef MR_UNIX_MT
+#define P1363_THREADS
+#endif
+
+#define P1363_CRT_BITS 512
+#define P1363_CRT_WORKERS 4
+
+#ifdef P1363_THREADS
+#if !defined(MR_GENERIC_MT) && !defined(MR_OS_THREADS)
+#error P1363_THREADS needs MR_GENERIC_MT or MR_UNIX_MT
+#endif
+#ifdef MR_STATIC
+#error P1363_THREADS is not available with MR_STATIC
+#endif
+#include <pthread.h>
+#endif
+
 /* Hash IDs for supported EMSA3 hash functions. <hashIDlen>,<hash ID> */
 
 static unsigned char SHA160ID[]={15,0x30,0x21,0x30,0x09,0x06,0x05,0x2b,0x0e,0x03,0x02,0x1a,0x05,0x00,0x04,0x14};
@@ -586,7 +613,8 @@ Returns TRUE if x and/or fp are empty
 static BOOL hash(octet *p,int *n,octet *x,FILE *fp,octet *e,int hash_type,octet *w)
 {
     BOOL result=TRUE;
-    int i,hlen,ch,c[4];
+    int i,hlen,ch;
+    char c[4],buff[HASH_FILE_BUFF];
     sha256 sh32;
 #ifdef mr_unsign64
     sha512 sh64;
@@ -595,10 +623,10 @@ static BOOL hash(octet *p,int *n,octet *x,FILE *fp,octet *e,int hash_type,octet
 
     if (n!=NULL)
     {
-        c[0]=(*n>>24)&0xff;
-        c[1]=(*n>>16)&0xff;
-        c[2]=(*n>>8)&0xff;
-        c[3]=(*n)&0xff;
+        c[0]=(char)((*n>>24)&0xff);
+        c[1]=(char)((*n>>16)&0xff);
+        c[2]=(char)((*n>>8)&0xff);
+        c[3]=(char)((*n)&0xff);
     }
 
     hlen=hash_params(hash_type,NULL);
@@ -613,66 +641,62 @@ static BOOL hash(octet *p,int *n,octet *x,FILE *fp,octet *e,int hash_type,octet
     case SHA1:
         shs_init(&sh32);
         if (p!=NULL)
-            for (i=0;i<p->len;i++) shs_process(&sh32,p->val[i]);
+            shs_update(&sh32,p->val,p->len);
         if (n!=NULL) 
-           for (i=0;i<4;i++) shs_process(&sh32,c[i]);
-        if (x!=NULL)
-            for (i=0;i<x->len;i++) 
-               { shs_process(&sh32,x->val[i]); result=FALSE; }
+           shs_update(&sh32,c,4);
+        if (x!=NULL && x->len>0)
+            { shs_update(&sh32,x->val,x->len); result=FALSE; }
         if (fp!=NULL)
-            while ((ch=fgetc(fp))!=EOF) 
-                { shs_process(&sh32,ch); result=FALSE;}
+            while ((ch=(int)fread(buff,1,HASH_FILE_BUFF,fp))>0) 
+                { shs_update(&sh32,buff,ch); result=FALSE; }
         if (e!=NULL)
-            for (i=0;i<e->len;i++) shs_process(&sh32,e->val[i]);
+            shs_update(&sh32,e->val,e->len);
         shs_hash(&sh32,hh);
         break;
     case SHA256:
         shs256_init(&sh32);
         if (p!=NULL)
-            for (i=0;i<p->len;i++) shs256_process(&sh32,p->val[i]);
+            shs256_update(&sh32,p->val,p->len);
         if (n!=NULL) 
-           for (i=0;i<4;i++) shs256_process(&sh32,c[i]);
-        if (x!=NULL)
-            for (i=0;i<x->len;i++) 
-                 { shs256_process(&sh32,x->val[i]); result=FALSE; }
+           shs256_update(&sh32,c,4);
+        if (x!=NULL && x->len>0)
+            { shs256_update(&sh32,x->val,x->len); result=FALSE; }
         if (fp!=NULL)
-            while ((ch=fgetc(fp))!=EOF) 
-                 { shs256_process(&sh32,ch); result=FALSE; }
+            while ((ch=(int)fread(buff,1,HASH_FILE_BUFF,fp))>0) 
+                 { shs256_update(&sh32,buff,ch); result=FALSE; }
         if (e!=NULL)
-            for (i=0;i<e->len;i++) shs256_process(&sh32,e->val[i]);
+            shs256_update(&sh32,e->val,e->len);
         shs256_hash(&sh32,hh);
         break;
 #ifdef mr_unsign64
     case SHA384:
         shs384_init(&sh64);
         if (p!=NULL)
-            for (i=0;i<p->len;i++) shs384_process(&sh64,p->val[i]);
+            shs384_update(&sh64,p->val,p->len);
         if (n!=NULL) 
-           for (i=0;i<4;i++) shs384_process(&sh64,c[i]);
-        if (x!=NULL)
-            for (i=0;i<x->len;i++) 
-                { shs384_process(&sh64,x->val[i]); result=FALSE; }
+           shs384_update(&sh64,c,4);
+        if (x!=NULL && x->len>0)
+            { shs384_update(&sh64,x->val,x->len); result=FALSE; }
         if (fp!=NULL)
-            while ((ch=fgetc(fp))!=EOF) 
-                { shs384_process(&sh64,ch);  result=FALSE; }
+            while ((ch=(int)fread(buff,1,HASH_FILE_BUFF,fp))>0) 
+                { shs384_update(&sh64,buff,ch); result=FALSE; }
         if (e!=NULL)
-            for (i=0;i<e->len;i++) shs384_process(&sh64,e->val[i]);
+            shs384_update(&sh64,e->val,e->len);
         shs384_hash(&sh64,hh);
         break;
     case SHA512:
         shs512_init(&sh64);
         if (p!=NULL)
-            for (i=0;i<p->len;i++) shs512_process(&sh64,p->val[i]);
+            shs512_update(&sh64,p->val,p->len);
         if (n!=NULL) 
-           for (i=0;i<4;i++) shs512_process(&sh64,c[i]);
-        if (x!=NULL)
-            for (i=0;i<x->len;i++) 
-                 { shs512_process(&sh64,x->val[i]); result=FALSE; }
+           shs512_update(&sh64,c,4);
+        if (x!=NULL && x->len>0)
+            { shs512_update(&sh64,x->val,x->len); result=FALSE; }
         if (fp!=NULL)
-            while ((ch=fgetc(fp))!=EOF) 
-                 { shs512_process(&sh64,ch); result=FALSE; }
+            while ((ch=(int)fread(buff,1,HASH_FILE_BUFF,fp))>0) 
+                 { shs512_update(&sh64,buff,ch); result=FALSE; }
         if (e!=NULL)
-            for (i=0;i<e->len;i++) shs512_process(&sh64,e->val[i]);
+            shs512_update(&sh64,e->val,e->len);
         shs512_hash(&sh64,hh);
         break;
 #endif
@@ -6314,20 +6338,8 @@ P1363_API int IF_KEY_PAIR(BOOL (*idle)(void),csprng *RNG,int bits,int E,if_priva
                 r=remain(_MIPP_ p,8);
                 incr(_MIPP_ p,(3-r)%8,p);
             }
-            do
-            {
-                if (mr_mip->ERNUM) break;
-                if (RW) incr(_MIPP_ p,6,p);
-                incr(_MIPP_ p,1,p);
-                if (RW)
-                {
-                    if (hE==1) r=1;
-                    else r=remain(_MIPP_ p,hE);
-                } 
-                else r=remain(_MIPP_ p,E);
-                incr(_MIPP_ p,1,p);
-                if (r==0) continue;
-            } while (!isprime(_MIPP_ p));
+            if (RW) nxprime_step(_MIPP_ 8,hE,p,p);
+            else    nxprime_step(_MIPP_ 2,E,p,p);
 
             expb2(_MIPP_ bits,t);
             divide(_MIPP_ t,p,t);
@@ -6346,20 +6358,8 @@ P1363_API int IF_KEY_PAIR(BOOL (*idle)(void),csprng *RNG,int bits,int E,if_priva
                 r=remain(_MIPP_ q,8);
                 incr(_MIPP_ q,(7-r)%8,q);
             }
-            do
-            {
-                if (mr_mip->ERNUM) break;
-                if (RW) incr(_MIPP_ q,6,q);
-                incr(_MIPP_ q,1,q);
-                if (RW)
-                {
-                    if (hE==1) r=1;
-                    else r=remain(_MIPP_ q,hE);
-                } 
-                else r=remain(_MIPP_ q,E);
-                incr(_MIPP_ q,1,q);
-                if (r==0) continue;
-            } while (!isprime(_MIPP_ q));
+            if (RW) nxprime_step(_MIPP_ 8,hE,q,q);
+            else    nxprime_step(_MIPP_ 2,E,q,q);
             multiply(_MIPP_ p,q,n);
             if (logb2(_MIPP_ n)!=bits) continue;  /* very rare! */
             decr(_MIPP_ p,1,p1);
@@ -6399,9 +6399,143 @@ P1363_API int IF_KEY_PAIR(BOOL (*idle)(void),csprng *RNG,int bits,int E,if_priva
     else return bytes;
 }
 
+#ifdef P1363_THREADS
+
+typedef struct
+{
+    pthread_mutex_t use;    /* held by the caller of this worker */
+    pthread_mutex_t m;
+    pthread_cond_t cv;
+    BOOL running;
+    int state;              /* 0 idle, 1 job posted, 2 job done */
+    int words,err;
+    big i,d,p,w;
+} crt_worker;
+
+static crt_worker crt_pool[P1363_CRT_WORKERS];
+static pthread_once_t crt_once=PTHREAD_ONCE_INIT;
+
+static void *crt_worker_loop(void *arg)
+{ /* internal:- w=i^d mod p for each job posted, with an instance kept 
+     for the life of the thread and grown as needed */
+    crt_worker *h=(crt_worker *)arg;
+    miracl *mr_mip=NULL;
+    big x,d,p,w;
+    char *mem=NULL;
+    int words=0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&h->m);
+        while (h->state!=1) pthread_cond_wait(&h->cv,&h->m);
+        pthread_mutex_unlock(&h->m);
+
+        if (mr_mip!=NULL && h->words>words)
+        {
+            memkill(_MIPP_ mem,4);
+            mirexit(_MIPPO_ );
+            mr_mip=NULL;
+        }
+        if (mr_mip==NULL)
+        {
+            words=h->words;
+            mr_mip=mirsys(words,0);
+            if (mr_mip!=NULL)
+            {
+                mr_mip->ERCON=TRUE;
+                mem=(char *)memalloc(_MIPP_ 4);
+                if (mem==NULL)
+                {
+                    mirexit(_MIPPO_ );
+                    mr_mip=NULL;
+                }
+            }
+        }
+        if (mr_mip==NULL) h->err=MR_ERR_OUT_OF_MEMORY;
+        else
+        {
+            x=mirvar_mem(_MIPP_ mem,0);
+            d=mirvar_mem(_MIPP_ mem,1);
+            p=mirvar_mem(_MIPP_ mem,2);
+            w=mirvar_mem(_MIPP_ mem,3);
+            copy(h->i,x);
+            copy(h->d,d);
+            copy(h->p,p);
+            powmod(_MIPP_ x,d,p,w);
+            copy(w,h->w);
+            zero(d); zero(p);
+            h->err=mr_mip->ERNUM;
+            mr_mip->ERNUM=0;
+        }
+
+        pthread_mutex_lock(&h->m);
+        h->state=2;
+        pthread_cond_signal(&h->cv);
+        pthread_mutex_unlock(&h->m);
+    }
+    return NULL;
+}
+
+static void crt_start(void)
+{
+    pthread_t tid;
+    int k;
+    for (k=0;k<P1363_CRT_WORKERS;k++)
+    {
+        crt_worker *h=&crt_pool[k];
+        pthread_mutex_init(&h->use,NULL);
+        pthread_mutex_init(&h->m,NULL);
+        pthread_cond_init(&h->cv,NULL);
+        h->state=0;
+        h->running=(pthread_create(&tid,NULL,crt_worker_loop,h)==0);
+        if (h->running) pthread_detach(tid);
+    }
+}
+
+static crt_worker *crt_post(int words,big i,big d,big p,big w)
+{ /* internal:- hand w=i^d mod p to an idle worker. NULL if none */
+    crt_worker *h;
+    int k;
+    pthread_once(&crt_once,crt_start);
+    for (k=0;k<P1363_CRT_WORKERS;k++)
+    {
+        h=&crt_pool[k];
+        if (!h->running || pthread_mutex_trylock(&h->use)!=0) continue;
+        pthread_mutex_lock(&h->m);
+        h->words=words;
+        h->i=i; h->d=d; h->p=p; h->w=w;
+        h->state=1;
+        pthread_cond_signal(&h->cv);
+        pthread_mutex_unlock(&h->m);
+        return h;
+    }
+    return NULL;
+}
+
+static int crt_wait(crt_worker *h)
+{ /* internal:- wait for the job, release the worker, return its error */
+    int err;
+    pthread_mutex_lock(&h->m);
+    while (h->state!=2) pthread_cond_wait(&h->cv,&h->m);
+    h->state=0;
+    err=h->err;
+    pthread_mutex_unlock(&h->m);
+    pthread_mutex_unlock(&h->use);
+    return err;
+}
+
+#endif
+
 static void private_key_op(_MIPD_ big p,big q,big dp,big dq,big c,big i,big s)
 { /* internal:- basic RSA/RW decryption operation */
+#ifdef MR_OS_THREADS
+    miracl *mr_mip=get_mip();
+#endif
     big jp,jq;
+#ifdef P1363_THREADS
+    crt_worker *h=NULL;
+    int err=0;
+#endif
 #ifndef MR_STATIC
     char *mem;
 #else
@@ -6413,8 +6547,18 @@ static void private_key_op(_MIPD_ big p,big q,big dp,big dq,big c,big i,big s)
 #endif
     jp=mirvar_mem(_MIPP_ mem,0);
     jq=mirvar_mem(_MIPP_ mem,1);
+#ifdef P1363_THREADS
+    if (logb2(_MIPP_ q)>=P1363_CRT_BITS)
+    { /* mod q half on a worker thread, mod p half on this one */
+        h=crt_post(mr_mip->nib-1,i,dq,q,jq);
+    }
+    powmod(_MIPP_ i,dp,p,jp);
+    if (h!=NULL) err=crt_wait(h);
+    if (h==NULL || err!=0) powmod(_MIPP_ i,dq,q,jq);
+#else
     powmod(_MIPP_ i,dp,p,jp);
     powmod(_MIPP_ i,dq,q,jq);
+#endif
     subtract(_MIPP_ jp,jq,jp);
     mad(_MIPP_ c,jp,jp,p,p,s);
     if (size(s)<0) add(_MIPP_ s,p,s);
@@ -6937,3 +7081,578 @@ P1363_API int IFVP_RW(BOOL (*idle)(void),if_public_key *PUB,octet *S,octet *F)
     return res;
 }
 
+
+/*** Prepared contexts ***/
+/* As the corresponding primitives, but without the per-call mirsys(), *
+ * decoding of the domain or key, curve set-up and mirexit()           */
+
+#ifndef MR_STATIC
+
+static void *ctx_lock_init(void)
+{ /* lock serializing the calls on a context, NULL if not needed */
+#ifdef P1363_THREADS
+    pthread_mutex_t *m=(pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
+    if (m!=NULL && pthread_mutex_init(m,NULL)!=0)
+    {
+        free(m);
+        m=NULL;
+    }
+    return (void *)m;
+#else
+    return NULL;
+#endif
+}
+
+static void ctx_lock_kill(void *lock)
+{
+#ifdef P1363_THREADS
+    if (lock==NULL) return;
+    pthread_mutex_destroy((pthread_mutex_t *)lock);
+    free(lock);
+#endif
+}
+
+static miracl *ctx_enter(void *lock,miracl *mip)
+{ /* take the context's lock and make its instance current, returning the *
+   * one it replaces                                                      */
+    miracl *old=NULL;
+#ifdef P1363_THREADS
+    if (lock!=NULL) pthread_mutex_lock((pthread_mutex_t *)lock);
+#endif
+#ifndef MR_GENERIC_MT
+    old=get_mip();
+    set_mip(mip);
+#endif
+    return old;
+}
+
+static int ctx_leave(void *lock,miracl *mip,miracl *old,int res)
+{ /* restore the previous instance, clear any error for next time and *
+   * release the lock                                                 */
+    int err=mip->ERNUM;
+    mip->ERNUM=0;
+#ifndef MR_GENERIC_MT
+    set_mip(old);
+#endif
+#ifdef P1363_THREADS
+    if (lock!=NULL) pthread_mutex_unlock((pthread_mutex_t *)lock);
+#endif
+    if (err==MR_ERR_OUT_OF_MEMORY) return MR_P1363_OUT_OF_MEMORY;
+    if (err==MR_ERR_DIV_BY_ZERO) return MR_P1363_DIV_BY_ZERO;
+    if (err!=0) return -(1000+err);
+    return res;
+}
+
+static miracl *ctx_mirsys(int words,miracl **old)
+{
+#ifndef MR_GENERIC_MT
+    *old=get_mip();
+#endif
+    return mirsys(words,0);
+}
+
+static void ctx_mirexit(miracl *mr_mip,miracl *old)
+{
+#ifndef MR_GENERIC_MT
+    set_mip(mr_mip);
+#endif
+    mirexit(_MIPPO_ );
+#ifndef MR_GENERIC_MT
+    set_mip(old);
+#endif
+}
+
+/* DL */
+
+P1363_API int DL_CONTEXT_INIT(BOOL (*idle)(void),dl_context *CTX,dl_domain *DOM)
+{
+    miracl *old=NULL;
+    miracl *mr_mip=ctx_mirsys(DOM->words,&old);
+    int res;
+
+    CTX->DOM=DOM;
+    CTX->mip=mr_mip;
+    CTX->mem=NULL;
+    CTX->lock=NULL;
+    if (mr_mip==NULL) return MR_P1363_OUT_OF_MEMORY;
+    CTX->lock=ctx_lock_init();
+    mr_mip->ERCON=TRUE;
+    set_user_function(_MIPP_ idle);
+    CTX->mem=(char *)memalloc(_MIPP_ 11);
+    if (CTX->mem!=NULL)
+    {
+        CTX->q=mirvar_mem(_MIPP_ CTX->mem, 0);
+        CTX->r=mirvar_mem(_MIPP_ CTX->mem, 1);
+        CTX->g=mirvar_mem(_MIPP_ CTX->mem, 2);
+        CTX->s=mirvar_mem(_MIPP_ CTX->mem, 3);
+        CTX->w=mirvar_mem(_MIPP_ CTX->mem, 4);
+        CTX->f=mirvar_mem(_MIPP_ CTX->mem, 5);
+        CTX->c=mirvar_mem(_MIPP_ CTX->mem, 6);
+        CTX->d=mirvar_mem(_MIPP_ CTX->mem, 7);
+        CTX->u=mirvar_mem(_MIPP_ CTX->mem, 8);
+        CTX->v=mirvar_mem(_MIPP_ CTX->mem, 9);
+        CTX->h2=mirvar_mem(_MIPP_ CTX->mem,10);
+
+        OS2FEP(_MIPP_ &DOM->Q,CTX->q);
+        OS2FEP(_MIPP_ &DOM->R,CTX->r);
+        OS2FEP(_MIPP_ &DOM->G,CTX->g);
+        prepare_monty(_MIPP_ CTX->q);
+    }
+    res=ctx_leave(NULL,mr_mip,old,0);
+    if (CTX->mem==NULL) res=MR_P1363_OUT_OF_MEMORY;
+#ifdef P1363_THREADS
+    if (CTX->lock==NULL) res=MR_P1363_OUT_OF_MEMORY;
+#endif
+    if (res!=0) DL_CONTEXT_KILL(CTX);
+    return res;
+}
+
+P1363_API void DL_CONTEXT_KILL(dl_context *CTX)
+{
+    miracl *mr_mip=CTX->mip;
+    miracl *old=NULL;
+    if (mr_mip==NULL) return;
+    old=ctx_enter(NULL,mr_mip);
+    if (CTX->mem!=NULL) memkill(_MIPP_ CTX->mem,11);
+    ctx_mirexit(mr_mip,old);
+    ctx_lock_kill(CTX->lock);
+    CTX->lock=NULL;
+    CTX->mem=NULL;
+    CTX->mip=NULL;
+}
+
+P1363_API int DLSVDP_DH_CTX(dl_context *CTX,octet *S,octet *WD,octet *Z)
+{
+    miracl *mr_mip=CTX->mip;
+    miracl *old=ctx_enter(CTX->lock,mr_mip);
+
+    OS2FEP(_MIPP_ S,CTX->s);
+    OS2FEP(_MIPP_ WD,CTX->w);
+    powmod(_MIPP_ CTX->w,CTX->s,CTX->q,CTX->v);
+    FE2OSP(_MIPP_ CTX->v,CTX->DOM->fsize,Z);
+    zero(CTX->s);
+    zero(CTX->v);
+
+    return ctx_leave(CTX->lock,mr_mip,old,0);
+}
+
+P1363_API int DLSP_DSA_CTX(dl_context *CTX,csprng *RNG,octet *S,octet *F,octet *C,octet *D)
+{
+    miracl *mr_mip=CTX->mip;
+    miracl *old=ctx_enter(CTX->lock,mr_mip);
+    big r=CTX->r,s=CTX->s,f=CTX->f,c=CTX->c,d=CTX->d,u=CTX->u,v=CTX->v;
+
+    OS2FEP(_MIPP_ S,s);
+    OS2FEP(_MIPP_ F,f);
+    do {
+        if (mr_mip->ERNUM) break;
+        zero(d);
+        strong_bigrand(_MIPP_ RNG,r,u);
+
+        if (CTX->DOM->PC.window==0) 
+            powmod(_MIPP_ CTX->g,u,CTX->q,v);
+        else
+            pow_brick(_MIPP_ &CTX->DOM->PC,u,v);
+
+        copy(v,c); 
+        divide(_MIPP_ c,r,r);
+        if (size(c)==0) continue;
+        xgcd(_MIPP_ u,r,u,u,u);
+        mad(_MIPP_ s,c,f,r,r,d);
+        mad(_MIPP_ u,d,u,r,r,d);
+    } while (size(d)==0);
+    if (mr_mip->ERNUM==0)
+    {
+        convert_big_octet(_MIPP_ c,C);
+        convert_big_octet(_MIPP_ d,D);
+    }
+    zero(s);
+    zero(u);
+
+    return ctx_leave(CTX->lock,mr_mip,old,0);
+}
+
+P1363_API int DLVP_DSA_CTX(dl_context *CTX,octet *W,octet *C,octet *D,octet *F)
+{
+    miracl *mr_mip=CTX->mip;
+    miracl *old=ctx_enter(CTX->lock,mr_mip);
+    big r=CTX->r,w=CTX->w,f=CTX->f,c=CTX->c,d=CTX->d,h2=CTX->h2;
+    int res=0;
+
+    OS2FEP(_MIPP_ W,w);
+    OS2FEP(_MIPP_ C,c);
+    OS2FEP(_MIPP_ D,d);
+    OS2FEP(_MIPP_ F,f);
+    if (size(c)<1 || size(d)<1 || mr_compare(c,r)>=0 || mr_compare(d,r)>=0) 
+        res=MR_P1363_INVALID;
+    if (res==0)
+    {
+        xgcd(_MIPP_ d,r,d,d,d);
+        mad(_MIPP_ f,d,f,r,r,f);
+        mad(_MIPP_ c,d,c,r,r,h2);
+        powmod2(_MIPP_ CTX->g,f,w,h2,CTX->q,d);
+        divide(_MIPP_ d,r,r);
+        if (mr_compare(d,c)!=0) res=MR_P1363_INVALID;
+    }
+    return ctx_leave(CTX->lock,mr_mip,old,res);
+}
+
+/* EC GF(p) */
+
+P1363_API int ECP_CONTEXT_INIT(BOOL (*idle)(void),ecp_context *CTX,ecp_domain *DOM)
+{
+    miracl *old=NULL;
+    miracl *mr_mip=ctx_mirsys(DOM->words,&old);
+    int res;
+
+    CTX->DOM=DOM;
+    CTX->mip=mr_mip;
+    CTX->mem=CTX->mem1=NULL;
+    CTX->lock=NULL;
+    if (mr_mip==NULL) return MR_P1363_OUT_OF_MEMORY;
+    CTX->lock=ctx_lock_init();
+    mr_mip->ERCON=TRUE;
+    set_user_function(_MIPP_ idle);
+    CTX->mem=(char *)memalloc(_MIPP_ 13);
+    CTX->mem1=(char *)ecp_memalloc(_MIPP_ 3);
+    if (CTX->mem!=NULL && CTX->mem1!=NULL)
+    {
+        CTX->q=mirvar_mem(_MIPP_ CTX->mem, 0);
+        CTX->a=mirvar_mem(_MIPP_ CTX->mem, 1);
+        CTX->b=mirvar_mem(_MIPP_ CTX->mem, 2);
+        CTX->r=mirvar_mem(_MIPP_ CTX->mem, 3);
+        CTX->s=mirvar_mem(_MIPP_ CTX->mem, 4);
+        CTX->wx=mirvar_mem(_MIPP_ CTX->mem, 5);
+        CTX->wy=mirvar_mem(_MIPP_ CTX->mem, 6);
+        CTX->z=mirvar_mem(_MIPP_ CTX->mem, 7);
+        CTX->f=mirvar_mem(_MIPP_ CTX->mem, 8);
+        CTX->c=mirvar_mem(_MIPP_ CTX->mem, 9);
+        CTX->d=mirvar_mem(_MIPP_ CTX->mem, 10);
+        CTX->u=mirvar_mem(_MIPP_ CTX->mem, 11);
+        CTX->h2=mirvar_mem(_MIPP_ CTX->mem,12);
+
+        OS2FEP(_MIPP_ &DOM->Q,CTX->q);
+        OS2FEP(_MIPP_ &DOM->A,CTX->a);
+        OS2FEP(_MIPP_ &DOM->B,CTX->b);
+        OS2FEP(_MIPP_ &DOM->R,CTX->r);
+        OS2FEP(_MIPP_ &DOM->Gx,CTX->wx);
+        OS2FEP(_MIPP_ &DOM->Gy,CTX->wy);
+
+        ecurve_init(_MIPP_ CTX->a,CTX->b,CTX->q,MR_PROJECTIVE);
+        CTX->G=epoint_init_mem(_MIPP_ CTX->mem1,0);
+        CTX->W=epoint_init_mem(_MIPP_ CTX->mem1,1);
+        CTX->P=epoint_init_mem(_MIPP_ CTX->mem1,2);
+        epoint_set(_MIPP_ CTX->wx,CTX->wy,0,CTX->G);
+    }
+    res=ctx_leave(NULL,mr_mip,old,0);
+    if (CTX->mem==NULL || CTX->mem1==NULL) res=MR_P1363_OUT_OF_MEMORY;
+#ifdef P1363_THREADS
+    if (CTX->lock==NULL) res=MR_P1363_OUT_OF_MEMORY;
+#endif
+    if (res!=0) ECP_CONTEXT_KILL(CTX);
+    return res;
+}
+
+P1363_API void ECP_CONTEXT_KILL(ecp_context *CTX)
+{
+    miracl *mr_mip=CTX->mip;
+    miracl *old=NULL;
+    if (mr_mip==NULL) return;
+    old=ctx_enter(NULL,mr_mip);
+    if (CTX->mem!=NULL) memkill(_MIPP_ CTX->mem,13);
+    if (CTX->mem1!=NULL) ecp_memkill(_MIPP_ CTX->mem1,3);
+    ctx_mirexit(mr_mip,old);
+    ctx_lock_kill(CTX->lock);
+    CTX->lock=NULL;
+    CTX->mem=CTX->mem1=NULL;
+    CTX->mip=NULL;
+}
+
+static BOOL ctx_get_point(_MIPD_ ecp_context *CTX,octet *WD,epoint *W)
+{ /* decode a point into W */
+    int bit;
+    if (OS2ECP(_MIPP_ WD,CTX->wx,CTX->wy,CTX->DOM->fsize,&bit))
+        return epoint_set(_MIPP_ CTX->wx,CTX->wx,bit,W);
+    return epoint_set(_MIPP_ CTX->wx,CTX->wy,0,W);
+}
+
+P1363_API int ECPSVDP_DH_CTX(ecp_context *CTX,octet *S,octet *WD,octet *Z)
+{
+    miracl *mr_mip=CTX->mip;
+    miracl *old=ctx_enter(CTX->lock,mr_mip);
+    int res=0;
+
+    OS2FEP(_MIPP_ S,CTX->s);
+    if (!ctx_get_point(_MIPP_ CTX,WD,CTX->W)) res=MR_P1363_ERROR;
+    else
+    {
+        ecurve_mult(_MIPP_ CTX->s,CTX->W,CTX->W);
+        if (CTX->W->marker==MR_EPOINT_INFINITY) res=MR_P1363_ERROR; 
+        else
+        {
+            epoint_get(_MIPP_ CTX->W,CTX->z,CTX->z);
+            FE2OSP(_MIPP_ CTX->z,CTX->DOM->fsize,Z);
+        }
+    }
+    zero(CTX->s);
+    zero(CTX->z);
+
+    return ctx_leave(CTX->lock,mr_mip,old,res);
+}
+
+P1363_API int ECPSP_DSA_CTX(ecp_context *CTX,csprng *RNG,octet *S,octet *F,octet *C,octet *D)
+{
+    miracl *mr_mip=CTX->mip;
+    miracl *old=ctx_enter(CTX->lock,mr_mip);
+    big r=CTX->r,s=CTX->s,f=CTX->f,c=CTX->c,d=CTX->d,u=CTX->u,vx=CTX->z;
+
+    OS2FEP(_MIPP_ S,s);
+    OS2FEP(_MIPP_ F,f);
+    do {
+        if (mr_mip->ERNUM) break;
+        zero(d);
+        strong_bigrand(_MIPP_ RNG,r,u);
+        if (CTX->DOM->PC.window==0)
+        {
+            ecurve_mult(_MIPP_ u,CTX->G,CTX->P);        
+            epoint_get(_MIPP_ CTX->P,vx,vx);
+        }
+        else
+            mul_brick(_MIPP_ &CTX->DOM->PC,u,vx,vx);
+
+        copy(vx,c); 
+        divide(_MIPP_ c,r,r);
+        if (size(c)==0) continue;
+        xgcd(_MIPP_ u,r,u,u,u);
+        mad(_MIPP_ s,c,f,r,r,d);
+        mad(_MIPP_ u,d,u,r,r,d);
+    } while (size(d)==0);
+    if (mr_mip->ERNUM==0)
+    {
+        convert_big_octet(_MIPP_ c,C);
+        convert_big_octet(_MIPP_ d,D);
+    }
+    zero(s);
+    zero(u);
+
+    return ctx_leave(CTX->lock,mr_mip,old,0);
+}
+
+P1363_API int ECPVP_DSA_CTX(ecp_context *CTX,octet *W,octet *C,octet *D,octet *F)
+{
+    miracl *mr_mip=CTX->mip;
+    miracl *old=ctx_enter(CTX->lock,mr_mip);
+    big r=CTX->r,f=CTX->f,c=CTX->c,d=CTX->d,h2=CTX->h2;
+    int res=0;
+
+    OS2FEP(_MIPP_ C,c);
+    OS2FEP(_MIPP_ D,d);
+    OS2FEP(_MIPP_ F,f);
+    if (size(c)<1 || mr_compare(c,r)>=0 || size(d)<1 || mr_compare(d,r)>=0) 
+        res=MR_P1363_INVALID;
+    if (res==0)
+    {
+        xgcd(_MIPP_ d,r,d,d,d);
+        mad(_MIPP_ f,d,f,r,r,f);
+        mad(_MIPP_ c,d,c,r,r,h2);
+
+        if (!ctx_get_point(_MIPP_ CTX,W,CTX->W)) res=MR_P1363_ERROR;
+        else
+        {
+            ecurve_mult2(_MIPP_ f,CTX->G,h2,CTX->W,CTX->P);
+            if (CTX->P->marker==MR_EPOINT_INFINITY) res=MR_P1363_INVALID;
+            else
+            {
+                epoint_get(_MIPP_ CTX->P,d,d);
+                divide(_MIPP_ d,r,r);
+                if (mr_compare(d,c)!=0) res=MR_P1363_INVALID;
+            }
+        }
+    }
+    return ctx_leave(CTX->lock,mr_mip,old,res);
+}
+
+/* RSA - the CRT exponentiations are done in prepared Montgomery contexts *
+ * for p and q                                                            */
+
+P1363_API int IF_CONTEXT_INIT(BOOL (*idle)(void),if_context *CTX,if_private_key *PRIV)
+{
+    miracl *old=NULL;
+    miracl *mr_mip=ctx_mirsys(PRIV->words,&old);
+    int res;
+
+    CTX->PRIV=PRIV;
+    CTX->mip=mr_mip;
+    CTX->mem=NULL;
+    CTX->P.mem=CTX->Q.mem=NULL;
+    CTX->lock=NULL;
+    if (mr_mip==NULL) return MR_P1363_OUT_OF_MEMORY;
+    CTX->lock=ctx_lock_init();
+    mr_mip->ERCON=TRUE;
+    set_user_function(_MIPP_ idle);
+    CTX->mem=(char *)memalloc(_MIPP_ 10);
+    if (CTX->mem!=NULL)
+    {
+        CTX->p=mirvar_mem(_MIPP_ CTX->mem, 0);
+        CTX->q=mirvar_mem(_MIPP_ CTX->mem, 1);
+        CTX->dp=mirvar_mem(_MIPP_ CTX->mem, 2);
+        CTX->dq=mirvar_mem(_MIPP_ CTX->mem, 3);
+        CTX->c=mirvar_mem(_MIPP_ CTX->mem, 4);
+        CTX->n=mirvar_mem(_MIPP_ CTX->mem, 5);
+        CTX->f=mirvar_mem(_MIPP_ CTX->mem, 6);
+        CTX->s=mirvar_mem(_MIPP_ CTX->mem, 7);
+        CTX->jp=mirvar_mem(_MIPP_ CTX->mem, 8);
+        CTX->jq=mirvar_mem(_MIPP_ CTX->mem, 9);
+
+        OS2FEP(_MIPP_ &PRIV->P,CTX->p);
+        OS2FEP(_MIPP_ &PRIV->Q,CTX->q);
+        OS2FEP(_MIPP_ &PRIV->DP,CTX->dp);
+        OS2FEP(_MIPP_ &PRIV->DQ,CTX->dq);
+        OS2FEP(_MIPP_ &PRIV->C,CTX->c);
+        multiply(_MIPP_ CTX->p,CTX->q,CTX->n);
+        monty_init(_MIPP_ &CTX->P,CTX->p);
+        monty_init(_MIPP_ &CTX->Q,CTX->q);
+    }
+    res=ctx_leave(NULL,mr_mip,old,0);
+    if (CTX->mem==NULL) res=MR_P1363_OUT_OF_MEMORY;
+#ifdef P1363_THREADS
+    if (CTX->lock==NULL) res=MR_P1363_OUT_OF_MEMORY;
+#endif
+    if (res!=0) IF_CONTEXT_KILL(CTX);
+    return res;
+}
+
+P1363_API void IF_CONTEXT_KILL(if_context *CTX)
+{
+    miracl *mr_mip=CTX->mip;
+    miracl *old=NULL;
+    if (mr_mip==NULL) return;
+    old=ctx_enter(NULL,mr_mip);
+    monty_end(_MIPP_ &CTX->P);
+    monty_end(_MIPP_ &CTX->Q);
+    if (CTX->mem!=NULL) memkill(_MIPP_ CTX->mem,10);
+    ctx_mirexit(mr_mip,old);
+    ctx_lock_kill(CTX->lock);
+    CTX->lock=NULL;
+    CTX->mem=NULL;
+    CTX->mip=NULL;
+}
+
+static int ctx_private_key_op(if_context *CTX,octet *I,octet *O)
+{ /* as private_key_op() */
+    miracl *mr_mip=CTX->mip;
+    miracl *old=ctx_enter(CTX->lock,mr_mip);
+    big p=CTX->p,q=CTX->q,jp=CTX->jp,jq=CTX->jq,s=CTX->s;
+    int res=0;
+
+    OS2FEP(_MIPP_ I,CTX->f);
+    if (mr_compare(CTX->f,CTX->n)>=0) res=MR_P1363_BAD_ASSUMPTION;
+    if (res==0)
+    {
+        copy(CTX->f,jp);
+        divide(_MIPP_ jp,p,p);
+        monty_use(_MIPP_ &CTX->P);
+        nres(_MIPP_ jp,s);
+        nres_powmod(_MIPP_ s,CTX->dp,jp);
+        redc(_MIPP_ jp,jp);
+
+        copy(CTX->f,jq);
+        divide(_MIPP_ jq,q,q);
+        monty_use(_MIPP_ &CTX->Q);
+        nres(_MIPP_ jq,s);
+        nres_powmod(_MIPP_ s,CTX->dq,jq);
+        redc(_MIPP_ jq,jq);
+        monty_use(_MIPP_ NULL);
+
+        subtract(_MIPP_ jp,jq,jp);
+        mad(_MIPP_ CTX->c,jp,jp,p,p,s);
+        if (size(s)<0) add(_MIPP_ s,p,s);
+        multiply(_MIPP_ s,q,jp);
+        add(_MIPP_ jq,jp,s);
+        convert_big_octet(_MIPP_ s,O);
+    }
+    zero(jp);
+    zero(jq);
+    zero(s);
+    return ctx_leave(CTX->lock,mr_mip,old,res);
+}
+
+P1363_API int IFDP_RSA_CTX(if_context *CTX,octet *G,octet *F)
+{
+    return ctx_private_key_op(CTX,G,F);
+}
+
+P1363_API int IFSP_RSA1_CTX(if_context *CTX,octet *F,octet *S)
+{
+    return ctx_private_key_op(CTX,F,S);
+}
+
+/* Batch RSA decryption. Each worker prepares one context for the key and  *
+ * decrypts its share of the ciphertexts with it.                          */
+
+typedef struct
+{
+    int n,first,step,res;
+    BOOL (*idle)(void);
+    if_private_key *PRIV;
+    octet **G,**F;
+    int *r;
+} if_job;
+
+static void *if_worker(void *arg)
+{
+    if_job *job=(if_job *)arg;
+    if_context ctx;
+    int i,res,err;
+
+    err=job->res=IF_CONTEXT_INIT(job->idle,&ctx,job->PRIV);
+    for (i=job->first;i<job->n;i+=job->step)
+    {
+        if (err!=0) res=err;
+        else res=ctx_private_key_op(&ctx,job->G[i],job->F[i]);
+        if (job->r!=NULL) job->r[i]=res;
+        if (res!=0 && job->res==0) job->res=res;
+    }
+    IF_CONTEXT_KILL(&ctx);
+    return NULL;
+}
+
+/* Decrypt n ciphertexts G[i] to F[i] using threads workers. Per-ciphertext *
+ * results go to res[i] if res is not NULL. Returns 0 if all OK.            */
+
+P1363_API int IFDP_RSA_BATCH(BOOL (*idle)(void),if_private_key *PRIV,int threads,int n,octet **G,octet **F,int *r)
+{
+    if_job job[P1363_MAX_THREADS];
+    int i,res;
+#ifdef P1363_THREADS
+    pthread_t tid[P1363_MAX_THREADS];
+#endif
+    if (n<=0) return 0;
+    if (threads<1) threads=1;
+    if (threads>P1363_MAX_THREADS) threads=P1363_MAX_THREADS;
+    if (threads>n) threads=n;
+
+    for (i=0;i<threads;i++)
+    {
+        job[i].n=n;
+        job[i].first=i;
+        job[i].step=threads;
+        job[i].res=0;
+        job[i].idle=idle;
+        job[i].PRIV=PRIV;
+        job[i].G=G; job[i].F=F;
+        job[i].r=r;
+    }
+#ifdef P1363_THREADS
+    for (i=1;i<threads;i++)
+        if (pthread_create(&tid[i],NULL,if_worker,&job[i])!=0) if_worker(&job[i]);
+    if_worker(&job[0]);
+    for (i=1;i<threads;i++) pthread_join(tid[i],NULL);
+#else
+    for (i=0;i<threads;i++) if_worker(&job[i]);
+#endif
+    for (res=0,i=0;i<threads && res==0;i++) res=job[i].res;
+    return res;
+}
+
+#endif
@@ -91,6 +91,9 @@ typedef int oltype;
 #define MAX_HASH_BYTES 32
 #endif
 
+#define HASH_FILE_BUFF 1024  /* files are hashed in chunks of this size */
+#define P1363_MAX_THREADS 64  /* workers used by IFDP_RSA_BATCH */
+
 /* portable representation of a big positive number */
 
 typedef struct
@@ -181,6 +184,50 @@ typedef struct
     octet C;
 } if_private_key;
 
+#ifndef MR_STATIC
+
+/* Prepared contexts. Each keeps its own miracl instance alive between calls,  *
+ * with the domain or private key decoded and set up in it, and scratch space. *
+ * With P1363_THREADS the calls on a context are serialized by its lock, so it *
+ * may be shared, though threads then wait for each other; otherwise it must   *
+ * only be used by one thread at a time. The domain or key it was made from    *
+ * (including its precomputed table) is only read, so for parallel use each    *
+ * thread should have its own context for the same domain or key.              */
+
+typedef struct
+{
+    dl_domain *DOM;
+    miracl *mip;
+    void *lock;
+    char *mem;
+    big q,r,g;
+    big s,w,f,c,d,u,v,h2;
+} dl_context;
+
+typedef struct
+{
+    ecp_domain *DOM;
+    miracl *mip;
+    void *lock;
+    char *mem,*mem1;
+    big q,a,b,r;
+    big s,wx,wy,z,f,c,d,u,h2;
+    epoint *G,*W,*P;
+} ecp_context;
+
+typedef struct
+{
+    if_private_key *PRIV;
+    miracl *mip;
+    void *lock;
+    char *mem;
+    big p,q,dp,dq,c,n;
+    big f,s,jp,jq;
+    mr_monty P,Q;
+} if_context;
+
+#endif
+
 /* Octet string handlers */
 
 extern P1363_API BOOL OCTET_INIT(octet *,int);
@@ -255,6 +302,14 @@ extern P1363_API int DLVP_NR2(BOOL (*)(void),dl_domain *,octet *,octet *,octet *
 extern P1363_API int DLSP_PV(BOOL (*)(void),dl_domain *,octet *,octet *,octet *,octet *);
 extern P1363_API int DLVP_PV(BOOL (*)(void),dl_domain *,octet *,octet *,octet *,octet *);
 
+#ifndef MR_STATIC
+extern P1363_API int  DL_CONTEXT_INIT(BOOL (*)(void),dl_context *,dl_domain *);
+extern P1363_API void DL_CONTEXT_KILL(dl_context *);
+extern P1363_API int  DLSVDP_DH_CTX(dl_context *,octet *,octet *,octet *);
+extern P1363_API int  DLSP_DSA_CTX(dl_context *,csprng *,octet *,octet *,octet *,octet *);
+extern P1363_API int  DLVP_DSA_CTX(dl_context *,octet *,octet *,octet *,octet *);
+#endif
+
 /* ECP primitives - support functions */
 
 extern P1363_API void ECP_DOMAIN_KILL(ecp_domain *);
@@ -279,6 +334,14 @@ extern P1363_API int ECPVP_NR2(BOOL (*)(void),ecp_domain *,octet *,octet *,octet
 extern P1363_API int ECPSP_PV(BOOL (*)(void),ecp_domain *,octet *,octet *,octet *,octet *);
 extern P1363_API int ECPVP_PV(BOOL (*)(void),ecp_domain *,octet *,octet *,octet *,octet *);
 
+#ifndef MR_STATIC
+extern P1363_API int  ECP_CONTEXT_INIT(BOOL (*)(void),ecp_context *,ecp_domain *);
+extern P1363_API void ECP_CONTEXT_KILL(ecp_context *);
+extern P1363_API int  ECPSVDP_DH_CTX(ecp_context *,octet *,octet *,octet *);
+extern P1363_API int  ECPSP_DSA_CTX(ecp_context *,csprng *,octet *,octet *,octet *,octet *);
+extern P1363_API int  ECPVP_DSA_CTX(ecp_context *,octet *,octet *,octet *,octet *);
+#endif
+
 /* EC2 primitives - support functions */
 
 extern P1363_API void EC2_DOMAIN_KILL(ec2_domain *);
@@ -320,5 +383,13 @@ extern P1363_API int IFVP_RSA2(BOOL (*)(void),if_public_key *,octet *,octet *);
 extern P1363_API int IFSP_RW(BOOL (*)(void),if_private_key *,octet *,octet *);
 extern P1363_API int IFVP_RW(BOOL (*)(void),if_public_key *,octet *,octet *);
 
+#ifndef MR_STATIC
+extern P1363_API int  IF_CONTEXT_INIT(BOOL (*)(void),if_context *,if_private_key *);
+extern P1363_API void IF_CONTEXT_KILL(if_context *);
+extern P1363_API int  IFDP_RSA_CTX(if_context *,octet *,octet *);
+extern P1363_API int  IFSP_RSA1_CTX(if_context *,octet *,octet *);
+extern P1363_API int  IFDP_RSA_BATCH(BOOL (*)(void),if_private_key *,int,int,octet **,octet **,int *);
+#endif
+
 #endif
 
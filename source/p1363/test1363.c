@@ -57,6 +57,9 @@ int main(int argc,char **argv)
     dl_domain dom;
     ecp_domain epdom;
     ec2_domain e2dom;
+    dl_context dlctx;
+    ecp_context epctx;
+    if_context ifctx;
     if_public_key pub;
     if_private_key priv;
     csprng RNG;                  /* Crypto Strong RNG */
@@ -276,6 +279,26 @@ int main(int argc,char **argv)
         printf("*** DL DSA Signature Failed\n");
         return 0;
     }
+
+    res=DL_CONTEXT_INIT(NULL,&dlctx,&dom);
+    if (res==0)
+    {
+        DLSVDP_DH(NULL,&dom,&s1,&w0,&z1);
+        res=DLSVDP_DH_CTX(&dlctx,&s0,&w1,&z2);
+        if (res==0 && !OCTET_COMPARE(&z1,&z2)) res=MR_P1363_ERROR;
+    }
+    if (res==0) res=DLSP_DSA_CTX(&dlctx,&RNG,&s,&f,&c,&d);
+    if (res==0) res=DLVP_DSA(NULL,&dom,&p,&c,&d,&f);
+    if (res==0) res=DLVP_DSA_CTX(&dlctx,&p,&c,&d,&f);
+    if (res==0 && DLVP_DSA_CTX(&dlctx,&w0,&c,&d,&f)!=MR_P1363_INVALID) res=MR_P1363_ERROR;
+    DL_CONTEXT_KILL(&dlctx);
+    if (res==0)
+        printf("DL Context - OK\n");
+    else
+    {
+        printf("*** DL Context Failed\n");
+        return 0;
+    }
     
     res=DLSP_NR(NULL,&dom,&RNG,&s,&f,&c,&d); /* sign it */
     res=DLVP_NR(NULL,&dom,&p,&c,&d,&f1);
@@ -467,6 +490,26 @@ int main(int argc,char **argv)
         return 0;
     } 
 
+    res=ECP_CONTEXT_INIT(NULL,&epctx,&epdom);
+    if (res==0)
+    {
+        ECPSVDP_DH(NULL,&epdom,&s1,&w0,&z1);
+        res=ECPSVDP_DH_CTX(&epctx,&s0,&w1,&z2);
+        if (res==0 && !OCTET_COMPARE(&z1,&z2)) res=MR_P1363_ERROR;
+    }
+    if (res==0) res=ECPSP_DSA_CTX(&epctx,&RNG,&s,&f,&c,&d);
+    if (res==0) res=ECPVP_DSA(NULL,&epdom,&w,&c,&d,&f);
+    if (res==0) res=ECPVP_DSA_CTX(&epctx,&w,&c,&d,&f);
+    if (res==0 && ECPVP_DSA_CTX(&epctx,&w0,&c,&d,&f)!=MR_P1363_INVALID) res=MR_P1363_ERROR;
+    ECP_CONTEXT_KILL(&epctx);
+    if (res==0)
+        printf("ECP Context - OK\n");
+    else
+    {
+        printf("*** ECP Context Failed\n");
+        return 0;
+    }
+
     res=ECPSP_NR(NULL,&epdom,&RNG,&s,&f,&c,&d);
     res=ECPVP_NR(NULL,&epdom,&w,&c,&d,&f1);
 
@@ -730,6 +773,20 @@ int main(int argc,char **argv)
         return 0;
     } 
 
+    res=IF_CONTEXT_INIT(NULL,&ifctx,&priv);
+    if (res==0) res=IFDP_RSA_CTX(&ifctx,&g,&f1);
+    if (res==0 && !OCTET_COMPARE(&f,&f1)) res=MR_P1363_ERROR;
+    if (res==0) res=IFSP_RSA1_CTX(&ifctx,&f,&g);
+    if (res==0 && !OCTET_COMPARE(&s,&g)) res=MR_P1363_ERROR;
+    IF_CONTEXT_KILL(&ifctx);
+    if (res==0)
+        printf("RSA Context - OK\n");
+    else
+    {
+        printf("RSA Context Failed\n");
+        return 0;
+    } 
+
     f.len=20;
     for (i=0;i<20;i++) f.val[i]=i+1;    /* fake a message */
     f.val[19]=12;                       /* =12 mod 16     */
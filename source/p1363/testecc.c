@@ -46,6 +46,26 @@ the CertiVox MIRACL Crypto SDK with a closed source product.               *
 #include <time.h>
 #include "ecdh.h"
 
+#define NB 12       /* signatures in the batch tests */
+#define NT 400      /* and on the small curve */
+
+/* y^2=x^3-3x+122 mod 16007 has prime order 15787, so that the x coordinate *
+ * of a random point is at least the group order about once in 70          */
+
+static void toy_domain(ecp_domain *DOM)
+{
+	static const unsigned char q[]={0x3e,0x87},b[]={0x00,0x7a},r[]={0x3d,0xab},gx[]={0x00,0x02},gy[]={0x1a,0x0a},a[]={0x3e,0x84};
+
+	memset(DOM,0,sizeof(ecp_domain));
+	DOM->nibbles=2*EFS;
+	memcpy(&DOM->Q[EFS-2],q,2);
+	memcpy(&DOM->A[EFS-2],a,2);
+	memcpy(&DOM->B[EFS-2],b,2);
+	memcpy(&DOM->R[EGS-2],r,2);
+	memcpy(&DOM->Gx[EFS-2],gx,2);
+	memcpy(&DOM->Gy[EFS-2],gy,2);
+}
+
 int main(int argc,char **argv)
 {   
     int i,res;
@@ -75,9 +95,16 @@ int main(int argc,char **argv)
 	octet CS={0,sizeof(cs),cs};
 	octet DS={0,sizeof(ds),ds};
 
-    ecp_domain epdom;
+	static char fb[NT][4],cb[NT][EGS],db[NT][EGS];
+	static octet FB[NT],CB[NT],DB[NT],*SP[NT],*WP[NT],*FP[NT],*CP[NT],*DP[NT];
+	static int rb[NT];
+
+    ecp_domain epdom,toydom;
     csprng RNG;                /* Crypto Strong RNG */
                               
+#ifdef MR_UNIX_MT
+    mr_init_threading();        /* batch ECDSA runs on several threads */
+#endif
     RAW.len=100;				/* fake random seed source */
     for (i=0;i<100;i++) RAW.val[i]=i+1;
 
@@ -198,6 +225,68 @@ int main(int argc,char **argv)
 	}
 	else printf("ECDSA Signature/Verification succeeded\n");
 
+	printf("Testing batch ECDSA\n");
+
+	for (i=0;i<NT;i++)
+	{
+		FB[i].len=4; FB[i].max=4; FB[i].val=fb[i];
+		fb[i][0]=fb[i][1]=0; fb[i][2]=(char)(i>>8); fb[i][3]=(char)i;
+		CB[i].len=0; CB[i].max=EGS; CB[i].val=cb[i];
+		DB[i].len=0; DB[i].max=EGS; DB[i].val=db[i];
+		SP[i]=(i%3==0)? &S1 : &S0;
+		WP[i]=(i%3==0)? &W1 : &W0;
+		FP[i]=&FB[i]; CP[i]=&CB[i]; DP[i]=&DB[i];
+	}
+	if (ECPSP_DSA_BATCH(&epdom,&RNG,3,NB,SP,FP,CP,DP,rb)!=0)
+	{
+		printf("***Batch ECDSA Signature Failed\n");
+		return 0;
+	}
+	for (i=0;i<NB;i++)
+	{
+		if (rb[i]!=0 || ECPVP_DSA(&epdom,WP[i],FP[i],CP[i],DP[i])!=0)
+		{
+			printf("***Batch ECDSA Signature %d is invalid\n",i);
+			return 0;
+		}
+	}
+	if (ECPVP_DSA_BATCH(&epdom,3,NB,WP,FP,CP,DP,rb)!=0 || ECPVP_DSA_ALL(&epdom,&RNG,3,NB,WP,FP,CP,DP)!=0)
+	{
+		printf("***Batch ECDSA Verification Failed\n");
+		return 0;
+	}
+
+/* a corrupted signature, then a signature checked with the wrong key */
+
+	db[5][7]^=1;
+	res=ECPVP_DSA_BATCH(&epdom,3,NB,WP,FP,CP,DP,rb);
+	if (res!=ECDH_INVALID || rb[5]!=ECDH_INVALID || rb[4]!=0 || rb[6]!=0 || ECPVP_DSA_ALL(&epdom,&RNG,3,NB,WP,FP,CP,DP)!=ECDH_INVALID)
+	{
+		printf("***Batch ECDSA accepted a corrupted signature\n");
+		return 0;
+	}
+	db[5][7]^=1;
+	WP[10]=&W1;
+	res=ECPVP_DSA_BATCH(&epdom,3,NB,WP,FP,CP,DP,rb);
+	if (res!=ECDH_INVALID || rb[10]!=ECDH_INVALID || rb[9]!=0 || rb[11]!=0 || ECPVP_DSA_ALL(&epdom,&RNG,3,NB,WP,FP,CP,DP)!=ECDH_INVALID)
+	{
+		printf("***Batch ECDSA accepted the wrong public key\n");
+		return 0;
+	}
+
+/* On a small curve many signatures have R with x coordinate c+r */
+
+	toy_domain(&toydom);
+	ECP_KEY_PAIR_GENERATE(&toydom,&RNG,&S0,&W0);
+	ECP_KEY_PAIR_GENERATE(&toydom,&RNG,&S1,&W1);
+	for (i=0;i<NT;i++) WP[i]=(i%3==0)? &W1 : &W0;
+	if (ECPSP_DSA_BATCH(&toydom,&RNG,3,NT,SP,FP,CP,DP,rb)!=0 || ECPVP_DSA_BATCH(&toydom,3,NT,WP,FP,CP,DP,rb)!=0 || ECPVP_DSA_ALL(&toydom,&RNG,3,NT,WP,FP,CP,DP)!=0)
+	{
+		printf("***Batch ECDSA failed on the small curve\n");
+		return 0;
+	}
+	printf("Batch ECDSA Signature/Verification succeeded\n");
+
     ECP_DOMAIN_KILL(&epdom);
 
     KILL_CSPRNG(&RNG);
@@ -1,26 +1,77 @@
 /*
- *   Program to factor big numbers using Pomerance-Silverman-Montgomery  
- *   multiple polynomial quadratic sieve.
+ *   Program to factor big numbers using the self-initialising multiple
+ *   polynomial quadratic sieve, with the large prime variation.
  *   See "The Multiple Polynomial Quadratic Sieve", R.D. Silverman,
- *   Math. Comp. Vol. 48, 177, Jan. 1987, pp329-339
+ *   Math. Comp. Vol. 48, 177, Jan. 1987, pp329-339, and "Factoring
+ *   Integers with the Self-Initializing Quadratic Sieve", S.P. Contini,
+ *   M.A. Thesis, University of Georgia, 1997
+ *
+ *   Dependencies between relations are found using Montgomery's block
+ *   Lanczos method. See "A Block Lanczos Algorithm for Finding
+ *   Dependencies over GF(2)", P.L. Montgomery, Eurocrypt '95, LNCS 921
+ *
+ *   If MIRACL is built with MR_UNIX_MT, THREADS families of polynomials
+ *   are sieved at once, each by a thread with its own MIRACL instance.
+ *   Compile with -D_REENTRANT and link with -lpthread
  */
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h> 
+#include <math.h>
 #include "miracl.h"
+#ifdef MR_UNIX_MT
+#include <pthread.h>
+#endif
 
-#define SSIZE 100000    /* Maximum sieve size            */
+#define SSIZE 65536     /* Sieve block size                     */
+#define MAXS 20         /* Maximum number of primes in A        */
+#define MAXR 2048       /* Relations buffered by each thread    */
+#define MAXF 256        /* Maximum prime factors of a relation  */
+#define LPMULT 128      /* Large primes < LPMULT*largest prime  */
+#define SMALLP 30       /* Smaller primes are not sieved        */
+#define EXTRA 64        /* Relations needed over factor base    */
+#define NB 32           /* Block size for Lanczos               */
+
+#ifdef MR_UNIX_MT
+#ifndef THREADS
+#define THREADS 4
+#endif
+#else
+#undef THREADS
+#define THREADS 1
+#endif
 
-static big NN,TT,DD,RR,VV,PP,XX,YY,DG,IG,AA,BB;
-static big *x,*y,*z,*w;
-static unsigned int **EE,**G;
-static int *epr,*r1,*r2,*rp,*b,*pr,*e,*hash;
-static unsigned char *logp,*sieve;
-static int mm,mlf,jj,nbts,nlp,lp,hmod,hmod2;
-static BOOL partial;
+typedef struct {
+    int s,qi[MAXS];         /* A = product of epr[qi[i]]          */
+    big N,D,A,B,U,T,Q,W,Bl[MAXS];
+    int *r1,*r2,*e,*delta[MAXS];
+    unsigned char *sieve;
+    int nr,nf;              /* relations and factors buffered     */
+    big *u;                 /* u^2 = product of factors mod N     */
+    int *lp,*fs,*f;         /* large prime, start of factors in f */
+} job;
+
+static job work[THREADS];
+
+static big NN,TT,DD,RR,PP,XX,YY;
+static big *x,*z;
+static int **xf,**zf,*xl,*epr,*rp,*pr,*hash,*cnt;
+static unsigned int *used;
+static unsigned char *logp;
+static int mm,mlf,nlp,nrel,maxrel,cap,hmod,hmod2,threshold,ns,qlo,qhi,nused;
+static long M;
+static double alog;
 static miracl *mip;
 
+static miracl *instance(void)
+{ /* all instances must have the same size of big */
+#ifndef MR_FULLWIDTH
+    return mirsys(-50,0);
+#else
+    return mirsys(-50,MAXBASE);
+#endif
+}
+
 int knuth(int mm,int *epr,big N,big D)
 { /* Input number to be factored N and find best multiplier k  *
    * for use over a factor base epr[] of size mm.  Set D=k.N.  */
@@ -71,33 +122,53 @@ int knuth(int mm,int *epr,big N,big D)
     return kk;
 }
 
-BOOL factored(long lptr,big T)
-{ /* factor quadratic residue */
+void relation(job *j,long lx)
+{ /* factor residue at lx, and buffer it if successful */
+    int i,k,p,r,st,lp,*e=j->e;
     BOOL facted;
-    int i,j,r,st;  
-    partial=FALSE;
+
+    if (j->nr>=MAXR || j->nf+MAXF>32*MAXR) return;
+
+    lgconv(lx,j->T);
+    multiply(j->A,j->T,j->U);
+    add(j->U,j->B,j->U);            /* U = Ax+B         */
+    multiply(j->U,j->U,j->T);
+    subtract(j->T,j->D,j->T);
+    divide(j->T,j->A,j->Q);         /* Q = (U^2-kN)/A   */
+    e[0]=0;
+    if (size(j->Q)<0)
+    {
+        e[0]=1;
+        negify(j->Q,j->Q);
+    }
+    for (k=1;k<=mm;k++) e[k]=0;
     facted=FALSE;
-    for (j=1;j<=mm;j++)
-    { /* now attempt complete factorisation of T */
-        r=(int)(lptr%epr[j]);
-        if (r<0) r+=epr[j];
-        if (r!=r1[j] && r!=r2[j]) continue;
-        while (subdiv(T,epr[j],XX)==0)
-        { /* cast out epr[j] */
-            e[j]++;
-            copy(XX,T);
+    lp=1;
+    for (k=1;k<=mm;k++)
+    { /* now attempt complete factorisation of Q */
+        p=epr[k];
+        if (j->r1[k]>=0)
+        { /* primes dividing A are always tried */
+            r=(int)(lx%p);
+            if (r<0) r+=p;
+            if (r!=j->r1[k] && r!=j->r2[k]) continue;
+        }
+        while (subdiv(j->Q,p,j->W)==0)
+        { /* cast out epr[k] */
+            e[k]++;
+            copy(j->W,j->Q);
         }
-        st=size(T);
+        st=size(j->Q);
         if (st==1)
         {
            facted=TRUE;
            break;
         }
-        if (size(XX)<=epr[j])
+        if (size(j->W)<=p)
         { /* st is prime < epr[mm]^2 */
-            if (st>=MR_TOOBIG || (st/epr[mm])>(1+mlf/50)) break;
+            if (st>=MR_TOOBIG || (st/epr[mm])>=LPMULT) break;
             if (st<=epr[mm])
-                for (i=j;i<=mm;i++)
+                for (i=k;i<=mm;i++)
                 if (st==epr[i])
                 {
                     e[i]++;
@@ -106,184 +177,642 @@ BOOL factored(long lptr,big T)
                 }
             if (facted) break;
             lp=st;  /* factored with large prime */
-            partial=TRUE;
             facted=TRUE;
             break;
         }
     }
-    return facted;
+    if (!facted) return;
+
+    divide(j->U,j->N,j->N);
+    if (size(j->U)<0) add(j->U,j->N,j->U);
+    copy(j->U,j->u[j->nr]);
+    j->lp[j->nr]=lp;
+    if (e[0]) j->f[j->nf++]=0;
+    for (k=1;k<=mm;k++)
+        for (i=0;i<e[k];i++) j->f[j->nf++]=k;
+    for (i=0;i<j->s;i++) j->f[j->nf++]=j->qi[i];
+    j->fs[++j->nr]=j->nf;
 }
 
-BOOL gotcha(void)
-{ /* use new factorisation */
-    int r,j,i,k,n,rb,had,hp;
-    unsigned int t;
-    BOOL found;
-    found=TRUE;
-    if (partial)
-    { /* check partial factorisation for usefulness */
+void family(job *j)
+{ /* sieve all 2^(s-1) polynomials (Ax+B)^2-kN for this A */
+    int i,k,l,p,r,t,s1,s2,ai,np,*d;
+    int sg[MAXS];
+    unsigned int a,*SV;
+    unsigned char logpk,*sieve=j->sieve;
+    long la;
+
+    j->nr=j->nf=0;
+    j->fs[0]=0;
+    convert(1,j->A);
+    for (l=0;l<j->s;l++) premult(j->A,epr[j->qi[l]],j->A);
+    zero(j->B);
+    for (l=0;l<j->s;l++)
+    { /* B_l = (A/q).(sqrt(kN).(A/q)^-1 mod q) so B^2=kN mod A */
+        p=epr[j->qi[l]];
+        subdiv(j->A,p,j->W);
+        r=subdiv(j->W,p,j->T);
+        t=smul(rp[j->qi[l]],invers(r,p),p);
+        if (t>p/2) t=p-t;
+        premult(j->W,t,j->Bl[l]);
+        add(j->B,j->Bl[l],j->B);
+        sg[l]=1;
+    }
+    for (k=1;k<=mm;k++)
+    { /* find roots of quadratic mod each prime */
+        p=epr[k];
+        for (l=0;l<j->s;l++) if (j->qi[l]==k) break;
+        if (l<j->s)
+        {
+            j->r1[k]=j->r2[k]=(-1);
+            continue;
+        }
+        ai=invers(subdiv(j->A,p,j->T),p);     /* ai = 1/A mod p */
+        r=subdiv(j->B,p,j->T);
+        j->r1[k]=smul(ai,(rp[k]+p-r)%p,p);
+        j->r2[k]=smul(ai,(p-rp[k]+p-r)%p,p);
+        for (l=0;l<j->s;l++)
+            j->delta[l][k]=smul(ai,(2*subdiv(j->Bl[l],p,j->T))%p,p);
+    }
+
+    np=(1<<(j->s-1));
+    for (i=0;;)
+    {
+        for (la=(-M);la<M;la+=SSIZE)
+        { /* sieve over next period */
+            SV=(unsigned int *)sieve;
+            for (a=0;a<SSIZE/sizeof(int);a++) *SV++=0;
+            for (k=1;k<=mm;k++)
+            { /* sieving with each prime */
+                p=epr[k];
+                if (p<SMALLP || j->r1[k]<0) continue;
+                logpk=logp[k];
+                r=(int)(la%p);
+                s1=(j->r1[k]-r)%p;
+                if (s1<0) s1+=p;
+                s2=(j->r2[k]-r)%p;
+                if (s2<0) s2+=p;
+
+            /* these loops are time-critical */
+
+                for (a=s1;a<SSIZE;a+=p) sieve[a]+=logpk;
+                if (s1==s2) continue;
+                for (a=s2;a<SSIZE;a+=p) sieve[a]+=logpk;
+            }
+            for (a=0;a<SSIZE;a++)
+            { /* main loop - look for fully factored residues */
+                if (sieve[a]<threshold) continue;
+                relation(j,la+a);
+            }
+        }
+        if (++i>=np) break;
+
+    /* next polynomial in Gray code order - just change the sign of one B_l */
+
+        for (l=0;(i>>l)%2==0;l++) ;
+        d=j->delta[l];
+        if (sg[l]>0)
+        {
+            subtract(j->B,j->Bl[l],j->B);
+            subtract(j->B,j->Bl[l],j->B);
+        }
+        else
+        {
+            add(j->B,j->Bl[l],j->B);
+            add(j->B,j->Bl[l],j->B);
+        }
+        for (k=1;k<=mm;k++)
+        {
+            if (j->r1[k]<0) continue;
+            p=epr[k];
+            if (sg[l]>0)
+            {
+                j->r1[k]+=d[k];
+                if (j->r1[k]>=p) j->r1[k]-=p;
+                j->r2[k]+=d[k];
+                if (j->r2[k]>=p) j->r2[k]-=p;
+            }
+            else
+            {
+                j->r1[k]-=d[k];
+                if (j->r1[k]<0) j->r1[k]+=p;
+                j->r2[k]-=d[k];
+                if (j->r2[k]<0) j->r2[k]+=p;
+            }
+        }
+        sg[l]=(-sg[l]);
+    }
+}
+
+#ifdef MR_UNIX_MT
+
+void *worker(void *arg)
+{ /* each thread needs its own MIRACL instance */
+    instance();
+    family((job *)arg);
+    mirexit();
+    return NULL;
+}
+
+#endif
+
+int fbindex(double lg)
+{ /* index of smallest prime in factor base >= e^lg */
+    int lo=2,hi=mm,k;
+    if (lg>log((double)epr[mm])) return mm;
+    while (lo<hi)
+    {
+        k=(lo+hi)/2;
+        if (log((double)epr[k])<lg) lo=k+1;
+        else hi=k;
+    }
+    return lo;
+}
+
+void choose(job *j)
+{ /* choose primes whose product A is close to sqrt(2kN)/M */
+    int i,k,l,t,tries,h,q[MAXS];
+    unsigned int key;
+    double lg;
+    for (tries=0;;tries++)
+    {
+        lg=alog;
+        for (l=0;l<ns;l++)
+        {
+            if (l<ns-1 || ns==1) k=qlo+(int)(brand()%(qhi-qlo+1));
+            else
+            { /* last prime brings A close to optimal */
+                k=fbindex(lg);
+                if (k<qlo) k=qlo;
+                if (k>qhi) k=qhi;
+            }
+            for (;;)
+            { /* avoid repeats, and primes dividing kN */
+                for (i=0;i<l;i++) if (j->qi[i]==k) break;
+                if (i==l && rp[k]!=0) break;
+                if (++k>qhi) k=qlo;
+            }
+            j->qi[l]=k;
+            lg-=log((double)epr[k]);
+        }
+        for (l=0;l<ns;l++) q[l]=j->qi[l];
+        for (l=1;l<ns;l++)
+            for (i=l;i>0 && q[i-1]>q[i];i--) {t=q[i]; q[i]=q[i-1]; q[i-1]=t;}
+        for (key=1,l=0;l<ns;l++) key=key*16777619+q[l];
+        if (key==0) key=1;
+        if (nused>=hmod || tries>100) break;    /* give up checking */
+        for (h=key%hmod;used[h]!=0 && used[h]!=key;h=(h+1)%hmod) ;
+        if (used[h]==0)
+        { /* new A */
+            used[h]=key;
+            nused++;
+            break;
+        }
+    }
+    j->s=ns;
+}
+
+void addrel(big u,int *f,int nf,big v,int *g,int ng,int lp)
+{ /* store relation u.v with factors f[] and g[], and large prime lp */
+    int i,k,*h;
+    big *nx;
+    int **nxf,*nxl;
+    if (nrel>=cap)
+    { /* make more room */
+        k=cap+cap/2;
+        nx=(big *)mr_alloc(k,sizeof(big));
+        nxf=(int **)mr_alloc(k,sizeof(int *));
+        nxl=(int *)mr_alloc(k,sizeof(int));
+        for (i=0;i<cap;i++)
+        {
+            nx[i]=x[i];
+            nxf[i]=xf[i];
+            nxl[i]=xl[i];
+        }
+        for (;i<k;i++) nx[i]=mirvar(0);
+        mr_free(x); mr_free(xf); mr_free(xl);
+        x=nx; xf=nxf; xl=nxl;
+        cap=k;
+    }
+    h=(int *)mr_alloc(nf+ng+1,sizeof(int));
+    h[0]=nf+ng;
+    for (i=0;i<nf;i++) h[i+1]=f[i];
+    for (i=0;i<ng;i++) h[nf+i+1]=g[i];
+    if (v==NULL) copy(u,x[nrel]);
+    else mad(u,v,u,NN,NN,x[nrel]);
+    xf[nrel]=h;
+    xl[nrel]=lp;
+    nrel++;
+}
+
+void merge(job *j)
+{ /* add relations found by a thread, matching up partials */
+    int k,r,lp,had,hp,nf,*f;
+    for (r=0;r<j->nr;r++)
+    {
+        f=&j->f[j->fs[r]];
+        nf=j->fs[r+1]-j->fs[r];
+        lp=j->lp[r];
+        if (lp==1)
+        {
+            addrel(j->u[r],f,nf,NULL,NULL,0,1);
+            continue;
+        }
         had=lp%hmod;
         forever
         { /* hash search for matching large prime */
             hp=hash[had];
-            if (hp<0)
-            { /* failed to find match */
-                found=FALSE;
-                break;
-            }
-            if (pr[hp]==lp) break; /* hash hit! */
+            if (hp<0 || pr[hp]==lp) break;
             had=(had+(hmod2-lp%hmod2))%hmod;
         }
-        if (!found && nlp>=mlf) return FALSE;
+        if (hp>=0)
+        { /* hash hit! */
+            addrel(j->u[r],f,nf,z[hp],&zf[hp][1],zf[hp][0],lp);
+            continue;
+        }
+        if (nlp>=mlf) continue;
+        hash[had]=nlp;
+        pr[nlp]=lp;
+        copy(j->u[r],z[nlp]);
+        zf[nlp]=(int *)mr_alloc(nf+1,sizeof(int));
+        zf[nlp][0]=nf;
+        for (k=0;k<nf;k++) zf[nlp][k+1]=f[k];
+        nlp++;
     }
-    copy(PP,XX);
-    convert(1,YY);
-    for (k=1;k<=mm;k++)
-    { /* build up square part in YY  *
-       * reducing e[k] to 0s and 1s */
-        if (e[k]<2) continue;
-        r=e[k]/2;
-        e[k]%=2;
-        expint(epr[k],r,TT);
-        multiply(TT,YY,YY);
+}
+
+/* Block Lanczos. Column i of the sparse matrix B lists the primes    *
+ * appearing to an odd power in relation i. The symmetric A=B'B is    *
+ * applied to n x NB blocks of bits, held one row per mr_unsign32     */
+
+static void mul_b(int n,int nr,int *cs,int *ci,mr_unsign32 *v,mr_unsign32 *w)
+{ /* w=Bv */
+    int i,k;
+    for (i=0;i<nr;i++) w[i]=0;
+    for (i=0;i<n;i++)
+        for (k=cs[i];k<cs[i+1];k++) w[ci[k]]^=v[i];
+}
+
+static void mul_a(int n,int nr,int *cs,int *ci,mr_unsign32 *v,mr_unsign32 *w,mr_unsign32 *t)
+{ /* w=B'Bv */
+    int i,k;
+    mr_unsign32 s;
+    mul_b(n,nr,cs,ci,v,t);
+    for (i=0;i<n;i++)
+    {
+        for (s=0,k=cs[i];k<cs[i+1];k++) s^=t[ci[k]];
+        w[i]=s;
     }
-/* debug only 
-	printf("\nX= ");
-    cotnum(XX,stdout);
-	printf("Y= ");
-    cotnum(YY,stdout);
-    if (e[0]==1) printf("-1");
-    else printf("1");
-    for (k=1;k<=mm;k++)
+}
+
+static void mul_vm(int n,mr_unsign32 *v,mr_unsign32 *m,mr_unsign32 *w)
+{ /* w+=v.m, m is NB x NB */
+    mr_unsign32 tab[4][256];
+    int i,k,b;
+    for (b=0;b<4;b++)
     {
-        if (e[k]==0) continue;
-        printf(".%d",epr[k]);
+        tab[b][0]=0;
+        for (i=1;i<256;i++)
+        {
+            for (k=0;((i>>k)&1)==0;k++) ;
+            tab[b][i]=tab[b][i&(i-1)]^m[8*b+k];
+        }
     }
-    if (partial) printf(".%d\n",lp);
-    else printf("\n");
-*/
-    if (partial)
-    { /* factored with large prime */
-        if (!found)
-        { /* store new partial factorization */
-            hash[had]=nlp;
-            pr[nlp]=lp;
-            copy(XX,z[nlp]);
-            copy(YY,w[nlp]);
-            for (n=0,rb=0,j=0;j<=mm;j++)
-            {
-                G[nlp][n]|=((e[j]&1)<<rb);
-                if (++rb==nbts) n++,rb=0;
-            }
-            nlp++;
+    for (i=0;i<n;i++)
+        w[i]^=tab[0][v[i]&0xFF]^tab[1][(v[i]>>8)&0xFF]^tab[2][(v[i]>>16)&0xFF]^tab[3][(v[i]>>24)&0xFF];
+}
+
+static void mul_tv(int n,mr_unsign32 *v,mr_unsign32 *w,mr_unsign32 *m)
+{ /* m=v'.w */
+    mr_unsign32 tab[4][256];
+    int i,k,b;
+    for (b=0;b<4;b++)
+        for (i=0;i<256;i++) tab[b][i]=0;
+    for (i=0;i<n;i++)
+    {
+        tab[0][v[i]&0xFF]^=w[i];
+        tab[1][(v[i]>>8)&0xFF]^=w[i];
+        tab[2][(v[i]>>16)&0xFF]^=w[i];
+        tab[3][(v[i]>>24)&0xFF]^=w[i];
+    }
+    for (b=0;b<4;b++)
+        for (k=0;k<8;k++)
+        {
+            m[8*b+k]=0;
+            for (i=1;i<256;i++) if ((i>>k)&1) m[8*b+k]^=tab[b][i];
         }
-        if (found)
-        { /* match found so use as factorization */
-            printf("\b\b\b\b\b\b*");
-            fflush(stdout);
-            mad(XX,z[hp],XX,NN,NN,XX);
-            mad(YY,w[hp],YY,NN,NN,YY);
-            for (n=0,rb=0,j=0;j<=mm;j++)
-            {
-                t=(G[hp][n]>>rb);
-                e[j]+=(t&1);
-                if (e[j]==2)
+}
+
+static void mul_mm(mr_unsign32 *a,mr_unsign32 *b,mr_unsign32 *c)
+{ /* c=a.b, all NB x NB */
+    mr_unsign32 s,t[NB];
+    int i,k;
+    for (i=0;i<NB;i++)
+    {
+        for (s=0,k=0;k<NB;k++) if ((a[i]>>k)&1) s^=b[k];
+        t[i]=s;
+    }
+    for (i=0;i<NB;i++) c[i]=t[i];
+}
+
+static int subspace(mr_unsign32 *t,int *s,int *sl,int dl,mr_unsign32 *winv)
+{ /* choose columns s[] so that s't.s is invertible, preferring those  *
+   * not chosen last time, and find winv = s.(s't.s)^-1.s'. Returns |s| */
+    mr_unsign32 m[NB][2],mask,u;
+    int i,j,c[NB],dim;
+    for (i=0;i<NB;i++)
+    {
+        m[i][0]=t[i];
+        m[i][1]=((mr_unsign32)1<<i);
+    }
+    for (mask=0,i=0;i<dl;i++)
+    {
+        c[NB-1-i]=sl[i];
+        mask|=((mr_unsign32)1<<sl[i]);
+    }
+    for (i=j=0;i<NB;i++) if (!((mask>>i)&1)) c[j++]=i;
+    for (i=dim=0;i<NB;i++)
+    {
+        mask=((mr_unsign32)1<<c[i]);
+        for (j=i;j<NB;j++) if (m[c[j]][0]&mask) break;
+        if (j<NB)
+        { /* pivot found */
+            u=m[c[i]][0]; m[c[i]][0]=m[c[j]][0]; m[c[j]][0]=u;
+            u=m[c[i]][1]; m[c[i]][1]=m[c[j]][1]; m[c[j]][1]=u;
+            for (j=0;j<NB;j++)
+                if (j!=c[i] && (m[j][0]&mask))
                 {
-                    premult(YY,epr[j],YY);
-                    divide(YY,NN,NN);
-                    e[j]=0;
+                    m[j][0]^=m[c[i]][0];
+                    m[j][1]^=m[c[i]][1];
                 }
-                if (++rb==nbts) n++,rb=0;
-            }
-            premult(YY,lp,YY);
-            divide(YY,NN,NN);
+            s[dim++]=c[i];
+            continue;
         }
+        for (j=i;j<NB;j++) if (m[c[j]][1]&mask) break;
+        if (j==NB) return 0;
+        u=m[c[i]][0]; m[c[i]][0]=m[c[j]][0]; m[c[j]][0]=u;
+        u=m[c[i]][1]; m[c[i]][1]=m[c[j]][1]; m[c[j]][1]=u;
+        for (j=0;j<NB;j++)
+            if (j!=c[i] && (m[j][1]&mask))
+            {
+                m[j][0]^=m[c[i]][0];
+                m[j][1]^=m[c[i]][1];
+            }
+        m[c[i]][0]=m[c[i]][1]=0;
     }
-    else 
+    for (i=0;i<NB;i++) winv[i]=m[i][1];
+    return dim;
+}
+
+static int parity(mr_unsign32 w)
+{
+    w^=(w>>16); w^=(w>>8); w^=(w>>4); w^=(w>>2); w^=(w>>1);
+    return (int)(w&1);
+}
+
+mr_unsign32 lanczos(int n,int nr,int *cs,int *ci,mr_unsign32 *dep)
+{ /* find vectors in the nullspace of B, as the columns of dep[].  *
+   * Returns a mask of the columns found, or 0 if it failed        */
+    mr_unsign32 vav[2][NB],va2v[2][NB],winv[3][NB],d[NB],e[NB],f[NB],f2[NB];
+    mr_unsign32 *v[3],*vn,*v0,*y,*xx,*t,*p,**u,tg[2*NB][2],mask0,mask1,ok;
+    int i,k,c,r,nw,iter,dim0,dim1,s[2][NB],piv[2*NB];
+
+    nw=(nr+NB-1)/NB;
+    for (i=0;i<3;i++) v[i]=(mr_unsign32 *)mr_alloc(n,sizeof(mr_unsign32));
+    vn=(mr_unsign32 *)mr_alloc(n,sizeof(mr_unsign32));
+    v0=(mr_unsign32 *)mr_alloc(n,sizeof(mr_unsign32));
+    y=(mr_unsign32 *)mr_alloc(n,sizeof(mr_unsign32));
+    xx=(mr_unsign32 *)mr_alloc(n,sizeof(mr_unsign32));
+    t=(mr_unsign32 *)mr_alloc(nr,sizeof(mr_unsign32));
+    u=(mr_unsign32 **)mr_alloc(2*NB,sizeof(mr_unsign32 *));
+    for (c=0;c<2*NB;c++) u[c]=(mr_unsign32 *)mr_alloc(nw,sizeof(mr_unsign32));
+
+/* solve Ax=Ay for random y, so that A(x+y)=0 */
+
+    for (i=0;i<n;i++) y[i]=(mr_unsign32)brand()^((mr_unsign32)brand()<<16);
+    mul_a(n,nr,cs,ci,y,v[0],t);
+    for (i=0;i<n;i++) v0[i]=v[0][i];
+    for (i=0;i<NB;i++)
     {
-        printf("\b\b\b\b\b\b ");
-        fflush(stdout);
+        vav[1][i]=va2v[1][i]=winv[1][i]=winv[2][i]=0;
+        s[1][i]=i;
     }
-    if (found)
+    dim1=NB;
+    mask1=(~(mr_unsign32)0);
+    ok=0;
+    for (iter=0;iter<n/(NB-4)+10;iter++)
     {
-        for (k=mm;k>=0;k--)
-        { /* use new factorization in search for solution */
-            if (e[k]%2==0) continue;
-            if (b[k]<0)
-            { /* no solution this time */
-                found=FALSE;
-                break;
-            }
-            i=b[k];
-            mad(XX,x[i],XX,NN,NN,XX);    /* This is very inefficient -  */
-            mad(YY,y[i],YY,NN,NN,YY);    /* There must be a better way! */
-            for (n=0,rb=0,j=0;j<=mm;j++)
-            { /* Gaussian elimination */
-                t=(EE[i][n]>>rb);
-                e[j]+=(t&1);
-                if (++rb==nbts) n++,rb=0;
-            }
+        mul_a(n,nr,cs,ci,v[0],vn,t);
+        mul_tv(n,v[0],vn,vav[0]);
+        mul_tv(n,vn,vn,va2v[0]);
+        for (i=0;i<NB;i++) if (vav[0][i]!=0) break;
+        if (i==NB)
+        { /* finished */
+            ok=1;
+            break;
         }
-        for (j=0;j<=mm;j++)
-        { /* update YY */
-            if (e[j]<2) continue;
-            convert(epr[j],TT);
-            power(TT,e[j]/2,NN,TT);
-            mad(YY,TT,YY,NN,NN,YY);
+        dim0=subspace(vav[0],s[0],s[1],dim1,winv[0]);
+        if (dim0==0) break;
+        for (mask0=0,i=0;i<dim0;i++) mask0|=((mr_unsign32)1<<s[0][i]);
+
+        for (i=0;i<NB;i++) d[i]=(va2v[0][i]&mask0)^vav[0][i];
+        mul_mm(winv[0],d,d);
+        for (i=0;i<NB;i++) d[i]^=((mr_unsign32)1<<i);
+        mul_mm(winv[1],vav[0],e);
+        for (i=0;i<NB;i++) e[i]&=mask0;
+        mul_mm(vav[1],winv[1],f);
+        for (i=0;i<NB;i++) f[i]^=((mr_unsign32)1<<i);
+        mul_mm(winv[2],f,f);
+        for (i=0;i<NB;i++) f2[i]=((va2v[1][i]&mask1)^vav[1][i])&mask0;
+        mul_mm(f,f2,f);
+
+        for (i=0;i<n;i++) vn[i]&=mask0;
+        mul_vm(n,v[0],d,vn);
+        mul_vm(n,v[1],e,vn);
+        mul_vm(n,v[2],f,vn);
+
+        mul_tv(n,v[0],v0,d);
+        mul_mm(winv[0],d,d);
+        mul_vm(n,v[0],d,xx);
+
+        p=v[2]; v[2]=v[1]; v[1]=v[0]; v[0]=vn; vn=p;
+        for (i=0;i<NB;i++)
+        {
+            winv[2][i]=winv[1][i];
+            winv[1][i]=winv[0][i];
+            vav[1][i]=vav[0][i];
+            va2v[1][i]=va2v[0][i];
+            s[1][i]=s[0][i];
+        }
+        dim1=dim0;
+        mask1=mask0;
+    }
+
+/* B(x+y) and Bv may not quite be 0, but some combination of their columns will be */
+
+    if (ok)
+    {
+        for (i=0;i<n;i++) xx[i]^=y[i];
+        for (c=0;c<2*NB;c++)
+        {
+            for (k=0;k<nw;k++) u[c][k]=0;
+            tg[c][0]=tg[c][1]=0;
+            tg[c][c/NB]=((mr_unsign32)1<<(c%NB));
+            piv[c]=0;
         }
-        if (!found)
-        { /* store details in E, x and y for later */
-            b[k]=jj;
-            copy(XX,x[jj]);
-            copy(YY,y[jj]);
-            for (n=0,rb=0,j=0;j<=mm;j++)
+        mul_b(n,nr,cs,ci,xx,t);
+        for (r=0;r<nr;r++)
+            for (c=0;c<NB;c++) if ((t[r]>>c)&1) u[c][r/NB]|=((mr_unsign32)1<<(r%NB));
+        mul_b(n,nr,cs,ci,v[0],t);
+        for (r=0;r<nr;r++)
+            for (c=0;c<NB;c++) if ((t[r]>>c)&1) u[NB+c][r/NB]|=((mr_unsign32)1<<(r%NB));
+        for (r=0;r<nr;r++)
+        { /* Gaussian elimination on columns */
+            for (c=0;c<2*NB;c++) if (!piv[c] && ((u[c][r/NB]>>(r%NB))&1)) break;
+            if (c==2*NB) continue;
+            piv[c]=1;
+            for (i=0;i<2*NB;i++)
             {
-                EE[jj][n]|=((e[j]&1)<<rb);
-                if (++rb==nbts) n++,rb=0;
+                if (i==c || !((u[i][r/NB]>>(r%NB))&1)) continue;
+                for (k=0;k<nw;k++) u[i][k]^=u[c][k];
+                tg[i][0]^=tg[c][0];
+                tg[i][1]^=tg[c][1];
             }
-            jj++;
-            printf("%5d",jj);
         }
+        for (i=0;i<n;i++) dep[i]=0;
+        for (k=c=0;c<2*NB && k<NB;c++)
+        { /* non-pivot columns are now 0 */
+            if (piv[c]) continue;
+            for (i=0;i<n;i++)
+                if (parity(xx[i]&tg[c][0])^parity(v[0][i]&tg[c][1])) dep[i]|=((mr_unsign32)1<<k);
+            k++;
+        }
+        mul_b(n,nr,cs,ci,dep,t);
+        for (ok=0,i=0;i<n;i++) ok|=dep[i];
+        for (r=0;r<nr;r++) ok&=(~t[r]);
     }
-/*
-    for (i=0;i<mm;i++)
+
+    for (c=0;c<2*NB;c++) mr_free(u[c]);
+    mr_free(u);
+    mr_free(t); mr_free(xx); mr_free(y); mr_free(v0); mr_free(vn);
+    for (i=0;i<3;i++) mr_free(v[i]);
+    return ok;
+}
+
+BOOL solve(void)
+{ /* find dependencies between relations, and try them */
+    int i,j,k,n,nr,cw,*cs,*ci,*wt,*col,*row,*f;
+    mr_unsign32 *dep,mask;
+    BOOL found,more;
+
+    printf("\ntrying...\n");
+    wt=(int *)mr_alloc(mm+1,sizeof(int));
+    row=(int *)mr_alloc(mm+1,sizeof(int));
+    col=(int *)mr_alloc(nrel,sizeof(int));
+    cs=(int *)mr_alloc(nrel+1,sizeof(int));
+    for (cw=0,i=0;i<nrel;i++)
+    { /* primes to odd powers */
+        for (k=1;k<=xf[i][0];k++) cnt[xf[i][k]]^=1;
+        for (k=1;k<=xf[i][0];k++) if (cnt[xf[i][k]]) {cnt[xf[i][k]]=0; cw++;}
+    }
+    ci=(int *)mr_alloc(cw+1,sizeof(int));
+    for (cw=0,i=0;i<nrel;i++)
     {
-        for (j=0;j<1+mm/(8*sizeof(int));j++)
+        cs[i]=cw;
+        for (k=1;k<=xf[i][0];k++) cnt[xf[i][k]]^=1;
+        for (k=1;k<=xf[i][0];k++)
+            if (cnt[xf[i][k]])
+            {
+                cnt[xf[i][k]]=0;
+                ci[cw++]=xf[i][k];
+                wt[xf[i][k]]++;
+            }
+        col[i]=1;
+    }
+    cs[nrel]=cw;
+
+    do
+    { /* remove relations with a prime which appears in no other */
+        more=FALSE;
+        for (i=0;i<nrel;i++)
         {
-            printf("%x",EE[i][j]);
+            if (!col[i]) continue;
+            for (k=cs[i];k<cs[i+1];k++) if (wt[ci[k]]==1) break;
+            if (k==cs[i+1]) continue;
+            col[i]=0;
+            for (k=cs[i];k<cs[i+1];k++) wt[ci[k]]--;
+            more=TRUE;
         }
-        printf("\n");
+    } while (more);
+
+    for (nr=0,k=0;k<=mm;k++) row[k]=(wt[k]>0 ? nr++ : -1);
+    for (n=0,cw=0,i=0;i<nrel;i++)
+    { /* compress */
+        if (!col[i]) continue;
+        j=cs[i];
+        cs[n]=cw;
+        for (k=j;k<cs[i+1];k++) ci[cw++]=row[ci[k]];
+        col[n++]=i;
+        cs[n]=cw;
     }
-*/
-    if (found)
-    { /* check for false alarm */
-        printf("\ntrying...\n");
+    printf("%d relations, %d primes after filtering\n",n,nr);
+    found=FALSE;
+    dep=(mr_unsign32 *)mr_alloc(n+1,sizeof(mr_unsign32));
+    mask=0;
+    if (n>nr+8) for (i=0;i<3 && mask==0;i++) mask=lanczos(n,nr,cs,ci,dep);
+
+    for (j=0;j<NB && !found;j++)
+    { /* try each dependency */
+        if (!((mask>>j)&1)) continue;
+        convert(1,XX);
+        convert(1,YY);
+        for (k=0;k<=mm;k++) cnt[k]=0;
+        for (i=0;i<n;i++)
+        {
+            if (!((dep[i]>>j)&1)) continue;
+            f=xf[col[i]];
+            mad(XX,x[col[i]],XX,NN,NN,XX);
+            for (k=1;k<=f[0];k++) cnt[f[k]]++;
+            if (xl[col[i]]>1)
+            {
+                premult(YY,xl[col[i]],YY);
+                divide(YY,NN,NN);
+            }
+        }
+        for (k=1;k<=mm;k++)
+        { /* build up square part in YY */
+            if (cnt[k]<2) continue;
+            convert(epr[k],TT);
+            power(TT,cnt[k]/2,NN,TT);
+            mad(YY,TT,YY,NN,NN,YY);
+        }
+        for (k=0;k<=mm;k++) cnt[k]=0;
         add(XX,YY,TT);
-        if (mr_compare(XX,YY)==0 || mr_compare(TT,NN)==0) found=FALSE;
-        if (!found) printf("working... %5d",jj);
+        egcd(TT,NN,PP);
+        if (size(PP)!=1 && mr_compare(PP,NN)!=0) found=TRUE;
     }
+    mr_free(dep);
+    mr_free(ci);
+    mr_free(cs);
+    mr_free(col);
+    mr_free(row);
+    mr_free(wt);
+    if (!found) printf("working... %5d",nrel);
     return found;
 }
 
 int initv(void)
 { /* initialize big numbers and arrays */
-    int i,j,d,pak,k,maxp;
+    int i,d,k,t,maxp;
     double dp;
 
-    NN=mirvar(0); 
+    NN=mirvar(0);
     TT=mirvar(0);
     DD=mirvar(0);
     RR=mirvar(0);
-    VV=mirvar(0);
     PP=mirvar(0);
     XX=mirvar(0);
     YY=mirvar(0);
-    DG=mirvar(0);
-    IG=mirvar(0);
-    AA=mirvar(0);
-    BB=mirvar(0);
-
-    nbts=8*sizeof(int);
 
     printf("input number to be factored N= \n");
     d=cinnum(NN,stdin);
@@ -297,7 +826,8 @@ int initv(void)
 
     if (d<8) mm=d;
     else  mm=25;
-    if (d>20) mm=(d*d*d*d)/4096;
+    if (d>20) mm=(3*d*d*d*d)/8192;
+    if (mm<50) mm=50;
 
 /* only half the primes (on average) wil be used, so generate twice as
    many (+ a bit for luck) */
@@ -307,7 +837,7 @@ int initv(void)
     gprime(maxp);
 
     epr=(int *)mr_alloc(mm+1,sizeof(int));
-  
+
     k=knuth(mm,epr,NN,DD);
 
     if (nroot(DD,2,RR))
@@ -324,82 +854,98 @@ int initv(void)
         return (-1);
     }
 
+    for (i=1;i<=mm;i++)
+    { /* small N may have a factor in the factor base */
+        if (subdiv(NN,epr[i],TT)!=0) continue;
+        printf("factors are\n");
+        printf("prime factor     %d\n",epr[i]);
+        if (isprime(TT)) printf("prime factor     ");
+        else             printf("composite factor ");
+        cotnum(TT,stdout);
+        return (-1);
+    }
+
     printf("using multiplier k= %d\n",k);
     printf("and %d small primes as factor base\n",mm);
     gprime(0);   /* reclaim PRIMES space */
 
-    mlf=2*mm;
+    mlf=8*mm;
 
 /* now get space for arrays */
 
-    r1=(int *)mr_alloc((mm+1),sizeof(int));
-    r2=(int *)mr_alloc((mm+1),sizeof(int));
     rp=(int *)mr_alloc((mm+1),sizeof(int));
-    b=(int *)mr_alloc((mm+1),sizeof(int));
-    e=(int *)mr_alloc((mm+1),sizeof(int));
-
+    cnt=(int *)mr_alloc((mm+1),sizeof(int));
     logp=(unsigned char *)mr_alloc(mm+1,1);
 
     pr=(int *)mr_alloc((mlf+1),sizeof(int));
     hash=(int *)mr_alloc((2*mlf+1),sizeof(int));
-
-    sieve=(unsigned char *)mr_alloc(SSIZE+1,1); 
-
-    x=(big *)mr_alloc(mm+1,sizeof(big *));
-    y=(big *)mr_alloc(mm+1,sizeof(big *));
-    z=(big *)mr_alloc(mlf+1,sizeof(big *));
-    w=(big *)mr_alloc(mlf+1,sizeof(big *));
-
-    for (i=0;i<=mm;i++)
-    {
-        x[i]=mirvar(0);
-        y[i]=mirvar(0);
-    }
-    for (i=0;i<=mlf;i++)
-    {
-        z[i]=mirvar(0);
-        w[i]=mirvar(0);
+    used=(unsigned int *)mr_alloc((2*mlf+1),sizeof(int));
+
+    cap=mm+EXTRA+THREADS*MAXR;
+    x=(big *)mr_alloc(cap,sizeof(big));
+    xf=(int **)mr_alloc(cap,sizeof(int *));
+    xl=(int *)mr_alloc(cap,sizeof(int));
+    z=(big *)mr_alloc(mlf+1,sizeof(big));
+    zf=(int **)mr_alloc(mlf+1,sizeof(int *));
+    for (i=0;i<cap;i++) x[i]=mirvar(0);
+    for (i=0;i<=mlf;i++) z[i]=mirvar(0);
+
+    for (t=0;t<THREADS;t++)
+    { /* workspace for each thread */
+        work[t].N=mirvar(0);
+        work[t].D=mirvar(0);
+        copy(NN,work[t].N);
+        copy(DD,work[t].D);
+        work[t].A=mirvar(0);
+        work[t].B=mirvar(0);
+        work[t].U=mirvar(0);
+        work[t].T=mirvar(0);
+        work[t].Q=mirvar(0);
+        work[t].W=mirvar(0);
+        for (i=0;i<MAXS;i++) work[t].Bl[i]=mirvar(0);
+        work[t].r1=(int *)mr_alloc(mm+1,sizeof(int));
+        work[t].r2=(int *)mr_alloc(mm+1,sizeof(int));
+        work[t].e=(int *)mr_alloc(mm+1,sizeof(int));
+        for (i=0;i<MAXS;i++) work[t].delta[i]=NULL;
+        work[t].sieve=(unsigned char *)mr_alloc(SSIZE+1,1);
+        work[t].u=(big *)mr_alloc(MAXR,sizeof(big));
+        for (i=0;i<MAXR;i++) work[t].u[i]=mirvar(0);
+        work[t].lp=(int *)mr_alloc(MAXR,sizeof(int));
+        work[t].fs=(int *)mr_alloc(MAXR+1,sizeof(int));
+        work[t].f=(int *)mr_alloc(32*MAXR,sizeof(int));
     }
-
-    EE=(unsigned int **)mr_alloc(mm+1,sizeof(unsigned int *));
-    G=(unsigned int **)mr_alloc(mlf+1,sizeof(unsigned int *));
-    
-    pak=1+mm/(8*sizeof(int));
-    for (i=0;i<=mm;i++)
-    { 
-        b[i]=(-1);
-        EE[i]=(unsigned int *)mr_alloc(pak,sizeof(int));
-    }
-
-    for (i=0;i<=mlf;i++)
-        G[i]=(unsigned int *)mr_alloc(pak,sizeof(int));
     return 1;
 }
- 
+
 int main()
 { /* factoring via quadratic sieve */
-    unsigned int i,j,a,*SV;
-    unsigned char logpi;
-    int k,S,r,s1,s2,s,NS,logm,ptr,threshold,epri;
-    long M,la,lptr;
-#ifndef MR_FULLWIDTH
-    mip=mirsys(-36,0);
-#else
-    mip=mirsys(-36,MAXBASE);
+    int i,k,r,t,d,logm;
+    long la;
+#ifdef MR_UNIX_MT
+    pthread_t tid[THREADS];
+    BOOL started[THREADS];
 #endif
+#ifdef MR_UNIX_MT
+    mr_init_threading();    /* initialize MIRACL for multi-threading */
+#endif
+    mip=instance();
     if (initv()<0) return 0;
 
-    hmod=2*mlf+1;               /* set up hash table */
+    hmod=2*mlf+1;               /* set up hash tables */
     convert(hmod,TT);
     while (!isprime(TT)) decr(TT,2,TT);
     hmod=size(TT);
     hmod2=hmod-2;
     for (k=0;k<hmod;k++) hash[k]=(-1);
+    for (k=0;k<hmod;k++) used[k]=0;
+
+/* sieve over [-M,M) for each polynomial */
 
-    M=50*(long)mm;
-    NS=(int)(M/SSIZE);
-    if (M%SSIZE!=0) NS++;
-    M=SSIZE*(long)NS;
+    d=(int)(logb2(DD)*0.30103);
+    M=SSIZE;
+    if (d>50) M*=2;
+    if (d>70) M*=2;
+    if (d>90) M*=2;
     logm=0;
     la=M;
     while ((la/=2)>0) logm++;   /* logm = log(M) */
@@ -416,116 +962,61 @@ int main()
     if (r==5) logp[1]++;
     if (r==1) logp[1]+=2;
 
-    threshold=logm+logb2(RR)-2*logp[mm];
-
-    jj=0;
-    nlp=0;
-    premult(DD,2,DG);
-    nroot(DG,2,DG);
-    
-    lgconv(M,TT);
-    divide(DG,TT,DG);
-    nroot(DG,2,DG);
-    if (subdiv(DG,2,TT)==0) incr(DG,1,DG);
-    if (subdiv(DG,4,TT)==1) incr(DG,2,DG);
+    threshold=logm+logb2(RR)-2*logp[mm]-6;  /* allow for unsieved small primes */
+
+/* A should be about sqrt(2kN)/M, a product of ns primes of about 2000 */
+
+    alog=((double)logb2(DD)+1.0)*log(2.0)/2.0-log((double)M);
+    ns=(int)(alog/log(2000.0)+0.5);
+    if (ns<1) ns=1;
+    while (ns<MAXS && alog/ns>log((double)epr[mm]/2.0)) ns++;
+    if (ns==MAXS) ns--;
+    qlo=fbindex(alog/ns-log(2.0));
+    qhi=fbindex(alog/ns+log(2.0));
+    if (qlo<3) qlo=3;
+    if (qhi-qlo<2*ns+4)
+    { /* not enough primes to choose from */
+        qlo=3;
+        qhi=mm;
+    }
+    for (t=0;t<THREADS;t++)
+        for (i=0;i<ns;i++) work[t].delta[i]=(int *)mr_alloc(mm+1,sizeof(int));
+
+    nrel=nlp=nused=0;
+    maxrel=mm+EXTRA;
     printf("working...     0");
 
     forever
-    { /* try a new polynomial */
-        r=mip->NTRY;
-        mip->NTRY=1;         /* speed up search for prime */
-        do
-        { /* looking for suitable prime DG = 3 mod 4 */
-            do {
-               incr(DG,4,DG);
-            } while(!isprime(DG));
-            decr(DG,1,TT);
-            subdiv(TT,2,TT);
-            powmod(DD,TT,DG,TT);  /* check D is quad residue */
-        } while (size(TT)!=1);
-        mip->NTRY=r;
-        incr(DG,1,TT);
-        subdiv(TT,4,TT);
-        powmod(DD,TT,DG,BB);
-        negify(DD,TT);
-        mad(BB,BB,TT,DG,TT,TT);
-        negify(TT,TT);
-        premult(BB,2,AA);
-        xgcd(AA,DG,AA,AA,AA);
-        mad(AA,TT,TT,DG,DG,AA);
-        multiply(AA,DG,TT);
-        add(BB,TT,BB);        /* BB^2 = DD mod DG^2 */
-        multiply(DG,DG,AA);   /* AA = DG*DG         */
-        xgcd(DG,DD,IG,IG,IG); /* IG = 1/DG mod DD  */
-
-        r1[0]=r2[0]=0;
-        for (k=1;k<=mm;k++) 
-        { /* find roots of quadratic mod each prime */
-            s=subdiv(BB,epr[k],TT);
-            r=subdiv(AA,epr[k],TT);
-            r=invers(r,epr[k]);     /* r = 1/AA mod p */
-            s1=(epr[k]-s+rp[k]);
-            s2=(epr[k]-s+epr[k]-rp[k]);
-            r1[k]=smul(s1,r,epr[k]);
-            r2[k]=smul(s2,r,epr[k]);
+    { /* sieve another family of polynomials with each thread */
+        for (t=0;t<THREADS;t++) choose(&work[t]);
+#ifdef MR_UNIX_MT
+        for (t=0;t<THREADS;t++)
+            started[t]=(pthread_create(&tid[t],NULL,worker,&work[t])==0);
+        for (t=0;t<THREADS;t++)
+        {
+            if (started[t]) pthread_join(tid[t],NULL);
+            else family(&work[t]);
         }
-
-        for (ptr=(-NS);ptr<NS;ptr++)
-        { /* sieve over next period */
-            la=(long)ptr*SSIZE;
-            SV=(unsigned int *)sieve;
-            for (i=0;i<SSIZE/sizeof(int);i++) *SV++=0;
-            for (k=1;k<=mm;k++)
-            { /* sieving with each prime */
-                epri=epr[k];
-                logpi=logp[k];
-                r=(int)(la%epri);
-                s1=(r1[k]-r)%epri;
-                if (s1<0) s1+=epri;
-                s2=(r2[k]-r)%epri;
-                if (s2<0) s2+=epri;
-
-            /* these loops are time-critical */
-   
-                for (j=s1;j<SSIZE;j+=epri) sieve[j]+=logpi;
-                if (s1==s2) continue;
-                for (j=s2;j<SSIZE;j+=epri) sieve[j]+=logpi;
-            }
-
-            for (a=0;a<SSIZE;a++)
-            { /* main loop - look for fully factored residues */
-                if (sieve[a]<threshold) continue;
-                lptr=la+a;
-                lgconv(lptr,TT);
-                S=0;
-                multiply(AA,TT,TT);           /* TT = AAx + BB      */
-                add(TT,BB,TT);
-                mad(TT,IG,TT,DD,DD,PP);       /* PP = (AAx + BB)/G  */
-                if (size(PP)<0) add(PP,DD,PP);
-                mad(PP,PP,PP,DD,DD,VV);       /* VV = PP^2 mod kN  */
-                absol(TT,TT);
-                if (mr_compare(TT,RR)<0) S=1;    /* check for -ve VV */
-                if (S==1) subtract(DD,VV,VV);
-                copy(VV,TT);
-                e[0]=S;
-                for (k=1;k<=mm;k++) e[k]=0;
-                if (!factored(lptr,TT)) continue;
-                if (gotcha())
-                { /* factors found! */
-                    egcd(TT,NN,PP);
-                    printf("factors are\n");
-                    if (isprime(PP)) printf("prime factor     ");
-                    else          printf("composite factor ");
-                    cotnum(PP,stdout);
-                    divide(NN,PP,NN);
-                    if (isprime(NN)) printf("prime factor     ");
-                    else          printf("composite factor ");
-                    cotnum(NN,stdout);
-                    return 0;
-                }
-            }
+#else
+        family(&work[0]);
+#endif
+        for (t=0;t<THREADS;t++) merge(&work[t]);
+        printf("\b\b\b\b\b%5d",nrel);
+        fflush(stdout);
+        if (nrel<maxrel) continue;
+        if (solve())
+        { /* factors found! */
+            printf("factors are\n");
+            if (isprime(PP)) printf("prime factor     ");
+            else          printf("composite factor ");
+            cotnum(PP,stdout);
+            divide(NN,PP,NN);
+            if (isprime(NN)) printf("prime factor     ");
+            else          printf("composite factor ");
+            cotnum(NN,stdout);
+            return 0;
         }
+        maxrel=nrel+EXTRA;
     }
     return 0;
 }
-